@@ -0,0 +1,69 @@
+#ifndef __BENCH_MARKER__
+#define __BENCH_MARKER__
+/*! \file */
+/**
+ * Benchmark marker protocol between the benchmark image (bench_avr.cpp) and
+ * the simavr harness (host/simbench.cpp).  The image writes the benchmark ID
+ * to GPIOR1 and then a BenchMark to GPIOR0; the harness watches GPIOR0 and
+ * times each START to STOP pair in CPU cycles.  GPIOR0-2 are otherwise unused
+ * by the firmware.  Dependency free so that the harness can include it.
+ */
+
+/// Data space address of GPIOR0 on the ATmega32U4
+#define BENCH_GPIOR0_ADDR 0x3E
+/// Data space address of GPIOR1 on the ATmega32U4
+#define BENCH_GPIOR1_ADDR 0x4A
+
+/**
+ * Values written to GPIOR0.
+ */
+enum BenchMark{
+	BENCH_MARK_START = 1,
+	BENCH_MARK_STOP = 2,
+	/// All benchmarks have run; the harness stops the simulation
+	BENCH_MARK_DONE = 0xFF
+};
+
+/**
+ * Benchmark IDs.  Each START to STOP pair times one unit of the named
+ * operation.  Only append to this list; host/simbench.cpp names them in the
+ * same order.
+ */
+enum BenchId{
+	/// Empty START/STOP pair, subtracted from all other results
+	BENCH_EMPTY = 0,
+	/// One byte through NMEA::decode
+	BENCH_NMEA_BYTE = 1,
+	/// One complete RMC sentence through Sensor_Module::decode
+	BENCH_RMC_SENTENCE = 2,
+	/// One complete GGA sentence through Sensor_Module::decode
+	BENCH_GGA_SENTENCE = 3,
+	/// One Sensor_Module::getPacket
+	BENCH_GET_PACKET = 4,
+	/// One HMC5983::read with the I2C device stubbed out
+	BENCH_COMPASS_READ = 5,
+	/// One LED timer interrupt, through the Timer 1 compare vector
+	BENCH_TIMER_ISR = 6,
+	/// One byte read from Serial1 and passed to Sensor_Module::decode
+	BENCH_UART_BYTE = 7,
+	BENCH__SIZE
+};
+
+#ifdef __AVR__
+#define BENCH_START(id) do{ \
+		__asm__ __volatile__("" ::: "memory"); \
+		GPIOR1 = (id); \
+		GPIOR0 = BENCH_MARK_START; \
+		__asm__ __volatile__("" ::: "memory"); \
+	}while(0)
+
+#define BENCH_STOP() do{ \
+		__asm__ __volatile__("" ::: "memory"); \
+		GPIOR0 = BENCH_MARK_STOP; \
+		__asm__ __volatile__("" ::: "memory"); \
+	}while(0)
+
+#define BENCH_DONE() do{ GPIOR0 = BENCH_MARK_DONE; }while(0)
+#endif
+
+#endif
@@ -0,0 +1,106 @@
+#include "Config_Store.hpp"
+#include <stddef.h>
+#include <string.h>
+#include "HMC5983.hpp"
+#include "ui_core.hpp"
+
+/**
+ * Configuration as it is laid out in EEPROM.
+ */
+typedef struct StoredConfig{
+	uint8_t version;
+	ConfigPacket config;
+	/// CRC of the version and configuration
+	uint16_t crc;
+} StoredConfig;
+
+static_assert(sizeof(StoredConfig) <= CONFIG_EEPROM_SIZE,
+	"stored configuration overlaps the next EEPROM area");
+
+static const uint32_t CONFIG_BAUDS[BAUD__SIZE] PROGMEM = {
+	4800, 9600, 19200, 38400, 57600, 115200
+};
+
+void Config_Store::defaults(ConfigPacket* config){
+	config->output_period_ms = 0;
+	config->output_format = FMT_JSON;
+	config->compass_rate = HMC5983_DATARATE_220HZ;
+	config->compass_averaging = HMC5983_SAMPLEAVERAGE_2;
+	config->gps_rate_hz = 1;
+	config->gps_baud = BAUD_9600;
+	config->gps_timeout_ms = 5000;
+	config->nmea_passthrough = 0;
+	config->mag_batch = 0;
+	config->keyframe_interval = 10;
+	config->gps_assist = 1;
+}
+
+bool Config_Store::load(ConfigPacket* config){
+	StoredConfig stored;
+	pHALSystem->RCT_EEPROMRead(CONFIG_EEPROM_ADDR, &stored, sizeof(stored));
+	if(stored.version != CONFIG_VERSION
+			|| stored.crc != crc16(&stored, offsetof(StoredConfig, crc))){
+		defaults(config);
+		return false;
+	}
+	*config = stored.config;
+	return true;
+}
+
+void Config_Store::save(const ConfigPacket& config){
+	StoredConfig stored;
+	memset(&stored, 0, sizeof(stored));
+	stored.version = CONFIG_VERSION;
+	stored.config = config;
+	stored.crc = crc16(&stored, offsetof(StoredConfig, crc));
+	pHALSystem->RCT_EEPROMWrite(CONFIG_EEPROM_ADDR, &stored, sizeof(stored));
+}
+
+void Config_Store::print(Print* out, const ConfigPacket& config,
+		uint8_t applied, uint8_t rejected){
+	out->print(F("{\"cfg\": 1, \"acc\": "));
+	out->print(applied);
+	out->print(F(", \"rej\": "));
+	out->print(rejected);
+	out->print(F(", \"opr\": "));
+	out->print(config.output_period_ms);
+	out->print(F(", \"ofm\": "));
+	out->print(config.output_format);
+	out->print(F(", \"cdr\": "));
+	out->print(config.compass_rate);
+	out->print(F(", \"cav\": "));
+	out->print(config.compass_averaging);
+	out->print(F(", \"grt\": "));
+	out->print(config.gps_rate_hz);
+	out->print(F(", \"gbd\": "));
+	out->print(baud(config.gps_baud));
+	out->print(F(", \"gto\": "));
+	out->print(config.gps_timeout_ms);
+	out->print(F(", \"nmp\": "));
+	out->print(config.nmea_passthrough);
+	out->print(F(", \"mgb\": "));
+	out->print(config.mag_batch);
+	out->print(F(", \"kfi\": "));
+	out->print(config.keyframe_interval);
+	out->print(F(", \"aid\": "));
+	out->print(config.gps_assist);
+	out->println(F("}"));
+}
+
+uint32_t Config_Store::baud(uint16_t index){
+	if(index >= BAUD__SIZE){
+		index = BAUD_9600;
+	}
+	return pgm_read_dword(&CONFIG_BAUDS[index]);
+}
+
+uint16_t Config_Store::crc16(const void* data, size_t len, uint16_t crc){
+	const uint8_t* p = (const uint8_t*)data;
+	while(len--){
+		crc ^= (uint16_t)*p++ << 8;
+		for(uint8_t i = 0; i < 8; i++){
+			crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+		}
+	}
+	return crc;
+}
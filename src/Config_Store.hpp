@@ -0,0 +1,150 @@
+#ifndef __CONFIG_STORE__
+#define __CONFIG_STORE__
+/*! \file */
+#include <Arduino.h>
+
+/**
+ * EEPROM address of the stored configuration.
+ */
+#define CONFIG_EEPROM_ADDR 0
+
+/**
+ * EEPROM bytes set aside for the stored configuration.
+ */
+#define CONFIG_EEPROM_SIZE 64
+
+/**
+ * Layout version of the stored configuration.  Bump this whenever
+ * ConfigPacket changes so that old settings are discarded rather than
+ * misread.
+ */
+#define CONFIG_VERSION 5
+
+/**
+ * Sensor packet formats.
+ */
+enum OutputFormat{
+	/// Full JSON sensor packet
+	FMT_JSON = 0,
+	/// JSON with position, heading and time only
+	FMT_JSON_SHORT = 1,
+	/// Key frames and varint deltas, see Delta_Packet.hpp
+	FMT_DELTA = 2,
+	FMT__SIZE
+};
+
+/**
+ * Sentence types for the raw NMEA passthrough mask.  Talker IDs are ignored,
+ * so NMEA_PASS_GGA covers GPGGA, GNGGA and so on.
+ */
+enum NMEAPassthrough{
+	NMEA_PASS_GGA = 0x01,
+	NMEA_PASS_RMC = 0x02,
+	NMEA_PASS_GSA = 0x04,
+	NMEA_PASS_GSV = 0x08,
+	NMEA_PASS_VTG = 0x10,
+	NMEA_PASS_ZDA = 0x20,
+	NMEA_PASS_GLL = 0x40,
+	/// Any other sentence, including proprietary ones
+	NMEA_PASS_OTHER = 0x80,
+	NMEA_PASS_ALL = 0xFF
+};
+
+/**
+ * GPS link baud rates.
+ */
+enum ConfigBaud{
+	BAUD_4800 = 0,
+	BAUD_9600 = 1,
+	BAUD_19200 = 2,
+	BAUD_38400 = 3,
+	BAUD_57600 = 4,
+	BAUD_115200 = 5,
+	BAUD__SIZE
+};
+
+/**
+ * Runtime configuration.  The OBC sets these with status keys (see
+ * Status_Module.cpp); every field is a uint16_t so that the status decoder
+ * can store any of them the same way.
+ */
+typedef struct ConfigPacket{
+	/// Least time between sensor packets in ms, 0 to send one per fix
+	uint16_t output_period_ms;
+	/// Sensor packet format, OutputFormat
+	uint16_t output_format;
+	/// Compass data rate, hmc5983_dataRate_t
+	uint16_t compass_rate;
+	/// Compass averaging, hmc5983_sampleAverages_t
+	uint16_t compass_averaging;
+	/// GPS fix rate in Hz
+	uint16_t gps_rate_hz;
+	/// GPS link baud rate, ConfigBaud
+	uint16_t gps_baud;
+	/// Time without a fix before the GPS is reported as initializing, in ms
+	uint16_t gps_timeout_ms;
+	/// Sentences forwarded raw to the OBC, a mask of NMEAPassthrough; 0 for
+	/// none
+	uint16_t nmea_passthrough;
+	/// Raw magnetometer samples per batch packet, 0 for no batches
+	uint16_t mag_batch;
+	/// Most FMT_DELTA frames from one key frame to the next
+	uint16_t keyframe_interval;
+	/// Whether to send the stored last fix to the GPS at boot, 0 or 1
+	uint16_t gps_assist;
+} ConfigPacket;
+
+/**
+ * Configuration store.  The configuration is kept in EEPROM behind a version
+ * and a CRC, and written through the HAL so that host builds can persist it
+ * too.
+ */
+class Config_Store{
+public:
+	/**
+	 * Fills in the compiled in defaults.
+	 * @param config ConfigPacket to fill in
+	 */
+	static void defaults(ConfigPacket* config);
+
+	/**
+	 * Loads the stored configuration.  If nothing valid is stored, the
+	 * defaults are loaded instead.
+	 * @param  config ConfigPacket to fill in
+	 * @return        true if the stored configuration was valid
+	 */
+	static bool load(ConfigPacket* config);
+
+	/**
+	 * Stores a configuration.  Only bytes that differ are written, so saving
+	 * an unchanged configuration costs no EEPROM wear.
+	 * @param config Configuration to store
+	 */
+	static void save(const ConfigPacket& config);
+
+	/**
+	 * Prints a configuration acknowledgement as a JSON packet.
+	 * @param out      Print to write to
+	 * @param config   Configuration now in effect
+	 * @param applied  Number of values applied from the last status message
+	 * @param rejected Number of values rejected from the last status message
+	 */
+	static void print(Print* out, const ConfigPacket& config, uint8_t applied,
+		uint8_t rejected);
+
+	/**
+	 * Baud rate of a ConfigBaud.
+	 */
+	static uint32_t baud(uint16_t index);
+
+	/**
+	 * CRC-16/CCITT-FALSE of a block of memory.
+	 * @param  data Data to checksum
+	 * @param  len  Number of bytes
+	 * @param  crc  Initial value, or the CRC of the preceding data
+	 * @return      CRC of the data
+	 */
+	static uint16_t crc16(const void* data, size_t len, uint16_t crc = 0xFFFF);
+};
+
+#endif
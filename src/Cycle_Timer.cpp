@@ -0,0 +1,63 @@
+#include "Cycle_Timer.hpp"
+
+#ifdef RCT_CYCLE_TIMER
+
+#ifdef __AVR__
+
+static volatile uint16_t cycle_timer_overflows = 0;
+
+ISR( TIMER3_OVF_vect ){
+	cycle_timer_overflows++;
+}
+
+void Cycle_Timer::begin(){
+	uint8_t sreg = SREG;
+	cli();
+	// Normal mode, no prescaler.  The Arduino core leaves Timer 3 in 8-bit
+	// PWM mode, so all of the waveform bits must be cleared.
+	TCCR3A = 0;
+	TCCR3B = _BV(CS30);
+	TCNT3 = 0;
+	cycle_timer_overflows = 0;
+	TIFR3 = _BV(TOV3);
+	TIMSK3 = _BV(TOIE3);
+	SREG = sreg;
+}
+
+uint32_t Cycle_Timer::now(){
+	uint8_t sreg = SREG;
+	cli();
+	uint16_t low = TCNT3;
+	uint16_t high = cycle_timer_overflows;
+	// Account for an overflow that is pending but not yet serviced
+	if((TIFR3 & _BV(TOV3)) && low < 0x8000){
+		high++;
+	}
+	SREG = sreg;
+	return ((uint32_t)high << 16) | low;
+}
+
+#else
+#include <time.h>
+
+static uint64_t cycle_timer_start_ns = 0;
+
+static uint64_t monotonic_ns(){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void Cycle_Timer::begin(){
+	cycle_timer_start_ns = monotonic_ns();
+}
+
+uint32_t Cycle_Timer::now(){
+	// Scale to F_CPU so host counts read the same as target cycles
+	uint64_t elapsed = monotonic_ns() - cycle_timer_start_ns;
+	return (uint32_t)(elapsed * (F_CPU / 1000000UL) / 1000UL);
+}
+
+#endif
+
+#endif
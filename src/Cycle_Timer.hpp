@@ -0,0 +1,32 @@
+#ifndef __CYCLE_TIMER__
+#define __CYCLE_TIMER__
+/*! \file */
+#include <Arduino.h>
+
+#if defined(RCT_PROFILE) || defined(RCT_TRACE)
+#define RCT_CYCLE_TIMER
+#endif
+
+/**
+ * Free running CPU cycle counter.  Timer 3 runs unprescaled from the system
+ * clock, and its overflow interrupt extends it to 32 bits, so the counter
+ * wraps every 2^32 / F_CPU seconds (268 s at 16 MHz).  Off target, the
+ * monotonic clock is scaled to F_CPU instead.  Only compiled into instrumented
+ * builds.
+ */
+class Cycle_Timer{
+public:
+	/**
+	 * Starts the counter.  This takes over Timer 3, so analogWrite() on pin 5
+	 * is no longer available.
+	 */
+	static void begin();
+
+	/**
+	 * Returns the current cycle count.  Safe to call from interrupts.
+	 * @return Cycles since begin(), modulo 2^32.
+	 */
+	static uint32_t now();
+};
+
+#endif
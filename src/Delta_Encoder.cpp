@@ -0,0 +1,95 @@
+#include "Delta_Encoder.hpp"
+#include <string.h>
+
+static const char DELTA_BASE64[64] PROGMEM = {
+	'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H', 'I', 'J', 'K', 'L', 'M', 'N', 'O',
+	'P', 'Q', 'R', 'S', 'T', 'U', 'V', 'W', 'X', 'Y', 'Z', 'a', 'b', 'c', 'd',
+	'e', 'f', 'g', 'h', 'i', 'j', 'k', 'l', 'm', 'n', 'o', 'p', 'q', 'r', 's',
+	't', 'u', 'v', 'w', 'x', 'y', 'z', '0', '1', '2', '3', '4', '5', '6', '7',
+	'8', '9', '+', '/'
+};
+
+/**
+ * Appends a varint to a frame.
+ * @return Position after the varint
+ */
+static uint8_t* put_varint(uint8_t* p, uint32_t value){
+	while(value >= 0x80){
+		*p++ = (value & 0x7F) | 0x80;
+		value >>= 7;
+	}
+	*p++ = value;
+	return p;
+}
+
+Delta_Encoder::Delta_Encoder() : seq(0), since_key(0){
+	memset(&previous, 0, sizeof(previous));
+}
+
+void Delta_Encoder::reset(){
+	since_key = 0;
+}
+
+int Delta_Encoder::encode(const DeltaFix& fix, uint8_t interval, char* buf,
+		size_t len){
+	if(since_key >= interval || fix.date != previous.date){
+		since_key = 0;
+	}
+	bool key = since_key == 0;
+
+	uint8_t frame[DELTA_FRAME_MAX];
+	uint8_t* p = frame;
+	*p++ = (key ? DELTA_KEYFRAME : 0) | (fix.fix ? DELTA_FIX : 0)
+		| (fix.run ? DELTA_RUN : 0);
+	*p++ = seq++;
+	if(key){
+		p = put_varint(p, delta_zigzag(fix.lat));
+		p = put_varint(p, delta_zigzag(fix.lon));
+		p = put_varint(p, delta_zigzag(fix.hdg));
+		p = put_varint(p, delta_zigzag(fix.time_cs));
+		p = put_varint(p, fix.uts);
+		p = put_varint(p, fix.date);
+	}else{
+		p = put_varint(p, delta_zigzag(fix.lat - previous.lat));
+		p = put_varint(p, delta_zigzag(fix.lon - previous.lon));
+		p = put_varint(p, delta_zigzag((int32_t)fix.hdg - previous.hdg));
+		p = put_varint(p, delta_zigzag(fix.time_cs - previous.time_cs));
+		p = put_varint(p, delta_zigzag(fix.uts - previous.uts));
+	}
+	*p++ = fix.sat;
+	*p = delta_crc8(frame, p - frame);
+	p++;
+	previous = fix;
+	since_key++;
+
+	// Base64, three bytes to four characters
+	uint8_t frame_len = p - frame;
+	size_t n = 0;
+	if(n + 1 < len){
+		buf[n] = DELTA_MARK;
+	}
+	n++;
+	for(uint8_t i = 0; i < frame_len; i += 3){
+		uint32_t group = (uint32_t)frame[i] << 16;
+		uint8_t chars = 2;
+		if(i + 1 < frame_len){
+			group |= (uint32_t)frame[i + 1] << 8;
+			chars++;
+		}
+		if(i + 2 < frame_len){
+			group |= frame[i + 2];
+			chars++;
+		}
+		for(uint8_t j = 0; j < chars; j++){
+			if(n + 1 < len){
+				buf[n] = pgm_read_byte(&DELTA_BASE64[(group >> (18 - 6 * j))
+					& 0x3F]);
+			}
+			n++;
+		}
+	}
+	if(len > 0){
+		buf[(n < len) ? n : len - 1] = 0;
+	}
+	return n;
+}
@@ -0,0 +1,40 @@
+#ifndef __DELTA_ENCODER__
+#define __DELTA_ENCODER__
+/*! \file */
+#include <Arduino.h>
+#include "Delta_Packet.hpp"
+
+/**
+ * Encoder for the delta position stream described in Delta_Packet.hpp.
+ */
+class Delta_Encoder{
+public:
+	/**
+	 * Constructs an encoder whose first frame is a key frame.
+	 */
+	Delta_Encoder();
+
+	/**
+	 * Makes the next frame a key frame.
+	 */
+	void reset();
+
+	/**
+	 * Encodes a position as a delta stream line, without a line ending.
+	 * @param  fix      Position to encode
+	 * @param  interval Most frames from one key frame to the next
+	 * @param  buf      char buffer in which to store the line
+	 * @param  len      Length of buf
+	 * @return          The number of characters that would have been written
+	 *                  if len had been sufficiently large, not counting the
+	 *                  terminating null character.
+	 */
+	int encode(const DeltaFix& fix, uint8_t interval, char* buf, size_t len);
+private:
+	DeltaFix previous;
+	uint8_t seq;
+	/// Frames since the last key frame, 0 if the next must be one
+	uint8_t since_key;
+};
+
+#endif
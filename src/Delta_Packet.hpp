@@ -0,0 +1,109 @@
+#ifndef __DELTA_PACKET__
+#define __DELTA_PACKET__
+/*! \file
+ * Compact position stream, OutputFormat FMT_DELTA.
+ *
+ * Each sensor packet is sent as one line: DELTA_MARK followed by the base64
+ * (RFC 4648 alphabet, no padding) of a binary frame.
+ *
+ *     header  uint8   DeltaHeader bits
+ *     seq     uint8   incremented for every frame, wrapping
+ *     lat     varint  1e-7 degrees, zigzag
+ *     lon     varint  1e-7 degrees, zigzag
+ *     hdg     varint  degrees, zigzag
+ *     time    varint  GPS time of day in 1/100 s, zigzag
+ *     uts     varint  UIB time of the fix in us, zigzag in delta frames
+ *     date    varint  ddmmyy, key frames only
+ *     sat     uint8   satellites used in the fix
+ *     crc     uint8   delta_crc8() of the bytes before it
+ *
+ * In a key frame, lat, lon, hdg, time and uts are the values themselves; in the
+ * other frames they are the difference from the previous frame.  Varints are
+ * little endian groups of 7 bits, with the top bit set on all but the last.
+ *
+ * A receiver can only apply a delta to the frame right before it, so after a
+ * gap in the sequence numbers it discards frames until the next key frame.
+ * Key frames are sent every ConfigPacket::keyframe_interval frames and
+ * whenever the date changes.
+ */
+#include <stdint.h>
+
+/**
+ * First character of a delta stream line.
+ */
+#define DELTA_MARK '~'
+
+/**
+ * Longest frame in bytes: header, seq, six 5 byte varints, sat and crc.
+ */
+#define DELTA_FRAME_MAX 34
+
+/**
+ * Longest line in characters, not counting the terminating null character.
+ */
+#define DELTA_LINE_MAX (1 + (DELTA_FRAME_MAX * 4 + 2) / 3)
+
+/**
+ * Frame header bits.  Bits not listed here are zero.
+ */
+enum DeltaHeader{
+	/// Values are absolute rather than differences
+	DELTA_KEYFRAME = 0x01,
+	/// At least a 3D fix, Sensor_Module::GPS_FIX_FIX
+	DELTA_FIX = 0x02,
+	/// Run switch state
+	DELTA_RUN = 0x04,
+	DELTA_HEADER_MASK = 0x07
+};
+
+/**
+ * One position as carried by the delta stream.
+ */
+typedef struct DeltaFix{
+	/// Latitude and longitude in 1e-7 degrees
+	int32_t lat;
+	int32_t lon;
+	/// Heading in degrees from magnetic North
+	uint16_t hdg;
+	/// GPS time of day in 1/100 s
+	uint32_t time_cs;
+	/// RCT_Micros() at the start of the fix's RMC sentence
+	uint32_t uts;
+	/// GPS date as the number ddmmyy
+	uint32_t date;
+	/// Satellites used in the fix
+	uint8_t sat;
+	bool fix;
+	bool run;
+} DeltaFix;
+
+/**
+ * Maps a signed value onto an unsigned one so that small magnitudes of either
+ * sign make short varints.
+ */
+inline uint32_t delta_zigzag(int32_t value){
+	return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+/**
+ * Inverse of delta_zigzag().
+ */
+inline int32_t delta_unzigzag(uint32_t value){
+	return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+/**
+ * CRC-8 with polynomial 0x07 and initial value 0.
+ */
+inline uint8_t delta_crc8(const uint8_t* data, uint8_t len){
+	uint8_t crc = 0;
+	while(len--){
+		crc ^= *data++;
+		for(uint8_t i = 0; i < 8; i++){
+			crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+		}
+	}
+	return crc;
+}
+
+#endif
@@ -0,0 +1,168 @@
+#include "Diagnostics.hpp"
+#include <stddef.h>
+
+#ifndef SERIAL_RX_BUFFER_SIZE
+#define SERIAL_RX_BUFFER_SIZE 64
+#endif
+
+/**
+ * Offsets of the free running counters in a DiagnosticsPacket.
+ */
+static const uint8_t DIAG_COUNTER_OFFSETS[DIAG_COUNTERS] PROGMEM = {
+	offsetof(DiagnosticsPacket, gps_overruns),
+	offsetof(DiagnosticsPacket, obc_overruns),
+	offsetof(DiagnosticsPacket, nmea_sentences),
+	offsetof(DiagnosticsPacket, nmea_checksum_errors),
+	offsetof(DiagnosticsPacket, nmea_runaway_resets),
+	offsetof(DiagnosticsPacket, status_messages),
+	offsetof(DiagnosticsPacket, status_resyncs),
+	offsetof(DiagnosticsPacket, status_rejects),
+	offsetof(DiagnosticsPacket, rtcm_frames),
+	offsetof(DiagnosticsPacket, rtcm_crc_errors),
+	offsetof(DiagnosticsPacket, rtcm_dropped),
+	offsetof(DiagnosticsPacket, rtcm_timeouts),
+	offsetof(DiagnosticsPacket, rtcm_bytes),
+	offsetof(DiagnosticsPacket, compass_failures)
+};
+
+Diagnostics::Diagnostics() : last_loop_us(0), rate_start_us(0), loop_count(0),
+		loop_rate(0), loop_max_us(0), last_report_ms(0), setup_us(0),
+		first_packet_ms(0){
+	for(uint8_t i = 0; i < 2; i++){
+		overruns[i] = 0;
+		rx_full[i] = false;
+	}
+}
+
+void Diagnostics::loopTick(uint32_t now_us){
+	uint32_t elapsed = now_us - last_loop_us;
+	last_loop_us = now_us;
+	if(elapsed > loop_max_us){
+		loop_max_us = (elapsed > 0xFFFF) ? 0xFFFF : elapsed;
+	}
+	loop_count++;
+	if(now_us - rate_start_us >= 1000000UL){
+		loop_rate = loop_count;
+		loop_count = 0;
+		rate_start_us = now_us;
+	}
+}
+
+void Diagnostics::checkRX(DiagnosticsPort port, int available){
+	// The ring buffer holds one less than its size
+	bool full = available >= SERIAL_RX_BUFFER_SIZE - 1;
+	if(full && !rx_full[port]){
+		overruns[port]++;
+	}
+	rx_full[port] = full;
+}
+
+void Diagnostics::setupDone(uint32_t now_us){
+	setup_us = now_us;
+	// The first loop iteration is timed from here, not from boot
+	last_loop_us = now_us;
+	rate_start_us = now_us;
+}
+
+void Diagnostics::packetSent(uint32_t now_ms){
+	if(first_packet_ms == 0){
+		// A packet in the very first millisecond still reads as sent
+		first_packet_ms = (now_ms == 0) ? 1 : now_ms;
+	}
+}
+
+bool Diagnostics::reportDue(uint32_t now_ms){
+	if(now_ms - last_report_ms >= DIAG_PERIOD_MS){
+		last_report_ms = now_ms;
+		return true;
+	}
+	return false;
+}
+
+void Diagnostics::getDiagnostics(DiagnosticsPacket* diag){
+	diag->gps_overruns = overruns[DIAG_PORT_GPS];
+	diag->obc_overruns = overruns[DIAG_PORT_OBC];
+	diag->loop_rate = loop_rate;
+	diag->loop_max_us = loop_max_us;
+	diag->boot_setup_us = setup_us;
+	diag->boot_packet_ms = first_packet_ms;
+	loop_max_us = 0;
+}
+
+void Diagnostics::getCounters(const DiagnosticsPacket& diag,
+		uint16_t* counters){
+	const uint8_t* base = (const uint8_t*)&diag;
+	for(uint8_t i = 0; i < DIAG_COUNTERS; i++){
+		uint8_t offset = pgm_read_byte(&DIAG_COUNTER_OFFSETS[i]);
+		counters[i] = *(const uint16_t*)(base + offset);
+	}
+}
+
+void Diagnostics::addCounters(DiagnosticsPacket* diag,
+		const uint16_t* counters){
+	uint8_t* base = (uint8_t*)diag;
+	for(uint8_t i = 0; i < DIAG_COUNTERS; i++){
+		uint8_t offset = pgm_read_byte(&DIAG_COUNTER_OFFSETS[i]);
+		*(uint16_t*)(base + offset) += counters[i];
+	}
+}
+
+void Diagnostics::print(Print* out, const DiagnosticsPacket& diag){
+	out->print(F("{\"dia\": 1, \"gov\": "));
+	out->print(diag.gps_overruns);
+	out->print(F(", \"oov\": "));
+	out->print(diag.obc_overruns);
+	out->print(F(", \"nok\": "));
+	out->print(diag.nmea_sentences);
+	out->print(F(", \"nck\": "));
+	out->print(diag.nmea_checksum_errors);
+	out->print(F(", \"nrw\": "));
+	out->print(diag.nmea_runaway_resets);
+	out->print(F(", \"sok\": "));
+	out->print(diag.status_messages);
+	out->print(F(", \"srs\": "));
+	out->print(diag.status_resyncs);
+	out->print(F(", \"srj\": "));
+	out->print(diag.status_rejects);
+	out->print(F(", \"rfr\": "));
+	out->print(diag.rtcm_frames);
+	out->print(F(", \"rce\": "));
+	out->print(diag.rtcm_crc_errors);
+	out->print(F(", \"rdr\": "));
+	out->print(diag.rtcm_dropped);
+	out->print(F(", \"rto\": "));
+	out->print(diag.rtcm_timeouts);
+	out->print(F(", \"rby\": "));
+	out->print(diag.rtcm_bytes);
+	out->print(F(", \"cmf\": "));
+	out->print(diag.compass_failures);
+	out->print(F(", \"tff\": "));
+	out->print(diag.gps_ttff_ms);
+	out->print(F(", \"aid\": "));
+	out->print(diag.gps_aided);
+	out->print(F(", \"bsu\": "));
+	out->print(diag.boot_setup_us);
+	out->print(F(", \"bcu\": "));
+	out->print(diag.boot_compass_us);
+	out->print(F(", \"bfp\": "));
+	out->print(diag.boot_packet_ms);
+	out->print(F(", \"rsf\": "));
+	out->print(diag.reset_flags);
+	out->print(F(", \"wrs\": "));
+	out->print(diag.warm_restarts);
+	out->print(F(", \"wdr\": "));
+	out->print(diag.watchdog_resets);
+	out->print(F(", \"lhz\": "));
+	out->print(diag.loop_rate);
+	out->print(F(", \"lmx\": "));
+	out->print(diag.loop_max_us);
+	out->print(F(", \"brk\": "));
+	out->print(diag.heap_break);
+	out->print(F(", \"fre\": "));
+	out->print(diag.free_ram);
+	out->print(F(", \"stk\": "));
+	out->print(diag.stack_max);
+	out->print(F(", \"smg\": "));
+	out->print(diag.stack_margin);
+	out->println(F("}"));
+}
@@ -0,0 +1,177 @@
+#ifndef __DIAGNOSTICS__
+#define __DIAGNOSTICS__
+/*! \file */
+#include <Arduino.h>
+
+/**
+ * Period between unsolicited diagnostics packets in ms.
+ */
+#define DIAG_PERIOD_MS 10000
+
+/**
+ * Number of free running counters at the start of a DiagnosticsPacket, from
+ * gps_overruns to compass_failures.
+ */
+#define DIAG_COUNTERS 14
+
+/**
+ * Link and parser health counters.  All counters are free running and wrap at
+ * 65535; the OBC is expected to difference successive packets.
+ */
+typedef struct DiagnosticsPacket{
+	/// Number of times the GPS UART receive buffer was found full
+	uint16_t gps_overruns;
+	/// Number of times the OBC receive buffer was found full
+	uint16_t obc_overruns;
+	/// Number of NMEA sentences accepted
+	uint16_t nmea_sentences;
+	/// Number of NMEA sentences rejected for a bad checksum
+	uint16_t nmea_checksum_errors;
+	/// Number of runaway NMEA sentences discarded
+	uint16_t nmea_runaway_resets;
+	/// Number of status messages received from the OBC
+	uint16_t status_messages;
+	/// Number of times the status parser discarded a partial message
+	uint16_t status_resyncs;
+	/// Number of status values rejected for an unknown key or out of range
+	uint16_t status_rejects;
+	/// Number of RTCM frames queued for the GPS receiver
+	uint16_t rtcm_frames;
+	/// Number of RTCM frames discarded for a bad CRC
+	uint16_t rtcm_crc_errors;
+	/// Number of RTCM frames discarded for lack of room in the transmit ring
+	uint16_t rtcm_dropped;
+	/// Number of partial RTCM frames discarded when their bytes stopped
+	uint16_t rtcm_timeouts;
+	/// Number of RTCM bytes sent to the GPS receiver
+	uint16_t rtcm_bytes;
+	/// Number of failed compass transactions
+	uint16_t compass_failures;
+	/// Time from boot to the first GPS fix in ms, 0 until then
+	uint32_t gps_ttff_ms;
+	/// How the stored last fix was sent to the GPS at boot, a FixAssist
+	uint8_t gps_aided;
+	/// Time from boot to the end of setup() in us
+	uint32_t boot_setup_us;
+	/// Time from boot until the compass was ready in us, 0 until then
+	uint32_t boot_compass_us;
+	/// Time from boot to the first sensor packet in ms, 0 until then
+	uint32_t boot_packet_ms;
+	/// RCT_RESET_* causes of the last reset
+	uint8_t reset_flags;
+	/// Resets since power on that kept the RAM
+	uint16_t warm_restarts;
+	/// Watchdog resets since power on
+	uint16_t watchdog_resets;
+	/// Main loop iterations in the last full second
+	uint16_t loop_rate;
+	/// Longest main loop iteration since the last report in us
+	uint16_t loop_max_us;
+	/// Heap break address
+	uint16_t heap_break;
+	/// Bytes currently free between the heap and the stack
+	uint16_t free_ram;
+	/// Deepest stack use since boot in bytes
+	uint16_t stack_max;
+	/// Bytes between the heap and the deepest stack use never touched
+	uint16_t stack_margin;
+} DiagnosticsPacket;
+
+/**
+ * Serial ports monitored for receive overruns.
+ */
+enum DiagnosticsPort{
+	DIAG_PORT_GPS,
+	DIAG_PORT_OBC
+};
+
+/**
+ * Diagnostics Module.  This class tracks serial and main loop health, and
+ * reports it together with the parser counters as a JSON diagnostics packet.
+ */
+class Diagnostics{
+public:
+	/**
+	 * Constructs a new Diagnostics instance with all counters zeroed.
+	 */
+	Diagnostics();
+
+	/**
+	 * Records one main loop iteration.  Call once at the top of every loop,
+	 * after setupDone().
+	 * @param now_us Current time in us
+	 */
+	void loopTick(uint32_t now_us);
+
+	/**
+	 * Samples the receive buffer fill of a serial port.  A full buffer means
+	 * bytes may have been dropped; each run of full samples counts as one
+	 * overrun.
+	 * @param port      Port that was sampled
+	 * @param available Number of bytes waiting in the receive buffer
+	 */
+	void checkRX(DiagnosticsPort port, int available);
+
+	/**
+	 * Records the end of setup().
+	 * @param now_us Current time in us
+	 */
+	void setupDone(uint32_t now_us);
+
+	/**
+	 * Records that a sensor packet was sent.  Only the first one after boot
+	 * is kept.
+	 * @param now_ms Current time in ms
+	 */
+	void packetSent(uint32_t now_ms);
+
+	/**
+	 * Checks whether a periodic report is due.
+	 * @param  now_ms Current time in ms
+	 * @return        true if DIAG_PERIOD_MS has elapsed since the last report
+	 */
+	bool reportDue(uint32_t now_ms);
+
+	/**
+	 * Fills in the serial and loop fields of a diagnostics packet, and starts
+	 * a new reporting period.
+	 * @param diag DiagnosticsPacket to fill in
+	 */
+	void getDiagnostics(DiagnosticsPacket* diag);
+
+	/**
+	 * Copies out the free running counters of a diagnostics packet.
+	 * @param diag     Diagnostics packet to copy from
+	 * @param counters DIAG_COUNTERS values to fill in
+	 */
+	static void getCounters(const DiagnosticsPacket& diag, uint16_t* counters);
+
+	/**
+	 * Adds to the free running counters of a diagnostics packet, so that
+	 * they carry on from the values kept across a reset.
+	 * @param diag     Diagnostics packet to add to
+	 * @param counters DIAG_COUNTERS values to add
+	 */
+	static void addCounters(DiagnosticsPacket* diag, const uint16_t* counters);
+
+	/**
+	 * Writes a diagnostics packet as a single JSON line.
+	 * @param out  Stream to write to
+	 * @param diag Diagnostics packet to write
+	 */
+	static void print(Print* out, const DiagnosticsPacket& diag);
+
+private:
+	uint16_t overruns[2];
+	bool rx_full[2];
+	uint32_t last_loop_us;
+	uint32_t rate_start_us;
+	uint16_t loop_count;
+	uint16_t loop_rate;
+	uint16_t loop_max_us;
+	uint32_t last_report_ms;
+	uint32_t setup_us;
+	uint32_t first_packet_ms;
+};
+
+#endif
@@ -0,0 +1,51 @@
+#include "Fix_Store.hpp"
+#include <stddef.h>
+#include "ui_core.hpp"
+
+static_assert(FIX_EEPROM_ADDR + FIX_SLOTS * sizeof(StoredFix)
+	<= RCT_EEPROM_SIZE, "stored fix slots do not fit in the EEPROM");
+
+Fix_Store::Fix_Store() : slot(0), seq(0), remaining(0), addr(0),
+		last_write_us(0){
+}
+
+bool Fix_Store::load(StoredFix* fix){
+	bool found = false;
+	for(uint8_t i = 0; i < FIX_SLOTS; i++){
+		StoredFix stored;
+		pHALSystem->RCT_EEPROMRead(FIX_EEPROM_ADDR + i * sizeof(StoredFix),
+			&stored, sizeof(stored));
+		if(stored.crc != Config_Store::crc16(&stored,
+				offsetof(StoredFix, crc))){
+			continue;
+		}
+		// Sequence numbers wrap, so compare them by their difference
+		if(!found || (int16_t)(stored.seq - fix->seq) > 0){
+			*fix = stored;
+			slot = (i + 1) % FIX_SLOTS;
+			seq = stored.seq + 1;
+			found = true;
+		}
+	}
+	return found;
+}
+
+void Fix_Store::save(const StoredFix& fix){
+	pending = fix;
+	pending.seq = seq++;
+	pending.crc = Config_Store::crc16(&pending, offsetof(StoredFix, crc));
+	addr = FIX_EEPROM_ADDR + slot * sizeof(StoredFix);
+	remaining = sizeof(StoredFix);
+	slot = (slot + 1) % FIX_SLOTS;
+}
+
+void Fix_Store::service(uint32_t now_us){
+	if(remaining == 0 || now_us - last_write_us < FIX_WRITE_SPACING_US){
+		return;
+	}
+	uint8_t offset = sizeof(StoredFix) - remaining;
+	pHALSystem->RCT_EEPROMWrite(addr + offset, (const uint8_t*)&pending
+		+ offset, 1);
+	remaining--;
+	last_write_us = now_us;
+}
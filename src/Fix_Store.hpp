@@ -0,0 +1,109 @@
+#ifndef __FIX_STORE__
+#define __FIX_STORE__
+/*! \file */
+#include <Arduino.h>
+#include "Config_Store.hpp"
+
+/**
+ * EEPROM address of the stored fix slots, after the configuration.
+ */
+#define FIX_EEPROM_ADDR (CONFIG_EEPROM_ADDR + CONFIG_EEPROM_SIZE)
+
+/**
+ * Number of slots the stored fix rotates through.  Each save goes to the next
+ * slot, so each cell sees one write in FIX_SLOTS saves.
+ */
+#define FIX_SLOTS 32
+
+/**
+ * Least time between saves while the GPS has a fix, in ms.  With FIX_SLOTS
+ * slots this keeps each cell under its 100,000 rated writes for 30 years of
+ * continuous running.
+ */
+#define FIX_SAVE_PERIOD_MS 300000UL
+
+/**
+ * Least time between EEPROM byte writes in us.  A byte takes 3.4 ms to write,
+ * so spacing them out means the main loop never waits on the EEPROM.
+ */
+#define FIX_WRITE_SPACING_US 4000UL
+
+/**
+ * How the GPS receiver was assisted at boot, as reported in
+ * DiagnosticsPacket::gps_aided.
+ */
+enum FixAssist{
+	/// No assistance was sent
+	FIX_ASSIST_NONE = 0,
+	/// Stored position with the time it was stored; the receiver had no time
+	FIX_ASSIST_STORED_TIME = 1,
+	/// Stored position with the receiver's own time
+	FIX_ASSIST_RECEIVER_TIME = 2
+};
+
+/**
+ * Last good fix as it is laid out in an EEPROM slot.
+ */
+typedef struct StoredFix{
+	/// Latitude and longitude in 1e-7 degrees
+	int32_t lat;
+	int32_t lon;
+	/// GPS date as the number ddmmyy
+	uint32_t date;
+	/// GPS time of day in 1/100 s
+	uint32_t time_cs;
+	/// Altitude above mean sea level in m
+	int16_t alt_m;
+	/// Incremented for every save; the newest valid slot wins
+	uint16_t seq;
+	/// CRC of the fields before it
+	uint16_t crc;
+} StoredFix;
+
+/**
+ * Wear levelled store of the last good fix, for GPS assistance at boot.
+ *
+ * Saves are written a byte at a time from service() rather than all at once,
+ * and each goes to a fresh slot.  A save cut short by a reset fails its CRC,
+ * so load() falls back to the slot before it.
+ */
+class Fix_Store{
+public:
+	/**
+	 * Constructs a store that writes to the first slot until load() finds
+	 * the newest one.
+	 */
+	Fix_Store();
+
+	/**
+	 * Finds the newest valid stored fix.  Call once at boot, before save().
+	 * @param  fix StoredFix to fill in
+	 * @return     true if a valid fix was stored
+	 */
+	bool load(StoredFix* fix);
+
+	/**
+	 * Queues a fix to be written to the next slot.  A save still being
+	 * written is abandoned.
+	 * @param fix Fix to store; seq and crc are filled in
+	 */
+	void save(const StoredFix& fix);
+
+	/**
+	 * Writes the next byte of a queued save if the EEPROM is due to be idle.
+	 * Call every loop.
+	 * @param now_us Current time in us
+	 */
+	void service(uint32_t now_us);
+private:
+	StoredFix pending;
+	/// Slot the next save goes to
+	uint8_t slot;
+	uint16_t seq;
+	/// Bytes of pending still to write, 0 if there is nothing queued
+	uint8_t remaining;
+	uint16_t addr;
+	uint32_t last_write_us;
+};
+
+#endif
@@ -12,18 +12,14 @@
 // In other words, we are not making any compensation for the earth's north pole location vs the magnetic measurement
 
 #include "HMC5983.hpp"
-#include <pins_arduino.h>
-#include <Wire.h>
+#include "Profiler.hpp"
+#include "ui_core.hpp"
 
 bool HMC5983::begin(void (*ISR_callback)(), int D){
 
 	DEBUG = D;
 
-	Wire.begin();
-
-	if ((fastRegister8(HMC5983_REG_IDENT_A) != 0x48)
-		|| (fastRegister8(HMC5983_REG_IDENT_B) != 0x34)
-		|| (fastRegister8(HMC5983_REG_IDENT_C) != 0x33)) {
+	if (!identify()) {
 		return false;
 	}
 
@@ -38,8 +34,8 @@ bool HMC5983::begin(void (*ISR_callback)(), int D){
 
 	// Setup DRDY int
 	if (ISR_callback != NULL) {
-		pinMode(3, INPUT_PULLUP);
-		attachInterrupt(digitalPinToInterrupt(3), ISR_callback, FALLING);
+		pHALSystem->RCT_PinMode(3, INPUT_PULLUP);
+		pHALSystem->RCT_AttachInterrupt(3, ISR_callback, FALLING);
 	}
 
 	return true;
@@ -69,6 +65,12 @@ following set of equations:
 	Direction (y=0, x>0) = 0.0
 */
 
+bool HMC5983::identify(void) {
+	return (fastRegister8(HMC5983_REG_IDENT_A) == 0x48)
+		&& (fastRegister8(HMC5983_REG_IDENT_B) == 0x34)
+		&& (fastRegister8(HMC5983_REG_IDENT_C) == 0x33);
+}
+
 void HMC5983::setRange(hmc5983_range_t range) {
 
 		writeRegister8(HMC5983_REG_CONFIG_B, range << 5);
@@ -140,68 +142,56 @@ hmc5983_sampleAverages_t HMC5983::getSampleAverages(void) {
 
 // Write byte to register
 void HMC5983::writeRegister8(uint8_t reg, uint8_t value) {
-	Wire.beginTransmission(HMC5983_ADDRESS);
-			Wire.write(reg);
-			Wire.write(value);
-	Wire.endTransmission();
+	data_pointer = false;
+	uint8_t data[2] = {reg, value};
+	if (pHALSystem->RCT_I2CWrite(HMC5983_ADDRESS, data, 2) != 0) failures++;
 }
 
 // Read byte to register
 uint8_t HMC5983::fastRegister8(uint8_t reg) {
-	uint8_t value;
-	Wire.beginTransmission(HMC5983_ADDRESS);
-			Wire.write(reg);
-	Wire.endTransmission();
-
-	Wire.requestFrom(HMC5983_ADDRESS, 1);
-			value = Wire.read();
+	data_pointer = false;
+	uint8_t value = 0;
+	pHALSystem->RCT_I2CWrite(HMC5983_ADDRESS, &reg, 1);
+	pHALSystem->RCT_I2CRead(HMC5983_ADDRESS, &value, 1);
 
 	return value;
 }
 
 // Read byte from register
 uint8_t HMC5983::readRegister8(uint8_t reg) {
-	uint8_t value;
-	Wire.beginTransmission(HMC5983_ADDRESS);
-			Wire.write(reg);
-	Wire.endTransmission();
-
-	Wire.beginTransmission(HMC5983_ADDRESS);
-	Wire.requestFrom(HMC5983_ADDRESS, 1);
-	while(!Wire.available()) {};
-			value = Wire.read();
+	data_pointer = false;
+	uint8_t value = 0;
+	if ((pHALSystem->RCT_I2CWrite(HMC5983_ADDRESS, &reg, 1) != 0)
+		|| (pHALSystem->RCT_I2CRead(HMC5983_ADDRESS, &value, 1) != 1)) {
+		failures++;
+	}
 
 	return value;
 }
 
 // Read word from register
 int16_t HMC5983::readRegister16(uint8_t reg) {
-	int16_t value;
-	Wire.beginTransmission(HMC5983_ADDRESS);
-			Wire.write(reg);
-	Wire.endTransmission();
-
-	Wire.beginTransmission(HMC5983_ADDRESS);
-	Wire.requestFrom(HMC5983_ADDRESS, 2);
-	while(!Wire.available()) {};
-			uint8_t vha = Wire.read();
-			uint8_t vla = Wire.read();
-
-	value = vha << 8 | vla;
+	data_pointer = false;
+	uint8_t data[2] = {0, 0};
+	if ((pHALSystem->RCT_I2CWrite(HMC5983_ADDRESS, &reg, 1) != 0)
+		|| (pHALSystem->RCT_I2CRead(HMC5983_ADDRESS, data, 2) != 2)) {
+		failures++;
+	}
 
-	return value;
+	return data[0] << 8 | data[1];
 }
 
 double HMC5983::read() {
+	PROFILE_BEGIN(PROF_COMPASS_READ);
 	// the values for X, Y & Z must be read in X, Z & Y order.
-	writeRegister8(HMC5983_OUT_X_MSB, 0); // Select MSB X register
-	Wire.requestFrom(HMC5983_ADDRESS, 6);
-	byte X_MSB = Wire.read();
-	byte X_LSB = Wire.read();
-	byte Z_MSB = Wire.read();
-	byte Z_LSB = Wire.read();
-	byte Y_MSB = Wire.read();
-	byte Y_LSB = Wire.read();
+	uint8_t data[6] = {0, 0, 0, 0, 0, 0};
+	readData(data);
+	byte X_MSB = data[0];
+	byte X_LSB = data[1];
+	byte Z_MSB = data[2];
+	byte Z_LSB = data[3];
+	byte Y_MSB = data[4];
+	byte Y_LSB = data[5];
 
 	// compose byte for X, Y, Z's LSB & MSB 8bit registers
 	double HX = (X_MSB << 8) + X_LSB;
@@ -224,8 +214,54 @@ double HMC5983::read() {
 	if (HY == 0 && HX < 0) H = 180;
 	if (HY == 0 && HX > 0) H = 0;
 
-	// point to first data register (from datasheet). Only for continuous-measurement mode.
-	Wire.requestFrom(HMC5983_ADDRESS, 0x03);
-
+	PROFILE_END(PROF_COMPASS_READ);
 	return H;
 }
+
+bool HMC5983::readRaw(HMC5983Sample* sample) {
+	uint8_t data[6] = {0, 0, 0, 0, 0, 0};
+	if (!readData(data)) {
+		return false;
+	}
+	sample->x = (int16_t)(data[0] << 8 | data[1]);
+	sample->z = (int16_t)(data[2] << 8 | data[3]);
+	sample->y = (int16_t)(data[4] << 8 | data[5]);
+	return true;
+}
+
+void HMC5983::setTemperatureSensor(bool enable) {
+	uint8_t value;
+
+	value = readRegister8(HMC5983_REG_CONFIG_A);
+	value &= 0b01111111;
+	if (enable) {
+		value |= 0b10000000;
+	}
+
+	writeRegister8(HMC5983_REG_CONFIG_A, value);
+}
+
+int16_t HMC5983::readTemperature() {
+	return readRegister16(HMC5983_TEMP_OUT_MSB);
+}
+
+// Read the six output registers, X, Z & Y.  The pointer wraps from Y LSB back
+// to X MSB, so it only needs setting after another register was accessed.
+bool HMC5983::readData(uint8_t* data) {
+	if (!data_pointer) {
+		uint8_t reg = HMC5983_OUT_X_MSB;
+		if (pHALSystem->RCT_I2CWrite(HMC5983_ADDRESS, &reg, 1) != 0) {
+			failures++;
+			return false;
+		}
+	}
+	data_pointer = pHALSystem->RCT_I2CRead(HMC5983_ADDRESS, data, 6) == 6;
+	if (!data_pointer) {
+		failures++;
+	}
+	return data_pointer;
+}
+
+uint16_t HMC5983::getFailures(void) {
+	return failures;
+}
@@ -204,6 +204,15 @@ typedef enum {
 	HMC5983_CONTINOUS     = 0b00
 } hmc5983_mode_t;
 
+/**
+ * One raw magnetometer measurement, in signed counts at the configured gain.
+ */
+typedef struct HMC5983Sample{
+	int16_t x;
+	int16_t y;
+	int16_t z;
+} HMC5983Sample;
+
 /**
  * Class to interface with HMC5983 magnetometer
  */
@@ -217,6 +226,13 @@ class HMC5983 {
 		 * @return      		True if HMC5983 identified, false otherwise
 		 */
 		bool begin(void (*ISR_callback)() = NULL, int D = false);
+
+		/**
+		 * Checks the identification registers.  begin() does this too;
+		 * identify() lets a caller bring the device up one step at a time.
+		 * @return True if the device identifies as an HMC5983
+		 */
+		bool identify(void);
 		
 		/**
 		 * Sets the dynamic range of the HMC5983.  
@@ -270,13 +286,49 @@ class HMC5983 {
 		 * @return Magnetic heading in decimal degrees. Range +/- 180.
 		 */
 		double read();
+
+		/**
+		 * Reads the current measurement without reducing it to a heading.
+		 * Reading all six output registers leaves the device's register
+		 * pointer back at X MSB, so back to back calls cost a single read
+		 * transaction each.
+		 * @param  sample HMC5983Sample to fill in
+		 * @return        true if the read succeeded
+		 */
+		bool readRaw(HMC5983Sample* sample);
+
+		/**
+		 * Enables the temperature sensor, which also turns on the device's
+		 * temperature compensation of the magnetic measurements.
+		 * @param enable true to enable, false to disable
+		 */
+		void setTemperatureSensor(bool enable);
+
+		/**
+		 * Reads the die temperature.  The temperature sensor must be enabled
+		 * with setTemperatureSensor().
+		 * @return Temperature in 1/128 degrees C above 25 degrees C
+		 */
+		int16_t readTemperature();
+
+		/**
+		 * Gets the number of failed I2C transactions since power up.  A
+		 * transaction fails if the device NAKs or returns fewer bytes than
+		 * requested.
+		 * @return Number of failed transactions.
+		 */
+		uint16_t getFailures(void);
 		
 	private:
 		void writeRegister8(uint8_t reg, uint8_t value);
 		uint8_t readRegister8(uint8_t reg);
 		uint8_t fastRegister8(uint8_t reg);
 		int16_t readRegister16(uint8_t reg);
+		bool readData(uint8_t* data);
 		int DEBUG;
+		uint16_t failures = 0;
+		/// Whether the register pointer is known to be at X MSB
+		bool data_pointer = false;
 };
 
 #endif
@@ -2,13 +2,23 @@
 #define __LED__
 /*! \file */
 /**
- * Permissible LED states.
+ * Permissible LED states.  Each state is rendered from a blink pattern in
+ * LED_PATTERNS (see LED_Engine.hpp).
  */
 enum LEDState {
 	OFF = 0,
 	SLOW = 1,
 	FAST = 2,
-	ON = 3
+	ON = 3,
+	/// Error code: one blink per pattern frame
+	BLINK_1 = 4,
+	/// Error code: two blinks per pattern frame
+	BLINK_2 = 5,
+	/// Error code: three blinks per pattern frame
+	BLINK_3 = 6,
+	/// Error code: four blinks per pattern frame
+	BLINK_4 = 7,
+	LED__SIZE
 };
 typedef struct LED {
 	/**
@@ -21,11 +31,17 @@ typedef struct LED {
 	 */
 	volatile LEDState ledstate;
 
+	/**
+	 * Blink pattern for the current state, one bit per timer tick.
+	 */
+	volatile uint32_t pattern;
+
 	/**
 	 * Default constructor.
 	 */
 	LED(){
 		ledstate = OFF;
+		pattern = 0;
 		pin = -1;
 	}
 } LED;
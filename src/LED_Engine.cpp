@@ -0,0 +1,13 @@
+#include "LED_Engine.hpp"
+
+// Patterns are LED_FRAME_TICKS (20) bits long, LSB first, 200 ms per tick.
+const uint32_t LED_PATTERNS[LED__SIZE] PROGMEM = {
+	0x00000000,	// OFF
+	0x00007C1F,	// SLOW: 1 s on, 1 s off
+	0x00055555,	// FAST: 200 ms on, 200 ms off
+	0x000FFFFF,	// ON
+	0x00000001,	// BLINK_1
+	0x00000005,	// BLINK_2
+	0x00000015,	// BLINK_3
+	0x00000055	// BLINK_4
+};
@@ -0,0 +1,303 @@
+#ifndef __LED_ENGINE__
+#define __LED_ENGINE__
+/*! \file */
+#include <Arduino.h>
+#include "LED.hpp"
+#include "ui_core.hpp"
+
+/**
+ * Number of timer ticks in one LED pattern frame.  At the 5 Hz LED timer this
+ * is a 4 s frame.
+ */
+#define LED_FRAME_TICKS 20
+
+/**
+ * LED_Engine sweep position when no self test is running.
+ */
+#define LED_SWEEP_NONE 0xFF
+
+/**
+ * Blink patterns for each LEDState, indexed by state.  Bit n is the LED output
+ * during tick n of the pattern frame.
+ */
+extern const uint32_t LED_PATTERNS[LED__SIZE] PROGMEM;
+
+namespace led_detail{
+	/**
+	 * ATmega32U4 output ports.
+	 */
+	enum LEDPort{
+		LED_PORT_B,
+		LED_PORT_C,
+		LED_PORT_D,
+		LED_PORT_E,
+		LED_PORT_F,
+		LED_PORT_NONE
+	};
+
+	/**
+	 * Arduino Leonardo pin to port table, indexed by Arduino pin.
+	 */
+	constexpr uint8_t PIN_PORT[] = {
+		LED_PORT_D, LED_PORT_D, LED_PORT_D, LED_PORT_D,	// D0 - D3
+		LED_PORT_D, LED_PORT_C, LED_PORT_D, LED_PORT_E,	// D4 - D7
+		LED_PORT_B, LED_PORT_B, LED_PORT_B, LED_PORT_B,	// D8 - D11
+		LED_PORT_D, LED_PORT_C, LED_PORT_B, LED_PORT_B,	// D12 - D15
+		LED_PORT_B, LED_PORT_B, LED_PORT_F, LED_PORT_F,	// D16 - D19
+		LED_PORT_F, LED_PORT_F, LED_PORT_F, LED_PORT_F	// D20 - D23
+	};
+
+	/**
+	 * Arduino Leonardo pin to port bit table, indexed by Arduino pin.
+	 */
+	constexpr uint8_t PIN_BIT[] = {
+		2, 3, 1, 0,
+		4, 6, 7, 6,
+		4, 5, 6, 7,
+		6, 7, 3, 1,
+		2, 0, 7, 6,
+		5, 4, 1, 0
+	};
+
+	constexpr uint8_t port_of(uint8_t pin){
+		return (pin < sizeof(PIN_PORT)) ? PIN_PORT[pin] : LED_PORT_NONE;
+	}
+
+	constexpr uint8_t mask_of(uint8_t pin){
+		return (pin < sizeof(PIN_BIT)) ? (1 << PIN_BIT[pin]) : 0;
+	}
+
+	/**
+	 * Mask of all pins in PINS that live on PORT.
+	 */
+	template<uint8_t PORT, uint8_t... PINS> struct PortMask;
+
+	template<uint8_t PORT> struct PortMask<PORT>{
+		static const uint8_t value = 0;
+	};
+
+	template<uint8_t PORT, uint8_t PIN, uint8_t... REST>
+	struct PortMask<PORT, PIN, REST...>{
+		static const uint8_t value =
+			((port_of(PIN) == PORT) ? mask_of(PIN) : 0)
+			| PortMask<PORT, REST...>::value;
+	};
+
+	/**
+	 * Output bits for PORT given the current tick.  LED I drives PIN, the
+	 * remaining LEDs drive REST.  During a self test sweep only the LED with
+	 * index sweep is lit.  Unrolled at compile time.
+	 */
+	template<uint8_t PORT, uint8_t I, uint8_t... PINS> struct PortBits;
+
+	template<uint8_t PORT, uint8_t I> struct PortBits<PORT, I>{
+		static inline uint8_t get(const LED*, uint32_t, uint8_t){
+			return 0;
+		}
+	};
+
+	template<uint8_t PORT, uint8_t I, uint8_t PIN, uint8_t... REST>
+	struct PortBits<PORT, I, PIN, REST...>{
+		static inline uint8_t get(const LED* leds, uint32_t tick,
+				uint8_t sweep){
+			uint8_t bits = PortBits<PORT, I + 1, REST...>::get(leds, tick,
+				sweep);
+			if(port_of(PIN) == PORT && ((sweep == LED_SWEEP_NONE)
+					? (leds[I].pattern & tick) : (sweep == I))){
+				bits |= mask_of(PIN);
+			}
+			return bits;
+		}
+	};
+
+#ifdef __AVR__
+	inline volatile uint8_t& port_reg(uint8_t port){
+		switch(port){
+			case LED_PORT_B:
+				return PORTB;
+			case LED_PORT_C:
+				return PORTC;
+			case LED_PORT_E:
+				return PORTE;
+			case LED_PORT_F:
+				return PORTF;
+			case LED_PORT_D:
+			default:
+				return PORTD;
+		}
+	}
+
+	inline volatile uint8_t& ddr_reg(uint8_t port){
+		switch(port){
+			case LED_PORT_B:
+				return DDRB;
+			case LED_PORT_C:
+				return DDRC;
+			case LED_PORT_E:
+				return DDRE;
+			case LED_PORT_F:
+				return DDRF;
+			case LED_PORT_D:
+			default:
+				return DDRD;
+		}
+	}
+#endif
+}
+
+/**
+ * LED driver with compile-time pin resolution.  Each LED is given as an Arduino
+ * pin number in PINS, and is addressed by its index in PINS.  All pin to
+ * port/bit lookups happen at compile time, so update() reduces to one masked
+ * write per port that has an LED on it.  Off target, the LEDs are driven
+ * through the HAL instead.
+ */
+template<uint8_t... PINS>
+class LED_Engine{
+public:
+	/**
+	 * Number of LEDs driven by this engine.
+	 */
+	static const uint8_t COUNT = sizeof...(PINS);
+
+	/**
+	 * Constructs a new engine with all LEDs OFF.
+	 */
+	LED_Engine() : tick(1), sweep(LED_SWEEP_NONE){
+		const uint8_t pins[COUNT] = {PINS...};
+		for(uint8_t i = 0; i < COUNT; i++){
+			leds[i].pin = pins[i];
+		}
+	}
+
+	/**
+	 * Configures every LED pin as an output and drives it low.
+	 */
+	void begin(){
+#ifdef __AVR__
+		configure<led_detail::LED_PORT_B>();
+		configure<led_detail::LED_PORT_C>();
+		configure<led_detail::LED_PORT_D>();
+		configure<led_detail::LED_PORT_E>();
+		configure<led_detail::LED_PORT_F>();
+#else
+		for(uint8_t i = 0; i < COUNT; i++){
+			pHALSystem->RCT_PinMode(leds[i].pin, OUTPUT);
+			pHALSystem->RCT_DigitalWrite(leds[i].pin, LOW);
+		}
+#endif
+	}
+
+	/**
+	 * Starts the power on self test: each LED in turn is lit for one timer
+	 * tick, then the LEDs go back to their states.  The sweep runs from
+	 * update(), so this returns at once.
+	 */
+	void selfTest(){
+		sweep = 0;
+	}
+
+	/**
+	 * Sets the state of an LED.  Safe to call with interrupts enabled.
+	 * @param idx   Index of the LED in PINS
+	 * @param state New LED state
+	 */
+	void set(uint8_t idx, LEDState state){
+		if(idx >= COUNT){
+			return;
+		}
+		if(state >= LED__SIZE){
+			state = OFF;
+		}
+		if(leds[idx].ledstate == state){
+			return;
+		}
+		uint32_t pattern = pgm_read_dword(&LED_PATTERNS[state]);
+		uint8_t sreg = SREG;
+		cli();
+		leds[idx].ledstate = state;
+		leds[idx].pattern = pattern;
+		SREG = sreg;
+	}
+
+	/**
+	 * Gets the state of an LED.
+	 * @param  idx Index of the LED in PINS
+	 * @return     Current LED state
+	 */
+	LEDState get(uint8_t idx) const{
+		return leds[idx].ledstate;
+	}
+
+	/**
+	 * Gets the Arduino pin of an LED.
+	 * @param  idx Index of the LED in PINS
+	 * @return     Arduino pin number
+	 */
+	uint8_t pin(uint8_t idx) const{
+		return leds[idx].pin;
+	}
+
+	/**
+	 * Advances the pattern frame by one tick and drives all LEDs.  Call from
+	 * the LED timer interrupt.
+	 */
+	inline void update(){
+		uint32_t t = tick;
+		tick = (t & (1UL << (LED_FRAME_TICKS - 1))) ? 1 : (t << 1);
+		uint8_t s = sweep;
+		if(s != LED_SWEEP_NONE){
+			sweep = (s + 1 < COUNT) ? s + 1 : LED_SWEEP_NONE;
+		}
+#ifdef __AVR__
+		write<led_detail::LED_PORT_B>(t, s);
+		write<led_detail::LED_PORT_C>(t, s);
+		write<led_detail::LED_PORT_D>(t, s);
+		write<led_detail::LED_PORT_E>(t, s);
+		write<led_detail::LED_PORT_F>(t, s);
+#else
+		for(uint8_t i = 0; i < COUNT; i++){
+			bool lit = (s == LED_SWEEP_NONE) ? (leds[i].pattern & t) : (s == i);
+			pHALSystem->RCT_DigitalWrite(leds[i].pin, lit ? HIGH : LOW);
+		}
+#endif
+	}
+
+private:
+	LED leds[COUNT];
+
+	/**
+	 * Bit of the current tick within the pattern frame.
+	 */
+	uint32_t tick;
+
+	/**
+	 * Index of the LED lit by the self test on the next tick, or
+	 * LED_SWEEP_NONE.
+	 */
+	volatile uint8_t sweep;
+
+#ifdef __AVR__
+	template<uint8_t PORT>
+	inline void write(uint32_t t, uint8_t s){
+		const uint8_t mask = led_detail::PortMask<PORT, PINS...>::value;
+		if(mask){
+			uint8_t bits = led_detail::PortBits<PORT, 0, PINS...>::get(leds, t,
+				s);
+			volatile uint8_t& port = led_detail::port_reg(PORT);
+			port = (port & ~mask) | bits;
+		}
+	}
+
+	template<uint8_t PORT>
+	inline void configure(){
+		const uint8_t mask = led_detail::PortMask<PORT, PINS...>::value;
+		if(mask){
+			led_detail::port_reg(PORT) &= ~mask;
+			led_detail::ddr_reg(PORT) |= mask;
+		}
+	}
+#endif
+};
+
+#endif
@@ -0,0 +1,58 @@
+#include "Mag_Batch.hpp"
+
+Mag_Batch::Mag_Batch() : first_us(0), gap_shift(0), count(0), last_us(0){
+}
+
+void Mag_Batch::clear(){
+	count = 0;
+}
+
+uint8_t Mag_Batch::add(uint32_t time_us, const HMC5983Sample& sample){
+	if(count < MAG_BATCH_MAX){
+		if(count == 0){
+			first_us = time_us;
+			last_us = time_us;
+		}else{
+			uint32_t gap = time_us - last_us;
+			if(count == 1){
+				gap_shift = 0;
+				while((gap >> gap_shift) >= 0x8000UL){
+					gap_shift++;
+				}
+			}
+			gap >>= gap_shift;
+			gaps[count - 1] = (gap > 0xFFFFUL) ? 0xFFFF : gap;
+			// Measured from the time as printed, so rounding does not add up
+			// over the batch
+			last_us += (uint32_t)gaps[count - 1] << gap_shift;
+		}
+		samples[count] = sample;
+		count++;
+	}
+	return count;
+}
+
+void Mag_Batch::print(Print* out, int16_t temperature) const{
+	if(count == 0){
+		return;
+	}
+	out->print(F("{\"mag\": "));
+	out->print(first_us);
+	out->print(F(", \"tmp\": "));
+	// 128 LSB per degree C, 0 at 25 degrees C
+	out->print((long)temperature * 25 / 32 + 2500);
+	out->print(F(", \"smp\": ["));
+	for(uint8_t i = 0; i < count; i++){
+		if(i){
+			out->print(F(", "));
+		}
+		out->print(i ? (uint32_t)gaps[i - 1] << gap_shift : 0UL);
+		out->print(F(", "));
+		out->print(samples[i].x);
+		out->print(F(", "));
+		out->print(samples[i].y);
+		out->print(F(", "));
+		out->print(samples[i].z);
+	}
+	out->println(F("]}"));
+}
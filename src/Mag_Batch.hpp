@@ -0,0 +1,69 @@
+#ifndef __MAG_BATCH__
+#define __MAG_BATCH__
+/*! \file */
+#include <Arduino.h>
+#include "HMC5983.hpp"
+
+/**
+ * Most samples in one batch.  At 12 samples the longest possible batch line
+ * stays under the 512 bytes a line may take in rctbridge.
+ */
+#ifndef MAG_BATCH_MAX
+#define MAG_BATCH_MAX 12
+#endif
+
+/**
+ * Batch of raw magnetometer samples.  Samples are collected at the compass
+ * data rate and sent to the OBC together as one line, so that the full rate
+ * stream does not pay line framing for every sample:
+ *
+ *     {"mag": 81234567, "tmp": 2731, "smp": [0, -120, 301, -330, 4545, ...]}
+ *
+ * "mag" is RCT_Micros() at the first sample and "tmp" the die temperature in
+ * 0.01 degrees C.  "smp" holds four values per sample: the time since the
+ * previous sample in us (0 for the first), then the raw X, Y and Z counts.
+ * The times are kept as 16-bit gaps, so at compass rates below 75 Hz they are
+ * rounded down to a power of two us, at most 64 us at 0.75 Hz.
+ */
+class Mag_Batch{
+public:
+	/**
+	 * Constructs an empty batch.
+	 */
+	Mag_Batch();
+
+	/**
+	 * Discards all samples.
+	 */
+	void clear();
+
+	/**
+	 * Adds a sample.  Samples beyond MAG_BATCH_MAX are discarded.
+	 * @param  time_us RCT_Micros() when the sample was read
+	 * @param  sample  Sample to add
+	 * @return         Number of samples in the batch
+	 */
+	uint8_t add(uint32_t time_us, const HMC5983Sample& sample);
+
+	/**
+	 * Prints the batch as a JSON packet.
+	 * @param out         Print to write to
+	 * @param temperature Die temperature, as from HMC5983::readTemperature()
+	 */
+	void print(Print* out, int16_t temperature) const;
+private:
+	HMC5983Sample samples[MAG_BATCH_MAX];
+	/// RCT_Micros() at the first sample
+	uint32_t first_us;
+	/// Time from each sample to the next, in units of 2^gap_shift us, or
+	/// 0xFFFF if longer than that can hold
+	uint16_t gaps[MAG_BATCH_MAX - 1];
+	/// Set from the first gap so that twice that gap still fits in 16 bits:
+	/// 0, exact to the us, at compass rates of 75 Hz and up
+	uint8_t gap_shift;
+	uint8_t count;
+	/// Time of the last sample as it will be printed
+	uint32_t last_us;
+};
+
+#endif
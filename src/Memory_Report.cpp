@@ -0,0 +1,88 @@
+#include "Memory_Report.hpp"
+
+#ifdef __AVR__
+
+// Symbols provided by the avr-libc linker script and malloc
+extern "C" {
+	extern uint8_t __heap_start;
+	extern uint8_t __stack;
+	extern char* __brkval;
+}
+
+/**
+ * Paints all RAM from the end of .bss to the top of the stack with
+ * STACK_CANARY.  This runs from .init1, before the stack pointer is set up, the
+ * zero register is cleared or any constructors have run, so it must be naked
+ * and must not touch the stack.
+ */
+void paint_stack(void) __attribute__((naked, used, section(".init1")));
+
+void paint_stack(void){
+	__asm__ volatile (
+		"	ldi r30, lo8(__heap_start)\n"
+		"	ldi r31, hi8(__heap_start)\n"
+		"	ldi r24, %0\n"
+		"	ldi r25, hi8(__stack)\n"
+		"	rjmp 2f\n"
+		"1:\n"
+		"	st Z+, r24\n"
+		"2:\n"
+		"	cpi r30, lo8(__stack)\n"
+		"	cpc r31, r25\n"
+		"	brlo 1b\n"
+		"	breq 1b\n"
+		:: "M" (STACK_CANARY)
+	);
+}
+
+uint16_t Memory_Report::heapBreak(){
+	if(__brkval == 0){
+		return (uint16_t)&__heap_start;
+	}
+	return (uint16_t)__brkval;
+}
+
+uint16_t Memory_Report::freeRAM(){
+	uint8_t top;
+	return (uint16_t)&top - heapBreak();
+}
+
+/**
+ * Returns the lowest address above the heap that has been overwritten since
+ * boot.
+ */
+static const uint8_t* lowest_touched(){
+	const uint8_t* p = (const uint8_t*)Memory_Report::heapBreak();
+	while(p <= &__stack && *p == STACK_CANARY){
+		p++;
+	}
+	return p;
+}
+
+void Memory_Report::getDiagnostics(DiagnosticsPacket* diag){
+	const uint8_t* low = lowest_touched();
+	diag->heap_break = heapBreak();
+	diag->free_ram = freeRAM();
+	diag->stack_max = (uint16_t)&__stack - (uint16_t)low + 1;
+	diag->stack_margin = (uint16_t)low - diag->heap_break;
+}
+
+#else
+
+// There is no fixed heap/stack layout to report off target
+uint16_t Memory_Report::heapBreak(){
+	return 0;
+}
+
+uint16_t Memory_Report::freeRAM(){
+	return 0;
+}
+
+void Memory_Report::getDiagnostics(DiagnosticsPacket* diag){
+	diag->heap_break = 0;
+	diag->free_ram = 0;
+	diag->stack_max = 0;
+	diag->stack_margin = 0;
+}
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef __MEMORY_REPORT__
+#define __MEMORY_REPORT__
+/*! \file */
+#include <Arduino.h>
+#include "Diagnostics.hpp"
+
+/**
+ * Value painted over the free RAM between the end of .bss and the top of the
+ * stack at boot.
+ */
+#define STACK_CANARY 0xC5
+
+/**
+ * Runtime RAM usage report.  The free RAM between the static data and the
+ * stack is painted with STACK_CANARY before any C++ constructors run (see
+ * Memory_Report.cpp), so the deepest the stack has ever reached can be found
+ * later by scanning for the first overwritten byte above the heap.
+ */
+class Memory_Report{
+public:
+	/**
+	 * Returns the current heap break, i.e. the first address above all heap
+	 * allocations.
+	 * @return Heap break address
+	 */
+	static uint16_t heapBreak();
+
+	/**
+	 * Returns the number of bytes currently free between the heap break and
+	 * the stack pointer.
+	 * @return Free bytes
+	 */
+	static uint16_t freeRAM();
+
+	/**
+	 * Fills in the memory fields of a diagnostics packet.  The stack
+	 * high-water mark and the never used bytes below it, the true RAM
+	 * headroom of the firmware, come from one scan of the painted region.
+	 * The scan walks the untouched region byte by byte, so it takes a few
+	 * hundred us.
+	 * @param diag DiagnosticsPacket to fill in
+	 */
+	static void getDiagnostics(DiagnosticsPacket* diag);
+};
+
+#endif
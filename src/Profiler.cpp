@@ -0,0 +1,86 @@
+#include "Profiler.hpp"
+
+#ifdef RCT_PROFILE
+
+Profiler profiler;
+
+static const char PROF_NAME_SENSOR_DECODE[] PROGMEM = "sensor_decode";
+static const char PROF_NAME_NMEA_DECODE[] PROGMEM = "nmea_decode";
+static const char PROF_NAME_COMPASS_READ[] PROGMEM = "compass_read";
+static const char PROF_NAME_GET_PACKET[] PROGMEM = "get_packet";
+static const char PROF_NAME_OBC_PRINTLN[] PROGMEM = "obc_println";
+static const char PROF_NAME_TIMER_ISR[] PROGMEM = "timer_isr";
+
+static const char* const PROF_NAMES[PROF__SIZE] PROGMEM = {
+	PROF_NAME_SENSOR_DECODE,
+	PROF_NAME_NMEA_DECODE,
+	PROF_NAME_COMPASS_READ,
+	PROF_NAME_GET_PACKET,
+	PROF_NAME_OBC_PRINTLN,
+	PROF_NAME_TIMER_ISR
+};
+
+Profiler::Profiler(){
+	reset();
+}
+
+void Profiler::begin(){
+	Cycle_Timer::begin();
+}
+
+void Profiler::record(ProfileSite site, uint32_t cycles){
+	ProfileStats& s = stats[site];
+	uint8_t bucket = 0;
+	for(uint32_t c = cycles >> 5; c && bucket < PROFILE_BUCKETS - 1; c >>= 1){
+		bucket++;
+	}
+	if(s.count == 0 || cycles < s.min){
+		s.min = cycles;
+	}
+	if(cycles > s.max){
+		s.max = cycles;
+	}
+	s.count++;
+	s.total += cycles;
+	if(s.hist[bucket] != 0xFFFF){
+		s.hist[bucket]++;
+	}
+}
+
+void Profiler::reset(){
+	uint8_t sreg = SREG;
+	cli();
+	memset(stats, 0, sizeof(stats));
+	SREG = sreg;
+}
+
+void Profiler::print(Print* out){
+	for(uint8_t i = 0; i < PROF__SIZE; i++){
+		ProfileStats s;
+		uint8_t sreg = SREG;
+		cli();
+		s = stats[i];
+		SREG = sreg;
+
+		out->print(F("{\"prf\": \""));
+		out->print((const __FlashStringHelper*)pgm_read_ptr(&PROF_NAMES[i]));
+		out->print(F("\", \"cnt\": "));
+		out->print(s.count);
+		out->print(F(", \"min\": "));
+		out->print(s.min);
+		out->print(F(", \"max\": "));
+		out->print(s.max);
+		out->print(F(", \"sum\": "));
+		out->print(s.total);
+		out->print(F(", \"hst\": ["));
+		for(uint8_t b = 0; b < PROFILE_BUCKETS; b++){
+			if(b){
+				out->print(F(", "));
+			}
+			out->print(s.hist[b]);
+		}
+		out->println(F("]}"));
+	}
+}
+
+#endif
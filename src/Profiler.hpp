@@ -0,0 +1,90 @@
+#ifndef __PROFILER__
+#define __PROFILER__
+/*! \file */
+#include <Arduino.h>
+#include "Cycle_Timer.hpp"
+
+/**
+ * Number of log2 histogram buckets per site.  Bucket 0 holds samples shorter
+ * than 32 cycles, bucket n holds samples of [2^(n+4), 2^(n+5)) cycles, and the
+ * last bucket also holds everything longer.
+ */
+#define PROFILE_BUCKETS 16
+
+/**
+ * Instrumented hot path sites.
+ */
+enum ProfileSite{
+	PROF_SENSOR_DECODE,
+	PROF_NMEA_DECODE,
+	PROF_COMPASS_READ,
+	PROF_GET_PACKET,
+	PROF_OBC_PRINTLN,
+	PROF_TIMER_ISR,
+	PROF__SIZE
+};
+
+/**
+ * Latency statistics for a single site, in CPU cycles.
+ */
+typedef struct ProfileStats{
+	uint32_t count;
+	uint32_t min;
+	uint32_t max;
+	uint32_t total;
+	uint16_t hist[PROFILE_BUCKETS];
+} ProfileStats;
+
+/**
+ * Hot path profiler.  Keeps per site latency statistics in RAM, measured with
+ * the Cycle_Timer.  Only compiled into the profiling build (RCT_PROFILE); use
+ * the PROFILE_BEGIN and PROFILE_END macros so that the instrumentation
+ * disappears from normal builds.
+ */
+class Profiler{
+public:
+	/**
+	 * Constructs a new Profiler with all statistics cleared.
+	 */
+	Profiler();
+
+	/**
+	 * Starts the cycle counter.
+	 */
+	void begin();
+
+	/**
+	 * Records one sample.  Safe to call from interrupts, as long as each site
+	 * is only ever recorded from one context.
+	 * @param site   Site the sample was taken at
+	 * @param cycles Duration of the sample in CPU cycles
+	 */
+	void record(ProfileSite site, uint32_t cycles);
+
+	/**
+	 * Clears all statistics.
+	 */
+	void reset();
+
+	/**
+	 * Writes the statistics of every site, one JSON line per site.
+	 * @param out Stream to write to
+	 */
+	void print(Print* out);
+
+private:
+	ProfileStats stats[PROF__SIZE];
+};
+
+#ifdef RCT_PROFILE
+extern Profiler profiler;
+
+#define PROFILE_BEGIN(site) uint32_t _profile_##site = Cycle_Timer::now()
+#define PROFILE_END(site) \
+	profiler.record(site, Cycle_Timer::now() - _profile_##site)
+#else
+#define PROFILE_BEGIN(site)
+#define PROFILE_END(site)
+#endif
+
+#endif
@@ -0,0 +1,151 @@
+#include "RTCM_Relay.hpp"
+
+#define RTCM_RING_MASK (RTCM_RING_SIZE - 1)
+#define RTCM_CRC_LEN 3
+
+static_assert((RTCM_RING_SIZE & RTCM_RING_MASK) == 0,
+	"RTCM_RING_SIZE must be a power of two");
+
+RTCM_Relay::RTCM_Relay() : tail(0), head(0), fill(0), state(RTCM_IDLE),
+		remaining(0), crc(0), frame_crc(0), dropping(false), quiet(false),
+		quiet_us(0), frames(0), crc_errors(0), dropped(0), timeouts(0),
+		bytes_sent(0){
+}
+
+void RTCM_Relay::store(uint8_t c){
+	uint16_t next = (fill + 1) & RTCM_RING_MASK;
+	if(next == tail){
+		// Out of room; the rest of the frame is discarded
+		dropping = true;
+	}
+	if(dropping){
+		return;
+	}
+	ring[fill] = c;
+	fill = next;
+}
+
+void RTCM_Relay::end_frame(){
+	state = RTCM_IDLE;
+	if(dropping){
+		dropped++;
+		fill = head;
+	}else if(frame_crc != crc){
+		crc_errors++;
+		fill = head;
+	}else{
+		frames++;
+		head = fill;
+	}
+}
+
+bool RTCM_Relay::decode(uint8_t c){
+	quiet = false;
+	switch(state){
+		case RTCM_IDLE:
+			if(c != RTCM_PREAMBLE){
+				return false;
+			}
+			fill = head;
+			dropping = false;
+			crc = crc24q(&c, 1);
+			store(c);
+			state = RTCM_LENGTH_HI;
+			return true;
+		case RTCM_LENGTH_HI:
+			if(c & 0xFC){
+				// Reserved bits set, so this was not a frame after all
+				state = RTCM_IDLE;
+				fill = head;
+				return false;
+			}
+			remaining = (uint16_t)c << 8;
+			crc = crc24q(&c, 1, crc);
+			store(c);
+			state = RTCM_LENGTH_LO;
+			return true;
+		case RTCM_LENGTH_LO:
+			remaining |= c;
+			crc = crc24q(&c, 1, crc);
+			store(c);
+			if(remaining == 0){
+				remaining = RTCM_CRC_LEN;
+				frame_crc = 0;
+				state = RTCM_CRC;
+			}else{
+				state = RTCM_PAYLOAD;
+			}
+			return true;
+		case RTCM_PAYLOAD:
+			crc = crc24q(&c, 1, crc);
+			store(c);
+			if(--remaining == 0){
+				remaining = RTCM_CRC_LEN;
+				frame_crc = 0;
+				state = RTCM_CRC;
+			}
+			return true;
+		case RTCM_CRC:
+			frame_crc = (frame_crc << 8) | c;
+			store(c);
+			if(--remaining == 0){
+				end_frame();
+			}
+			return true;
+		default:
+			state = RTCM_IDLE;
+			return false;
+	}
+}
+
+void RTCM_Relay::service(Print* out){
+	while(tail != head){
+		int room = out->availableForWrite();
+		if(room <= 0){
+			return;
+		}
+		// Longest contiguous run of queued bytes
+		uint16_t len = ((head > tail) ? head : RTCM_RING_SIZE) - tail;
+		if(len > (uint16_t)room){
+			len = room;
+		}
+		out->write(&ring[tail], len);
+		tail = (tail + len) & RTCM_RING_MASK;
+		bytes_sent += len;
+	}
+}
+
+void RTCM_Relay::idle(uint32_t now_us){
+	if(state == RTCM_IDLE){
+		return;
+	}
+	if(!quiet){
+		quiet = true;
+		quiet_us = now_us;
+	}else if(now_us - quiet_us > RTCM_GAP_TIMEOUT_US){
+		state = RTCM_IDLE;
+		fill = head;
+		timeouts++;
+	}
+}
+
+void RTCM_Relay::getDiagnostics(DiagnosticsPacket* diag) const{
+	diag->rtcm_frames = frames;
+	diag->rtcm_crc_errors = crc_errors;
+	diag->rtcm_dropped = dropped;
+	diag->rtcm_timeouts = timeouts;
+	diag->rtcm_bytes = bytes_sent;
+}
+
+uint32_t RTCM_Relay::crc24q(const uint8_t* data, uint16_t len, uint32_t crc){
+	while(len--){
+		crc ^= (uint32_t)*data++ << 16;
+		for(uint8_t i = 0; i < 8; i++){
+			crc <<= 1;
+			if(crc & 0x1000000UL){
+				crc ^= 0x1864CFBUL;
+			}
+		}
+	}
+	return crc & 0xFFFFFFUL;
+}
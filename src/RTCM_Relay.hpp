@@ -0,0 +1,129 @@
+#ifndef __RTCM_RELAY__
+#define __RTCM_RELAY__
+/*! \file */
+#include <Arduino.h>
+#include "Diagnostics.hpp"
+
+/**
+ * First byte of every RTCM3 frame.  It cannot occur in the ASCII status
+ * messages, so it marks the start of a correction frame on the OBC link.
+ */
+#define RTCM_PREAMBLE 0xD3
+
+/**
+ * Size of the transmit ring in bytes, a power of two.  Frames that do not fit
+ * in the free part of the ring are dropped whole, so frames of RTCM_RING_SIZE
+ * bytes or more never get through.  256 bytes holds a 1005 station frame or an
+ * MSM4 frame of up to 15 satellites on two signals; with the NMEA parser's
+ * heap, a larger ring does not fit in the 2.5 KB of the ATmega32U4.
+ */
+#ifndef RTCM_RING_SIZE
+#define RTCM_RING_SIZE 256
+#endif
+
+/**
+ * Longest gap between two bytes of a frame in us.  A frame that stalls for
+ * longer is abandoned, so that a frame cut short by the OBC side does not
+ * swallow the status messages after it.  About 20 character times at 9600
+ * baud, and well clear of the 1 ms USB frames the bytes arrive in.
+ */
+#ifndef RTCM_GAP_TIMEOUT_US
+#define RTCM_GAP_TIMEOUT_US 20000UL
+#endif
+
+/**
+ * RTCM3 correction relay.  The OBC link carries RTCM3 frames interleaved with
+ * the JSON status messages.  Every byte from the OBC is offered to decode()
+ * first; bytes that are part of a frame are taken, and all others are left
+ * for the Status_Module.
+ *
+ * Frames are stored in a ring as they arrive and only become visible to
+ * service() once their CRC-24Q checks, so the receiver never sees a corrupt
+ * or partial frame.  service() writes as much of the ring to the GPS UART as
+ * its transmit buffer will take without blocking.  idle() abandons a frame
+ * whose bytes stop coming.
+ */
+class RTCM_Relay{
+public:
+	/**
+	 * Constructs an empty relay.
+	 */
+	RTCM_Relay();
+
+	/**
+	 * Offers the next byte from the OBC link.
+	 * @param  c Next byte from the OBC link
+	 * @return   true if the byte belongs to an RTCM frame, false if it should
+	 *           be passed to the Status_Module
+	 */
+	bool decode(uint8_t c);
+
+	/**
+	 * Tells the relay that no byte from the OBC link is waiting.  A frame
+	 * that has had no byte for RTCM_GAP_TIMEOUT_US is discarded, and the
+	 * bytes after it go to the Status_Module again.  Only time with the
+	 * link empty counts, so a slow main loop does not cut frames short.
+	 * @param now_us RCT_Micros()
+	 */
+	void idle(uint32_t now_us);
+
+	/**
+	 * Writes queued frames to the GPS receiver without blocking.
+	 * @param out GPS serial port
+	 */
+	void service(Print* out);
+
+	/**
+	 * Fills in the RTCM counters of a diagnostics packet.
+	 * @param diag DiagnosticsPacket to fill in
+	 */
+	void getDiagnostics(DiagnosticsPacket* diag) const;
+
+	/**
+	 * CRC-24Q of a block of memory, as used by RTCM3.
+	 * @param  data Data to checksum
+	 * @param  len  Number of bytes
+	 * @param  crc  CRC of the preceding data
+	 * @return      CRC of the data
+	 */
+	static uint32_t crc24q(const uint8_t* data, uint16_t len, uint32_t crc = 0);
+private:
+	enum FrameState{
+		RTCM_IDLE,
+		RTCM_LENGTH_HI,
+		RTCM_LENGTH_LO,
+		RTCM_PAYLOAD,
+		RTCM_CRC
+	};
+
+	uint8_t ring[RTCM_RING_SIZE];
+	/// Next byte to send
+	uint16_t tail;
+	/// End of the complete frames
+	uint16_t head;
+	/// End of the frame being received
+	uint16_t fill;
+
+	FrameState state;
+	/// Bytes of the current frame still to come in this state
+	uint16_t remaining;
+	uint32_t crc;
+	uint32_t frame_crc;
+	/// Whether the current frame is being discarded for lack of space
+	bool dropping;
+	/// Whether idle() has been called since the last byte of the frame
+	bool quiet;
+	/// now_us of the first idle() call since the last byte of the frame
+	uint32_t quiet_us;
+
+	uint16_t frames;
+	uint16_t crc_errors;
+	uint16_t dropped;
+	uint16_t timeouts;
+	uint16_t bytes_sent;
+
+	void store(uint8_t c);
+	void end_frame();
+};
+
+#endif
@@ -27,10 +27,19 @@
  */
 #include "Sensor_Module.hpp"
 #include "HMC5983.hpp"
-#include <Wire.h>
+#include "Profiler.hpp"
+#include "Trace.hpp"
+#include "ui_core.hpp"
 
 #define RUN_SWITCH_PIN 10
 
+/// compass_busy value while a compass I2C transaction is under way
+#define COMPASS_BUSY_MARK 0xC5
+
+/// Set around every compass I2C transaction.  Kept across a reset, so that
+/// after a watchdog reset it shows whether the bus hung the main loop.
+static volatile uint8_t compass_busy RCT_NOINIT;
+
 const char *Sensor_Module::RUN_TRUE = "true";
 const char *Sensor_Module::RUN_FALSE = "false";
 
@@ -41,6 +50,20 @@ Sensor_Module::Sensor_Module(GPSState *state_var) :
 				0), previous_fix(0) {
 	*state_var = GPS_INIT;
 	compass_ready = false;
+	previous_output = 0;
+	passthrough_ready = false;
+	next_mag_us = 0;
+	mag_temperature = 0;
+	sentence_us = 0;
+	previous_save = 0;
+	fix_saved = false;
+	alt_m = 0;
+	ttff_ms = 0;
+	aided = FIX_ASSIST_NONE;
+	assist_pending = false;
+	compass_step = COMPASS_PROBE;
+	compass_ready_us = 0;
+	Config_Store::defaults(&config);
 	packet.lat = 181;
 	packet.lon = 181;
 	packet.hdg = 361;
@@ -54,13 +77,92 @@ Sensor_Module::Sensor_Module(GPSState *state_var) :
 	packet.fix = GPS_FIX_NONE;
 	packet.sat = 0;
 	packet.rail = 0;
+	packet.uts = 0;
 }
 
 Sensor_Module::~Sensor_Module() {
 }
 
+/**
+ * Compass sample periods in us, indexed by hmc5983_dataRate_t.
+ */
+static const uint32_t MAG_PERIODS_US[8] PROGMEM = {
+	1333333, 666667, 333333, 133333, 66667, 33333, 13333, 4545
+};
+
+/**
+ * Passthrough mask bit of a sentence's data type term, e.g. "GPGGA".
+ */
+static uint8_t passthrough_type(const char* type) {
+	if (type[0] == 'P') {
+		return NMEA_PASS_OTHER;
+	}
+	switch (type[2]) {
+	case 'G':
+		if (type[3] == 'G' && type[4] == 'A') {
+			return NMEA_PASS_GGA;
+		}
+		if (type[3] == 'S' && type[4] == 'A') {
+			return NMEA_PASS_GSA;
+		}
+		if (type[3] == 'S' && type[4] == 'V') {
+			return NMEA_PASS_GSV;
+		}
+		if (type[3] == 'L' && type[4] == 'L') {
+			return NMEA_PASS_GLL;
+		}
+		return NMEA_PASS_OTHER;
+	case 'R':
+		return (type[3] == 'M' && type[4] == 'C') ? NMEA_PASS_RMC
+				: NMEA_PASS_OTHER;
+	case 'V':
+		return (type[3] == 'T' && type[4] == 'G') ? NMEA_PASS_VTG
+				: NMEA_PASS_OTHER;
+	case 'Z':
+		return (type[3] == 'D' && type[4] == 'A') ? NMEA_PASS_ZDA
+				: NMEA_PASS_OTHER;
+	default:
+		return NMEA_PASS_OTHER;
+	}
+}
+
+/**
+ * Converts GPS time hhmmss.ss to 1/100 s since midnight.
+ */
+static uint32_t time_cs(const char* time) {
+	uint32_t value = 0;
+	// Mixed radix; the tens of minutes and of seconds are base 6 digits
+	for (uint8_t i = 0; i < 6; i++) {
+		if (time[i] < '0' || time[i] > '9') {
+			return 0;
+		}
+		value = value * ((i & 1) ? 10 : 6) + (time[i] - '0');
+	}
+	value *= 100;
+	if (time[6] == '.' && time[7] >= '0' && time[7] <= '9') {
+		value += (time[7] - '0') * 10;
+		if (time[8] >= '0' && time[8] <= '9') {
+			value += time[8] - '0';
+		}
+	}
+	return value;
+}
+
 int Sensor_Module::decode(const char c) {
-	if (gps.decode(c)) {
+	passthrough_ready = false;
+	if (c == '$') {
+		sentence_us = pHALSystem->RCT_Micros();
+		TRACE(TRACE_SENTENCE_START, 0);
+	}
+	PROFILE_BEGIN(PROF_NMEA_DECODE);
+	int sentence_ready = gps.decode(c);
+	PROFILE_END(PROF_NMEA_DECODE);
+	if (sentence_ready) {
+		TRACE(TRACE_SENTENCE_END, gps.term(0)[3]);
+		if (config.nmea_passthrough) {
+			passthrough_ready = config.nmea_passthrough
+					& passthrough_type(gps.term(0));
+		}
 #ifdef DEBUG
 		Serial.println(gps.sentence());
 		Serial.println(gps.term(0));
@@ -69,6 +171,10 @@ int Sensor_Module::decode(const char c) {
 				&& gps.term(0)[4] == 'C') {
 
 			// have RMC message
+			if (assist_pending) {
+				assist_pending = false;
+				assist();
+			}
 			if (gps.gprmc_status() == 'A') {
 				packet.lat = gps.gprmc_latitude();
 				packet.lon = gps.gprmc_longitude();
@@ -87,11 +193,22 @@ int Sensor_Module::decode(const char c) {
 					}
 				}
 				if (compass_ready) {
+					compass_busy = COMPASS_BUSY_MARK;
 					packet.hdg = compass.read();
+					compass_busy = 0;
+					TRACE(TRACE_COMPASS_SAMPLE, packet.hdg / 2);
 				}
-				packet.run = digitalRead(RUN_SWITCH_PIN);
-				previous_fix = millis();
-				if (packet.fix == GPS_FIX_FIX) {
+				packet.run = pHALSystem->RCT_DigitalRead(RUN_SWITCH_PIN);
+				packet.uts = sentence_us;
+				previous_fix = pHALSystem->RCT_Millis();
+				if (packet.fix == GPS_FIX_FIX && (!fix_saved
+						|| previous_fix - previous_save >= FIX_SAVE_PERIOD_MS)) {
+					saveFix();
+				}
+				if (packet.fix == GPS_FIX_FIX && (config.output_period_ms == 0
+						|| previous_fix - previous_output
+							>= config.output_period_ms)) {
+					previous_output = previous_fix;
 					return 1;
 				}
 			}
@@ -108,13 +225,20 @@ int Sensor_Module::decode(const char c) {
 			default:	// All other types of fixes
 				packet.fix = GPS_FIX_FIX;
 				*state_var = GPS_READY;
+				if (ttff_ms == 0) {
+					ttff_ms = pHALSystem->RCT_Millis();
+				}
 				break;
 
 			}
+			alt_m = gps.term_decimal(9);
 			packet.lat = gps.term_decimal(2);
 			packet.lon = gps.term_decimal(4);
 			if (compass_ready) {
+				compass_busy = COMPASS_BUSY_MARK;
 				packet.hdg = compass.read();
+				compass_busy = 0;
+				TRACE(TRACE_COMPASS_SAMPLE, packet.hdg / 2);
 			}
 			packet.sat = gps.term_decimal(7);
 			return 0;
@@ -123,29 +247,24 @@ int Sensor_Module::decode(const char c) {
 				&& gps.term(0)[4] == 'A') {
 			// have ZDA message
 			utc_offset_ms = gps.term_decimal(1) * 1e3;
-			offset_timestamp_ms = millis();
+			offset_timestamp_ms = pHALSystem->RCT_Millis();
 			return 0;
 		}
 	}
-	if (millis() - previous_fix > 5000) {
+	if (pHALSystem->RCT_Millis() - previous_fix > config.gps_timeout_ms) {
 		*state_var = GPS_INIT;
 	}
 	return 0;
 }
 
-void Sensor_Module::start() {
-	// Check if compass device is present first
-	Wire.begin();
-	Wire.beginTransmission(0x1E);
-	if (Wire.endTransmission() == 0) {
-		compass.begin(NULL);
-		compass.setMeasurementMode(HMC5983_CONTINOUS);
-		compass_ready = true;
-	} else {
-		*state_var = GPS_FAIL;
-		compass_ready = false;
-		packet.hdg = 361;
-	}
+void Sensor_Module::start(bool warm) {
+	StoredFix fix;
+	// Also finds the slot the next save goes to, so it runs after any reset
+	bool stored = fixes.load(&fix);
+	assist_pending = !warm && stored && config.gps_assist
+			&& pHALSystem->RCT_SerialGPS != NULL;
+	compass_step = COMPASS_PROBE;
+	compass_ready = false;
 	packet.lat = 181;
 	packet.lon = 181;
 	packet.hdg = 361;
@@ -159,40 +278,297 @@ void Sensor_Module::start() {
 	packet.fix = GPS_FIX_NONE;
 	packet.sat = 0;
 	packet.rail = 0;
+	packet.uts = 0;
+}
+
+void Sensor_Module::startCompass() {
+	switch (compass_step) {
+	case COMPASS_PROBE:
+		// Check if compass device is present first
+		if (pHALSystem->RCT_I2CWrite(HMC5983_ADDRESS, NULL, 0) != 0) {
+			break;
+		}
+		compass_step++;
+		return;
+	case COMPASS_IDENTIFY:
+		if (!compass.identify()) {
+			break;
+		}
+		compass_step++;
+		return;
+	case COMPASS_RANGE:
+		compass.setRange(HMC5983_RANGE_8_1GA);
+		compass_step++;
+		return;
+	case COMPASS_RATE:
+		compass.setDataRate((hmc5983_dataRate_t) config.compass_rate);
+		compass_step++;
+		return;
+	case COMPASS_AVERAGING:
+		compass.setSampleAverages(
+				(hmc5983_sampleAverages_t) config.compass_averaging);
+		compass_step++;
+		return;
+	case COMPASS_TEMPERATURE:
+		compass.setTemperatureSensor(true);
+		compass_step++;
+		return;
+	case COMPASS_MODE:
+		compass.setMeasurementMode(HMC5983_CONTINOUS);
+		compass_step = COMPASS_READY;
+		compass_ready = true;
+		compass_ready_us = pHALSystem->RCT_Micros();
+		next_mag_us = compass_ready_us;
+		return;
+	default:
+		return;
+	}
+	skipCompass();
+}
+
+bool Sensor_Module::compassHung() {
+	return compass_busy == COMPASS_BUSY_MARK;
+}
+
+void Sensor_Module::skipCompass() {
+	compass_busy = 0;
+	*state_var = GPS_FAIL;
+	compass_step = COMPASS_ABSENT;
+	compass_ready = false;
+	packet.hdg = 361;
+}
+
+const Sensor_Module::SensorPacket& Sensor_Module::getState() const {
+	return packet;
+}
+
+void Sensor_Module::restoreState(const SensorPacket& state) {
+	packet = state;
+	if (packet.fix == GPS_FIX_FIX) {
+		*state_var = GPS_READY;
+		previous_fix = pHALSystem->RCT_Millis();
+	}
+}
+
+const char* Sensor_Module::getPassthrough() {
+	return passthrough_ready ? gps.sentence() : NULL;
+}
+
+bool Sensor_Module::sampleCompass() {
+	if (!compass_ready || config.mag_batch == 0) {
+		return false;
+	}
+	uint32_t now = pHALSystem->RCT_Micros();
+	if ((int32_t) (now - next_mag_us) < 0) {
+		return false;
+	}
+	uint32_t period = pgm_read_dword(&MAG_PERIODS_US[config.compass_rate & 7]);
+	next_mag_us += period;
+	if ((int32_t) (now - next_mag_us) >= 0) {
+		// More than a period late; start the schedule over from now
+		next_mag_us = now + period;
+	}
+	HMC5983Sample sample;
+	compass_busy = COMPASS_BUSY_MARK;
+	bool sampled = compass.readRaw(&sample);
+	compass_busy = 0;
+	if (!sampled) {
+		return false;
+	}
+	uint8_t count = mag.add(now, sample);
+	if (count == 1) {
+		// Temperature changes slowly, so once per batch is plenty
+		compass_busy = COMPASS_BUSY_MARK;
+		mag_temperature = compass.readTemperature();
+		compass_busy = 0;
+	}
+	return count >= config.mag_batch;
+}
+
+void Sensor_Module::printMagBatch(Print* out) {
+	mag.print(out, mag_temperature);
+	mag.clear();
+}
+
+void Sensor_Module::configure(const ConfigPacket& next) {
+	// Steps still to come of the bring up pick up the new values themselves
+	if (compass_step > COMPASS_RATE && compass_step != COMPASS_ABSENT
+			&& next.compass_rate != config.compass_rate) {
+		compass_busy = COMPASS_BUSY_MARK;
+		compass.setDataRate((hmc5983_dataRate_t) next.compass_rate);
+		compass_busy = 0;
+	}
+	if (compass_step > COMPASS_AVERAGING && compass_step != COMPASS_ABSENT
+			&& next.compass_averaging != config.compass_averaging) {
+		compass_busy = COMPASS_BUSY_MARK;
+		compass.setSampleAverages(
+				(hmc5983_sampleAverages_t) next.compass_averaging);
+		compass_busy = 0;
+	}
+	if (next.output_format != config.output_format
+			|| next.keyframe_interval != config.keyframe_interval) {
+		delta.reset();
+	}
+	if (next.mag_batch != config.mag_batch
+			|| next.compass_rate != config.compass_rate) {
+		mag.clear();
+		next_mag_us = pHALSystem->RCT_Micros();
+	}
+	if (pHALSystem->RCT_SerialGPS != NULL) {
+		char body[20];
+		if (next.gps_rate_hz != config.gps_rate_hz) {
+			// PMTK_SET_NMEA_UPDATERATE takes the fix period in ms
+			snprintf(body, sizeof(body), "PMTK220,%u",
+					1000 / next.gps_rate_hz);
+			sendGPS(body);
+		}
+		if (next.gps_baud != config.gps_baud) {
+			uint32_t baud = Config_Store::baud(next.gps_baud);
+			snprintf(body, sizeof(body), "PMTK251,%lu", (unsigned long) baud);
+			sendGPS(body);
+			pHALSystem->RCT_BeginGPS(baud);
+		}
+	}
+	config = next;
+}
+
+/**
+ * Formats 1e-7 degrees as decimal degrees.
+ */
+static void format_degrees(char* buf, size_t len, int32_t value) {
+	uint32_t magnitude = (value < 0) ? -(uint32_t) value : value;
+	snprintf(buf, len, "%s%lu.%07lu", (value < 0) ? "-" : "",
+			(unsigned long) (magnitude / 10000000UL),
+			(unsigned long) (magnitude % 10000000UL));
+}
+
+/**
+ * Orders GPS dates: ddmmyy as yyymmdd, with years from 80 in the 1900s, so
+ * that the 1980 date a receiver reports before it knows the time sorts
+ * before any stored fix.
+ */
+static uint32_t date_order(uint32_t date) {
+	uint32_t yy = date % 100;
+	return (yy < 80 ? yy + 100 : yy) * 10000UL + date / 100 % 100 * 100
+			+ date / 10000;
+}
+
+void Sensor_Module::assist() {
+	StoredFix fix;
+	if (!fixes.load(&fix)) {
+		return;
+	}
+	// PMTK741 takes position, altitude and UTC time.  A receiver with a
+	// backup battery keeps its clock and reports the time in its RMC before
+	// it has a fix; that time is never before the stored fix, so it is sent
+	// back unchanged rather than overridden by the stored one.  Otherwise the
+	// time the fix was stored is the best guess, and close for the short power
+	// cycles between flights.
+	aided = FIX_ASSIST_STORED_TIME;
+	if (strlen(gps.term(9)) == 6 && gps.term(1)[0] != 0) {
+		uint32_t date = strtoul(gps.term(9), NULL, 10);
+		uint32_t time = time_cs(gps.term(1));
+		if (date_order(date) > date_order(fix.date)
+				|| (date_order(date) == date_order(fix.date)
+						&& time >= fix.time_cs)) {
+			fix.date = date;
+			fix.time_cs = time;
+			aided = FIX_ASSIST_RECEIVER_TIME;
+		}
+	}
+	char lat[14];
+	char lon[14];
+	format_degrees(lat, sizeof(lat), fix.lat);
+	format_degrees(lon, sizeof(lon), fix.lon);
+	char body[80];
+	snprintf(body, sizeof(body),
+			"PMTK741,%s,%s,%d,%u,%u,%u,%u,%u,%u", lat, lon, fix.alt_m,
+			(unsigned) (2000 + fix.date % 100),
+			(unsigned) (fix.date / 100 % 100), (unsigned) (fix.date / 10000),
+			(unsigned) (fix.time_cs / 360000),
+			(unsigned) (fix.time_cs / 6000 % 60),
+			(unsigned) (fix.time_cs / 100 % 60));
+	sendGPS(body);
+}
+
+void Sensor_Module::saveFix() {
+	StoredFix fix;
+	fix.lat = packet.lat * 1e7;
+	fix.lon = packet.lon * 1e7;
+	fix.date = strtoul(packet.date, NULL, 10);
+	fix.time_cs = time_cs(packet.time);
+	fix.alt_m = alt_m;
+	fixes.save(fix);
+	previous_save = previous_fix;
+	fix_saved = true;
+}
+
+void Sensor_Module::service() {
+	if (compass_step < COMPASS_READY) {
+		compass_busy = COMPASS_BUSY_MARK;
+		startCompass();
+		compass_busy = 0;
+	}
+	fixes.service(pHALSystem->RCT_Micros());
+}
+
+bool Sensor_Module::compassReady() const {
+	return compass_ready;
+}
+
+void Sensor_Module::sendGPS(const char* body) {
+	uint8_t checksum = 0;
+	for (const char* p = body; *p; p++) {
+		checksum ^= *p;
+	}
+	char tail[6];
+	snprintf(tail, sizeof(tail), "*%02X\r\n", checksum);
+	pHALSystem->RCT_SerialGPS->print('$');
+	pHALSystem->RCT_SerialGPS->print(body);
+	pHALSystem->RCT_SerialGPS->print(tail);
 }
 
 int Sensor_Module::getPacket(char *buf, size_t len) {
+	if (config.output_format == FMT_DELTA) {
+		DeltaFix fix;
+		fix.lat = packet.lat * 1e7;
+		fix.lon = packet.lon * 1e7;
+		fix.hdg = packet.hdg;
+		fix.time_cs = time_cs(packet.time);
+		fix.date = strtoul(packet.date, NULL, 10);
+		fix.sat = packet.sat;
+		fix.fix = packet.fix == GPS_FIX_FIX;
+		fix.run = packet.run;
+		fix.uts = packet.uts;
+		return delta.encode(fix, config.keyframe_interval, buf, len);
+	}
+	if (config.output_format == FMT_JSON_SHORT) {
+		return snprintf(buf, len,
+				"{\"lat\": %ld, \"lon\": %ld, \"hdg\": %d, \"tme\": \"%s\", "
+						"\"uts\": %lu}",
+				(long) (packet.lat * 1e7), (long) (packet.lon * 1e7),
+				packet.hdg, packet.time, (unsigned long) packet.uts);
+	}
 	return snprintf(buf, len,
 			"{\"lat\": %ld, \"lon\": %ld, \"hdg\": %d, \"tme\": \"%s\", "
-					"\"run\": \"%s\", \"fix\": %d, \"sat\": %d, \"dat\": \"%s\"}",
+					"\"run\": \"%s\", \"fix\": %d, \"sat\": %d, \"dat\": \"%s\", "
+					"\"uts\": %lu}",
 			(long) (packet.lat * 1e7), (long) (packet.lon * 1e7), packet.hdg,
 			packet.time, ((packet.run) ? RUN_TRUE : RUN_FALSE),
-			(int) packet.fix, packet.sat, packet.date);
+			(int) packet.fix, packet.sat, packet.date,
+			(unsigned long) packet.uts);
+}
+
+void Sensor_Module::getDiagnostics(DiagnosticsPacket* diag){
+	diag->nmea_sentences = gps.sentences();
+	diag->nmea_checksum_errors = gps.checksum_errors();
+	diag->nmea_runaway_resets = gps.runaway_resets();
+	diag->compass_failures = compass.getFailures();
+	diag->gps_ttff_ms = ttff_ms;
+	diag->gps_aided = aided;
+	diag->boot_compass_us = compass_ready_us;
 }
 
 uint16_t Sensor_Module::measureVCC(){
-	// Read 1.1V reference against AVcc
-	// set the reference to Vcc and the measurement to the internal 1.1V reference
-#if defined(__AVR_ATmega32U4__) || defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__)
-	ADMUX = _BV(REFS0) | _BV(MUX4) | _BV(MUX3) | _BV(MUX2) | _BV(MUX1);
-#elif defined (__AVR_ATtiny24__) || defined(__AVR_ATtiny44__) || defined(__AVR_ATtiny84__)
-	ADMUX = _BV(MUX5) | _BV(MUX0);
-#elif defined (__AVR_ATtiny25__) || defined(__AVR_ATtiny45__) || defined(__AVR_ATtiny85__)
-	ADMUX = _BV(MUX3) | _BV(MUX2);
-#else
-	ADMUX = _BV(REFS0) | _BV(MUX3) | _BV(MUX2) | _BV(MUX1);
-#endif
-
-	delay(2); // Wait for Vref to settle
-	ADCSRA |= _BV(ADSC); // Start conversion
-	while (bit_is_set(ADCSRA, ADSC))
-		; // measuring
-
-	uint8_t low = ADCL; // must read ADCL first - it then locks ADCH
-	uint8_t high = ADCH; // unlocks both
-
-	long result = (high << 8) | low;
-
-	result = 1125300L / result; // Calculate Vcc (in mV); 1125300 = 1.1*1023*1000
-	return result; // Vcc in millivolts
+	return pHALSystem->RCT_ReadVCC();
 }
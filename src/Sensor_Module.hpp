@@ -30,6 +30,21 @@
 #include "nmea.hpp"
 #include "Status_Packet.hpp"
 #include "HMC5983.hpp"
+#include "Diagnostics.hpp"
+#include "Config_Store.hpp"
+#include "Mag_Batch.hpp"
+#include "Delta_Encoder.hpp"
+#include "Fix_Store.hpp"
+
+/**
+ * Buffer size for Sensor_Module::getPacket() that holds a packet of any
+ * OutputFormat.  The longest is a full FMT_JSON packet at 147 characters,
+ * plus the terminating null character.
+ */
+#define SENSOR_PACKET_MAX_LEN 160
+
+static_assert(DELTA_LINE_MAX < SENSOR_PACKET_MAX_LEN,
+	"SENSOR_PACKET_MAX_LEN does not hold a delta stream line");
 
 /**
  * Sensor Interface Module.  This class is responsible for initializing each
@@ -44,8 +59,55 @@ class Sensor_Module{
 		uint32_t utc_offset_ms;
 		uint32_t offset_timestamp_ms;
 		bool compass_ready;
+		unsigned long previous_output;
+		ConfigPacket config;
+		bool passthrough_ready;
+		Mag_Batch mag;
+		/// RCT_Micros() at which the next raw compass sample is due
+		uint32_t next_mag_us;
+		int16_t mag_temperature;
+		Delta_Encoder delta;
+		/// RCT_Micros() at the start of the sentence being decoded
+		uint32_t sentence_us;
+		Fix_Store fixes;
+		/// RCT_Millis() of the last save to the Fix_Store
+		unsigned long previous_save;
+		bool fix_saved;
+		/// Altitude from the last GGA sentence in m
+		int16_t alt_m;
+		/// RCT_Millis() at the first fix, 0 until then
+		uint32_t ttff_ms;
+		/// FixAssist sent to the receiver
+		uint8_t aided;
+		/// Whether the assistance waits for the receiver's first RMC
+		bool assist_pending;
+		/// Next step of the compass bring up, a CompassStep
+		uint8_t compass_step;
+		/// RCT_Micros() when the compass became ready, 0 until then
+		uint32_t compass_ready_us;
+		void sendGPS(const char* body);
+		void startCompass();
+		void assist();
+		void saveFix();
 
 	protected:
+		/**
+		 * Compass bring up steps.  service() runs one step per call, so
+		 * that GPS bytes are read between the I2C transactions.
+		 */
+		enum CompassStep{
+			COMPASS_PROBE,
+			COMPASS_IDENTIFY,
+			COMPASS_RANGE,
+			COMPASS_RATE,
+			COMPASS_AVERAGING,
+			COMPASS_TEMPERATURE,
+			COMPASS_MODE,
+			COMPASS_READY,
+			COMPASS_ABSENT
+		};
+
+	public:
 		/**
 		 * GPS States.  Fix should represent at least a 3D fix.
 		 */
@@ -75,8 +137,11 @@ class Sensor_Module{
 			uint8_t sat;
 			/// 5V Rail voltage
 			uint16_t rail;
+			/// RCT_Micros() at the start of the fix's RMC sentence
+			uint32_t uts;
 		} SensorPacket;
 
+	protected:
 		/**
 		 * Pointer to the GPS System state variable.
 		 */
@@ -109,9 +174,41 @@ class Sensor_Module{
 		~Sensor_Module();
 
 		/**
-		 * Initializes the sensor hardware.
+		 * Initializes the sensor hardware.  If GPS assistance is enabled and
+		 * a fix was stored, it is sent to the receiver once its first RMC
+		 * sentence shows whether it kept the time.  The compass is brought up
+		 * afterwards by service(), so start() returns without touching the
+		 * I2C bus.
+		 * @param warm true after a reset that left the GPS receiver running,
+		 *             which then needs no assistance
 		 */
-		void start();
+		void start(bool warm = false);
+
+		/**
+		 * Gets the current sensor data, to keep across a reset.
+		 * @return Current sensor data
+		 */
+		const SensorPacket& getState() const;
+
+		/**
+		 * Restores sensor data kept across a reset.  Call after start().
+		 * @param state Sensor data from getState()
+		 */
+		void restoreState(const SensorPacket& state);
+
+		/**
+		 * Whether a compass I2C transaction was under way when the UIB
+		 * reset.  Only meaningful after a watchdog reset, and only until
+		 * service() or skipCompass() next runs.
+		 * @return true if the compass hung the main loop
+		 */
+		static bool compassHung();
+
+		/**
+		 * Gives up on the compass as if it were absent, so that the I2C bus is
+		 * left alone until the next reset.  Call after restoreState().
+		 */
+		void skipCompass();
 
 		/**
 		 * Decodes a character of the GPS serial stream
@@ -131,11 +228,60 @@ class Sensor_Module{
 		 */
 		int getPacket(char* buf, size_t len);
 
+		/**
+		 * Returns the sentence completed by the last call to decode() if it
+		 * passes the raw NMEA passthrough mask.  The sentence is returned in
+		 * place in the NMEA parser, without its CR LF, and stays valid until
+		 * the next sentence completes.
+		 * @return The sentence to forward, or NULL if there is none
+		 */
+		const char* getPassthrough();
+
+		/**
+		 * Reads a raw compass sample into the current batch if one is due.
+		 * Samples are taken at the compass data rate while batches are
+		 * enabled by the configuration.
+		 * @return true if the batch is full and ready for printMagBatch()
+		 */
+		bool sampleCompass();
+
+		/**
+		 * Prints the current batch of raw compass samples and starts a new
+		 * one.
+		 * @param out Print to write to
+		 */
+		void printMagBatch(Print* out);
+		/**
+		 * Applies a configuration.  Settings that changed take effect
+		 * immediately; GPS rate and baud changes are sent to the receiver as
+		 * PMTK commands.
+		 * @param config Configuration to apply
+		 */
+		void configure(const ConfigPacket& config);
+		/**
+		 * Runs background work that must not hold up the main loop: the
+		 * compass bring up and the Fix_Store writes.  Call every loop.
+		 */
+		void service();
+
+		/**
+		 * Whether the compass is up and read with every fix.
+		 * @return true once service() has brought the compass up
+		 */
+		bool compassReady() const;
+
 		/**
 		 * Measures the VCC pin.
 		 * @return	VCC in mV
 		 */
 		uint16_t measureVCC();
+
+		/**
+		 * Fills in the GPS parser and compass counters of a diagnostics
+		 * packet.
+		 * @param diag DiagnosticsPacket to fill in
+		 */
+		void getDiagnostics(DiagnosticsPacket* diag);
 };
 
 #endif
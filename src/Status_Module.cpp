@@ -1,7 +1,139 @@
 #include "Status_Module.hpp"
 #include <Arduino.h>
+#include <stddef.h>
+#include <string.h>
+#include "HMC5983.hpp"
+#include "Mag_Batch.hpp"
 
-Status_Module::Status_Module() : state(CHECK_FOR_START){
+/**
+ * A key the OBC may send: where its value is stored and the range of valid
+ * values.
+ */
+struct StatusKey{
+	char key[4];
+	/// StatusTarget the value is stored in
+	uint8_t target;
+	/// Offset of the value in its target
+	uint8_t field;
+	uint16_t min;
+	uint16_t max;
+};
+
+/**
+ * Where a status value is stored.
+ */
+enum StatusTarget{
+	/// No key; an empty dispatch table slot
+	TARGET_NONE,
+	/// An int sized enum in the StatusPacket
+	TARGET_STATUS,
+	/// The pending OBCRequest
+	TARGET_REQUEST,
+	/// A uint16_t in the ConfigPacket
+	TARGET_CONFIG,
+	/// The ID of a pending clock synchronisation request
+	TARGET_CLOCK
+};
+
+#define STATUS_FIELD(member) TARGET_STATUS, offsetof(StatusPacket, member)
+#define STATUS_REQUEST TARGET_REQUEST, 0
+#define STATUS_CONFIG(member) TARGET_CONFIG, offsetof(ConfigPacket, member)
+#define STATUS_CLOCK TARGET_CLOCK, 0
+
+/**
+ * Keys the OBC may send.  Adding a key is one entry here; the build fails if
+ * it collides with an existing key, in which case change
+ * STATUS_HASH_MULTIPLIER or STATUS_HASH_SHIFT.
+ */
+static constexpr StatusKey STATUS_KEYS[] = {
+	{"STR", STATUS_FIELD(storage), 0, STR__SIZE - 1},
+	{"SYS", STATUS_FIELD(system), 0, SYS__SIZE - 1},
+	{"SDR", STATUS_FIELD(sdr), 0, SDR__SIZE - 1},
+	{"REQ", STATUS_REQUEST, 0, REQ__SIZE - 1},
+	{"CLK", STATUS_CLOCK, 0, 0xFFFF},
+	{"OPR", STATUS_CONFIG(output_period_ms), 0, 60000},
+	{"OFM", STATUS_CONFIG(output_format), 0, FMT__SIZE - 1},
+	{"CDR", STATUS_CONFIG(compass_rate), 0, HMC5983_DATARATE_220HZ},
+	{"CAV", STATUS_CONFIG(compass_averaging), 0, HMC5983_SAMPLEAVERAGE_8},
+	{"GRT", STATUS_CONFIG(gps_rate_hz), 1, 10},
+	{"GBD", STATUS_CONFIG(gps_baud), 0, BAUD__SIZE - 1},
+	{"GTO", STATUS_CONFIG(gps_timeout_ms), 1000, 60000},
+	{"NMP", STATUS_CONFIG(nmea_passthrough), 0, NMEA_PASS_ALL},
+	{"MGB", STATUS_CONFIG(mag_batch), 0, MAG_BATCH_MAX},
+	{"KFI", STATUS_CONFIG(keyframe_interval), 1, 255},
+	{"AID", STATUS_CONFIG(gps_assist), 0, 1},
+};
+
+#define STATUS_KEYS_N (sizeof(STATUS_KEYS) / sizeof(STATUS_KEYS[0]))
+#define STATUS_SLOTS 32
+#define STATUS_HASH_MULTIPLIER 33
+#define STATUS_HASH_SHIFT 3
+
+static_assert(STATUS_KEYS_N <= STATUS_SLOTS, "too many status keys");
+static_assert(sizeof(StorageState) == sizeof(int)
+	&& sizeof(SDRState) == sizeof(int) && sizeof(SystemState) == sizeof(int),
+	"status fields are stored as int");
+
+/**
+ * Hash of the key so far after one more character.  The parser runs this on
+ * each key character as it arrives.
+ */
+static constexpr uint8_t status_hash(uint8_t hash, char c){
+	return (uint8_t)(hash * STATUS_HASH_MULTIPLIER + (uint8_t)c);
+}
+
+/**
+ * Dispatch table slot of a full key's hash.
+ */
+static constexpr uint8_t status_slot(uint8_t hash){
+	return (hash ^ (hash >> STATUS_HASH_SHIFT)) & (STATUS_SLOTS - 1);
+}
+
+static constexpr uint8_t status_key_slot(const char* key){
+	return status_slot(status_hash(status_hash(status_hash(0, key[0]),
+		key[1]), key[2]));
+}
+
+static constexpr bool status_collides(size_t i, size_t j){
+	return i >= STATUS_KEYS_N ? false
+		: j >= STATUS_KEYS_N ? status_collides(i + 1, i + 2)
+		: status_key_slot(STATUS_KEYS[i].key)
+			== status_key_slot(STATUS_KEYS[j].key)
+		|| status_collides(i, j + 1);
+}
+
+static_assert(!status_collides(0, 1), "status key hashes collide; change "
+	"STATUS_HASH_MULTIPLIER or STATUS_HASH_SHIFT");
+
+/**
+ * Entry for a dispatch table slot: the key that hashes to it, or an empty
+ * entry.
+ */
+static constexpr StatusKey status_entry(uint8_t slot, size_t i = 0){
+	return i >= STATUS_KEYS_N ? StatusKey{"", TARGET_NONE, 0, 0, 0}
+		: status_key_slot(STATUS_KEYS[i].key) == slot ? STATUS_KEYS[i]
+		: status_entry(slot, i + 1);
+}
+
+#define STATUS_ENTRIES_4(n) status_entry(n), status_entry(n + 1), \
+	status_entry(n + 2), status_entry(n + 3)
+
+static const StatusKey STATUS_DISPATCH[STATUS_SLOTS] PROGMEM = {
+	STATUS_ENTRIES_4(0), STATUS_ENTRIES_4(4), STATUS_ENTRIES_4(8),
+	STATUS_ENTRIES_4(12), STATUS_ENTRIES_4(16), STATUS_ENTRIES_4(20),
+	STATUS_ENTRIES_4(24), STATUS_ENTRIES_4(28)
+};
+
+/**
+ * Values are clamped here while they are parsed; any larger value is out of
+ * range for every key.
+ */
+#define STATUS_VALUE_MAX 0x10000UL
+
+Status_Module::Status_Module() : state(CHECK_FOR_START), config(NULL),
+		request(REQ_NONE), messages(0), resyncs(0), rejects(0),
+		config_applied(0), config_rejected(0), clock_id(0),
+		clock_pending(false){
 	status = &_status;
 	_own_status = 1;
 	status->storage = STR_GET_OUTPUT_DIR;
@@ -10,7 +142,10 @@ Status_Module::Status_Module() : state(CHECK_FOR_START){
 	status->gps = GPS_INIT;
 }
 
-Status_Module::Status_Module(StatusPacket* packet) : state(CHECK_FOR_START){
+Status_Module::Status_Module(StatusPacket* packet, ConfigPacket* config) :
+		state(CHECK_FOR_START), config(config), request(REQ_NONE), messages(0),
+		resyncs(0), rejects(0), config_applied(0), config_rejected(0),
+		clock_id(0), clock_pending(false){
 	status = packet;
 	_own_status = 0;
 	status->storage = STR_GET_OUTPUT_DIR;
@@ -55,16 +190,42 @@ int parse_digit(char c){
 }
 
 void Status_Module::commit_value(){
-	switch(char2){
-		case 'T':
-			// STR
-			status->storage = (StorageState)value;
+	const StatusKey* entry = &STATUS_DISPATCH[status_slot(hash)];
+	uint8_t target = pgm_read_byte(&entry->target);
+	if(target == TARGET_NONE || (target == TARGET_CONFIG && config == NULL)
+			|| pgm_read_byte(&entry->key[0]) != key[0]
+			|| pgm_read_byte(&entry->key[1]) != key[1]
+			|| pgm_read_byte(&entry->key[2]) != key[2]){
+		rejects++;
+		return;
+	}
+	if(value < pgm_read_word(&entry->min) || value > pgm_read_word(&entry->max)){
+		// Out of range, e.g. a state the LED maps have no entry for
+		rejects++;
+		if(target == TARGET_CONFIG){
+			config_rejected++;
+		}
+		return;
+	}
+	uint8_t field = pgm_read_byte(&entry->field);
+	switch(target){
+		case TARGET_STATUS:{
+			int state = (int)value;
+			memcpy((uint8_t*)status + field, &state, sizeof(state));
+			return;
+		}
+		case TARGET_REQUEST:
+			request = (OBCRequest)value;
 			return;
-		case 'Y':
-			status->system = (SystemState)value;
+		case TARGET_CONFIG:{
+			uint16_t setting = (uint16_t)value;
+			memcpy((uint8_t*)config + field, &setting, sizeof(setting));
+			config_applied++;
 			return;
-		case 'D':
-			status->sdr = (SDRState)value;
+		}
+		case TARGET_CLOCK:
+			clock_id = (uint16_t)value;
+			clock_pending = true;
 			return;
 		default:
 			return;
@@ -85,25 +246,31 @@ int Status_Module::decode(char c){
 				state = GET_1_CHAR;
 			else if(is_whitespace(c)){
 				state = GET_START_QUOTE;
-			}else
+			}else{
+				resyncs++;
 				state = CHECK_FOR_START;
+			}
 			return 0;
 		case GET_1_CHAR:
-			char1 = c;
+			key[0] = c;
+			hash = status_hash(0, c);
 			state = GET_2_CHAR;
 			return 0;
 		case GET_2_CHAR:
-			char2 = c;
+			key[1] = c;
+			hash = status_hash(hash, c);
 			state = GET_3_CHAR;
 			return 0;
 		case GET_3_CHAR:
-			char3 = c;
+			key[2] = c;
+			hash = status_hash(hash, c);
 			state = GET_END_QUOTE;
 			return 0;
 		case GET_END_QUOTE:
 			if(c == '"'){
 				state = GET_COLON;
 			}else{
+				resyncs++;
 				state = GET_START_QUOTE;
 			}
 			return 0;
@@ -114,13 +281,16 @@ int Status_Module::decode(char c){
 			}else if(is_whitespace(c)){
 				state = GET_COLON;
 			}else{
+				resyncs++;
 				state = GET_START_QUOTE;
 			}
 			return 0;
 		case GET_VALUE:
 			if(is_digit(c)){
 				state = GET_VALUE;
-				value = value * 10 + parse_digit(c);
+				if(value < STATUS_VALUE_MAX){
+					value = value * 10 + parse_digit(c);
+				}
 			}else if(is_whitespace(c)){
 				state = GET_VALUE;
 			}else if(c == ','){
@@ -130,8 +300,10 @@ int Status_Module::decode(char c){
 				commit_value();
 				state = CHECK_FOR_START;
 				// complete!
+				messages++;
 				return 1;
 			}else{
+				resyncs++;
 				state = CHECK_FOR_START;
 			}
 			return 0;
@@ -143,3 +315,30 @@ int Status_Module::decode(char c){
 const StatusPacket& Status_Module::getStatus() const{
 	return *status;
 }
+
+OBCRequest Status_Module::getRequest(){
+	OBCRequest retval = request;
+	request = REQ_NONE;
+	return retval;
+}
+
+bool Status_Module::getConfigAck(uint8_t* applied, uint8_t* rejected){
+	*applied = config_applied;
+	*rejected = config_rejected;
+	config_applied = 0;
+	config_rejected = 0;
+	return *applied || *rejected;
+}
+
+bool Status_Module::getClockRequest(uint16_t* id){
+	*id = clock_id;
+	bool pending = clock_pending;
+	clock_pending = false;
+	return pending;
+}
+
+void Status_Module::getDiagnostics(DiagnosticsPacket* diag) const{
+	diag->status_messages = messages;
+	diag->status_resyncs = resyncs;
+	diag->status_rejects = rejects;
+}
@@ -2,6 +2,29 @@
 #define __STATUS_MODULE__
 
 #include "Status_Packet.hpp"
+#include "Diagnostics.hpp"
+#include "Config_Store.hpp"
+#include <stdint.h>
+
+/**
+ * Requests the OBC can make of the UIB using the "REQ" key.
+ */
+enum OBCRequest{
+	REQ_NONE = 0,
+	/// Send a diagnostics packet
+	REQ_DIAGNOSTICS = 1,
+	/// Send the hot path profile (profiling build only)
+	REQ_PROFILE = 2,
+	/// Clear the hot path profile (profiling build only)
+	REQ_PROFILE_RESET = 3,
+	/// Send and clear the event trace (trace build only)
+	REQ_TRACE = 4,
+	/// Send the configuration
+	REQ_CONFIG = 5,
+	/// Restore and store the default configuration
+	REQ_CONFIG_RESET = 6,
+	REQ__SIZE
+};
 
 /**
  * Status Module for interpreting status information from the OBC.
@@ -25,8 +48,11 @@ public:
 	/**
 	 * Alternate constructor to use a specific StatusPacket instance.  This
 	 * decoder is ready to operate immediately after this constructor.
+	 * @param packet StatusPacket to decode into
+	 * @param config ConfigPacket the configuration keys are stored in, or
+	 *               NULL to reject them
 	 */
-	Status_Module(StatusPacket* packet);
+	Status_Module(StatusPacket* packet, ConfigPacket* config = NULL);
 
 	/**
 	 * Destructor.
@@ -41,6 +67,37 @@ public:
 	 * @return   1 if a full message has been received, 0 otherwise.
 	 */
 	int decode(char c);
+
+	/**
+	 * Returns the last request received from the OBC and clears it.
+	 * @return The pending OBCRequest, or REQ_NONE if there is none.
+	 */
+	OBCRequest getRequest();
+
+	/**
+	 * Returns how many configuration values were applied to and rejected from
+	 * the ConfigPacket since the last call, and clears the counts.  Call after
+	 * each message to acknowledge it.
+	 * @param  applied  Set to the number of values applied
+	 * @param  rejected Set to the number of values out of range
+	 * @return          true if there is anything to acknowledge
+	 */
+	bool getConfigAck(uint8_t* applied, uint8_t* rejected);
+
+	/**
+	 * Returns the last clock synchronisation request received from the OBC
+	 * with the "CLK" key, and clears it.  The OBC chooses the ID and matches
+	 * it to the reply.
+	 * @param  id Set to the ID of the request
+	 * @return    true if a request is pending
+	 */
+	bool getClockRequest(uint16_t* id);
+
+	/**
+	 * Fills in the Status Module counters of a diagnostics packet.
+	 * @param diag DiagnosticsPacket to fill in
+	 */
+	void getDiagnostics(DiagnosticsPacket* diag) const;
 private:
 	enum ParserState{
 		CHECK_FOR_START,
@@ -53,19 +110,29 @@ private:
 		GET_VALUE
 	};
 
-	char char1;
-	char char2;
-	char char3;
-	unsigned int value;
+	/// Key being parsed and its hash so far
+	char key[3];
+	uint8_t hash;
+	uint32_t value;
 
 	ParserState state;
 	StatusPacket* status;
+	ConfigPacket* config;
 
 	void commit_value();
 
 	StatusPacket _status;
 
 	int _own_status;
+
+	OBCRequest request;
+	uint16_t messages;
+	uint16_t resyncs;
+	uint16_t rejects;
+	uint8_t config_applied;
+	uint8_t config_rejected;
+	uint16_t clock_id;
+	bool clock_pending;
 };
 
 #endif
\ No newline at end of file
@@ -8,7 +8,8 @@ typedef enum{
 	GPS_INIT = 0,
 	GPS_READY = 1,
 	GPS_FAIL = 2,
-	GPS_RETRY = 3
+	GPS_RETRY = 3,
+	GPS__SIZE
 } GPSState;
 
 /**
@@ -0,0 +1,56 @@
+#include "Trace.hpp"
+
+#ifdef RCT_TRACE
+
+Trace trace;
+
+Trace::Trace() : head(0), count(0), enabled(false){
+}
+
+void Trace::begin(){
+	Cycle_Timer::begin();
+	enabled = true;
+}
+
+void Trace::record(TraceEvent event, uint8_t arg){
+	uint32_t timestamp = Cycle_Timer::now();
+	uint8_t sreg = SREG;
+	cli();
+	if(enabled){
+		TraceRecord& r = ring[head];
+		r.timestamp = timestamp;
+		r.event = event;
+		r.arg = arg;
+		head = (head + 1) % TRACE_DEPTH;
+		if(count < TRACE_DEPTH){
+			count++;
+		}
+	}
+	SREG = sreg;
+}
+
+void Trace::print(Print* out){
+	enabled = false;
+	uint8_t idx = (head + TRACE_DEPTH - count) % TRACE_DEPTH;
+	out->print(F("{\"trc\": "));
+	out->print(count);
+	out->print(F(", \"clk\": "));
+	out->print((uint32_t)F_CPU);
+	out->println(F("}"));
+	for(uint8_t i = 0; i < count; i++){
+		const TraceRecord& r = ring[idx];
+		out->print(F("{\"tev\": "));
+		out->print(r.timestamp);
+		out->print(F(", \"eid\": "));
+		out->print(r.event);
+		out->print(F(", \"arg\": "));
+		out->print(r.arg);
+		out->println(F("}"));
+		idx = (idx + 1) % TRACE_DEPTH;
+	}
+	head = 0;
+	count = 0;
+	enabled = true;
+}
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef __TRACE__
+#define __TRACE__
+/*! \file */
+#include <Arduino.h>
+#include "Cycle_Timer.hpp"
+#include "Trace_Event.hpp"
+
+/**
+ * Number of records held by the trace ring.  Once full, the oldest records are
+ * overwritten.
+ */
+#define TRACE_DEPTH 64
+
+/**
+ * Single trace record.
+ */
+typedef struct TraceRecord{
+	/// Cycle_Timer timestamp
+	uint32_t timestamp;
+	/// TraceEvent ID
+	uint8_t event;
+	/// Event specific argument
+	uint8_t arg;
+} TraceRecord;
+
+/**
+ * Event trace ring.  Records timestamped events in a fixed size ring buffer in
+ * RAM.  Only compiled into the trace build (RCT_TRACE); use the TRACE macro so
+ * that the instrumentation disappears from normal builds.
+ */
+class Trace{
+public:
+	/**
+	 * Constructs an empty trace ring.
+	 */
+	Trace();
+
+	/**
+	 * Starts the cycle counter and enables recording.
+	 */
+	void begin();
+
+	/**
+	 * Records an event.  Safe to call from interrupts.
+	 * @param event TraceEvent ID
+	 * @param arg   Event specific argument
+	 */
+	void record(TraceEvent event, uint8_t arg);
+
+	/**
+	 * Writes the contents of the ring, oldest first, and empties it.
+	 * Recording is paused while the dump is in progress.  The dump starts with
+	 * a header line giving the record count and timestamp clock, followed by
+	 * one JSON line per record.
+	 * @param out Stream to write to
+	 */
+	void print(Print* out);
+
+private:
+	TraceRecord ring[TRACE_DEPTH];
+	uint8_t head;
+	uint8_t count;
+	volatile bool enabled;
+};
+
+#ifdef RCT_TRACE
+extern Trace trace;
+
+#define TRACE(event, arg) trace.record(event, arg)
+#else
+#define TRACE(event, arg)
+#endif
+
+#endif
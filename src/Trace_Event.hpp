@@ -0,0 +1,25 @@
+#ifndef __TRACE_EVENT__
+#define __TRACE_EVENT__
+/*! \file */
+/**
+ * Trace event IDs.  These values are part of the dump format read by
+ * host/trace2json, so only append to this list.
+ */
+enum TraceEvent{
+	/// '$' received from the GPS, arg unused
+	TRACE_SENTENCE_START = 0,
+	/// NMEA sentence accepted, arg is the 4th character of the sentence type
+	TRACE_SENTENCE_END = 1,
+	/// Sensor packet formatting started, arg unused
+	TRACE_PACKET_START = 2,
+	/// Sensor packet written to the OBC, arg is the packet length
+	TRACE_PACKET_END = 3,
+	/// Compass sampled, arg is the heading in units of 2 degrees
+	TRACE_COMPASS_SAMPLE = 4,
+	/// Status message received from the OBC, arg unused
+	TRACE_OBC_STATUS = 5,
+	/// LED timer interrupt entered, arg unused
+	TRACE_TIMER_ISR = 6
+};
+
+#endif
@@ -0,0 +1,136 @@
+#include "Warm_Start.hpp"
+#include <stddef.h>
+#include <string.h>
+#include "Config_Store.hpp"
+#include "ui_core.hpp"
+
+static WarmState warm RCT_NOINIT;
+
+/// expired_mark value set by expire()
+#define WARM_EXPIRED_MARK 0xA55A
+
+/// Set by expire(), so that a watchdog reset is recognised even when the
+/// bootloader has cleared the reset flags or the WarmState was torn
+static uint16_t expired_mark RCT_NOINIT;
+/// WatchdogTask the main loop was stuck in when the watchdog ran out
+static uint8_t expired_stuck RCT_NOINIT;
+/// Whether warm is being written, and so not fit to be sealed by expire()
+static volatile bool saving = false;
+
+/// Counters kept from before the last reset, added to every report
+static uint16_t base_counters[DIAG_COUNTERS];
+/// Cause of the last reset
+static uint8_t reset_cause = 0;
+/// WatchdogTask the main loop was stuck in before the last reset
+static uint8_t reset_stuck = 0;
+/// RCT_Micros() at the last save before the reset
+static uint32_t reset_saved_us = 0;
+static bool restored = false;
+
+/**
+ * Starts writing warm.  The barrier keeps the writes after the flag is set.
+ */
+static void unseal(){
+	saving = true;
+	__asm__ __volatile__("" ::: "memory");
+}
+
+/**
+ * Finishes writing warm: updates the CRC and clears the flag after it.
+ */
+static void seal(){
+	warm.saved_us = pHALSystem->RCT_Micros();
+	warm.crc = Config_Store::crc16(&warm, offsetof(WarmState, crc));
+	__asm__ __volatile__("" ::: "memory");
+	saving = false;
+}
+
+bool Warm_Start::begin(uint8_t reset_flags){
+	bool intact = warm.version == WARM_VERSION
+		&& warm.crc == Config_Store::crc16(&warm, offsetof(WarmState, crc));
+	reset_cause = reset_flags;
+	bool expired = expired_mark == WARM_EXPIRED_MARK
+		&& !(reset_flags & RCT_RESET_POWER_ON);
+	if(expired){
+		reset_cause |= RCT_RESET_WATCHDOG;
+	}
+	// After a power on the RAM is noise, whatever its CRC says
+	restored = intact && !(reset_cause & RCT_RESET_POWER_ON);
+	if(restored){
+		warm.warm_restarts++;
+		if(reset_cause & RCT_RESET_WATCHDOG){
+			warm.watchdog_resets++;
+		}
+		reset_saved_us = warm.saved_us;
+		memcpy(base_counters, warm.counters, sizeof(base_counters));
+	}else{
+		memset(&warm, 0, sizeof(warm));
+		warm.version = WARM_VERSION;
+		reset_saved_us = 0;
+		memset(base_counters, 0, sizeof(base_counters));
+	}
+	reset_stuck = expired ? expired_stuck : 0;
+	expired_mark = 0;
+	expired_stuck = 0;
+	seal();
+	return restored;
+}
+
+const WarmState& Warm_Start::state(){
+	return warm;
+}
+
+void Warm_Start::saveStatus(const StatusPacket& status){
+	unseal();
+	warm.status = status;
+	seal();
+}
+
+void Warm_Start::saveSensor(const Sensor_Module::SensorPacket& sensor){
+	unseal();
+	warm.sensor = sensor;
+	warm.sensor_valid = 1;
+	seal();
+}
+
+void Warm_Start::saveCounters(const DiagnosticsPacket& diag){
+	unseal();
+	Diagnostics::getCounters(diag, warm.counters);
+	seal();
+}
+
+void Warm_Start::expire(uint8_t stuck, const DiagnosticsPacket& diag){
+	expired_mark = WARM_EXPIRED_MARK;
+	expired_stuck = stuck;
+	if(!saving){
+		Diagnostics::getCounters(diag, warm.counters);
+		seal();
+	}
+}
+
+uint8_t Warm_Start::stuck(){
+	return reset_stuck;
+}
+
+void Warm_Start::getDiagnostics(DiagnosticsPacket* diag){
+	Diagnostics::addCounters(diag, base_counters);
+	diag->reset_flags = reset_cause;
+	diag->warm_restarts = warm.warm_restarts;
+	diag->watchdog_resets = warm.watchdog_resets;
+}
+
+void Warm_Start::print(Print* out){
+	out->print(F("{\"rst\": "));
+	out->print(reset_cause);
+	out->print(F(", \"wrm\": "));
+	out->print(restored ? 1 : 0);
+	out->print(F(", \"wrs\": "));
+	out->print(warm.warm_restarts);
+	out->print(F(", \"wdr\": "));
+	out->print(warm.watchdog_resets);
+	out->print(F(", \"tsk\": "));
+	out->print(reset_stuck);
+	out->print(F(", \"upt\": "));
+	out->print(reset_saved_us);
+	out->println(F("}"));
+}
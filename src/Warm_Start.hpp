@@ -0,0 +1,108 @@
+#ifndef __WARM_START__
+#define __WARM_START__
+/*! \file */
+#include <Arduino.h>
+#include "Status_Packet.hpp"
+#include "Sensor_Module.hpp"
+#include "Diagnostics.hpp"
+
+/**
+ * Layout version of WarmState.  Bump this whenever WarmState changes, so that
+ * a new firmware image does not misread the state left by the old one.
+ */
+#define WARM_VERSION 3
+
+/**
+ * State kept in RAM across any reset that does not remove power.
+ */
+typedef struct WarmState{
+	uint8_t version;
+	/// Resets since power on that kept this state
+	uint16_t warm_restarts;
+	/// Watchdog resets since power on
+	uint16_t watchdog_resets;
+	/// RCT_Micros() at the last save
+	uint32_t saved_us;
+	/// Whether sensor holds a packet
+	uint8_t sensor_valid;
+	StatusPacket status;
+	Sensor_Module::SensorPacket sensor;
+	/// Diagnostics counters as last reported, see Diagnostics::getCounters()
+	uint16_t counters[DIAG_COUNTERS];
+	/// CRC of everything before it
+	uint16_t crc;
+} WarmState;
+
+/**
+ * Warm restart support.  The last status, sensor data and diagnostics
+ * counters are copied to an RCT_NOINIT WarmState as they change.  After a
+ * reset that kept the RAM (watchdog, reset button or brown out), the copy is
+ * checked against its CRC and, if intact, restored, so that the UIB carries
+ * on where it stopped instead of starting from scratch.
+ */
+class Warm_Start{
+public:
+	/**
+	 * Checks the kept state and counts the reset.  Call once at boot, before
+	 * anything is saved.
+	 * @param  reset_flags RCT_RESET_* flags from RCT_ResetFlags()
+	 * @return             true if the kept state is intact and should be
+	 *                     restored
+	 */
+	static bool begin(uint8_t reset_flags);
+
+	/**
+	 * Kept state.  Only meaningful if begin() returned true.
+	 */
+	static const WarmState& state();
+
+	/**
+	 * Saves the subsystem states.
+	 * @param status Current status
+	 */
+	static void saveStatus(const StatusPacket& status);
+
+	/**
+	 * Saves the sensor data.
+	 * @param sensor Current sensor data
+	 */
+	static void saveSensor(const Sensor_Module::SensorPacket& sensor);
+
+	/**
+	 * Saves the diagnostics counters.
+	 * @param diag Diagnostics packet as reported, including the counters kept
+	 *             from before the last reset
+	 */
+	static void saveCounters(const DiagnosticsPacket& diag);
+
+	/**
+	 * Records that the watchdog ran out.  Called from interrupt context, so
+	 * it may have interrupted a save: the reset and the stuck task are kept
+	 * outside the WarmState, and the counters are only saved if no save was
+	 * under way.
+	 * @param stuck WatchdogTask the main loop was stuck in
+	 * @param diag  Diagnostics packet at the time, as for saveCounters()
+	 */
+	static void expire(uint8_t stuck, const DiagnosticsPacket& diag);
+
+	/**
+	 * Task the main loop was stuck in before the last reset.
+	 * @return WatchdogTask, or 0 if the last reset was not a watchdog reset
+	 */
+	static uint8_t stuck();
+
+	/**
+	 * Fills in the reset fields of a diagnostics packet and adds the counters
+	 * kept from before the last reset.
+	 * @param diag DiagnosticsPacket to fill in
+	 */
+	static void getDiagnostics(DiagnosticsPacket* diag);
+
+	/**
+	 * Prints the reset report as a JSON packet.
+	 * @param out Print to write to
+	 */
+	static void print(Print* out);
+};
+
+#endif
@@ -0,0 +1,30 @@
+#include "Watchdog.hpp"
+#include "ui_core.hpp"
+
+Watchdog::Watchdog() : checked_in(0), last(0), running(false){
+}
+
+void Watchdog::begin(){
+	checked_in = 0;
+	running = true;
+	pHALSystem->RCT_WatchdogStart();
+}
+
+void Watchdog::checkIn(uint8_t task){
+	uint8_t sreg = SREG;
+	cli();
+	checked_in |= task;
+	last = task;
+	SREG = sreg;
+}
+
+uint8_t Watchdog::stuck() const{
+	if(checked_in == WDT_TASK_ALL){
+		// The tasks all ran since the last kick; the tick stopped instead
+		return WDT_TASK_TICK;
+	}
+	if(last == 0 || last == WDT_TASK_SENSOR){
+		return WDT_TASK_GPS;
+	}
+	return last << 1;
+}
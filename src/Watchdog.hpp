@@ -0,0 +1,86 @@
+#ifndef __WATCHDOG__
+#define __WATCHDOG__
+/*! \file */
+#include <Arduino.h>
+#ifdef __AVR__
+#include <avr/wdt.h>
+#endif
+#include "ui_core.hpp"
+
+/**
+ * Main loop tasks that must check in for the watchdog to be kicked, as bits
+ * in the order the loop runs them.
+ */
+enum WatchdogTask{
+	/// GPS stream read and decoded
+	WDT_TASK_GPS = 0x01,
+	/// OBC stream read and its messages handled
+	WDT_TASK_OBC = 0x02,
+	/// Sensor background work and compass sampling done
+	WDT_TASK_SENSOR = 0x04,
+	WDT_TASK_ALL = 0x07,
+	/// Not a task: reported as stuck when every task checked in but the
+	/// system tick did not run to kick the watchdog
+	WDT_TASK_TICK = 0x80
+};
+
+/**
+ * Watchdog supervisor.  Each main loop task checks in once per pass, and the
+ * system tick kicks the hardware watchdog only once every task has checked in
+ * since the last kick.  A task that gets stuck therefore lets the watchdog
+ * run out even though the tick interrupt keeps running, and a tick that stops
+ * does the same.  With the 5 Hz tick and RCT_WATCHDOG_MS of 1 s, a task has
+ * about 800 ms to check in.
+ */
+class Watchdog{
+public:
+	/**
+	 * Constructs a supervisor with no tasks checked in.
+	 */
+	Watchdog();
+
+	/**
+	 * Starts the hardware watchdog.
+	 */
+	void begin();
+
+	/**
+	 * Records that a task completed a pass.  Safe to call with interrupts
+	 * enabled.
+	 * @param task WatchdogTask bit
+	 */
+	void checkIn(uint8_t task);
+
+	/**
+	 * Kicks the hardware watchdog if every task has checked in.  Call from
+	 * the system tick.  Inline, and on the UIB a bare wdr rather than a call
+	 * through the HAL, so that it adds only a few cycles to the tick ISR.
+	 */
+	inline void tick(){
+		if(running && checked_in == WDT_TASK_ALL){
+			checked_in = 0;
+#ifdef __AVR__
+			wdt_reset();
+#else
+			pHALSystem->RCT_WatchdogKick();
+#endif
+		}
+	}
+
+	/**
+	 * Task the main loop is stuck in, for when the watchdog runs out.  Tasks
+	 * keep checking in many times between two ticks, so which ones checked
+	 * in says little; the loop is in the task after the last one that did.
+	 * @return WatchdogTask, or WDT_TASK_TICK if every task has checked in
+	 *         since the last kick
+	 */
+	uint8_t stuck() const;
+
+private:
+	volatile uint8_t checked_in;
+	/// Last task to check in, 0 if none has yet
+	volatile uint8_t last;
+	bool running;
+};
+
+#endif
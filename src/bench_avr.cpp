@@ -0,0 +1,228 @@
+/*
+ * @file bench_avr.cpp
+ *
+ * @description Radio Telemetry Tracker UI Core - cycle benchmark image
+ *
+ * Benchmark firmware for host/simbench.  Runs each hot path of the UIB
+ * firmware on fixed inputs, bracketing every unit of work with the markers in
+ * Bench_Marker.hpp so that the simulator can count its cycles exactly.  The
+ * compass is replaced by an in-memory register file behind the HAL, so
+ * HMC5983::read times the heading computation and the HAL calls, not the bus.
+ * The last benchmark reads Serial1, and times whatever the harness scripts
+ * into UART1, including the RX interrupt.
+ *
+ *
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <Arduino.h>
+#include "ui_core.hpp"
+#include "nmea.hpp"
+#include "Sensor_Module.hpp"
+#include "HMC5983.hpp"
+#include "LED_Engine.hpp"
+#include "Bench_Marker.hpp"
+
+#define BENCH_SENTENCE_MAX_LEN 100
+#define BENCH_REPEAT 16
+/// Stop the UART benchmark after this many bytes
+#define BENCH_UART_BYTES 4096
+/// Stop the UART benchmark after this long without a byte, in ms
+#define BENCH_UART_IDLE_MS 2000
+
+static const char BENCH_RMC[] PROGMEM =
+	"$GNRMC,120000.00,A,3252.84200,N,11714.05800,W,0.12,90.0,191026,,,A*51\r\n";
+static const char BENCH_GGA[] PROGMEM =
+	"$GNGGA,120000.00,3252.84200,N,11714.05800,W,1,09,0.9,110.5,M,-35.2,M,,*48\r\n";
+
+StatusPacket status;
+Sensor_Module sensor(&status.gps);
+HMC5983 compass;
+LED_Engine<4, 12, 6, 8, 9> leds;
+RCT_HAL_System_t systemDescriptor;
+RCT_HAL_System_t* pHALSystem = NULL;
+
+char packet_buf[SENSOR_PACKET_MAX_LEN];
+char sentence_buf[BENCH_SENTENCE_MAX_LEN];
+
+/**
+ * Compass register file, with the ID registers and a fixed field reading.
+ */
+static uint8_t compass_regs[HMC5983_REG_IDENT_C + 1] = {
+	0x10, 0x20, 0x00,	// config A, config B, mode
+	0x01, 0x2C,			// X = 300
+	0xFF, 0x38,			// Z = -200
+	0x00, 0x96,			// Y = 150
+	0x01,				// status
+	'H', '4', '3'
+};
+static uint8_t compass_pointer = 0;
+
+static uint8_t stub_i2c_write(uint8_t addr, const uint8_t* data, uint8_t len){
+	if(addr != HMC5983_ADDRESS){
+		return 2;
+	}
+	if(len > 0){
+		compass_pointer = data[0];
+	}
+	return 0;
+}
+
+static uint8_t stub_i2c_read(uint8_t addr, uint8_t* data, uint8_t len){
+	if(addr != HMC5983_ADDRESS){
+		return 0;
+	}
+	for(uint8_t i = 0; i < len; i++){
+		data[i] = (compass_pointer < sizeof(compass_regs))
+			? compass_regs[compass_pointer] : 0;
+		compass_pointer = (compass_pointer == HMC5983_OUT_Y_LSB)
+			? HMC5983_OUT_X_MSB : compass_pointer + 1;
+	}
+	return len;
+}
+
+RCT_TICK_HANDLER(){
+	leds.update();
+}
+
+/**
+ * The benchmarks never start the watchdog, but hal_arduino.cpp's WDT_vect
+ * calls this.
+ */
+void watchdog_expired(void){
+}
+
+/**
+ * Times one pass through the Timer 1 compare vector, entry and reti included.
+ * Timer 1 runs at clk/1 with interrupts off until its compare flag is
+ * pending; the interrupt is then taken in a sei/nop/cli window between the
+ * markers.  The window adds 3 cycles that BENCH_EMPTY does not subtract.
+ */
+static void bench_timer_isr(){
+	TCCR1A = 0;
+	TCCR1B = _BV(WGM12) | _BV(CS10);
+	OCR1A = 0xFF;
+	TIMSK1 = _BV(OCIE1A);
+	for(uint8_t i = 0; i < LED_FRAME_TICKS; i++){
+		TIFR1 = _BV(OCF1A);
+		while(!(TIFR1 & _BV(OCF1A))){
+		}
+		BENCH_START(BENCH_TIMER_ISR);
+		__asm__ __volatile__("sei\n\tnop\n\tcli" ::: "memory");
+		BENCH_STOP();
+	}
+	TIMSK1 = 0;
+	TCCR1B = 0;
+}
+
+/**
+ * Copies a sentence out of program memory.
+ * @return Length of the sentence
+ */
+static uint8_t load(const char* sentence){
+	strncpy_P(sentence_buf, sentence, BENCH_SENTENCE_MAX_LEN - 1);
+	sentence_buf[BENCH_SENTENCE_MAX_LEN - 1] = 0;
+	return strlen(sentence_buf);
+}
+
+static void bench_nmea_bytes(NMEA& gps, const char* sentence){
+	uint8_t len = load(sentence);
+	for(uint8_t i = 0; i < len; i++){
+		char c = sentence_buf[i];
+		BENCH_START(BENCH_NMEA_BYTE);
+		gps.decode(c);
+		BENCH_STOP();
+	}
+}
+
+static void bench_sentence(BenchId id, const char* sentence){
+	uint8_t len = load(sentence);
+	BENCH_START(id);
+	for(uint8_t i = 0; i < len; i++){
+		sensor.decode(sentence_buf[i]);
+	}
+	BENCH_STOP();
+}
+
+static void bench_uart(){
+	uint16_t bytes = 0;
+	uint32_t last = millis();
+	while(bytes < BENCH_UART_BYTES && millis() - last < BENCH_UART_IDLE_MS){
+		if(pHALSystem->RCT_SerialGPS->available() > 0){
+			BENCH_START(BENCH_UART_BYTE);
+			sensor.decode(pHALSystem->RCT_SerialGPS->read());
+			BENCH_STOP();
+			bytes++;
+			last = millis();
+		}
+	}
+}
+
+void setup(){
+	pHALSystem = &systemDescriptor;
+	RCT_HAL_Init(pHALSystem);
+	pHALSystem->RCT_I2CWrite = stub_i2c_write;
+	pHALSystem->RCT_I2CRead = stub_i2c_read;
+	pHALSystem->RCT_BeginGPS(9600);
+	leds.begin();
+	sensor.start();
+	// The main loop would bring the compass up over its first iterations
+	for(uint8_t i = 0; i < 16; i++){
+		sensor.service();
+	}
+	compass.begin(NULL);
+	leds.set(0, FAST);
+	leds.set(1, SLOW);
+	leds.set(2, BLINK_2);
+
+	// Everything but the UART benchmark runs with interrupts off, so that
+	// the Timer 0 tick does not land inside a measurement
+	cli();
+	for(uint8_t i = 0; i < BENCH_REPEAT; i++){
+		BENCH_START(BENCH_EMPTY);
+		BENCH_STOP();
+	}
+
+	NMEA gps(ALL);
+	for(uint8_t i = 0; i < BENCH_REPEAT; i++){
+		bench_nmea_bytes(gps, BENCH_GGA);
+		bench_nmea_bytes(gps, BENCH_RMC);
+	}
+
+	for(uint8_t i = 0; i < BENCH_REPEAT; i++){
+		bench_sentence(BENCH_GGA_SENTENCE, BENCH_GGA);
+		bench_sentence(BENCH_RMC_SENTENCE, BENCH_RMC);
+	}
+
+	for(uint8_t i = 0; i < BENCH_REPEAT; i++){
+		BENCH_START(BENCH_GET_PACKET);
+		sensor.getPacket(packet_buf, SENSOR_PACKET_MAX_LEN);
+		BENCH_STOP();
+	}
+
+	for(uint8_t i = 0; i < BENCH_REPEAT; i++){
+		BENCH_START(BENCH_COMPASS_READ);
+		compass.read();
+		BENCH_STOP();
+	}
+
+	bench_timer_isr();
+	sei();
+
+	bench_uart();
+	BENCH_DONE();
+}
+
+void loop(){
+}
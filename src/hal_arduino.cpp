@@ -0,0 +1,195 @@
+/*
+ * @file hal_arduino.cpp
+ *
+ * @description Radio Telemetry Tracker UI Core - ATmega32U4 HAL backend
+ *
+ *
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <Arduino.h>
+#include <Wire.h>
+#include <avr/eeprom.h>
+#include <avr/wdt.h>
+#include "ui_core.hpp"
+
+/**
+ * MCUSR as it was at reset.  It is saved from .init3, before .bss is cleared,
+ * so it must live in .noinit.
+ */
+static uint8_t avr_mcusr RCT_NOINIT;
+
+/**
+ * Saves and clears MCUSR and stops the watchdog, which stays enabled with
+ * its shortest timeout after a watchdog reset.  Runs from .init3, so it must
+ * be naked and must not use the stack.  The Caterina bootloader clears MCUSR
+ * itself before starting the sketch, in which case the flags read 0 here.
+ */
+void avr_save_mcusr(void) __attribute__((naked, used, section(".init3")));
+
+void avr_save_mcusr(void){
+	avr_mcusr = MCUSR;
+	MCUSR = 0;
+	wdt_disable();
+}
+
+static void avr_begin_obc(uint32_t baud){
+	Serial.begin(baud);
+}
+
+static void avr_begin_gps(uint32_t baud){
+	Serial1.end();
+	Serial1.begin(baud);
+}
+
+static uint8_t avr_i2c_write(uint8_t addr, const uint8_t* data, uint8_t len){
+	Wire.beginTransmission(addr);
+	if(len){
+		Wire.write(data, len);
+	}
+	return Wire.endTransmission();
+}
+
+static uint8_t avr_i2c_read(uint8_t addr, uint8_t* data, uint8_t len){
+	uint8_t n = Wire.requestFrom(addr, len);
+	for(uint8_t i = 0; i < n; i++){
+		data[i] = Wire.read();
+	}
+	return n;
+}
+
+static void avr_pin_mode(uint8_t pin, uint8_t mode){
+	pinMode(pin, mode);
+}
+
+static int avr_digital_read(uint8_t pin){
+	return digitalRead(pin);
+}
+
+static void avr_digital_write(uint8_t pin, uint8_t value){
+	digitalWrite(pin, value);
+}
+
+static void avr_attach_interrupt(uint8_t pin, void (*isr)(void), int mode){
+	attachInterrupt(digitalPinToInterrupt(pin), isr, mode);
+}
+
+static uint16_t avr_read_vcc(void){
+	// Read 1.1V reference against AVcc
+	// set the reference to Vcc and the measurement to the internal 1.1V reference
+#if defined(__AVR_ATmega32U4__) || defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__)
+	ADMUX = _BV(REFS0) | _BV(MUX4) | _BV(MUX3) | _BV(MUX2) | _BV(MUX1);
+#elif defined (__AVR_ATtiny24__) || defined(__AVR_ATtiny44__) || defined(__AVR_ATtiny84__)
+	ADMUX = _BV(MUX5) | _BV(MUX0);
+#elif defined (__AVR_ATtiny25__) || defined(__AVR_ATtiny45__) || defined(__AVR_ATtiny85__)
+	ADMUX = _BV(MUX3) | _BV(MUX2);
+#else
+	ADMUX = _BV(REFS0) | _BV(MUX3) | _BV(MUX2) | _BV(MUX1);
+#endif
+
+	delay(2); // Wait for Vref to settle
+	ADCSRA |= _BV(ADSC); // Start conversion
+	while (bit_is_set(ADCSRA, ADSC))
+		; // measuring
+
+	uint8_t low = ADCL; // must read ADCL first - it then locks ADCH
+	uint8_t high = ADCH; // unlocks both
+
+	long result = (high << 8) | low;
+
+	result = 1125300L / result; // Calculate Vcc (in mV); 1125300 = 1.1*1023*1000
+	return result; // Vcc in millivolts
+}
+
+static void avr_eeprom_read(uint16_t addr, void* data, uint16_t len){
+	eeprom_read_block(data, (const void*)addr, len);
+}
+
+static void avr_eeprom_write(uint16_t addr, const void* data, uint16_t len){
+	eeprom_update_block(data, (void*)addr, len);
+}
+
+static uint32_t avr_millis(void){
+	return millis();
+}
+
+static uint32_t avr_micros(void){
+	return micros();
+}
+
+static void avr_delay(uint32_t ms){
+	delay(ms);
+}
+
+static void avr_start_tick(void){
+	// Timer 1, CTC mode, clk/1024, 3125 counts per tick: 5 Hz.  The vector
+	// is defined by the application with RCT_TICK_HANDLER()
+	cli();
+	TCCR1A = 0;
+	TCCR1B = 0;
+	TCNT1  = 0;
+	OCR1A = 3124;
+	TCCR1B |= (1 << WGM12);
+	TCCR1B |= (1 << CS12) | (1 << CS10);
+	TIMSK1 |= (1 << OCIE1A);
+	sei();
+}
+
+static void avr_watchdog_start(void){
+	// Interrupt and system reset mode, so that the first timeout runs
+	// WDT_vect rather than resetting straight away
+	wdt_enable(WDTO_1S);	// RCT_WATCHDOG_MS
+	WDTCSR |= _BV(WDIE);
+}
+
+static void avr_watchdog_kick(void){
+	wdt_reset();
+}
+
+static uint8_t avr_reset_flags(void){
+	return avr_mcusr & (RCT_RESET_POWER_ON | RCT_RESET_EXTERNAL
+		| RCT_RESET_BROWN_OUT | RCT_RESET_WATCHDOG);
+}
+
+ISR( WDT_vect ) {
+	watchdog_expired();
+	// Reset now rather than after another full timeout
+	wdt_enable(WDTO_15MS);
+	for(;;){
+	}
+}
+
+void RCT_HAL_Init(RCT_HAL_System_t* system){
+	system->RCT_SerialOBC = &Serial;
+	system->RCT_SerialGPS = &Serial1;
+	system->RCT_BeginOBC = avr_begin_obc;
+	system->RCT_BeginGPS = avr_begin_gps;
+	system->RCT_I2CWrite = avr_i2c_write;
+	system->RCT_I2CRead = avr_i2c_read;
+	system->RCT_PinMode = avr_pin_mode;
+	system->RCT_DigitalRead = avr_digital_read;
+	system->RCT_DigitalWrite = avr_digital_write;
+	system->RCT_AttachInterrupt = avr_attach_interrupt;
+	system->RCT_ReadVCC = avr_read_vcc;
+	system->RCT_EEPROMRead = avr_eeprom_read;
+	system->RCT_EEPROMWrite = avr_eeprom_write;
+	system->RCT_Millis = avr_millis;
+	system->RCT_Micros = avr_micros;
+	system->RCT_Delay = avr_delay;
+	system->RCT_StartTick = avr_start_tick;
+	system->RCT_WatchdogStart = avr_watchdog_start;
+	system->RCT_WatchdogKick = avr_watchdog_kick;
+	system->RCT_ResetFlags = avr_reset_flags;
+	Wire.begin();
+}
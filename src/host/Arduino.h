@@ -0,0 +1,117 @@
+#ifndef __HOST_ARDUINO__
+#define __HOST_ARDUINO__
+/*! \file
+ * Minimal Arduino core API for building the firmware as a native process.
+ * Only the parts of the core that the firmware sources use are provided;
+ * everything that touches hardware goes through the HAL instead.
+ */
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdio.h>
+
+#ifndef F_CPU
+#define F_CPU 16000000UL
+#endif
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 0x1
+#define LOW  0x0
+
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define INPUT_PULLUP 0x2
+
+#define CHANGE 1
+#define FALLING 2
+#define RISING 3
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+#define PI 3.1415926535897932384626433832795
+#define TWO_PI 6.283185307179586476925286766559
+#define radians(deg) ((deg)*0.017453292519943295769236907684886)
+#define degrees(rad) ((rad)*57.295779513082320876798154814105)
+#define sq(x) ((x)*(x))
+#define _BV(bit) (1 << (bit))
+
+/*
+ * Program memory is ordinary memory off target.
+ */
+#define PROGMEM
+#define pgm_read_byte(addr) (*(const uint8_t*)(addr))
+#define pgm_read_word(addr) (*(const uint16_t*)(addr))
+#define pgm_read_dword(addr) (*(const uint32_t*)(addr))
+#define pgm_read_ptr(addr) (*(void* const*)(addr))
+
+/*
+ * The host backend delivers the timer tick from the main thread, so the
+ * interrupt flag only has to exist for the firmware's critical sections to
+ * compile.
+ */
+extern uint8_t SREG;
+#define cli() (SREG &= 0x7F)
+#define sei() (SREG |= 0x80)
+
+class __FlashStringHelper;
+#define F(string_literal) (reinterpret_cast<const __FlashStringHelper*>(string_literal))
+
+/**
+ * Formatted output base, as in the Arduino core.
+ */
+class Print{
+public:
+	virtual ~Print(){}
+	virtual size_t write(uint8_t c) = 0;
+	virtual size_t write(const uint8_t* buffer, size_t size);
+	size_t write(const char* str){
+		return (str == NULL) ? 0 : write((const uint8_t*)str, strlen(str));
+	}
+	virtual int availableForWrite(){
+		return 0;
+	}
+
+	size_t print(const __FlashStringHelper* str);
+	size_t print(const char* str);
+	size_t print(char c);
+	size_t print(unsigned char n, int base = DEC);
+	size_t print(int n, int base = DEC);
+	size_t print(unsigned int n, int base = DEC);
+	size_t print(long n, int base = DEC);
+	size_t print(unsigned long n, int base = DEC);
+	size_t print(double n, int digits = 2);
+
+	size_t println(const __FlashStringHelper* str);
+	size_t println(const char* str);
+	size_t println(char c);
+	size_t println(unsigned char n, int base = DEC);
+	size_t println(int n, int base = DEC);
+	size_t println(unsigned int n, int base = DEC);
+	size_t println(long n, int base = DEC);
+	size_t println(unsigned long n, int base = DEC);
+	size_t println(double n, int digits = 2);
+	size_t println(void);
+
+private:
+	size_t printNumber(unsigned long n, uint8_t base);
+};
+
+/**
+ * Byte stream, as in the Arduino core.
+ */
+class Stream : public Print{
+public:
+	virtual int available() = 0;
+	virtual int read() = 0;
+	virtual int peek() = 0;
+	virtual void flush(){}
+};
+
+#endif
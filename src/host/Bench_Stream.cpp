@@ -0,0 +1,58 @@
+#include "Bench_Stream.hpp"
+
+Bench_Stream::Bench_Stream() : head(0), tail(0), rx_dropped(0){
+}
+
+bool Bench_Stream::receive(uint8_t c){
+	uint8_t next = (head + 1) % BENCH_RX_BUFFER_SIZE;
+	if(next == tail){
+		rx_dropped++;
+		return false;
+	}
+	rx[head] = c;
+	head = next;
+	return true;
+}
+
+void Bench_Stream::takeLines(std::vector<std::string>& lines){
+	lines.insert(lines.end(), tx_lines.begin(), tx_lines.end());
+	tx_lines.clear();
+}
+
+void Bench_Stream::reset(){
+	head = tail = 0;
+	rx_dropped = 0;
+	tx_line.clear();
+	tx_lines.clear();
+}
+
+int Bench_Stream::available(){
+	return (BENCH_RX_BUFFER_SIZE + head - tail) % BENCH_RX_BUFFER_SIZE;
+}
+
+int Bench_Stream::read(){
+	if(head == tail){
+		return -1;
+	}
+	uint8_t c = rx[tail];
+	tail = (tail + 1) % BENCH_RX_BUFFER_SIZE;
+	return c;
+}
+
+int Bench_Stream::peek(){
+	return (head == tail) ? -1 : rx[tail];
+}
+
+size_t Bench_Stream::write(uint8_t c){
+	if(c == '\n'){
+		tx_lines.push_back(tx_line);
+		tx_line.clear();
+	}else if(c != '\r'){
+		tx_line += (char)c;
+	}
+	return 1;
+}
+
+int Bench_Stream::availableForWrite(){
+	return BENCH_RX_BUFFER_SIZE;
+}
@@ -0,0 +1,65 @@
+#ifndef __BENCH_STREAM__
+#define __BENCH_STREAM__
+/*! \file */
+#include <Arduino.h>
+#include <string>
+#include <vector>
+
+/**
+ * Size of the simulated UART receive ring, as in the Arduino core.
+ */
+#define BENCH_RX_BUFFER_SIZE 64
+
+/**
+ * In-memory serial port for host harnesses.  Received bytes go through a ring
+ * of the same size as the Arduino core's, which holds one less than its size
+ * and drops bytes when full, so harnesses see the same overruns a slow loop()
+ * would cause on the board.  Transmitted bytes are collected into lines.
+ */
+class Bench_Stream : public Stream{
+public:
+	Bench_Stream();
+
+	/**
+	 * Delivers a byte from the far end of the link, as the RX interrupt would.
+	 * @param  c Received byte
+	 * @return   false if the ring was full and the byte was dropped
+	 */
+	bool receive(uint8_t c);
+
+	/**
+	 * Number of bytes dropped because the ring was full.
+	 */
+	uint32_t dropped() const{
+		return rx_dropped;
+	}
+
+	/**
+	 * Takes the lines transmitted since the last call, without their line
+	 * endings.
+	 * @param lines Vector to append the completed lines to
+	 */
+	void takeLines(std::vector<std::string>& lines);
+
+	/**
+	 * Discards all received and transmitted data and clears the counters.
+	 */
+	void reset();
+
+	int available();
+	int read();
+	int peek();
+	size_t write(uint8_t c);
+	int availableForWrite();
+	using Print::write;
+
+private:
+	uint8_t rx[BENCH_RX_BUFFER_SIZE];
+	uint8_t head;
+	uint8_t tail;
+	uint32_t rx_dropped;
+	std::string tx_line;
+	std::vector<std::string> tx_lines;
+};
+
+#endif
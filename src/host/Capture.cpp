@@ -0,0 +1,191 @@
+#include "Capture.hpp"
+#include <string.h>
+
+static const char CAPTURE_MAGIC[6] = {'R', 'C', 'T', 'C', 'A', 'P'};
+
+static const char* const CAPTURE_PORT_NAMES[CAP_PORT__SIZE] = {
+	"gps", "obc_rx", "obc_tx", "gps_tx"
+};
+
+const char* capture_port_name(uint8_t port){
+	return (port < CAP_PORT__SIZE) ? CAPTURE_PORT_NAMES[port] : "unknown";
+}
+
+uint8_t capture_port_parse(const char* name){
+	for(uint8_t i = 0; i < CAP_PORT__SIZE; i++){
+		if(!strcmp(name, CAPTURE_PORT_NAMES[i])){
+			return i;
+		}
+	}
+	return CAP_PORT__SIZE;
+}
+
+static void put_varint(FILE* f, uint64_t v){
+	do{
+		uint8_t b = v & 0x7F;
+		v >>= 7;
+		fputc(b | (v ? 0x80 : 0), f);
+	}while(v);
+}
+
+static bool get_varint(FILE* f, uint64_t* v){
+	*v = 0;
+	for(uint8_t shift = 0; shift < 64; shift += 7){
+		int c = fgetc(f);
+		if(c == EOF){
+			return false;
+		}
+		*v |= (uint64_t)(c & 0x7F) << shift;
+		if(!(c & 0x80)){
+			return true;
+		}
+	}
+	return false;
+}
+
+static void put_le(FILE* f, uint64_t v, uint8_t bytes){
+	for(uint8_t i = 0; i < bytes; i++){
+		fputc((v >> (8 * i)) & 0xFF, f);
+	}
+}
+
+static bool get_le(FILE* f, uint64_t* v, uint8_t bytes){
+	*v = 0;
+	for(uint8_t i = 0; i < bytes; i++){
+		int c = fgetc(f);
+		if(c == EOF){
+			return false;
+		}
+		*v |= (uint64_t)c << (8 * i);
+	}
+	return true;
+}
+
+Capture_Writer::Capture_Writer() : coalesce_us(CAPTURE_COALESCE_US),
+		file(NULL), last_us(0), has_pending(false){
+}
+
+Capture_Writer::~Capture_Writer(){
+	close();
+}
+
+bool Capture_Writer::open(const char* path, uint64_t start_us){
+	close();
+	file = fopen(path, "wb");
+	if(file == NULL){
+		return false;
+	}
+	fwrite(CAPTURE_MAGIC, 1, sizeof(CAPTURE_MAGIC), file);
+	put_le(file, CAPTURE_VERSION, 2);
+	put_le(file, start_us, 8);
+	last_us = 0;
+	has_pending = false;
+	return true;
+}
+
+void Capture_Writer::write(uint64_t t_us, uint8_t port, const uint8_t* data,
+		size_t len){
+	if(file == NULL || len == 0){
+		return;
+	}
+	if(has_pending && (pending.port != port
+			|| t_us - pending.t_us > coalesce_us)){
+		flush();
+	}
+	if(!has_pending){
+		pending.t_us = t_us;
+		pending.port = port;
+		pending.data.clear();
+		has_pending = true;
+	}
+	pending.data.append((const char*)data, len);
+}
+
+void Capture_Writer::flush(){
+	if(file == NULL || !has_pending){
+		return;
+	}
+	// Timestamps from different sources may step back slightly
+	uint64_t t = (pending.t_us > last_us) ? pending.t_us : last_us;
+	put_varint(file, t - last_us);
+	fputc(pending.port, file);
+	put_varint(file, pending.data.size());
+	fwrite(pending.data.data(), 1, pending.data.size(), file);
+	last_us = t;
+	has_pending = false;
+}
+
+void Capture_Writer::close(){
+	if(file != NULL){
+		flush();
+		fclose(file);
+		file = NULL;
+	}
+}
+
+Capture_Reader::Capture_Reader() : file(NULL), start_us(0), t_us(0),
+		err(NULL){
+}
+
+Capture_Reader::~Capture_Reader(){
+	close();
+}
+
+bool Capture_Reader::open(const char* path){
+	close();
+	file = strcmp(path, "-") ? fopen(path, "rb") : stdin;
+	if(file == NULL){
+		return false;
+	}
+	char magic[sizeof(CAPTURE_MAGIC)];
+	uint64_t version;
+	if(fread(magic, 1, sizeof(magic), file) != sizeof(magic)
+			|| memcmp(magic, CAPTURE_MAGIC, sizeof(magic))
+			|| !get_le(file, &version, 2) || version != CAPTURE_VERSION
+			|| !get_le(file, &start_us, 8)){
+		close();
+		return false;
+	}
+	t_us = 0;
+	err = NULL;
+	return true;
+}
+
+bool Capture_Reader::next(CaptureChunk& chunk){
+	uint64_t delta;
+	uint64_t len;
+	int port;
+	if(file == NULL || err != NULL){
+		return false;
+	}
+	int c = fgetc(file);
+	if(c == EOF){
+		return false;
+	}
+	ungetc(c, file);
+	if(!get_varint(file, &delta) || (port = fgetc(file)) == EOF
+			|| !get_varint(file, &len)){
+		err = "bad chunk header";
+		return false;
+	}
+	if(len > CAPTURE_CHUNK_MAX){
+		err = "chunk length out of range";
+		return false;
+	}
+	t_us += delta;
+	chunk.t_us = t_us;
+	chunk.port = port;
+	chunk.data.resize(len);
+	if(len != 0 && fread(&chunk.data[0], 1, len, file) != len){
+		err = "truncated chunk";
+		return false;
+	}
+	return true;
+}
+
+void Capture_Reader::close(){
+	if(file != NULL && file != stdin){
+		fclose(file);
+	}
+	file = NULL;
+}
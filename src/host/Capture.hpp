@@ -0,0 +1,168 @@
+#ifndef __CAPTURE__
+#define __CAPTURE__
+/*! \file
+ * Raw serial stream capture format.
+ *
+ * A capture file is a 16 byte header followed by chunks.  All integers are
+ * little endian.
+ *
+ *     Header:  char magic[6] = "RCTCAP"
+ *              uint16_t version = CAPTURE_VERSION
+ *              uint64_t start time, us since the Unix epoch (0 if unknown)
+ *     Chunk:   varint delta time in us since the previous chunk
+ *              uint8_t port (CapturePort)
+ *              varint length
+ *              uint8_t data[length]
+ *
+ * Varints are unsigned LEB128.  Bytes that arrive close together on the same
+ * port are coalesced into one chunk, so a 9600 baud GPS stream costs a few
+ * bytes of framing per burst rather than per byte.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+
+#define CAPTURE_VERSION 1
+
+/**
+ * Default window for coalescing bytes into one chunk, in us.
+ */
+#define CAPTURE_COALESCE_US 1000
+
+/**
+ * Longest chunk a reader accepts, in bytes.  Writers coalesce at most a few
+ * ms of serial data, so anything longer is a corrupt length.
+ */
+#define CAPTURE_CHUNK_MAX (1UL << 20)
+
+/**
+ * Link and direction of a captured chunk, as seen from the UIB.
+ */
+enum CapturePort{
+	/// GPS receiver to UIB
+	CAP_PORT_GPS = 0,
+	/// OBC to UIB
+	CAP_PORT_OBC_RX = 1,
+	/// UIB to OBC
+	CAP_PORT_OBC_TX = 2,
+	/// UIB to GPS receiver
+	CAP_PORT_GPS_TX = 3,
+	CAP_PORT__SIZE
+};
+
+/**
+ * Short name of a capture port.
+ */
+const char* capture_port_name(uint8_t port);
+
+/**
+ * Parses a capture port name.
+ * @return Port, or CAP_PORT__SIZE if the name is not known
+ */
+uint8_t capture_port_parse(const char* name);
+
+/**
+ * One chunk of captured bytes.
+ */
+typedef struct CaptureChunk{
+	/// Time of the chunk in us since the start of the capture
+	uint64_t t_us;
+	uint8_t port;
+	std::string data;
+} CaptureChunk;
+
+class Capture_Writer{
+public:
+	Capture_Writer();
+	~Capture_Writer();
+
+	/**
+	 * Creates a capture file and writes its header.
+	 * @param  path     File to create
+	 * @param  start_us Wall clock time of the start of the capture in us since
+	 *                  the Unix epoch, or 0
+	 * @return          true on success
+	 */
+	bool open(const char* path, uint64_t start_us);
+
+	/**
+	 * Records bytes seen on a port.  Bytes are held back for coalescing until
+	 * a different port is written, the window expires, or flush() is called.
+	 * @param t_us Time in us since the start of the capture
+	 * @param port CapturePort the bytes were seen on
+	 * @param data Bytes
+	 * @param len  Number of bytes
+	 */
+	void write(uint64_t t_us, uint8_t port, const uint8_t* data, size_t len);
+
+	/**
+	 * Writes out any held back bytes.
+	 */
+	void flush();
+
+	/**
+	 * Flushes and closes the file.
+	 */
+	void close();
+
+	bool isOpen() const{
+		return file != NULL;
+	}
+
+	/**
+	 * Coalescing window in us.  0 writes every call as its own chunk.
+	 */
+	uint32_t coalesce_us;
+
+private:
+	FILE* file;
+	uint64_t last_us;
+	CaptureChunk pending;
+	bool has_pending;
+};
+
+class Capture_Reader{
+public:
+	Capture_Reader();
+	~Capture_Reader();
+
+	/**
+	 * Opens a capture file and checks its header.
+	 * @param  path File to open, or "-" for stdin
+	 * @return      true on success
+	 */
+	bool open(const char* path);
+
+	/**
+	 * Reads the next chunk.
+	 * @param  chunk Chunk to fill in
+	 * @return       false at the end of the file or on a bad chunk, see
+	 *               error()
+	 */
+	bool next(CaptureChunk& chunk);
+
+	/**
+	 * Why next() last returned false.
+	 * @return Description of the bad chunk, or NULL at the end of the file
+	 */
+	const char* error() const{
+		return err;
+	}
+
+	void close();
+
+	/**
+	 * Wall clock start time from the header, in us since the Unix epoch.
+	 */
+	uint64_t startTime() const{
+		return start_us;
+	}
+
+private:
+	FILE* file;
+	uint64_t start_us;
+	uint64_t t_us;
+	const char* err;
+};
+
+#endif
@@ -0,0 +1,126 @@
+#include "Clock_Sync.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+Clock_Sync::Clock_Sync(size_t window) : window(window), next_id(0){
+	reset();
+}
+
+void Clock_Sync::reset(){
+	exchanges.clear();
+	pending = false;
+	pending_id = 0;
+	pending_t0 = 0;
+	last_uib_us = 0;
+	have_uib = false;
+	fitted = false;
+	ref_us = 0;
+	ref_ns = 0;
+	offset_ns = 0;
+	slope = 1000;
+}
+
+uint16_t Clock_Sync::request(uint64_t t0_ns){
+	pending = true;
+	pending_id = next_id++;
+	pending_t0 = t0_ns;
+	return pending_id;
+}
+
+bool Clock_Sync::reply(const char* line, uint64_t t3_ns){
+	unsigned id;
+	unsigned long rx_us, tx_us;
+	if(sscanf(line, "{\"clk\": %u, \"rx\": %lu, \"tx\": %lu}", &id, &rx_us,
+			&tx_us) != 3 || !pending || id != pending_id
+			|| t3_ns < pending_t0){
+		return false;
+	}
+	pending = false;
+
+	int64_t t1 = unwrap(rx_us);
+	int64_t t2 = t1 + (int32_t)((uint32_t)tx_us - (uint32_t)rx_us);
+	last_uib_us = t2;
+	have_uib = true;
+	Exchange exchange;
+	exchange.uib_us = (t1 + t2) / 2;
+	exchange.host_ns = pending_t0 + (t3_ns - pending_t0) / 2;
+	exchange.delay_ns = (int64_t)(t3_ns - pending_t0) - (t2 - t1) * 1000;
+	exchanges.push_back(exchange);
+	while(exchanges.size() > window){
+		exchanges.pop_front();
+	}
+	fit();
+	return true;
+}
+
+int64_t Clock_Sync::unwrap(uint32_t uib_us) const{
+	if(!have_uib){
+		return uib_us;
+	}
+	return last_uib_us + (int32_t)(uib_us - (uint32_t)last_uib_us);
+}
+
+void Clock_Sync::fit(){
+	// The half of the window with the lowest delay, and at least one
+	std::vector<Exchange> best(exchanges.begin(), exchanges.end());
+	size_t n = (best.size() + 1) / 2;
+	std::nth_element(best.begin(), best.begin() + (n - 1), best.end(),
+		[](const Exchange& a, const Exchange& b){
+			return a.delay_ns < b.delay_ns;
+		});
+	best.resize(n);
+
+	ref_us = best[0].uib_us;
+	ref_ns = best[0].host_ns;
+	double sx = 0, sy = 0, sxx = 0, sxy = 0;
+	int64_t first_us = ref_us, last_us = ref_us;
+	for(const Exchange& e : best){
+		double x = e.uib_us - ref_us;
+		double y = (double)(int64_t)(e.host_ns - ref_ns);
+		sx += x;
+		sy += y;
+		sxx += x * x;
+		sxy += x * y;
+		first_us = std::min(first_us, e.uib_us);
+		last_us = std::max(last_us, e.uib_us);
+	}
+	if(last_us - first_us >= CLOCK_SYNC_MIN_SPAN_US){
+		slope = (n * sxy - sx * sy) / (n * sxx - sx * sx);
+	}else{
+		// Too short to tell drift from jitter; assume none
+		slope = 1000;
+	}
+	offset_ns = (sy - slope * sx) / n;
+	fitted = true;
+}
+
+bool Clock_Sync::valid() const{
+	return fitted;
+}
+
+uint64_t Clock_Sync::toHost(uint32_t uib_us) const{
+	if(!fitted){
+		return 0;
+	}
+	double x = unwrap(uib_us) - ref_us;
+	return ref_ns + (int64_t)(offset_ns + slope * x);
+}
+
+double Clock_Sync::driftPPM() const{
+	return (1000 / slope - 1) * 1e6;
+}
+
+uint64_t Clock_Sync::minDelay() const{
+	int64_t delay = 0;
+	for(size_t i = 0; i < exchanges.size(); i++){
+		if(i == 0 || exchanges[i].delay_ns < delay){
+			delay = exchanges[i].delay_ns;
+		}
+	}
+	return delay > 0 ? delay : 0;
+}
+
+size_t Clock_Sync::samples() const{
+	return exchanges.size();
+}
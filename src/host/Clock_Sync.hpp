@@ -0,0 +1,120 @@
+#ifndef __CLOCK_SYNC__
+#define __CLOCK_SYNC__
+/*! \file
+ * OBC side clock synchronisation with the UIB.
+ *
+ * The OBC sends {"CLK": id} and notes the time t0 it wrote the request.  The
+ * UIB answers with {"clk": id, "rx": t1, "tx": t2}, its RCT_Micros() at the
+ * start of the request and just before the answer, and the OBC notes the
+ * time t3 it read the answer.  As in NTP, the UIB time (t1 + t2) / 2
+ * corresponds to the OBC time (t0 + t3) / 2, give or take half the round
+ * trip delay (t3 - t0) - (t2 - t1).
+ *
+ * USB CDC and loop latency make most round trips much longer than the best
+ * ones, so only the exchanges with the lowest delay in the window are used.
+ * A least squares line through them gives the offset and the drift between
+ * the clocks.
+ */
+#include <stddef.h>
+#include <stdint.h>
+#include <deque>
+
+/**
+ * Default number of exchanges kept.
+ */
+#define CLOCK_SYNC_WINDOW 64
+
+/**
+ * Least time the exchanges used must span before drift is estimated, in us.
+ */
+#define CLOCK_SYNC_MIN_SPAN_US 10000000
+
+class Clock_Sync{
+public:
+	/**
+	 * Constructs an estimator with no exchanges.
+	 * @param window Number of exchanges kept
+	 */
+	Clock_Sync(size_t window = CLOCK_SYNC_WINDOW);
+
+	/**
+	 * Forgets all exchanges, e.g. after the UIB reset.
+	 */
+	void reset();
+
+	/**
+	 * Starts an exchange.  Only the last exchange started can complete.
+	 * @param  t0_ns OBC time the request is written, in ns
+	 * @return       ID to send with the "CLK" key
+	 */
+	uint16_t request(uint64_t t0_ns);
+
+	/**
+	 * Completes an exchange from a UIB reply line.
+	 * @param  line  Line from the UIB, {"clk": id, "rx": t1, "tx": t2}
+	 * @param  t3_ns OBC time the line was read, in ns
+	 * @return       true if the line is the reply to the pending request
+	 */
+	bool reply(const char* line, uint64_t t3_ns);
+
+	/**
+	 * Whether there is an estimate to map UIB times with.
+	 */
+	bool valid() const;
+
+	/**
+	 * Maps a UIB time to OBC time.  The UIB time must be within half an
+	 * RCT_Micros() wrap, about 35 minutes, of the last reply.
+	 * @param  uib_us UIB RCT_Micros()
+	 * @return        OBC time in ns, or 0 if there is no estimate
+	 */
+	uint64_t toHost(uint32_t uib_us) const;
+
+	/**
+	 * Drift of the UIB clock against the OBC clock, in parts per million;
+	 * positive if the UIB clock runs fast.
+	 */
+	double driftPPM() const;
+
+	/**
+	 * Lowest round trip delay in the window, in ns.  Half of it bounds the
+	 * error of a mapped time.
+	 */
+	uint64_t minDelay() const;
+
+	/**
+	 * Number of exchanges in the window.
+	 */
+	size_t samples() const;
+private:
+	typedef struct Exchange{
+		/// Unwrapped UIB midpoint, us
+		int64_t uib_us;
+		/// OBC midpoint, ns
+		uint64_t host_ns;
+		/// Round trip delay less the UIB's turnaround, ns
+		int64_t delay_ns;
+	} Exchange;
+
+	size_t window;
+	std::deque<Exchange> exchanges;
+	uint16_t next_id;
+	bool pending;
+	uint16_t pending_id;
+	uint64_t pending_t0;
+	/// Last UIB time seen, unwrapped
+	int64_t last_uib_us;
+	bool have_uib;
+
+	/// Fit, host_ns = ref_ns + offset_ns + slope * (uib_us - ref_us)
+	bool fitted;
+	int64_t ref_us;
+	uint64_t ref_ns;
+	double offset_ns;
+	double slope;
+
+	int64_t unwrap(uint32_t uib_us) const;
+	void fit();
+};
+
+#endif
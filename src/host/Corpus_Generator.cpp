@@ -0,0 +1,105 @@
+#include "Corpus_Generator.hpp"
+#include <stdio.h>
+
+#include "../Status_Packet.hpp"
+#include "../Status_Module.hpp"
+
+#define CORPUS_REQUEST_PERIOD 10
+
+Corpus_Generator::Options Corpus_Generator::defaults(){
+	Options options;
+	options.gps = NMEA_Generator::multi_gnss();
+	options.error_rate = 0;
+	options.noise_rate = 0;
+	options.noise_max = 32;
+	options.seed = 1;
+	return options;
+}
+
+Corpus_Generator::Corpus_Generator(const Options& options) : options(options),
+		rng(options.seed ? options.seed : 1){
+}
+
+uint32_t Corpus_Generator::next(){
+	rng ^= rng << 13;
+	rng ^= rng >> 17;
+	rng ^= rng << 5;
+	return rng;
+}
+
+bool Corpus_Generator::chance(double p){
+	return p > 0 && next() < p * 4294967296.0;
+}
+
+void Corpus_Generator::append(std::string& out, std::string message,
+		size_t first, size_t last, Stats& stats){
+	stats.messages++;
+	if(last > first && chance(options.error_rate)){
+		size_t i = first + next() % (last - first);
+		// Any printable character but the original and the framing ones
+		char c;
+		do{
+			c = 0x20 + next() % 0x5F;
+		}while(c == message[i] || c == '$' || c == '*' || c == '{' ||
+			c == '}' || c == '"' || c == ',');
+		message[i] = c;
+		stats.corrupted++;
+	}
+	out += message;
+	if(options.noise_max > 0 && chance(options.noise_rate)){
+		uint8_t len = 1 + next() % options.noise_max;
+		for(uint8_t i = 0; i < len; i++){
+			out += (char)(next() & 0xFF);
+		}
+		stats.noise_bursts++;
+	}
+}
+
+std::string Corpus_Generator::gps(uint32_t epochs, Stats* stats){
+	Stats counts = {0, 0, 0, 0};
+	NMEA_Generator gen(options.gps);
+	std::string out;
+	for(uint32_t e = 0; e < epochs; e++){
+		std::string epoch = gen.epoch(e);
+		size_t start = 0;
+		while(start < epoch.size()){
+			size_t end = epoch.find('\n', start);
+			end = (end == std::string::npos) ? epoch.size() : end + 1;
+			std::string sentence = epoch.substr(start, end - start);
+			// Body between '$' and '*'
+			size_t star = sentence.rfind('*');
+			append(out, sentence, 1,
+				(star == std::string::npos) ? 1 : star, counts);
+			start = end;
+		}
+	}
+	counts.bytes = out.size();
+	if(stats != NULL){
+		*stats = counts;
+	}
+	return out;
+}
+
+std::string Corpus_Generator::status(uint32_t messages, Stats* stats){
+	Stats counts = {0, 0, 0, 0};
+	std::string out;
+	char buf[64];
+	for(uint32_t m = 0; m < messages; m++){
+		int len;
+		if(m % CORPUS_REQUEST_PERIOD == CORPUS_REQUEST_PERIOD - 1){
+			len = snprintf(buf, sizeof(buf), "{\"REQ\": %d}\n",
+				REQ_DIAGNOSTICS);
+		}else{
+			len = snprintf(buf, sizeof(buf),
+				"{\"STR\": %u, \"SYS\": %u, \"SDR\": %u}\n", m % STR__SIZE,
+				(m / 2) % SYS__SIZE, (m / 3) % SDR__SIZE);
+		}
+		// Everything between the braces
+		append(out, std::string(buf, len), 1, len - 2, counts);
+	}
+	counts.bytes = out.size();
+	if(stats != NULL){
+		*stats = counts;
+	}
+	return out;
+}
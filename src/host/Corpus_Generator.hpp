@@ -0,0 +1,90 @@
+#ifndef __CORPUS_GENERATOR__
+#define __CORPUS_GENERATOR__
+/*! \file */
+#include <stdint.h>
+#include <string>
+
+#include "NMEA_Generator.hpp"
+
+/**
+ * Parser input corpora for host benchmarks: a GPS receiver stream from
+ * NMEA_Generator and the OBC status traffic the UIB receives, each with
+ * configurable line errors.  A corrupted sentence has one character of its
+ * body replaced, so that its checksum no longer matches; noise is a burst of
+ * random bytes between sentences, as from a receiver reset or a loose
+ * connector.  Output is a pure function of the options.
+ */
+class Corpus_Generator{
+public:
+	typedef struct Options{
+		/// GPS receiver output
+		NMEA_Generator::Options gps;
+		/// Probability that a sentence or status message is corrupted
+		double error_rate;
+		/// Probability of a noise burst after a sentence or status message
+		double noise_rate;
+		/// Longest noise burst in bytes
+		uint8_t noise_max;
+		/// Seed for the errors
+		uint32_t seed;
+	} Options;
+
+	/**
+	 * Counts of what a corpus contains.
+	 */
+	typedef struct Stats{
+		/// Corpus size in bytes
+		uint64_t bytes;
+		/// Sentences or messages generated
+		uint32_t messages;
+		/// Of those, the number corrupted
+		uint32_t corrupted;
+		/// Noise bursts inserted
+		uint32_t noise_bursts;
+	} Stats;
+
+	/**
+	 * Default options: multi-constellation GPS output and no errors.
+	 */
+	static Options defaults();
+
+	Corpus_Generator(const Options& options);
+
+	/**
+	 * Generates GPS receiver output.
+	 * @param epochs Fix epochs to generate
+	 * @param stats  If not NULL, set to the counts of the corpus
+	 * @return       Corpus bytes
+	 */
+	std::string gps(uint32_t epochs, Stats* stats = NULL);
+
+	/**
+	 * Generates OBC status traffic: one status message per second, cycling
+	 * every subsystem through its states, with a diagnostics request every
+	 * tenth message.
+	 * @param messages Status messages to generate
+	 * @param stats    If not NULL, set to the counts of the corpus
+	 * @return         Corpus bytes
+	 */
+	std::string status(uint32_t messages, Stats* stats = NULL);
+
+private:
+	Options options;
+	uint32_t rng;
+
+	uint32_t next();
+	bool chance(double p);
+	/**
+	 * Appends a message to a corpus, corrupting it and following it with
+	 * noise according to the options.
+	 * @param out     Corpus
+	 * @param message Message, including its line ending
+	 * @param first   First character the corruption may replace
+	 * @param last    One past the last character it may replace
+	 * @param stats   Counts to update
+	 */
+	void append(std::string& out, std::string message, size_t first,
+		size_t last, Stats& stats);
+};
+
+#endif
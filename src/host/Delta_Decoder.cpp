@@ -0,0 +1,152 @@
+#include "Delta_Decoder.hpp"
+#include <stdio.h>
+#include <string.h>
+
+namespace{
+	/**
+	 * Value of a base64 character, or -1 if it is not one.
+	 */
+	int base64_value(char c){
+		if(c >= 'A' && c <= 'Z'){
+			return c - 'A';
+		}
+		if(c >= 'a' && c <= 'z'){
+			return c - 'a' + 26;
+		}
+		if(c >= '0' && c <= '9'){
+			return c - '0' + 52;
+		}
+		if(c == '+'){
+			return 62;
+		}
+		if(c == '/'){
+			return 63;
+		}
+		return -1;
+	}
+
+	/**
+	 * Reads a varint.
+	 * @return false if the varint runs past end or is longer than 5 bytes
+	 */
+	bool get_varint(const uint8_t*& p, const uint8_t* end, uint32_t* value){
+		*value = 0;
+		for(int shift = 0; shift < 35 && p < end; shift += 7){
+			uint8_t byte = *p++;
+			*value |= (uint32_t)(byte & 0x7F) << shift;
+			if(!(byte & 0x80)){
+				return true;
+			}
+		}
+		return false;
+	}
+}
+
+Delta_Decoder::Delta_Decoder() : frames(0), keyframes(0), lost(0),
+		invalid(0), skipped(0){
+	reset();
+}
+
+void Delta_Decoder::reset(){
+	memset(&previous, 0, sizeof(previous));
+	have_base = false;
+	have_seq = false;
+	seq = 0;
+}
+
+DeltaResult Delta_Decoder::decode(const char* line, DeltaFix* fix){
+	if(*line++ != DELTA_MARK){
+		invalid++;
+		return DELTA_INVALID;
+	}
+
+	// Base64, four characters to three bytes
+	uint8_t frame[DELTA_FRAME_MAX];
+	size_t len = 0;
+	uint32_t group = 0;
+	int bits = 0;
+	for(; *line; line++){
+		int value = base64_value(*line);
+		if(value < 0){
+			invalid++;
+			return DELTA_INVALID;
+		}
+		group = (group << 6) | value;
+		bits += 6;
+		if(bits >= 8){
+			bits -= 8;
+			if(len == DELTA_FRAME_MAX){
+				invalid++;
+				return DELTA_INVALID;
+			}
+			frame[len++] = group >> bits;
+		}
+	}
+	if(len < 5 || delta_crc8(frame, len - 1) != frame[len - 1]
+			|| (frame[0] & ~DELTA_HEADER_MASK)){
+		invalid++;
+		return DELTA_INVALID;
+	}
+
+	const uint8_t* p = frame + 2;
+	const uint8_t* end = frame + len - 2;
+	bool key = frame[0] & DELTA_KEYFRAME;
+	uint32_t values[6];
+	for(int i = 0; i < (key ? 6 : 5); i++){
+		if(!get_varint(p, end, &values[i])){
+			invalid++;
+			return DELTA_INVALID;
+		}
+	}
+	if(p != end){
+		invalid++;
+		return DELTA_INVALID;
+	}
+
+	uint8_t frame_seq = frame[1];
+	if(have_seq && frame_seq != (uint8_t)(seq + 1)){
+		lost += (uint8_t)(frame_seq - seq - 1);
+		have_base = false;
+	}
+	seq = frame_seq;
+	have_seq = true;
+
+	DeltaFix next;
+	if(key){
+		next.lat = delta_unzigzag(values[0]);
+		next.lon = delta_unzigzag(values[1]);
+		next.hdg = delta_unzigzag(values[2]);
+		next.time_cs = delta_unzigzag(values[3]);
+		next.uts = values[4];
+		next.date = values[5];
+		keyframes++;
+	}else if(have_base){
+		next.lat = previous.lat + delta_unzigzag(values[0]);
+		next.lon = previous.lon + delta_unzigzag(values[1]);
+		next.hdg = previous.hdg + delta_unzigzag(values[2]);
+		next.time_cs = previous.time_cs + delta_unzigzag(values[3]);
+		next.uts = previous.uts + delta_unzigzag(values[4]);
+		next.date = previous.date;
+	}else{
+		skipped++;
+		return DELTA_NO_BASE;
+	}
+	next.sat = *end;
+	next.fix = frame[0] & DELTA_FIX;
+	next.run = frame[0] & DELTA_RUN;
+	previous = next;
+	have_base = true;
+	frames++;
+	*fix = next;
+	return DELTA_OK;
+}
+
+void Delta_Decoder::formatTime(uint32_t time_cs, char* out){
+	snprintf(out, 10, "%02u%02u%02u.%02u", (unsigned)(time_cs / 360000 % 100),
+		(unsigned)(time_cs / 6000 % 60), (unsigned)(time_cs / 100 % 60),
+		(unsigned)(time_cs % 100));
+}
+
+void Delta_Decoder::formatDate(uint32_t date, char* out){
+	snprintf(out, 7, "%06u", (unsigned)(date % 1000000));
+}
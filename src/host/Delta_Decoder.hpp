@@ -0,0 +1,76 @@
+#ifndef __DELTA_DECODER__
+#define __DELTA_DECODER__
+/*! \file
+ * Host side decoder for the delta position stream (Delta_Packet.hpp).
+ */
+#include <stdint.h>
+#include "../Delta_Packet.hpp"
+
+/**
+ * Result of decoding a line.
+ */
+enum DeltaResult{
+	/// The line decoded to a position
+	DELTA_OK,
+	/// The line is not a well formed frame, or its CRC does not match
+	DELTA_INVALID,
+	/// The frame is a delta, but the frame it applies to was lost
+	DELTA_NO_BASE
+};
+
+/**
+ * Decoder for one delta stream.  Lines are passed in the order they were
+ * received; the decoder keeps the last position to apply deltas to and uses
+ * the sequence numbers to notice lost frames.
+ */
+class Delta_Decoder{
+public:
+	Delta_Decoder();
+
+	/**
+	 * Forgets the last position, e.g. when the link was reopened.
+	 */
+	void reset();
+
+	/**
+	 * Decodes one line.
+	 * @param  line Line from the UIB without its line ending, starting with
+	 *              DELTA_MARK
+	 * @param  fix  DeltaFix to fill in; only written on DELTA_OK
+	 * @return      DeltaResult
+	 */
+	DeltaResult decode(const char* line, DeltaFix* fix);
+
+	/**
+	 * Formats a time of day in 1/100 s as hhmmss.ss.
+	 * @param time_cs Time of day
+	 * @param out     Buffer of at least 10 characters
+	 */
+	static void formatTime(uint32_t time_cs, char* out);
+
+	/**
+	 * Formats a date as ddmmyy.
+	 * @param date Date as the number ddmmyy
+	 * @param out  Buffer of at least 7 characters
+	 */
+	static void formatDate(uint32_t date, char* out);
+
+	/// Frames decoded, key frames included
+	uint64_t frames;
+	/// Key frames decoded
+	uint64_t keyframes;
+	/// Frames missing from the sequence numbers
+	uint64_t lost;
+	/// Lines that were not valid frames
+	uint64_t invalid;
+	/// Deltas discarded while waiting for a key frame
+	uint64_t skipped;
+private:
+	DeltaFix previous;
+	/// Whether previous is the frame before the next expected one
+	bool have_base;
+	bool have_seq;
+	uint8_t seq;
+};
+
+#endif
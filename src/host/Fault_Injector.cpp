@@ -0,0 +1,90 @@
+#include "Fault_Injector.hpp"
+#include <math.h>
+
+static const char* const FAULT_NAMES[FAULT__SIZE] = {
+	"bit_flip", "drop", "duplicate", "truncate"
+};
+
+Fault_Injector::Options Fault_Injector::defaults(){
+	Options options;
+	options.bit_error_rate = 0;
+	options.drop_rate = 0;
+	options.duplicate_rate = 0;
+	options.truncate_rate = 0;
+	options.seed = 1;
+	return options;
+}
+
+const char* Fault_Injector::name(uint8_t type){
+	return (type < FAULT__SIZE) ? FAULT_NAMES[type] : "unknown";
+}
+
+Fault_Injector::Fault_Injector(const Options& options) : options(options),
+		rng(options.seed ? options.seed : 1){
+}
+
+uint32_t Fault_Injector::next(){
+	rng ^= rng << 13;
+	rng ^= rng >> 17;
+	rng ^= rng << 5;
+	return rng;
+}
+
+bool Fault_Injector::chance(double p){
+	return p > 0 && next() < p * 4294967296.0;
+}
+
+void Fault_Injector::mutate(const std::string& in, Result& result){
+	result.data.clear();
+	result.message_of.clear();
+	result.message_start.clear();
+	result.faults.clear();
+	result.data.reserve(in.size());
+	result.message_of.reserve(in.size());
+
+	// A byte has a bit flipped if any of its 8 bits is
+	double byte_error_rate = 1 - pow(1 - options.bit_error_rate, 8);
+	uint32_t message = 0;
+	size_t start = 0;
+	while(start < in.size()){
+		size_t end = in.find('\n', start);
+		end = (end == std::string::npos) ? in.size() : end + 1;
+		result.message_start.push_back(result.data.size());
+
+		if(end - start > 1 && chance(options.truncate_rate)){
+			// A truncated message carries no other fault, so that the
+			// position of the truncation is exact
+			size_t cut = start + next() % (end - start);
+			result.data.append(in, start, cut - start);
+			result.message_of.insert(result.message_of.end(), cut - start,
+				message);
+			Fault fault = {FAULT_TRUNCATE, result.data.size(), message};
+			result.faults.push_back(fault);
+		}else{
+			for(size_t i = start; i < end; i++){
+				char c = in[i];
+				if(chance(options.drop_rate)){
+					Fault fault = {FAULT_DROP, result.data.size(), message};
+					result.faults.push_back(fault);
+					continue;
+				}
+				if(chance(byte_error_rate)){
+					Fault fault = {FAULT_BIT_FLIP, result.data.size(), message};
+					result.faults.push_back(fault);
+					c ^= 1 << (next() % 8);
+				}
+				result.data += c;
+				result.message_of.push_back(message);
+				if(chance(options.duplicate_rate)){
+					Fault fault = {FAULT_DUPLICATE, result.data.size(), message};
+					result.faults.push_back(fault);
+					result.data += c;
+					result.message_of.push_back(message);
+				}
+			}
+		}
+		message++;
+		start = end;
+	}
+	result.message_start.push_back(result.data.size());
+}
@@ -0,0 +1,97 @@
+#ifndef __FAULT_INJECTOR__
+#define __FAULT_INJECTOR__
+/*! \file */
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/**
+ * Kinds of link fault.
+ */
+enum FaultType{
+	/// One bit of a byte inverted
+	FAULT_BIT_FLIP = 0,
+	/// A byte lost, as on a receiver overrun
+	FAULT_DROP = 1,
+	/// A byte received twice
+	FAULT_DUPLICATE = 2,
+	/// The rest of a message lost, as on a sender reset or a brownout
+	FAULT_TRUNCATE = 3,
+	FAULT__SIZE
+};
+
+/**
+ * One injected fault.
+ */
+typedef struct Fault{
+	uint8_t type;
+	/// Offset of the fault in the mutated stream
+	uint64_t position;
+	/// Message (line) of the source stream the fault is in
+	uint32_t message;
+} Fault;
+
+/**
+ * Applies link faults at random to a message stream, where messages are lines
+ * ('\n' terminated) as on both of the UIB's serial links.  Alongside the
+ * mutated stream it records which source message each byte came from and
+ * where each fault was injected, so that parser output on the mutated stream
+ * can be lined up against the source.  Output is a pure function of the
+ * options and the input.
+ */
+class Fault_Injector{
+public:
+	typedef struct Options{
+		/// Probability that any one bit is inverted
+		double bit_error_rate;
+		/// Probability that a byte is dropped
+		double drop_rate;
+		/// Probability that a byte is duplicated
+		double duplicate_rate;
+		/// Probability that a message is cut short
+		double truncate_rate;
+		uint32_t seed;
+	} Options;
+
+	/**
+	 * Mutated stream and its mapping back to the source.
+	 */
+	typedef struct Result{
+		std::string data;
+		/// Source message of each byte of data
+		std::vector<uint32_t> message_of;
+		/// Offset in data of the start of each source message, plus the end
+		/// of the stream
+		std::vector<uint64_t> message_start;
+		/// Faults in stream order
+		std::vector<Fault> faults;
+	} Result;
+
+	/**
+	 * Default options: no faults.
+	 */
+	static Options defaults();
+
+	/**
+	 * Short name of a fault type.
+	 */
+	static const char* name(uint8_t type);
+
+	Fault_Injector(const Options& options);
+
+	/**
+	 * Mutates a stream.
+	 * @param in     Source stream
+	 * @param result Mutated stream
+	 */
+	void mutate(const std::string& in, Result& result);
+
+private:
+	Options options;
+	uint32_t rng;
+
+	uint32_t next();
+	bool chance(double p);
+};
+
+#endif
@@ -0,0 +1,147 @@
+#include "Fleet_UIB.hpp"
+#include <math.h>
+#include <poll.h>
+#include <string.h>
+#include <time.h>
+
+#include "../Diagnostics.hpp"
+
+#define FLEET_RUN_SWITCH_PIN 10
+/// Longest the thread sleeps without checking for stop(), in ms
+#define FLEET_POLL_MAX_MS 100
+
+static uint64_t monotonic_ns(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+Fleet_UIB::Fleet_UIB(const Options& options) : options(options),
+		sensor(&status.gps), obc(&status), gen(options.gps), running(false),
+		rng(options.gps.seed ? options.gps.seed : 1), packets(0), dropped(0),
+		status_messages(0), status_resyncs(0), requests(0), max_late_us(0){
+	devices.compass_present = options.compass;
+	devices.vcc_mv = 5000;
+	memset(devices.pin_levels, 0, sizeof(devices.pin_levels));
+	devices.pin_levels[FLEET_RUN_SWITCH_PIN] = HIGH;
+}
+
+Fleet_UIB::~Fleet_UIB(){
+	stop();
+	devices.obc.close();
+}
+
+bool Fleet_UIB::open(){
+	return devices.obc.open(options.link);
+}
+
+void Fleet_UIB::start(uint64_t epoch_ns){
+	running = true;
+	thread = std::thread(&Fleet_UIB::run, this, epoch_ns);
+}
+
+void Fleet_UIB::stop(){
+	running = false;
+	if(thread.joinable()){
+		thread.join();
+	}
+}
+
+Fleet_UIB::Stats Fleet_UIB::stats() const{
+	Stats stats;
+	stats.packets = packets;
+	stats.dropped = dropped;
+	stats.status_messages = status_messages;
+	stats.status_resyncs = status_resyncs;
+	stats.requests = requests;
+	stats.max_late_us = max_late_us;
+	return stats;
+}
+
+double Fleet_UIB::uniform(){
+	rng ^= rng << 13;
+	rng ^= rng >> 17;
+	rng ^= rng << 5;
+	return rng / 4294967296.0;
+}
+
+double Fleet_UIB::gaussian(){
+	// Box-Muller
+	double u = uniform();
+	double v = uniform();
+	return sqrt(-2 * log(u > 0 ? u : 1e-12)) * cos(2 * M_PI * v);
+}
+
+void Fleet_UIB::serviceOBC(uint64_t until_ns){
+	for(;;){
+		while(devices.obc.available() > 0){
+			if(!obc.decode(devices.obc.read())){
+				continue;
+			}
+			status_messages++;
+			if(obc.getRequest() == REQ_DIAGNOSTICS){
+				DiagnosticsPacket diag;
+				memset(&diag, 0, sizeof(diag));
+				sensor.getDiagnostics(&diag);
+				obc.getDiagnostics(&diag);
+				Diagnostics::print(&devices.obc, diag);
+				requests++;
+			}
+		}
+		DiagnosticsPacket diag;
+		obc.getDiagnostics(&diag);
+		status_resyncs = diag.status_resyncs;
+		uint64_t now = monotonic_ns();
+		if(now >= until_ns || !running){
+			return;
+		}
+		uint64_t wait_ms = (until_ns - now + 999999) / 1000000;
+		struct pollfd pfd = {devices.obc.fd(), POLLIN, 0};
+		poll(&pfd, 1, wait_ms < FLEET_POLL_MAX_MS ? wait_ms : FLEET_POLL_MAX_MS);
+	}
+}
+
+void Fleet_UIB::sendPacket(){
+	char packet[SENSOR_PACKET_MAX_LEN];
+	sensor.getPacket(packet, sizeof(packet));
+	size_t len = strlen(packet);
+	size_t sent = devices.obc.println(packet);
+	packets++;
+	if(sent < len + 2){
+		dropped++;
+	}
+}
+
+void Fleet_UIB::run(uint64_t epoch_ns){
+	RCT_Fleet_Bind(&devices);
+	sensor.start();
+	uint64_t period_ns = 1e9 / options.gps.rate_hz;
+	uint64_t first_ns = epoch_ns + (uint64_t)(options.phase_s * 1e9);
+	for(uint32_t e = 0; running; e++){
+		uint64_t due_ns = first_ns + e * period_ns
+			+ (uint64_t)(uniform() * options.jitter_ms * 1e6);
+		serviceOBC(due_ns);
+		if(!running){
+			break;
+		}
+		uint64_t late_us = (monotonic_ns() - due_ns) / 1000;
+		if(late_us > max_late_us){
+			max_late_us = late_us;
+		}
+
+		double lat;
+		double lon;
+		double course;
+		gen.position(e, &lat, &lon, &course);
+		devices.compass.setHeading(fmod(course
+			+ options.heading_noise_deg * gaussian() + 360, 360));
+		std::string epoch = gen.epoch(e);
+		for(size_t i = 0; i < epoch.size(); i++){
+			sensor.service();
+			if(sensor.decode(epoch[i])){
+				sendPacket();
+			}
+		}
+	}
+	RCT_Fleet_Bind(NULL);
+}
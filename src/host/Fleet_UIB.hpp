@@ -0,0 +1,117 @@
+#ifndef __FLEET_UIB__
+#define __FLEET_UIB__
+/*! \file */
+#include <atomic>
+#include <stdint.h>
+#include <thread>
+
+#include "hal_fleet.hpp"
+#include "NMEA_Generator.hpp"
+#include "../Status_Packet.hpp"
+#include "../Sensor_Module.hpp"
+#include "../Status_Module.hpp"
+
+/**
+ * One simulated UIB of a fleet.  Runs the firmware's Sensor_Module and
+ * Status_Module on its own thread, against its own GPS trajectory and compass,
+ * and talks to the OBC over its own PTY.  Each fix epoch is fed to the sensor
+ * module whole, so packets leave at the fix rate (plus jitter) whatever the
+ * GPS baud rate would have been; status messages are answered as the firmware
+ * answers them.
+ */
+class Fleet_UIB{
+public:
+	typedef struct Options{
+		/// GPS receiver output and trajectory
+		NMEA_Generator::Options gps;
+		/// Delay of the first epoch after start(), in s
+		double phase_s;
+		/// Largest random delay added to each epoch, in ms
+		double jitter_ms;
+		/// Standard deviation of the compass heading about the course, in
+		/// degrees
+		double heading_noise_deg;
+		/// Whether the compass answers on the I2C bus
+		bool compass;
+		/// Path to symlink to the OBC PTY, or NULL
+		const char* link;
+	} Options;
+
+	/**
+	 * Counters, safe to read while the UIB runs.
+	 */
+	typedef struct Stats{
+		/// Sensor packets sent
+		uint32_t packets;
+		/// Sensor packets the OBC side did not drain in time, in part or in
+		/// full
+		uint32_t dropped;
+		/// Status messages received
+		uint32_t status_messages;
+		/// Status parser resyncs
+		uint32_t status_resyncs;
+		/// Diagnostics requests answered
+		uint32_t requests;
+		/// Largest lateness of an epoch behind its schedule, in us
+		uint32_t max_late_us;
+	} Stats;
+
+	Fleet_UIB(const Options& options);
+	~Fleet_UIB();
+
+	/**
+	 * Opens the OBC PTY.
+	 * @return true on success
+	 */
+	bool open();
+
+	/**
+	 * Starts the UIB thread.
+	 * @param epoch_ns Monotonic time in ns that phase_s is counted from
+	 */
+	void start(uint64_t epoch_ns);
+
+	/**
+	 * Stops and joins the UIB thread.
+	 */
+	void stop();
+
+	/**
+	 * Path of the OBC PTY slave, for the OBC to open.
+	 */
+	const char* name() const{
+		return devices.obc.name();
+	}
+
+	Stats stats() const;
+
+private:
+	Options options;
+	RCT_Fleet_Devices devices;
+	StatusPacket status;
+	Sensor_Module sensor;
+	Status_Module obc;
+	NMEA_Generator gen;
+	std::thread thread;
+	std::atomic<bool> running;
+	uint32_t rng;
+
+	std::atomic<uint32_t> packets;
+	std::atomic<uint32_t> dropped;
+	std::atomic<uint32_t> status_messages;
+	std::atomic<uint32_t> status_resyncs;
+	std::atomic<uint32_t> requests;
+	std::atomic<uint32_t> max_late_us;
+
+	void run(uint64_t epoch_ns);
+	/**
+	 * Handles OBC input until a deadline.
+	 * @param until_ns Monotonic time in ns to return at
+	 */
+	void serviceOBC(uint64_t until_ns);
+	void sendPacket();
+	double uniform();
+	double gaussian();
+};
+
+#endif
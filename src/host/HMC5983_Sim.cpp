@@ -0,0 +1,63 @@
+#include "HMC5983_Sim.hpp"
+#include "../HMC5983.hpp"
+
+/**
+ * Horizontal field strength in LSB at the default 1.3 Ga range gain.
+ */
+#define SIM_FIELD_LSB 330
+
+HMC5983_Sim::HMC5983_Sim() : pointer(0){
+	memset(regs, 0, sizeof(regs));
+	regs[HMC5983_REG_CONFIG_A] = 0x10;
+	regs[HMC5983_REG_CONFIG_B] = 0x20;
+	regs[HMC5983_REG_MODE] = 0x01;
+	regs[HMC5983_REG_IDENT_A] = 'H';
+	regs[HMC5983_REG_IDENT_B] = '4';
+	regs[HMC5983_REG_IDENT_C] = '3';
+	setHeading(0);
+	setTemperature(25);
+}
+
+uint8_t HMC5983_Sim::write(const uint8_t* data, uint8_t len){
+	if(len == 0){
+		return 0;
+	}
+	pointer = data[0];
+	for(uint8_t i = 1; i < len; i++){
+		// Only the configuration and mode registers are writable
+		if(pointer <= HMC5983_REG_MODE){
+			regs[pointer] = data[i];
+		}
+		pointer++;
+	}
+	return 0;
+}
+
+uint8_t HMC5983_Sim::read(uint8_t* data, uint8_t len){
+	for(uint8_t i = 0; i < len; i++){
+		data[i] = (pointer < REGISTERS) ? regs[pointer] : 0;
+		if(pointer == HMC5983_OUT_Y_LSB){
+			pointer = HMC5983_OUT_X_MSB;
+		}else{
+			pointer++;
+		}
+	}
+	return len;
+}
+
+void HMC5983_Sim::setHeading(double degrees){
+	double rad = degrees * M_PI / 180.0;
+	store16(HMC5983_OUT_X_MSB, (int16_t)(SIM_FIELD_LSB * cos(rad)));
+	store16(HMC5983_OUT_Y_MSB, (int16_t)(SIM_FIELD_LSB * sin(rad)));
+	store16(HMC5983_OUT_Z_MSB, -SIM_FIELD_LSB);
+}
+
+void HMC5983_Sim::setTemperature(double celsius){
+	// Temperature = (MSB * 2^8 + LSB) / (2^4 * 8) + 25 in C
+	store16(HMC5983_TEMP_OUT_MSB, (int16_t)((celsius - 25) * 128));
+}
+
+void HMC5983_Sim::store16(uint8_t reg, int16_t value){
+	regs[reg] = (uint16_t)value >> 8;
+	regs[reg + 1] = value & 0xFF;
+}
@@ -0,0 +1,59 @@
+#ifndef __HMC5983_SIM__
+#define __HMC5983_SIM__
+/*! \file */
+#include <Arduino.h>
+
+/**
+ * Register model of the HMC5983 magnetometer, as seen over I2C.  Writes set
+ * the register pointer and then store into consecutive registers; reads
+ * return consecutive registers from the pointer.  As on the part, the pointer
+ * wraps from the last output register (Y LSB) back to X MSB, so continuous
+ * reads of 6 bytes keep returning X, Z, Y.  The output registers follow a
+ * simulated field at the configured heading.
+ */
+class HMC5983_Sim{
+public:
+	/**
+	 * Number of registers in the model.  The temperature output lives at
+	 * 0x31 and 0x32.
+	 */
+	static const uint8_t REGISTERS = 0x33;
+
+	HMC5983_Sim();
+
+	/**
+	 * Handles a write transaction.
+	 * @param  data Bytes written, starting with the register pointer
+	 * @param  len  Number of bytes written
+	 * @return      0, as for a successful endTransmission()
+	 */
+	uint8_t write(const uint8_t* data, uint8_t len);
+
+	/**
+	 * Handles a read transaction.
+	 * @param  data Buffer to read into
+	 * @param  len  Number of bytes to read
+	 * @return      Number of bytes read
+	 */
+	uint8_t read(uint8_t* data, uint8_t len);
+
+	/**
+	 * Sets the simulated heading.
+	 * @param degrees Heading WRT magnetic North in degrees
+	 */
+	void setHeading(double degrees);
+
+	/**
+	 * Sets the simulated die temperature.
+	 * @param celsius Temperature in degrees C
+	 */
+	void setTemperature(double celsius);
+
+private:
+	uint8_t regs[REGISTERS];
+	uint8_t pointer;
+
+	void store16(uint8_t reg, int16_t value);
+};
+
+#endif
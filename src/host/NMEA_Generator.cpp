@@ -0,0 +1,158 @@
+#include "NMEA_Generator.hpp"
+#include <math.h>
+#include <stdio.h>
+
+#define GEN_LAT 32.8807
+#define GEN_LON -117.2353
+#define GEN_RADIUS_DEG 0.001
+#define GEN_PERIOD_S 600.0
+#define GEN_START_S (12 * 3600)
+#define GEN_MAX_CONSTELLATIONS 3
+
+/// GSV talker, first PRN and NMEA 4.1 system ID of each constellation
+static const char* const GEN_TALKER[GEN_MAX_CONSTELLATIONS] = {"GP", "GL", "GA"};
+static const uint8_t GEN_PRN_BASE[GEN_MAX_CONSTELLATIONS] = {1, 65, 1};
+
+NMEA_Generator::Options NMEA_Generator::defaults(){
+	Options options;
+	options.rate_hz = 1;
+	options.gsv_sentences = 3;
+	options.constellations = 1;
+	options.gsa = false;
+	options.vtg = false;
+	options.zda = true;
+	options.seed = 1;
+	options.lat = GEN_LAT;
+	options.lon = GEN_LON;
+	options.radius_deg = GEN_RADIUS_DEG;
+	options.period_s = GEN_PERIOD_S;
+	return options;
+}
+
+NMEA_Generator::Options NMEA_Generator::multi_gnss(){
+	Options options = defaults();
+	options.constellations = GEN_MAX_CONSTELLATIONS;
+	options.gsa = true;
+	options.vtg = true;
+	return options;
+}
+
+NMEA_Generator::NMEA_Generator(const Options& options) : options(options),
+		rng(options.seed ? options.seed : 1){
+}
+
+uint32_t NMEA_Generator::next(){
+	rng ^= rng << 13;
+	rng ^= rng >> 17;
+	rng ^= rng << 5;
+	return rng;
+}
+
+std::string NMEA_Generator::sentence(const std::string& body){
+	uint8_t checksum = 0;
+	for(size_t i = 0; i < body.size(); i++){
+		checksum ^= body[i];
+	}
+	char tail[8];
+	snprintf(tail, sizeof(tail), "*%02X\r\n", checksum);
+	return "$" + body + tail;
+}
+
+/**
+ * Formats an angle as NMEA ddmm.mmmmm (or dddmm.mmmmm) and a hemisphere.
+ */
+static std::string nmea_angle(double deg, int deg_digits, char pos, char neg){
+	char buf[32];
+	char hemi = (deg < 0) ? neg : pos;
+	deg = fabs(deg);
+	int whole = (int)deg;
+	snprintf(buf, sizeof(buf), "%0*d%08.5f,%c", deg_digits, whole,
+		(deg - whole) * 60, hemi);
+	return buf;
+}
+
+void NMEA_Generator::position(uint32_t index, double* lat, double* lon,
+		double* course) const{
+	double t = index / options.rate_hz;
+	double a = 2 * M_PI * t / options.period_s;
+	*lat = options.lat + options.radius_deg * sin(a);
+	*lon = options.lon + options.radius_deg * cos(a);
+	*course = fmod(360 + 90 - a * 180 / M_PI, 360);
+}
+
+std::string NMEA_Generator::epoch(uint32_t index, std::string* time){
+	char buf[128];
+	double t = index / options.rate_hz;
+	double lat;
+	double lon;
+	double course;
+	position(index, &lat, &lon, &course);
+
+	uint32_t cs = (uint32_t)(t * 100 + 0.5) + GEN_START_S * 100;
+	char tme[16];
+	snprintf(tme, sizeof(tme), "%02u%02u%02u.%02u", (cs / 360000) % 24,
+		(cs / 6000) % 60, (cs / 100) % 60, cs % 100);
+	if(time != NULL){
+		*time = tme;
+	}
+	std::string slat = nmea_angle(lat, 2, 'N', 'S');
+	std::string slon = nmea_angle(lon, 3, 'E', 'W');
+	int sats = 8 + (next() % 7);
+
+	std::string out;
+	snprintf(buf, sizeof(buf), "GNGGA,%s,%s,%s,1,%02d,0.9,110.5,M,-35.2,M,,",
+		tme, slat.c_str(), slon.c_str(), sats);
+	out += sentence(buf);
+
+	uint8_t constellations = options.constellations;
+	if(constellations < 1){
+		constellations = 1;
+	}else if(constellations > GEN_MAX_CONSTELLATIONS){
+		constellations = GEN_MAX_CONSTELLATIONS;
+	}
+
+	for(uint8_t c = 0; options.gsa && c < constellations; c++){
+		std::string body = "GNGSA,A,3";
+		for(uint8_t s = 0; s < 12; s++){
+			if(s < sats / constellations){
+				snprintf(buf, sizeof(buf), ",%02u", GEN_PRN_BASE[c] + s);
+				body += buf;
+			}else{
+				body += ",";
+			}
+		}
+		snprintf(buf, sizeof(buf), ",1.6,0.9,1.3,%u", c + 1);
+		out += sentence(body + buf);
+	}
+
+	for(uint8_t c = 0; c < constellations; c++){
+		for(uint8_t i = 0; i < options.gsv_sentences; i++){
+			std::string body;
+			snprintf(buf, sizeof(buf), "%sGSV,%u,%u,%02u", GEN_TALKER[c],
+				options.gsv_sentences, i + 1, options.gsv_sentences * 4);
+			body = buf;
+			for(uint8_t s = 0; s < 4; s++){
+				snprintf(buf, sizeof(buf), ",%02u,%02u,%03u,%02u",
+					GEN_PRN_BASE[c] + i * 4 + s, next() % 90, next() % 360,
+					20 + next() % 30);
+				body += buf;
+			}
+			out += sentence(body);
+		}
+	}
+
+	if(options.zda){
+		snprintf(buf, sizeof(buf), "GNZDA,%s,19,10,2026,00,00", tme);
+		out += sentence(buf);
+	}
+
+	if(options.vtg){
+		snprintf(buf, sizeof(buf), "GNVTG,%.1f,T,,M,0.12,N,0.22,K,A", course);
+		out += sentence(buf);
+	}
+
+	snprintf(buf, sizeof(buf), "GNRMC,%s,A,%s,%s,0.12,%.1f,191026,,,A", tme,
+		slat.c_str(), slon.c_str(), course);
+	out += sentence(buf);
+	return out;
+}
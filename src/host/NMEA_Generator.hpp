@@ -0,0 +1,86 @@
+#ifndef __NMEA_GENERATOR__
+#define __NMEA_GENERATOR__
+/*! \file */
+#include <stdint.h>
+#include <string>
+
+/**
+ * Synthetic GPS receiver output for host harnesses.  Each epoch is one fix
+ * period's worth of sentences for a receiver circling a point at walking
+ * speed.  The sentence order follows the usual receiver order with RMC last,
+ * so the last byte of an epoch is also the byte that completes a sensor
+ * packet.  Output is a pure function of the options and the epoch index.
+ */
+class NMEA_Generator{
+public:
+	typedef struct Options{
+		/// Fix rate in Hz
+		double rate_hz;
+		/// GSV sentences per epoch and constellation, as noise the parser
+		/// must skip
+		uint8_t gsv_sentences;
+		/// Constellations in view: GPS, then GLONASS, then Galileo (1-3)
+		uint8_t constellations;
+		/// Emit one GSA per constellation every epoch
+		bool gsa;
+		/// Emit VTG every epoch
+		bool vtg;
+		/// Emit ZDA every epoch
+		bool zda;
+		/// Seed for the satellite view
+		uint32_t seed;
+		/// Centre of the circle traced, in decimal degrees
+		double lat;
+		double lon;
+		/// Radius of the circle in degrees
+		double radius_deg;
+		/// Time to go once round the circle in s
+		double period_s;
+	} Options;
+
+	/**
+	 * Default options: 1 Hz, GPS only, three GSV sentences and ZDA.
+	 */
+	static Options defaults();
+
+	/**
+	 * Multi-constellation receiver: GPS, GLONASS and Galileo, each with GSA
+	 * and GSV, plus VTG and ZDA.
+	 */
+	static Options multi_gnss();
+
+	NMEA_Generator(const Options& options);
+
+	/**
+	 * Generates the sentences of one epoch.
+	 * @param index Epoch number, from 0
+	 * @param time  If not NULL, set to the RMC time term of the epoch
+	 * @return      Epoch bytes, CR LF terminated
+	 */
+	std::string epoch(uint32_t index, std::string* time = NULL);
+
+	/**
+	 * Position and course over ground of an epoch.
+	 * @param index  Epoch number, from 0
+	 * @param lat    Set to the latitude in decimal degrees
+	 * @param lon    Set to the longitude in decimal degrees
+	 * @param course Set to the course over ground in degrees from true North
+	 */
+	void position(uint32_t index, double* lat, double* lon,
+		double* course) const;
+
+	/**
+	 * Wraps a sentence body in '$', a checksum and CR LF.
+	 * @param body Sentence between '$' and '*'
+	 * @return     Complete sentence
+	 */
+	static std::string sentence(const std::string& body);
+
+private:
+	Options options;
+	uint32_t rng;
+
+	uint32_t next();
+};
+
+#endif
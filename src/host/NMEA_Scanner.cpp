@@ -0,0 +1,491 @@
+#include "NMEA_Scanner.hpp"
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define NMEA_SCANNER_X86
+#endif
+
+/// Limits of NMEA::decode: bytes per sentence, terms, characters per term
+#define SCAN_MAX_BYTES 100
+#define SCAN_MAX_TERM_CHARS 15
+#define SCAN_BLOCK 64
+
+static const char* const ISA_NAMES[NMEA_Scanner::ISA__SIZE] = {
+	"scalar", "sse2", "avx2"
+};
+
+static inline bool is_special(char c){
+	return c == '$' || c == '*' || c == ',' || c == '\r' || c == '\n';
+}
+
+static void classify_scalar(const char* block, NMEA_Scanner::Masks* masks){
+	uint64_t dollar = 0;
+	uint64_t comma = 0;
+	uint64_t special = 0;
+	for(int i = 0; i < SCAN_BLOCK; i++){
+		dollar |= (uint64_t)(block[i] == '$') << i;
+		comma |= (uint64_t)(block[i] == ',') << i;
+		special |= (uint64_t)is_special(block[i]) << i;
+	}
+	masks->dollar = dollar;
+	masks->comma = comma;
+	masks->special = special;
+}
+
+static uint8_t xor_scalar(const char* data, size_t len){
+	uint8_t x = 0;
+	for(size_t i = 0; i < len; i++){
+		x ^= data[i];
+	}
+	return x;
+}
+
+#ifdef NMEA_SCANNER_X86
+static void classify_sse2(const char* block, NMEA_Scanner::Masks* masks){
+	const __m128i dollar = _mm_set1_epi8('$');
+	const __m128i star = _mm_set1_epi8('*');
+	const __m128i comma = _mm_set1_epi8(',');
+	const __m128i cr = _mm_set1_epi8('\r');
+	const __m128i lf = _mm_set1_epi8('\n');
+	uint64_t d = 0;
+	uint64_t c = 0;
+	uint64_t s = 0;
+	for(int i = 0; i < SCAN_BLOCK; i += 16){
+		__m128i v = _mm_loadu_si128((const __m128i*)(block + i));
+		__m128i is_dollar = _mm_cmpeq_epi8(v, dollar);
+		__m128i is_comma = _mm_cmpeq_epi8(v, comma);
+		__m128i any = _mm_or_si128(
+			_mm_or_si128(is_dollar, _mm_cmpeq_epi8(v, star)),
+			_mm_or_si128(is_comma,
+				_mm_or_si128(_mm_cmpeq_epi8(v, cr), _mm_cmpeq_epi8(v, lf))));
+		d |= (uint64_t)(uint16_t)_mm_movemask_epi8(is_dollar) << i;
+		c |= (uint64_t)(uint16_t)_mm_movemask_epi8(is_comma) << i;
+		s |= (uint64_t)(uint16_t)_mm_movemask_epi8(any) << i;
+	}
+	masks->dollar = d;
+	masks->comma = c;
+	masks->special = s;
+}
+
+static uint8_t xor_sse2(const char* data, size_t len){
+	__m128i acc = _mm_setzero_si128();
+	size_t i = 0;
+	for(; i + 16 <= len; i += 16){
+		acc = _mm_xor_si128(acc, _mm_loadu_si128((const __m128i*)(data + i)));
+	}
+	acc = _mm_xor_si128(acc, _mm_srli_si128(acc, 8));
+	acc = _mm_xor_si128(acc, _mm_srli_si128(acc, 4));
+	acc = _mm_xor_si128(acc, _mm_srli_si128(acc, 2));
+	acc = _mm_xor_si128(acc, _mm_srli_si128(acc, 1));
+	return (uint8_t)_mm_cvtsi128_si32(acc) ^ xor_scalar(data + i, len - i);
+}
+
+__attribute__((target("avx2")))
+static void classify_avx2(const char* block, NMEA_Scanner::Masks* masks){
+	const __m256i dollar = _mm256_set1_epi8('$');
+	const __m256i star = _mm256_set1_epi8('*');
+	const __m256i comma = _mm256_set1_epi8(',');
+	const __m256i cr = _mm256_set1_epi8('\r');
+	const __m256i lf = _mm256_set1_epi8('\n');
+	uint64_t d = 0;
+	uint64_t c = 0;
+	uint64_t s = 0;
+	for(int i = 0; i < SCAN_BLOCK; i += 32){
+		__m256i v = _mm256_loadu_si256((const __m256i*)(block + i));
+		__m256i is_dollar = _mm256_cmpeq_epi8(v, dollar);
+		__m256i is_comma = _mm256_cmpeq_epi8(v, comma);
+		__m256i any = _mm256_or_si256(
+			_mm256_or_si256(is_dollar, _mm256_cmpeq_epi8(v, star)),
+			_mm256_or_si256(is_comma,
+				_mm256_or_si256(_mm256_cmpeq_epi8(v, cr),
+					_mm256_cmpeq_epi8(v, lf))));
+		d |= (uint64_t)(uint32_t)_mm256_movemask_epi8(is_dollar) << i;
+		c |= (uint64_t)(uint32_t)_mm256_movemask_epi8(is_comma) << i;
+		s |= (uint64_t)(uint32_t)_mm256_movemask_epi8(any) << i;
+	}
+	masks->dollar = d;
+	masks->comma = c;
+	masks->special = s;
+}
+
+__attribute__((target("avx2")))
+static uint8_t xor_avx2(const char* data, size_t len){
+	__m256i acc = _mm256_setzero_si256();
+	size_t i = 0;
+	for(; i + 32 <= len; i += 32){
+		acc = _mm256_xor_si256(acc,
+			_mm256_loadu_si256((const __m256i*)(data + i)));
+	}
+	__m128i x = _mm_xor_si128(_mm256_castsi256_si128(acc),
+		_mm256_extracti128_si256(acc, 1));
+	if(i + 16 <= len){
+		x = _mm_xor_si128(x, _mm_loadu_si128((const __m128i*)(data + i)));
+		i += 16;
+	}
+	x = _mm_xor_si128(x, _mm_srli_si128(x, 8));
+	x = _mm_xor_si128(x, _mm_srli_si128(x, 4));
+	x = _mm_xor_si128(x, _mm_srli_si128(x, 2));
+	x = _mm_xor_si128(x, _mm_srli_si128(x, 1));
+	return (uint8_t)_mm_cvtsi128_si32(x) ^ xor_scalar(data + i, len - i);
+}
+#endif
+
+/**
+ * NMEA::_dehex, which does not reject invalid digits, on a signed char.
+ */
+static inline int dehex(char a){
+	return (int(a) >= 65) ? int(a) - 55 : int(a) - 48;
+}
+
+namespace{
+	typedef unsigned __int128 Window_Bits;
+
+	inline unsigned ctz128(Window_Bits x){
+		uint64_t lo = (uint64_t)x;
+		return lo ? __builtin_ctzll(lo)
+			: 64 + __builtin_ctzll((uint64_t)(x >> 64));
+	}
+
+	/**
+	 * Character classes of 128 bytes from some position.
+	 */
+	typedef struct Window{
+		Window_Bits dollar;
+		Window_Bits comma;
+		Window_Bits special;
+	} Window;
+
+	/**
+	 * Classifies a buffer a block at a time, each block once, keeping the
+	 * last few blocks so that windows of them can be taken at any position.
+	 * Kept in locals during a scan, so that the compiler can hold it in
+	 * registers across the stores into the sentences.
+	 */
+	class Block_Cursor{
+	public:
+		Block_Cursor(const char* buf, size_t len,
+				void (*classify)(const char*, NMEA_Scanner::Masks*))
+				: buf(buf), len(len), classify(classify){
+			for(int i = 0; i < CACHED; i++){
+				tags[i] = (size_t)-1;
+			}
+		}
+
+		/**
+		 * First position at or after p of a '$' (dollar) or of any special
+		 * character, or len if there is none.
+		 */
+		inline size_t find(size_t p, bool dollar){
+			while(p < len){
+				size_t b = p / SCAN_BLOCK;
+				const NMEA_Scanner::Masks& masks = at(b);
+				uint64_t m = dollar ? masks.dollar : masks.special;
+				m &= ~0ULL << (p % SCAN_BLOCK);
+				if(m){
+					size_t found = b * SCAN_BLOCK + __builtin_ctzll(m);
+					return (found < len) ? found : len;
+				}
+				p = (b + 1) * SCAN_BLOCK;
+			}
+			return len;
+		}
+
+		/**
+		 * Character classes of the 128 bytes from p.  Bytes past the end of
+		 * the buffer are in no class.
+		 */
+		inline void window(size_t p, Window* w){
+			size_t b = p / SCAN_BLOCK;
+			unsigned r = p % SCAN_BLOCK;
+			const NMEA_Scanner::Masks& m0 = at(b);
+			const NMEA_Scanner::Masks& m1 = at(b + 1);
+			w->dollar = ((Window_Bits)m1.dollar << 64 | m0.dollar) >> r;
+			w->comma = ((Window_Bits)m1.comma << 64 | m0.comma) >> r;
+			w->special = ((Window_Bits)m1.special << 64 | m0.special) >> r;
+			if(r){
+				const NMEA_Scanner::Masks& m2 = at(b + 2);
+				w->dollar |= (Window_Bits)m2.dollar << (128 - r);
+				w->comma |= (Window_Bits)m2.comma << (128 - r);
+				w->special |= (Window_Bits)m2.special << (128 - r);
+			}
+		}
+
+	private:
+		/// A window spans at most three blocks; one more for find()
+		static const int CACHED = 4;
+
+		const char* buf;
+		size_t len;
+		void (*classify)(const char*, NMEA_Scanner::Masks*);
+		size_t tags[CACHED];
+		NMEA_Scanner::Masks masks[CACHED];
+
+		inline const NMEA_Scanner::Masks& at(size_t b){
+			int i = b % CACHED;
+			if(tags[i] != b){
+				load(b, &masks[i]);
+				tags[i] = b;
+			}
+			return masks[i];
+		}
+
+		void load(size_t b, NMEA_Scanner::Masks* m){
+			size_t start = b * SCAN_BLOCK;
+			if(start + SCAN_BLOCK <= len){
+				classify(buf + start, m);
+			}else if(start < len){
+				// Last, partial block
+				char tail[SCAN_BLOCK];
+				memset(tail, 0, sizeof(tail));
+				memcpy(tail, buf + start, len - start);
+				classify_scalar(tail, m);
+			}else{
+				memset(m, 0, sizeof(*m));
+			}
+		}
+	};
+
+	/**
+	 * The common case: a sentence with no term over the limit and not too
+	 * many of them, ending in a '*' and two checksum characters within the
+	 * byte limit.  Takes the 128 bytes after the '$' as one window, checks
+	 * the limits on its masks and fills in the delimiters.
+	 * @param next Set to the next '$' after the sentence if it is in the
+	 *             window, or to 0
+	 * @return     Position of the '*', or 0 if the sentence needs the exact
+	 *             walk
+	 */
+	inline size_t fast_walk(Block_Cursor& cursor, const char* buf, size_t len,
+			size_t d, NMEA_Scanner::Sentence& sentence, size_t* next){
+		*next = 0;
+		if(d + 1 >= len){
+			return 0;
+		}
+		const char* w = buf + d + 1;
+		size_t avail = len - d - 1;
+		Window window;
+		cursor.window(d + 1, &window);
+		Window_Bits stop = window.special & ~window.comma;
+		if(!stop){
+			return 0;
+		}
+		// The '*' at w[k]: its second checksum character must come before
+		// the byte limit, and be in the buffer
+		unsigned k = ctz128(stop);
+		if(k + 3 >= SCAN_MAX_BYTES || k + 2 >= avail || w[k] != '*'){
+			return 0;
+		}
+		char c1 = w[k + 1];
+		char c2 = w[k + 2];
+		if(c1 == '$' || c1 == '\r' || c1 == '\n' || c2 == '$' || c2 == '\r'
+				|| c2 == '\n'){
+			return 0;
+		}
+		Window_Bits body = ((Window_Bits)1 << k) - 1;
+		Window_Bits comma = window.comma & body;
+		unsigned commas = __builtin_popcountll((uint64_t)comma)
+			+ __builtin_popcountll((uint64_t)(comma >> 64));
+		// With the '*', each delimiter is a term
+		if(commas + 1 >= NMEA_SCANNER_MAX_TERMS){
+			return 0;
+		}
+		// Any run of SCAN_MAX_TERM_CHARS term characters is a runaway
+		Window_Bits run = ~window.special & body;
+		run &= run >> 1;
+		run &= run >> 2;
+		run &= run >> 4;
+		run &= run >> (SCAN_MAX_TERM_CHARS - 8);
+		if(run){
+			return 0;
+		}
+
+		unsigned t = 0;
+		for(uint64_t m = (uint64_t)comma; m; m &= m - 1){
+			sentence.delim[++t] = 1 + __builtin_ctzll(m);
+		}
+		for(uint64_t m = (uint64_t)(comma >> 64); m; m &= m - 1){
+			sentence.delim[++t] = 1 + SCAN_BLOCK + __builtin_ctzll(m);
+		}
+		sentence.delim[++t] = 1 + k;
+		sentence.terms = t + 1;
+
+		Window_Bits dollar = window.dollar & ~(((Window_Bits)1 << (k + 3)) - 1);
+		if(dollar){
+			*next = d + 1 + ctz128(dollar);
+		}
+		return d + 1 + k;
+	}
+}
+
+bool NMEA_Scanner::supported(Isa isa){
+	switch(isa){
+		case ISA_SCALAR:
+			return true;
+#ifdef NMEA_SCANNER_X86
+		case ISA_SSE2:
+			return __builtin_cpu_supports("sse2");
+		case ISA_AVX2:
+			return __builtin_cpu_supports("avx2");
+#endif
+		default:
+			return false;
+	}
+}
+
+NMEA_Scanner::Isa NMEA_Scanner::best(){
+	for(int isa = ISA__SIZE - 1; isa > ISA_SCALAR; isa--){
+		if(supported((Isa)isa)){
+			return (Isa)isa;
+		}
+	}
+	return ISA_SCALAR;
+}
+
+const char* NMEA_Scanner::name(Isa isa){
+	return (isa < ISA__SIZE) ? ISA_NAMES[isa] : "unknown";
+}
+
+NMEA_Scanner::NMEA_Scanner(Isa isa) : accepted(0), bad_checksums(0),
+		runaways(0){
+	selected = supported(isa) ? isa : best();
+	classify = classify_scalar;
+	xor_bytes = xor_scalar;
+#ifdef NMEA_SCANNER_X86
+	if(selected == ISA_SSE2){
+		classify = classify_sse2;
+		xor_bytes = xor_sse2;
+	}else if(selected == ISA_AVX2){
+		classify = classify_avx2;
+		xor_bytes = xor_avx2;
+	}
+#endif
+}
+
+size_t NMEA_Scanner::scan(const char* buf, size_t len,
+		std::vector<Sentence>& out){
+	Block_Cursor cursor(buf, len, classify);
+
+	size_t pos = 0;
+	size_t next = 0;
+	for(;;){
+		size_t d = next ? next : cursor.find(pos, true);
+		if(d >= len){
+			return len;
+		}
+		Sentence sentence;
+		sentence.begin = d;
+		sentence.delim[0] = 0;
+		size_t star = fast_walk(cursor, buf, len, d, sentence, &next);
+		if(star){
+			checksum(buf, star, sentence, out);
+			pos = star + 3;
+			continue;
+		}
+
+		// d is the '$' of a sentence in progress.  NMEA::decode checks its
+		// limits as each byte arrives, before looking at the byte, so a limit
+		// reached at position v abandons the sentence there and v is looked
+		// at again in state 0.
+		bool restart;
+		do{
+			restart = false;
+			sentence.begin = d;
+			sentence.delim[0] = 0;
+			size_t limit = d + SCAN_MAX_BYTES;
+			size_t term_start = d + 1;
+			uint8_t delims = 0;
+			for(;;){
+				size_t j = cursor.find(term_start, false);
+				size_t v = term_start + SCAN_MAX_TERM_CHARS;
+				v = (limit < v) ? limit : v;
+				if(v <= j){
+					if(v >= len){
+						return d;
+					}
+					runaways++;
+					pos = v;
+					break;
+				}
+				if(j >= len){
+					return d;
+				}
+				char c = buf[j];
+				if(c == '$'){
+					d = j;
+					restart = true;
+					break;
+				}
+				if(c == '\r' || c == '\n'){
+					pos = j + 1;
+					break;
+				}
+				if(delims + 1 >= NMEA_SCANNER_MAX_TERMS){
+					// The term limit is checked as the next byte arrives
+					if(j + 1 >= len){
+						return d;
+					}
+					runaways++;
+					pos = j + 1;
+					break;
+				}
+				sentence.delim[++delims] = j - d;
+				term_start = j + 1;
+				if(c == ','){
+					continue;
+				}
+
+				// '*', then the two checksum characters
+				size_t p;
+				for(p = j + 1; p <= j + 2; p++){
+					if(p >= len){
+						return d;
+					}
+					if(p >= limit){
+						runaways++;
+						break;
+					}
+					if(buf[p] == '$' || buf[p] == '\r' || buf[p] == '\n'){
+						break;
+					}
+				}
+				if(p <= j + 2){
+					// A runaway or a '$' is looked at again in state 0, which
+					// restarts on a '$'; CR and LF are consumed
+					pos = (p >= limit || buf[p] == '$') ? p : p + 1;
+					break;
+				}
+
+				sentence.terms = delims + 1;
+				checksum(buf, j, sentence, out);
+				pos = j + 3;
+				break;
+			}
+		}while(restart);
+	}
+}
+
+void NMEA_Scanner::checksum(const char* buf, size_t star,
+		Sentence& sentence, std::vector<Sentence>& out){
+	// _parity is an int XORed with sign extended chars, which sets its upper
+	// bits iff the XOR of the bytes has bit 7 set
+	size_t d = sentence.begin;
+	int parity = (int8_t)xor_bytes(buf + d + 1, star - d - 1);
+	parity -= 16 * dehex(buf[star + 1]) + dehex(buf[star + 2]);
+	if(parity == 0){
+		sentence.length = star + 3 - d;
+		out.push_back(sentence);
+		accepted++;
+	}else{
+		bad_checksums++;
+	}
+}
+
+const char* NMEA_Scanner::term(const char* buf, const Sentence& sentence,
+		uint8_t t, size_t* len){
+	size_t start = sentence.delim[t] + 1;
+	size_t end = (t + 1 < sentence.terms) ? sentence.delim[t + 1]
+		: sentence.length;
+	*len = end - start;
+	return buf + sentence.begin + start;
+}
@@ -0,0 +1,151 @@
+#ifndef __NMEA_SCANNER__
+#define __NMEA_SCANNER__
+/*! \file */
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/**
+ * Most terms a sentence accepted by NMEA::decode can have, including the
+ * checksum term.
+ */
+#define NMEA_SCANNER_MAX_TERMS 30
+
+/**
+ * Bulk NMEA scanner for host tools.  Finds the sentences in a buffer that
+ * NMEA::decode would accept if fed the same bytes one at a time, with the
+ * same quirks: '$' restarts a sentence, CR and LF abandon one, the same
+ * runaway limits (100 bytes, 30 terms, 14 characters per term), and the
+ * same checksum arithmetic, invalid hex digits included.  Its counters match
+ * the parser's counters.
+ *
+ * Rather than stepping a state machine per byte, the scanner classifies 64
+ * bytes at a time into bit masks of '$', ',' and all of '$', '*', ',', CR
+ * and LF, with SSE2 or AVX2 where the CPU has them.  A well formed sentence
+ * is then checked against the limits on the masks of the 128 bytes after its
+ * '$', and its body XORed for the checksum a vector at a time; only
+ * sentences that come near a limit or are cut short are walked delimiter by
+ * delimiter.
+ */
+class NMEA_Scanner{
+public:
+	/**
+	 * Instruction set used for classification and checksums.
+	 */
+	enum Isa{
+		ISA_SCALAR = 0,
+		ISA_SSE2 = 1,
+		ISA_AVX2 = 2,
+		ISA__SIZE
+	};
+
+	/**
+	 * A sentence the scanner accepted.  Offsets are relative to begin.
+	 */
+	typedef struct Sentence{
+		/// Offset of the '$' in the buffer
+		size_t begin;
+		/// Length from the '$' through the last checksum digit
+		uint8_t length;
+		/// Number of terms, including the checksum term
+		uint8_t terms;
+		/// Offset of the '$', each ',' and the '*'.  Term i runs from
+		/// delim[i] + 1 up to delim[i + 1], or to length for the checksum.
+		uint8_t delim[NMEA_SCANNER_MAX_TERMS];
+	} Sentence;
+
+	/**
+	 * Character classes of one 64 byte block, one bit per byte.
+	 */
+	typedef struct Masks{
+		uint64_t dollar;
+		uint64_t comma;
+		/// '$', '*', ',', CR and LF
+		uint64_t special;
+	} Masks;
+
+	/**
+	 * Best instruction set this CPU supports.
+	 */
+	static Isa best();
+
+	/**
+	 * Short name of an instruction set.
+	 */
+	static const char* name(Isa isa);
+
+	/**
+	 * Whether this build and CPU can run an instruction set.
+	 */
+	static bool supported(Isa isa);
+
+	/**
+	 * Creates a scanner.
+	 * @param isa Instruction set to use; falls back to the best supported one
+	 *            if this one is not
+	 */
+	NMEA_Scanner(Isa isa = best());
+
+	/**
+	 * Scans a buffer, as if its bytes were fed to a newly constructed
+	 * NMEA::decode.
+	 * @param  buf  Bytes to scan
+	 * @param  len  Number of bytes
+	 * @param  out  Accepted sentences are appended to this
+	 * @return      Offset of the first byte of an unfinished sentence at the
+	 *              end of the buffer, or len if there is none.  To scan a
+	 *              stream in pieces, carry the bytes from there over to the
+	 *              front of the next piece.
+	 */
+	size_t scan(const char* buf, size_t len, std::vector<Sentence>& out);
+
+	/**
+	 * Start and length of a term of a sentence.
+	 * @param  buf      Buffer the sentence was scanned from
+	 * @param  sentence Sentence
+	 * @param  t        Term number, from 0
+	 * @param  len      Set to the length of the term
+	 * @return          First character of the term
+	 */
+	static const char* term(const char* buf, const Sentence& sentence,
+		uint8_t t, size_t* len);
+
+	Isa isa() const{
+		return selected;
+	}
+
+	/// Sentences accepted, as NMEA::sentences()
+	unsigned sentences() const{
+		return accepted;
+	}
+
+	/// Sentences with a bad checksum, as NMEA::checksum_errors()
+	unsigned checksum_errors() const{
+		return bad_checksums;
+	}
+
+	/// Sentences abandoned at a runaway limit, as NMEA::runaway_resets()
+	unsigned runaway_resets() const{
+		return runaways;
+	}
+
+private:
+	typedef void (*ClassifyFn)(const char* block, Masks* masks);
+	typedef uint8_t (*XorFn)(const char* data, size_t len);
+
+	Isa selected;
+	ClassifyFn classify;
+	XorFn xor_bytes;
+	unsigned accepted;
+	unsigned bad_checksums;
+	unsigned runaways;
+
+	/**
+	 * Checks the checksum of a sentence whose terms are filled in, and
+	 * counts it or appends it to out.
+	 */
+	void checksum(const char* buf, size_t star, Sentence& sentence,
+		std::vector<Sentence>& out);
+};
+
+#endif
@@ -0,0 +1,118 @@
+#include "PTY_Stream.hpp"
+#include <errno.h>
+#include <fcntl.h>
+#include <pty.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+
+PTY_Stream::PTY_Stream() : master(-1), slave(-1), peeked(-1), recorder(NULL),
+		rx_port(0), tx_port(0), recorder_clock(NULL){
+	slave_name[0] = 0;
+	link_name[0] = 0;
+}
+
+PTY_Stream::~PTY_Stream(){
+	close();
+}
+
+bool PTY_Stream::open(const char* link){
+	struct termios tio;
+	if(openpty(&master, &slave, slave_name, NULL, NULL) < 0){
+		return false;
+	}
+	cfmakeraw(&tio);
+	tcsetattr(slave, TCSANOW, &tio);
+	fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK);
+
+	if(link != NULL){
+		unlink(link);
+		if(symlink(slave_name, link) == 0){
+			snprintf(link_name, sizeof(link_name), "%s", link);
+		}
+	}
+	return true;
+}
+
+void PTY_Stream::close(){
+	if(link_name[0]){
+		unlink(link_name);
+		link_name[0] = 0;
+	}
+	if(master >= 0){
+		::close(master);
+		master = -1;
+	}
+	if(slave >= 0){
+		::close(slave);
+		slave = -1;
+	}
+	peeked = -1;
+}
+
+void PTY_Stream::record(Capture_Writer* writer, uint8_t rx_port,
+		uint8_t tx_port, uint64_t (*now_us)(void)){
+	recorder = writer;
+	this->rx_port = rx_port;
+	this->tx_port = tx_port;
+	recorder_clock = now_us;
+}
+
+int PTY_Stream::available(){
+	int n = 0;
+	if(master < 0 || ioctl(master, FIONREAD, &n) < 0){
+		n = 0;
+	}
+	return n + (peeked >= 0);
+}
+
+int PTY_Stream::read(){
+	uint8_t c;
+	if(peeked >= 0){
+		c = peeked;
+		peeked = -1;
+	}else if(master < 0 || ::read(master, &c, 1) != 1){
+		return -1;
+	}
+	if(recorder != NULL){
+		recorder->write(recorder_clock(), rx_port, &c, 1);
+	}
+	return c;
+}
+
+int PTY_Stream::peek(){
+	if(peeked < 0){
+		uint8_t c;
+		if(master >= 0 && ::read(master, &c, 1) == 1){
+			peeked = c;
+		}
+	}
+	return peeked;
+}
+
+size_t PTY_Stream::write(uint8_t c){
+	return write(&c, 1);
+}
+
+size_t PTY_Stream::write(const uint8_t* buffer, size_t size){
+	if(recorder != NULL){
+		recorder->write(recorder_clock(), tx_port, buffer, size);
+	}
+	size_t sent = 0;
+	while(master >= 0 && sent < size){
+		ssize_t n = ::write(master, buffer + sent, size - sent);
+		if(n < 0){
+			if(errno == EINTR){
+				continue;
+			}
+			// Nobody is draining the slave; drop the rest, as a UART would
+			break;
+		}
+		sent += n;
+	}
+	return sent;
+}
+
+int PTY_Stream::availableForWrite(){
+	return 64;
+}
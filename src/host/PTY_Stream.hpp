@@ -0,0 +1,75 @@
+#ifndef __PTY_STREAM__
+#define __PTY_STREAM__
+/*! \file */
+#include <Arduino.h>
+#include "Capture.hpp"
+
+/**
+ * Serial port backed by a pseudo terminal.  The firmware side reads and writes
+ * the PTY master; the slave end behaves like the UIB's serial device, so an
+ * OBC process or GPS simulator can open it exactly as it would open
+ * /dev/ttyACM0.
+ */
+class PTY_Stream : public Stream{
+public:
+	PTY_Stream();
+	~PTY_Stream();
+
+	/**
+	 * Opens the PTY pair.  The slave is put in raw mode and held open so that
+	 * the master does not see a hangup while no client is attached.
+	 * @param  link Optional path to symlink to the slave device, or NULL
+	 * @return      true on success
+	 */
+	bool open(const char* link);
+
+	/**
+	 * Closes the PTY pair and removes the symlink, if any.
+	 */
+	void close();
+
+	/**
+	 * Records every byte the firmware reads or writes on this port.
+	 * @param writer  Open capture, or NULL to stop recording
+	 * @param rx_port CapturePort for bytes read by the firmware
+	 * @param tx_port CapturePort for bytes written by the firmware
+	 * @param now_us  Capture clock in us
+	 */
+	void record(Capture_Writer* writer, uint8_t rx_port, uint8_t tx_port,
+		uint64_t (*now_us)(void));
+
+	/**
+	 * Path of the slave device, for clients to open.
+	 */
+	const char* name() const{
+		return slave_name;
+	}
+
+	/**
+	 * File descriptor of the master side, for polling.
+	 */
+	int fd() const{
+		return master;
+	}
+
+	int available();
+	int read();
+	int peek();
+	size_t write(uint8_t c);
+	size_t write(const uint8_t* buffer, size_t size);
+	int availableForWrite();
+	using Print::write;
+
+private:
+	int master;
+	int slave;
+	int peeked;
+	char slave_name[64];
+	char link_name[128];
+	Capture_Writer* recorder;
+	uint8_t rx_port;
+	uint8_t tx_port;
+	uint64_t (*recorder_clock)(void);
+};
+
+#endif
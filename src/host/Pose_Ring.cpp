@@ -0,0 +1,167 @@
+#include "Pose_Ring.hpp"
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+static_assert(sizeof(PoseRingHeader) == 64, "header is one cache line");
+static_assert(sizeof(PoseRingSlot) == 64, "slots are one cache line");
+
+Pose_Ring::Pose_Ring() : header(NULL), slots(NULL), size(0), owner(false){
+	name[0] = 0;
+}
+
+Pose_Ring::~Pose_Ring(){
+	close();
+}
+
+bool Pose_Ring::map(int fd, bool writable){
+	void* p = mmap(NULL, size, writable ? PROT_READ | PROT_WRITE : PROT_READ,
+		MAP_SHARED, fd, 0);
+	::close(fd);
+	if(p == MAP_FAILED){
+		return false;
+	}
+	header = (PoseRingHeader*)p;
+	slots = (PoseRingSlot*)(header + 1);
+	return true;
+}
+
+bool Pose_Ring::create(const char* shm_name, uint32_t capacity){
+	close();
+	uint32_t slots_n = 1;
+	while(slots_n < capacity && slots_n < 0x80000000u){
+		slots_n <<= 1;
+	}
+	shm_unlink(shm_name);
+	int fd = shm_open(shm_name, O_RDWR | O_CREAT | O_EXCL, 0644);
+	if(fd < 0){
+		return false;
+	}
+	size = sizeof(PoseRingHeader) + (size_t)slots_n * sizeof(PoseRingSlot);
+	if(ftruncate(fd, size) < 0){
+		::close(fd);
+		shm_unlink(shm_name);
+		return false;
+	}
+	if(!map(fd, true)){
+		shm_unlink(shm_name);
+		return false;
+	}
+	owner = true;
+	strncpy(name, shm_name, sizeof(name) - 1);
+	name[sizeof(name) - 1] = 0;
+
+	// ftruncate zero filled the slots, so no slot claims a record yet
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	header->version = POSE_RING_VERSION;
+	header->slot_size = sizeof(PoseRingSlot);
+	header->capacity = slots_n;
+	header->writer_pid = getpid();
+	header->head = 0;
+	header->created_ns = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+	// Readers check the magic last
+	__atomic_store_n(&header->magic, POSE_RING_MAGIC, __ATOMIC_RELEASE);
+	return true;
+}
+
+bool Pose_Ring::attach(const char* shm_name){
+	close();
+	int fd = shm_open(shm_name, O_RDONLY, 0);
+	if(fd < 0){
+		return false;
+	}
+	struct stat st;
+	if(fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(PoseRingHeader)){
+		::close(fd);
+		return false;
+	}
+	size = st.st_size;
+	if(!map(fd, false)){
+		return false;
+	}
+	if(__atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) != POSE_RING_MAGIC
+			|| header->version != POSE_RING_VERSION
+			|| header->slot_size != sizeof(PoseRingSlot)
+			|| sizeof(PoseRingHeader) + (size_t)header->capacity
+				* sizeof(PoseRingSlot) > size){
+		close();
+		return false;
+	}
+	return true;
+}
+
+void Pose_Ring::close(){
+	if(header != NULL){
+		munmap(header, size);
+	}
+	if(owner){
+		shm_unlink(name);
+	}
+	header = NULL;
+	slots = NULL;
+	size = 0;
+	owner = false;
+}
+
+void Pose_Ring::publish(const PoseRecord& record){
+	uint64_t n = header->head;
+	PoseRingSlot& slot = slots[n & (header->capacity - 1)];
+	__atomic_store_n(&slot.seq, 2 * n + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	slot.record = record;
+	__atomic_store_n(&slot.seq, 2 * n + 2, __ATOMIC_RELEASE);
+	__atomic_store_n(&header->head, n + 1, __ATOMIC_RELEASE);
+}
+
+uint64_t Pose_Ring::head() const{
+	return header ? __atomic_load_n(&header->head, __ATOMIC_ACQUIRE) : 0;
+}
+
+PoseRingRead Pose_Ring::read(uint64_t n, PoseRecord* record) const{
+	if(n >= head()){
+		return POSE_READ_PENDING;
+	}
+	const PoseRingSlot& slot = slots[n & (header->capacity - 1)];
+	uint64_t before = __atomic_load_n(&slot.seq, __ATOMIC_ACQUIRE);
+	if(before != 2 * n + 2){
+		return POSE_READ_OVERWRITTEN;
+	}
+	*record = slot.record;
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	if(__atomic_load_n(&slot.seq, __ATOMIC_RELAXED) != before){
+		return POSE_READ_OVERWRITTEN;
+	}
+	return POSE_READ_OK;
+}
+
+bool Pose_Ring::next(uint64_t* next, PoseRecord* record, uint64_t* lost) const{
+	for(;;){
+		uint64_t h = head();
+		if(*next >= h){
+			return false;
+		}
+		// Records older than the last capacity are gone; the oldest kept one
+		// may be overwritten by the time it is read, so keep one slot spare
+		uint64_t oldest = (h > header->capacity) ? h - header->capacity + 1 : 0;
+		if(*next < oldest){
+			if(lost != NULL){
+				*lost += oldest - *next;
+			}
+			*next = oldest;
+		}
+		PoseRingRead r = read(*next, record);
+		if(r == POSE_READ_OK){
+			(*next)++;
+			return true;
+		}
+		if(r == POSE_READ_PENDING){
+			return false;
+		}
+		// Overwritten while reading: the bridge lapped this consumer
+	}
+}
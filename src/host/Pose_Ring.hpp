@@ -0,0 +1,166 @@
+#ifndef __POSE_RING__
+#define __POSE_RING__
+/*! \file
+ * Shared memory ring of UIB pose records.
+ *
+ * rctbridge parses each sensor packet from the UIB once and publishes it here;
+ * any number of processes on the OBC attach read only and read the records in
+ * place, with no syscalls and no coordination with the bridge or each other.
+ *
+ *     Header:  64 bytes, see PoseRingHeader
+ *     Slots:   capacity x 64 bytes, record n in slot n % capacity
+ *
+ * Each slot is a seqlock.  The bridge sets the slot's sequence to 2n + 1
+ * while it writes record n and to 2n + 2 once it is complete, then advances
+ * the header's head.  A reader copies the record out and checks the sequence
+ * before and after; a reader that falls more than capacity records behind
+ * finds its records overwritten and skips ahead.  The layout is host endian
+ * and only meant for processes on the same machine.
+ */
+#include <stddef.h>
+#include <stdint.h>
+
+#define POSE_RING_MAGIC 0x50544352u
+#define POSE_RING_VERSION 1
+
+/**
+ * Default shared memory object name.
+ */
+#define POSE_RING_NAME "/rctbridge"
+
+/**
+ * One sensor packet from the UIB, as sent by Sensor_Module::getPacket.
+ */
+typedef struct PoseRecord{
+	/// CLOCK_MONOTONIC time the bridge read the end of the packet, in ns
+	uint64_t rx_ns;
+	/// Latitude and longitude in 1e-7 degrees
+	int32_t lat;
+	int32_t lon;
+	/// Heading in degrees from magnetic North
+	uint16_t hdg;
+	/// Sensor_Module::GPSFix
+	uint8_t fix;
+	/// Satellites used in the fix
+	uint8_t sat;
+	/// Run switch state
+	uint8_t run;
+	/// GPS time hhmmss.ss and date ddmmyy, zero terminated
+	char time[10];
+	char date[7];
+	/// uts mapped to CLOCK_MONOTONIC by clock synchronisation, in ns; 0
+	/// until the bridge has a clock estimate
+	uint64_t uib_ns;
+	/// UIB time of the fix in us, 0 if the UIB did not send one
+	uint32_t uts;
+	uint8_t reserved[4];
+} PoseRecord;
+
+typedef struct PoseRingSlot{
+	/// 2n + 1 while record n is being written, 2n + 2 once it is complete
+	uint64_t seq;
+	PoseRecord record;
+} PoseRingSlot;
+
+typedef struct PoseRingHeader{
+	uint32_t magic;
+	uint16_t version;
+	uint16_t slot_size;
+	/// Number of slots, a power of two
+	uint32_t capacity;
+	/// Process ID of the bridge
+	int32_t writer_pid;
+	/// Number of records published so far
+	uint64_t head;
+	/// CLOCK_MONOTONIC time the ring was created, in ns
+	uint64_t created_ns;
+	uint8_t reserved[32];
+} PoseRingHeader;
+
+/**
+ * Result of reading a record.
+ */
+enum PoseRingRead{
+	/// The record was copied out
+	POSE_READ_OK,
+	/// The record has not been published yet
+	POSE_READ_PENDING,
+	/// The record was overwritten before or while it was read
+	POSE_READ_OVERWRITTEN
+};
+
+/**
+ * Producer or consumer side of a pose ring.
+ */
+class Pose_Ring{
+public:
+	Pose_Ring();
+	~Pose_Ring();
+
+	/**
+	 * Creates a ring, replacing any existing one of the same name.
+	 * @param  name     Shared memory object name, e.g. POSE_RING_NAME
+	 * @param  capacity Number of records kept, rounded up to a power of two
+	 * @return          true on success
+	 */
+	bool create(const char* name, uint32_t capacity);
+
+	/**
+	 * Attaches to an existing ring read only.
+	 * @return true on success
+	 */
+	bool attach(const char* name);
+
+	/**
+	 * Unmaps the ring, and removes it if this side created it.
+	 */
+	void close();
+
+	/**
+	 * Publishes a record.  Only the side that created the ring may call this.
+	 */
+	void publish(const PoseRecord& record);
+
+	/**
+	 * Number of records published so far.  The latest is head() - 1.
+	 */
+	uint64_t head() const;
+
+	/**
+	 * Reads record n.
+	 * @param  n      Record number
+	 * @param  record Set to the record if POSE_READ_OK
+	 */
+	PoseRingRead read(uint64_t n, PoseRecord* record) const;
+
+	/**
+	 * Reads the record after the one a consumer last read, skipping ahead if
+	 * the consumer fell behind.
+	 * @param  next   Number of the next record to read; start at head() to
+	 *                read only new records, and at 0 to read all that are
+	 *                still kept
+	 * @param  record Set to the record if one was read
+	 * @param  lost   If not NULL, incremented by the number of records skipped
+	 * @return        true if a record was read
+	 */
+	bool next(uint64_t* next, PoseRecord* record, uint64_t* lost = NULL) const;
+
+	uint32_t capacity() const{
+		return header ? header->capacity : 0;
+	}
+
+	int32_t writer() const{
+		return header ? header->writer_pid : 0;
+	}
+
+private:
+	PoseRingHeader* header;
+	PoseRingSlot* slots;
+	size_t size;
+	bool owner;
+	char name[64];
+
+	bool map(int fd, bool writable);
+};
+
+#endif
@@ -0,0 +1,340 @@
+/*
+ * @file bench_faults.cpp
+ *
+ * @description Fault injection benchmark for the firmware's stream parsers.
+ *
+ * Runs a GPS stream through NMEA::decode and an OBC status stream through
+ * Status_Module::decode twice: once clean and once mutated by Fault_Injector.
+ * Each message the parser accepts is attributed to the source message its
+ * last byte came from, and compared against what the parser produced for the
+ * same message on the clean stream.  Per parser and fault type it reports:
+ *
+ *  - lost messages per fault: messages accepted on the clean stream but not
+ *    on the mutated one, each charged to the closest fault at or before it
+ *  - corrupt messages accepted: messages accepted with different content
+ *    than on the clean stream, which the parser had no way to reject
+ *  - bytes to resync: bytes from a fault to the start of the next message the
+ *    parser accepts intact (0 if the faulted message itself got through)
+ *
+ * The streams are synthetic (Corpus_Generator) or come from the gps and
+ * obc_rx ports of a capture file.
+ *
+ * Usage: bench_faults [options]
+ *   --capture FILE      use the streams of a capture file
+ *   --epochs N          synthetic GPS epochs (default 3600)
+ *   --messages N        synthetic status messages (default 20000)
+ *   --ber P             bit error rate (default 1e-5)
+ *   --drop P            byte drop rate (default 1e-5)
+ *   --dup P             byte duplication rate (default 1e-5)
+ *   --truncate P        message truncation rate (default 1e-3)
+ *   --seed N            fault seed (default 1)
+ *   --format F          csv or json on stdout (default json)
+ */
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "Capture.hpp"
+#include "Corpus_Generator.hpp"
+#include "Fault_Injector.hpp"
+#include "../nmea.hpp"
+#include "../Status_Module.hpp"
+
+namespace{
+	struct Config{
+		const char* capture = NULL;
+		uint32_t epochs = 3600;
+		uint32_t messages = 20000;
+		bool json = true;
+		Fault_Injector::Options faults = Fault_Injector::defaults();
+	};
+
+	/**
+	 * What a parser made of a stream, per source message.
+	 */
+	struct Outcome{
+		std::vector<bool> accepted;
+		/// Parser output for each accepted message
+		std::vector<std::string> content;
+	};
+
+	struct FaultStats{
+		uint32_t count = 0;
+		uint32_t lost = 0;
+		uint32_t corrupt_accepted = 0;
+		/// Faults never followed by an intact message
+		uint32_t unresolved = 0;
+		std::vector<double> resync_bytes;
+	};
+
+	struct Report{
+		const char* parser;
+		uint32_t messages;
+		uint32_t accepted_clean;
+		uint32_t accepted;
+		/// Per FaultType, then all types
+		FaultStats stats[FAULT__SIZE + 1];
+	};
+
+	void usage(const char* name){
+		fprintf(stderr, "Usage: %s [--capture FILE] [--epochs N] "
+			"[--messages N] [--ber P] [--drop P] [--dup P] [--truncate P] "
+			"[--seed N] [--format csv|json]\n", name);
+	}
+
+	double percentile(std::vector<double>& v, double p){
+		if(v.empty()){
+			return 0;
+		}
+		size_t i = (size_t)(p * (v.size() - 1) + 0.5);
+		std::nth_element(v.begin(), v.begin() + i, v.end());
+		return v[i];
+	}
+
+	template<typename Parser, typename Content>
+	Outcome feed(Parser& parser, const Fault_Injector::Result& stream,
+			Content content){
+		Outcome outcome;
+		size_t messages = stream.message_start.size() - 1;
+		outcome.accepted.assign(messages, false);
+		outcome.content.resize(messages);
+		for(size_t i = 0; i < stream.data.size(); i++){
+			if(parser.decode(stream.data[i])){
+				uint32_t m = stream.message_of[i];
+				outcome.accepted[m] = true;
+				outcome.content[m] = content(parser);
+			}
+		}
+		return outcome;
+	}
+
+	std::string nmea_content(NMEA& gps){
+		return gps.sentence();
+	}
+
+	std::string status_content(Status_Module& obc){
+		const StatusPacket& status = obc.getStatus();
+		char buf[32];
+		snprintf(buf, sizeof(buf), "%d %d %d %d", status.storage, status.sdr,
+			status.system, obc.getRequest());
+		return buf;
+	}
+
+	Report analyze(const char* parser, const Outcome& clean,
+			const Outcome& faulty, const Fault_Injector::Result& stream){
+		Report report;
+		report.parser = parser;
+		report.messages = clean.accepted.size();
+		report.accepted_clean = 0;
+		report.accepted = 0;
+		std::vector<bool> intact(report.messages);
+		for(uint32_t m = 0; m < report.messages; m++){
+			report.accepted_clean += clean.accepted[m];
+			report.accepted += faulty.accepted[m];
+			intact[m] = faulty.accepted[m]
+				&& faulty.content[m] == clean.content[m];
+		}
+
+		const std::vector<Fault>& faults = stream.faults;
+		size_t f = 0;
+		// Closest fault at or before each message
+		int64_t last_fault = -1;
+		for(uint32_t m = 0; m < report.messages; m++){
+			bool faulted = false;
+			uint8_t first_type = FAULT__SIZE;
+			while(f < faults.size() && faults[f].message == m){
+				if(!faulted){
+					first_type = faults[f].type;
+				}
+				faulted = true;
+				last_fault = f++;
+			}
+			if(faulted && faulty.accepted[m] && !intact[m]){
+				report.stats[first_type].corrupt_accepted++;
+				report.stats[FAULT__SIZE].corrupt_accepted++;
+			}
+			if(clean.accepted[m] && !faulty.accepted[m] && last_fault >= 0){
+				report.stats[faults[last_fault].type].lost++;
+				report.stats[FAULT__SIZE].lost++;
+			}
+		}
+
+		uint32_t next_intact = 0;
+		for(size_t i = 0; i < faults.size(); i++){
+			const Fault& fault = faults[i];
+			FaultStats& stats = report.stats[fault.type];
+			FaultStats& all = report.stats[FAULT__SIZE];
+			stats.count++;
+			all.count++;
+			if(intact[fault.message]){
+				stats.resync_bytes.push_back(0);
+				all.resync_bytes.push_back(0);
+				continue;
+			}
+			next_intact = std::max(next_intact, fault.message + 1);
+			while(next_intact < report.messages && !intact[next_intact]){
+				next_intact++;
+			}
+			if(next_intact >= report.messages){
+				stats.unresolved++;
+				all.unresolved++;
+				continue;
+			}
+			double bytes = stream.message_start[next_intact] - fault.position;
+			stats.resync_bytes.push_back(bytes);
+			all.resync_bytes.push_back(bytes);
+		}
+		return report;
+	}
+
+	void print_json(Report& report, bool first){
+		printf("%s{\"parser\": \"%s\", \"messages\": %u, \"accepted_clean\": "
+			"%u, \"accepted\": %u, \"faults\": {", first ? "" : ", ",
+			report.parser, report.messages, report.accepted_clean,
+			report.accepted);
+		for(uint8_t t = 0; t <= FAULT__SIZE; t++){
+			FaultStats& s = report.stats[t];
+			double mean = 0;
+			for(size_t i = 0; i < s.resync_bytes.size(); i++){
+				mean += s.resync_bytes[i];
+			}
+			if(!s.resync_bytes.empty()){
+				mean /= s.resync_bytes.size();
+			}
+			printf("%s\"%s\": {\"count\": %u, \"lost\": %u, "
+				"\"lost_per_fault\": %.3f, \"corrupt_accepted\": %u, "
+				"\"unresolved\": %u, \"resync_bytes\": {\"mean\": %.1f, "
+				"\"p50\": %.0f, \"p90\": %.0f, \"p99\": %.0f, \"max\": %.0f}}",
+				t ? ", " : "", t < FAULT__SIZE ? Fault_Injector::name(t) : "all",
+				s.count, s.lost, s.count ? (double)s.lost / s.count : 0,
+				s.corrupt_accepted, s.unresolved, mean,
+				percentile(s.resync_bytes, 0.5), percentile(s.resync_bytes, 0.9),
+				percentile(s.resync_bytes, 0.99),
+				percentile(s.resync_bytes, 1));
+		}
+		printf("}}");
+	}
+
+	void print_csv(Report& report){
+		for(uint8_t t = 0; t <= FAULT__SIZE; t++){
+			FaultStats& s = report.stats[t];
+			printf("%s,%s,%u,%u,%.3f,%u,%u,%.0f,%.0f,%.0f,%.0f\n",
+				report.parser,
+				t < FAULT__SIZE ? Fault_Injector::name(t) : "all", s.count,
+				s.lost, s.count ? (double)s.lost / s.count : 0,
+				s.corrupt_accepted, s.unresolved,
+				percentile(s.resync_bytes, 0.5), percentile(s.resync_bytes, 0.9),
+				percentile(s.resync_bytes, 0.99),
+				percentile(s.resync_bytes, 1));
+		}
+	}
+}
+
+int main(int argc, char const *argv[]){
+	Config cfg;
+	cfg.faults.bit_error_rate = 1e-5;
+	cfg.faults.drop_rate = 1e-5;
+	cfg.faults.duplicate_rate = 1e-5;
+	cfg.faults.truncate_rate = 1e-3;
+	for(int i = 1; i < argc; i++){
+		bool has_value = i + 1 < argc;
+		if(!strcmp(argv[i], "--capture") && has_value){
+			cfg.capture = argv[++i];
+		}else if(!strcmp(argv[i], "--epochs") && has_value){
+			cfg.epochs = atoi(argv[++i]);
+		}else if(!strcmp(argv[i], "--messages") && has_value){
+			cfg.messages = atoi(argv[++i]);
+		}else if(!strcmp(argv[i], "--ber") && has_value){
+			cfg.faults.bit_error_rate = atof(argv[++i]);
+		}else if(!strcmp(argv[i], "--drop") && has_value){
+			cfg.faults.drop_rate = atof(argv[++i]);
+		}else if(!strcmp(argv[i], "--dup") && has_value){
+			cfg.faults.duplicate_rate = atof(argv[++i]);
+		}else if(!strcmp(argv[i], "--truncate") && has_value){
+			cfg.faults.truncate_rate = atof(argv[++i]);
+		}else if(!strcmp(argv[i], "--seed") && has_value){
+			cfg.faults.seed = atoi(argv[++i]);
+		}else if(!strcmp(argv[i], "--format") && has_value){
+			cfg.json = strcmp(argv[++i], "csv") != 0;
+		}else{
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	std::string gps;
+	std::string status;
+	if(cfg.capture != NULL){
+		Capture_Reader capture;
+		if(!capture.open(cfg.capture)){
+			fprintf(stderr, "%s: not a capture file\n", cfg.capture);
+			return 1;
+		}
+		CaptureChunk chunk;
+		while(capture.next(chunk)){
+			if(chunk.port == CAP_PORT_GPS){
+				gps += chunk.data;
+			}else if(chunk.port == CAP_PORT_OBC_RX){
+				status += chunk.data;
+			}
+		}
+		if(capture.error() != NULL){
+			fprintf(stderr, "%s: %s\n", cfg.capture, capture.error());
+			return 1;
+		}
+	}else{
+		Corpus_Generator gen(Corpus_Generator::defaults());
+		gps = gen.gps(cfg.epochs);
+		status = gen.status(cfg.messages);
+	}
+
+	Fault_Injector identity(Fault_Injector::defaults());
+	Fault_Injector injector(cfg.faults);
+	std::vector<Report> reports;
+
+	Fault_Injector::Result clean_stream;
+	Fault_Injector::Result faulty_stream;
+	identity.mutate(gps, clean_stream);
+	injector.mutate(gps, faulty_stream);
+	{
+		NMEA clean_parser(ALL);
+		NMEA faulty_parser(ALL);
+		Outcome clean = feed(clean_parser, clean_stream, nmea_content);
+		Outcome faulty = feed(faulty_parser, faulty_stream, nmea_content);
+		reports.push_back(analyze("NMEA::decode", clean, faulty,
+			faulty_stream));
+	}
+
+	identity.mutate(status, clean_stream);
+	injector.mutate(status, faulty_stream);
+	{
+		Status_Module clean_parser;
+		Status_Module faulty_parser;
+		Outcome clean = feed(clean_parser, clean_stream, status_content);
+		Outcome faulty = feed(faulty_parser, faulty_stream, status_content);
+		reports.push_back(analyze("Status_Module::decode", clean, faulty,
+			faulty_stream));
+	}
+
+	if(cfg.json){
+		printf("{\"gps_bytes\": %zu, \"status_bytes\": %zu, \"ber\": %g, "
+			"\"drop\": %g, \"dup\": %g, \"truncate\": %g, \"parsers\": [",
+			gps.size(), status.size(), cfg.faults.bit_error_rate,
+			cfg.faults.drop_rate, cfg.faults.duplicate_rate,
+			cfg.faults.truncate_rate);
+		for(size_t i = 0; i < reports.size(); i++){
+			print_json(reports[i], i == 0);
+		}
+		printf("]}\n");
+	}else{
+		printf("parser,fault,count,lost,lost_per_fault,corrupt_accepted,"
+			"unresolved,resync_p50,resync_p90,resync_p99,resync_max\n");
+		for(size_t i = 0; i < reports.size(); i++){
+			print_csv(reports[i]);
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,269 @@
+/*
+ * @file bench_latency.cpp
+ *
+ * @description End-to-end latency benchmark for the UIB firmware.
+ *
+ * Runs the firmware's setup() and loop() against the virtual time HAL and
+ * feeds the GPS port a synthetic NMEA stream, byte by byte at the configured
+ * baud rate.  Virtual time advances by the host time each loop() takes
+ * (scaled by --cpu-scale) or by a fixed --loop-ns, and skips ahead while the
+ * firmware is idle.  Reports, per run:
+ *
+ *  - latency from the last byte of each epoch to the sensor packet for that
+ *    epoch being written to the OBC port, in virtual time.  The last byte is
+ *    the final RMC checksum digit; the CR LF after it carries nothing the
+ *    parser waits for.
+ *  - sustained host throughput of the firmware loop in bytes/s and epochs/s
+ *  - dropped epochs (no packet) and bytes lost to GPS RX overruns
+ *
+ * Usage: bench_latency [options]
+ *   --baud N        GPS baud rate (default 9600)
+ *   --rate HZ       fix rate (default 1)
+ *   --epochs N      number of epochs (default 1000)
+ *   --gsv N         GSV sentences per epoch (default 3)
+ *   --no-zda        leave ZDA out of each epoch
+ *   --seed N        satellite view seed (default 1)
+ *   --cpu-scale X   virtual ns per host ns of loop() (default 1)
+ *   --loop-ns N     fixed virtual cost per loop(), for repeatable runs
+ *   --format F      csv or json summary on stdout (default json)
+ *   --epoch-log F   write per-epoch latencies to F as CSV
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "hal_virtual.hpp"
+#include "NMEA_Generator.hpp"
+
+void setup();
+void loop();
+
+namespace{
+	struct Config{
+		uint32_t baud = 9600;
+		uint32_t epochs = 1000;
+		double cpu_scale = 1;
+		uint64_t loop_ns = 0;
+		bool json = true;
+		const char* epoch_log = NULL;
+		NMEA_Generator::Options gen = NMEA_Generator::defaults();
+	};
+
+	struct Epoch{
+		std::string time;
+		uint64_t first_ns;
+		uint64_t last_ns;
+		int64_t latency_ns;
+	};
+
+	double percentile(std::vector<double>& v, double p){
+		if(v.empty()){
+			return 0;
+		}
+		size_t i = (size_t)(p * (v.size() - 1) + 0.5);
+		std::nth_element(v.begin(), v.begin() + i, v.end());
+		return v[i];
+	}
+
+	/**
+	 * Extracts the "tme" value of a sensor packet, or "" for other lines.
+	 */
+	std::string packet_time(const std::string& line){
+		if(line.compare(0, 8, "{\"lat\": ") != 0){
+			return "";
+		}
+		size_t start = line.find("\"tme\": \"");
+		if(start == std::string::npos){
+			return "";
+		}
+		start += 8;
+		return line.substr(start, line.find('"', start) - start);
+	}
+
+	void usage(const char* name){
+		fprintf(stderr, "Usage: %s [--baud N] [--rate HZ] [--epochs N] "
+			"[--gsv N] [--no-zda] [--seed N] [--cpu-scale X] [--loop-ns N] "
+			"[--format csv|json] [--epoch-log FILE]\n", name);
+	}
+}
+
+int main(int argc, char const *argv[]){
+	Config cfg;
+	for(int i = 1; i < argc; i++){
+		const char* arg = argv[i];
+		bool has_value = i + 1 < argc;
+		if(!strcmp(arg, "--baud") && has_value){
+			cfg.baud = atoi(argv[++i]);
+		}else if(!strcmp(arg, "--rate") && has_value){
+			cfg.gen.rate_hz = atof(argv[++i]);
+		}else if(!strcmp(arg, "--epochs") && has_value){
+			cfg.epochs = atoi(argv[++i]);
+		}else if(!strcmp(arg, "--gsv") && has_value){
+			cfg.gen.gsv_sentences = atoi(argv[++i]);
+		}else if(!strcmp(arg, "--no-zda")){
+			cfg.gen.zda = false;
+		}else if(!strcmp(arg, "--seed") && has_value){
+			cfg.gen.seed = atoi(argv[++i]);
+		}else if(!strcmp(arg, "--cpu-scale") && has_value){
+			cfg.cpu_scale = atof(argv[++i]);
+		}else if(!strcmp(arg, "--loop-ns") && has_value){
+			cfg.loop_ns = strtoull(argv[++i], NULL, 10);
+		}else if(!strcmp(arg, "--format") && has_value){
+			cfg.json = strcmp(argv[++i], "csv") != 0;
+		}else if(!strcmp(arg, "--epoch-log") && has_value){
+			cfg.epoch_log = argv[++i];
+		}else{
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if(cfg.baud == 0 || cfg.gen.rate_hz <= 0){
+		usage(argv[0]);
+		return 1;
+	}
+
+	RCT_Virtual_SetInput(10, HIGH);
+	setup();
+	virtual_obc.reset();
+
+	// Lay the stream out on the wire: each epoch starts on its fix period,
+	// or as soon as the previous one has finished if the link is saturated
+	NMEA_Generator gen(cfg.gen);
+	const uint64_t byte_ns = 10ULL * 1000000000ULL / cfg.baud;
+	const uint64_t period_ns = (uint64_t)(1e9 / cfg.gen.rate_hz);
+	const uint64_t start_ns = RCT_Virtual_Now();
+	std::string stream;
+	std::vector<uint64_t> arrival;
+	std::vector<Epoch> epochs(cfg.epochs);
+	std::map<std::string, uint32_t> by_time;
+	uint64_t line_free = start_ns;
+	for(uint32_t e = 0; e < cfg.epochs; e++){
+		std::string bytes = gen.epoch(e, &epochs[e].time);
+		uint64_t t = std::max(start_ns + e * period_ns, line_free);
+		epochs[e].first_ns = t + byte_ns;
+		for(size_t i = 0; i < bytes.size(); i++){
+			t += byte_ns;
+			arrival.push_back(t);
+		}
+		epochs[e].last_ns = t - 2 * byte_ns;
+		epochs[e].latency_ns = -1;
+		line_free = t;
+		stream += bytes;
+		by_time[epochs[e].time] = e;
+	}
+
+	// Run until the stream is consumed, plus one fix period to drain
+	size_t next_byte = 0;
+	uint64_t host_ns = 0;
+	uint64_t loops = 0;
+	const uint64_t end_ns = line_free + period_ns;
+	std::vector<std::string> lines;
+	while(RCT_Virtual_Now() < end_ns){
+		uint64_t now = RCT_Virtual_Now();
+		while(next_byte < stream.size() && arrival[next_byte] <= now){
+			virtual_gps.receive(stream[next_byte++]);
+		}
+
+		auto t0 = std::chrono::steady_clock::now();
+		loop();
+		auto t1 = std::chrono::steady_clock::now();
+		uint64_t dt = std::chrono::duration_cast<std::chrono::nanoseconds>(
+			t1 - t0).count();
+		host_ns += dt;
+		loops++;
+		RCT_Virtual_Advance(cfg.loop_ns ? cfg.loop_ns
+			: (uint64_t)(dt * cfg.cpu_scale) + 1);
+
+		virtual_obc.takeLines(lines);
+		for(size_t i = 0; i < lines.size(); i++){
+			std::map<std::string, uint32_t>::iterator it =
+				by_time.find(packet_time(lines[i]));
+			if(it != by_time.end() && epochs[it->second].latency_ns < 0){
+				epochs[it->second].latency_ns =
+					RCT_Virtual_Now() - epochs[it->second].last_ns;
+			}
+		}
+		lines.clear();
+
+		// Skip idle time up to the next byte
+		if(virtual_gps.available() == 0 && virtual_obc.available() == 0){
+			uint64_t next = (next_byte < stream.size()) ? arrival[next_byte]
+				: end_ns;
+			if(next > RCT_Virtual_Now()){
+				RCT_Virtual_Advance(next - RCT_Virtual_Now());
+			}
+		}
+	}
+
+	std::vector<double> latency_us;
+	uint32_t dropped = 0;
+	for(uint32_t e = 0; e < cfg.epochs; e++){
+		if(epochs[e].latency_ns < 0){
+			dropped++;
+		}else{
+			latency_us.push_back(epochs[e].latency_ns / 1e3);
+		}
+	}
+	double mean = 0;
+	double max = 0;
+	for(size_t i = 0; i < latency_us.size(); i++){
+		mean += latency_us[i];
+		max = std::max(max, latency_us[i]);
+	}
+	if(!latency_us.empty()){
+		mean /= latency_us.size();
+	}
+	double host_s = host_ns / 1e9;
+	double bytes_per_s = host_s > 0 ? stream.size() / host_s : 0;
+	double epochs_per_s = host_s > 0 ? cfg.epochs / host_s : 0;
+	double link_load = (double)stream.size() * byte_ns
+		/ (cfg.epochs * (double)period_ns);
+	double p50 = percentile(latency_us, 0.5);
+	double p99 = percentile(latency_us, 0.99);
+
+	if(cfg.epoch_log != NULL){
+		std::ofstream log(cfg.epoch_log);
+		log << "epoch,time,first_byte_us,last_byte_us,latency_us\n";
+		for(uint32_t e = 0; e < cfg.epochs; e++){
+			log << e << "," << epochs[e].time << ","
+				<< (epochs[e].first_ns - start_ns) / 1e3 << ","
+				<< (epochs[e].last_ns - start_ns) / 1e3 << ",";
+			if(epochs[e].latency_ns >= 0){
+				log << epochs[e].latency_ns / 1e3;
+			}
+			log << "\n";
+		}
+	}
+
+	if(cfg.json){
+		printf("{\"baud\": %u, \"rate_hz\": %g, \"gsv\": %u, \"zda\": %s, "
+			"\"epochs\": %u, \"bytes\": %zu, \"link_load\": %.3f, "
+			"\"loops\": %llu, \"packets\": %zu, \"dropped_epochs\": %u, "
+			"\"rx_overrun_bytes\": %u, \"latency_us\": {\"min\": %.3f, "
+			"\"mean\": %.3f, \"p50\": %.3f, \"p99\": %.3f, \"max\": %.3f}, "
+			"\"host_bytes_per_s\": %.0f, \"host_epochs_per_s\": %.0f}\n",
+			cfg.baud, cfg.gen.rate_hz, cfg.gen.gsv_sentences,
+			cfg.gen.zda ? "true" : "false", cfg.epochs, stream.size(),
+			link_load, (unsigned long long)loops, latency_us.size(), dropped,
+			virtual_gps.dropped(), percentile(latency_us, 0), mean, p50, p99,
+			max, bytes_per_s, epochs_per_s);
+	}else{
+		printf("baud,rate_hz,gsv,zda,epochs,bytes,link_load,loops,packets,"
+			"dropped_epochs,rx_overrun_bytes,latency_min_us,latency_mean_us,"
+			"latency_p50_us,latency_p99_us,latency_max_us,host_bytes_per_s,"
+			"host_epochs_per_s\n");
+		printf("%u,%g,%u,%d,%u,%zu,%.3f,%llu,%zu,%u,%u,%.3f,%.3f,%.3f,%.3f,"
+			"%.3f,%.0f,%.0f\n", cfg.baud, cfg.gen.rate_hz,
+			cfg.gen.gsv_sentences, cfg.gen.zda, cfg.epochs, stream.size(),
+			link_load, (unsigned long long)loops, latency_us.size(), dropped,
+			virtual_gps.dropped(), percentile(latency_us, 0), mean, p50, p99,
+			max, bytes_per_s, epochs_per_s);
+	}
+	return 0;
+}
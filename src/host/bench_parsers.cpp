@@ -0,0 +1,284 @@
+/*
+ * @file bench_parsers.cpp
+ *
+ * @description Throughput benchmark for the firmware's stream parsers.
+ *
+ * Generates a GPS corpus and an OBC status corpus with Corpus_Generator, then
+ * feeds them byte by byte to NMEA::decode, Sensor_Module::decode and
+ * Status_Module::decode, compiled from the firmware sources for the host.
+ * Each parser runs --repeat times on a freshly constructed instance; per
+ * parser it reports:
+ *
+ *  - bytes/s and ns per byte, for the fastest and the median run
+ *  - messages accepted per run against messages in the corpus
+ *  - heap allocations per message while decoding, and in the constructor
+ *    (the latter counts the instance itself).  The firmware heap is a few
+ *    hundred bytes, so anything but 0 per message is a bug.
+ *
+ * Allocations are counted by interposing malloc, so this needs glibc.
+ *
+ * Usage: bench_parsers [options]
+ *   --epochs N          GPS epochs in the corpus (default 3600)
+ *   --messages N        status messages in the corpus (default 100000)
+ *   --repeat N          runs per parser (default 5)
+ *   --constellations N  constellations in view, 1-3 (default 3)
+ *   --gsv N             GSV sentences per constellation (default 3)
+ *   --error-rate P      probability of a corrupted message (default 0)
+ *   --noise-rate P      probability of a noise burst after a message
+ *                       (default 0)
+ *   --seed N            corpus seed (default 1)
+ *   --format F          csv or json on stdout (default json)
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "Corpus_Generator.hpp"
+#include "hal_virtual.hpp"
+#include "../ui_core.hpp"
+#include "../nmea.hpp"
+#include "../Sensor_Module.hpp"
+#include "../Status_Module.hpp"
+
+RCT_HAL_System_t systemDescriptor;
+RCT_HAL_System_t* pHALSystem = &systemDescriptor;
+
+void timer_tick(void){
+}
+
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t n, size_t size);
+extern "C" void* __libc_realloc(void* ptr, size_t size);
+extern "C" void __libc_free(void* ptr);
+
+namespace{
+	bool counting = false;
+	uint64_t allocations = 0;
+}
+
+extern "C" void* malloc(size_t size){
+	if(counting){
+		allocations++;
+	}
+	return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t n, size_t size){
+	if(counting){
+		allocations++;
+	}
+	return __libc_calloc(n, size);
+}
+
+extern "C" void* realloc(void* ptr, size_t size){
+	if(counting){
+		allocations++;
+	}
+	return __libc_realloc(ptr, size);
+}
+
+extern "C" void free(void* ptr){
+	__libc_free(ptr);
+}
+
+namespace{
+	struct Config{
+		uint32_t epochs = 3600;
+		uint32_t messages = 100000;
+		uint32_t repeat = 5;
+		bool json = true;
+		Corpus_Generator::Options corpus = Corpus_Generator::defaults();
+	};
+
+	struct Result{
+		const char* parser;
+		uint64_t bytes;
+		/// Messages in the corpus
+		uint32_t messages;
+		/// Messages the parser completed, per run
+		uint64_t accepted;
+		uint64_t setup_allocations;
+		uint64_t allocations;
+		/// Run times in ns, sorted
+		std::vector<double> run_ns;
+	};
+
+	void usage(const char* name){
+		fprintf(stderr, "Usage: %s [--epochs N] [--messages N] [--repeat N] "
+			"[--constellations N] [--gsv N] [--error-rate P] "
+			"[--noise-rate P] [--seed N] [--format csv|json]\n", name);
+	}
+
+	/**
+	 * Times a parser over a corpus.  Parser is constructed by make() outside
+	 * of the timed region, then fed the corpus by feed(), which returns the
+	 * number of messages completed.
+	 */
+	template<typename Make, typename Feed>
+	Result run(const char* parser, const std::string& corpus,
+			uint32_t messages, uint32_t repeat, Make make, Feed feed){
+		Result result;
+		result.parser = parser;
+		result.bytes = corpus.size();
+		result.messages = messages;
+		result.accepted = 0;
+		result.allocations = 0;
+		for(uint32_t r = 0; r < repeat; r++){
+			allocations = 0;
+			counting = true;
+			auto instance = make();
+			counting = false;
+			result.setup_allocations = allocations;
+
+			allocations = 0;
+			counting = true;
+			auto start = std::chrono::steady_clock::now();
+			uint64_t accepted = feed(*instance, corpus);
+			auto stop = std::chrono::steady_clock::now();
+			counting = false;
+
+			result.allocations += allocations;
+			result.accepted = accepted;
+			result.run_ns.push_back(
+				std::chrono::duration<double, std::nano>(stop - start).count());
+			delete instance;
+		}
+		std::sort(result.run_ns.begin(), result.run_ns.end());
+		return result;
+	}
+
+	uint64_t feed_nmea(NMEA& gps, const std::string& corpus){
+		uint64_t accepted = 0;
+		for(size_t i = 0; i < corpus.size(); i++){
+			accepted += gps.decode(corpus[i]);
+		}
+		return accepted;
+	}
+
+	StatusPacket sensor_status;
+
+	uint64_t feed_sensor(Sensor_Module& sensor, const std::string& corpus){
+		uint64_t accepted = 0;
+		for(size_t i = 0; i < corpus.size(); i++){
+			accepted += sensor.decode(corpus[i]) ? 1 : 0;
+		}
+		return accepted;
+	}
+
+	uint64_t feed_status(Status_Module& obc, const std::string& corpus){
+		uint64_t accepted = 0;
+		for(size_t i = 0; i < corpus.size(); i++){
+			accepted += obc.decode(corpus[i]);
+		}
+		return accepted;
+	}
+}
+
+int main(int argc, char const *argv[]){
+	Config cfg;
+	for(int i = 1; i < argc; i++){
+		bool has_value = i + 1 < argc;
+		if(!strcmp(argv[i], "--epochs") && has_value){
+			cfg.epochs = atoi(argv[++i]);
+		}else if(!strcmp(argv[i], "--messages") && has_value){
+			cfg.messages = atoi(argv[++i]);
+		}else if(!strcmp(argv[i], "--repeat") && has_value){
+			cfg.repeat = atoi(argv[++i]);
+		}else if(!strcmp(argv[i], "--constellations") && has_value){
+			cfg.corpus.gps.constellations = atoi(argv[++i]);
+		}else if(!strcmp(argv[i], "--gsv") && has_value){
+			cfg.corpus.gps.gsv_sentences = atoi(argv[++i]);
+		}else if(!strcmp(argv[i], "--error-rate") && has_value){
+			cfg.corpus.error_rate = atof(argv[++i]);
+		}else if(!strcmp(argv[i], "--noise-rate") && has_value){
+			cfg.corpus.noise_rate = atof(argv[++i]);
+		}else if(!strcmp(argv[i], "--seed") && has_value){
+			cfg.corpus.seed = atoi(argv[++i]);
+			cfg.corpus.gps.seed = cfg.corpus.seed;
+		}else if(!strcmp(argv[i], "--format") && has_value){
+			cfg.json = strcmp(argv[++i], "csv") != 0;
+		}else{
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if(cfg.repeat == 0){
+		usage(argv[0]);
+		return 1;
+	}
+
+	RCT_HAL_Init(pHALSystem);
+	Corpus_Generator gen(cfg.corpus);
+	Corpus_Generator::Stats gps_stats;
+	Corpus_Generator::Stats status_stats;
+	std::string gps = gen.gps(cfg.epochs, &gps_stats);
+	std::string status = gen.status(cfg.messages, &status_stats);
+
+	std::vector<Result> results;
+	results.push_back(run("NMEA::decode", gps, gps_stats.messages, cfg.repeat,
+		[](){ return new NMEA(ALL); }, feed_nmea));
+	// Sensor_Module completes a message per RMC, one per epoch
+	results.push_back(run("Sensor_Module::decode", gps, cfg.epochs,
+		cfg.repeat, [](){
+			Sensor_Module* sensor = new Sensor_Module(&sensor_status.gps);
+			sensor->start();
+			// Bring the compass up as the main loop would, so that every
+			// RMC and GGA times the compass read as well
+			for(uint8_t i = 0; i < 16 && !sensor->compassReady(); i++){
+				sensor->service();
+			}
+			if(!sensor->compassReady()){
+				fprintf(stderr, "Sensor_Module: compass did not come up\n");
+				exit(1);
+			}
+			return sensor;
+		}, feed_sensor));
+	results.push_back(run("Status_Module::decode", status,
+		status_stats.messages, cfg.repeat,
+		[](){ return new Status_Module(); }, feed_status));
+
+	if(cfg.json){
+		printf("{\"epochs\": %u, \"constellations\": %u, \"gsv\": %u, "
+			"\"error_rate\": %g, \"noise_rate\": %g, \"repeat\": %u, "
+			"\"gps_corrupted\": %u, \"status_corrupted\": %u, "
+			"\"noise_bursts\": %u, \"parsers\": [", cfg.epochs,
+			cfg.corpus.gps.constellations, cfg.corpus.gps.gsv_sentences,
+			cfg.corpus.error_rate, cfg.corpus.noise_rate, cfg.repeat,
+			gps_stats.corrupted, status_stats.corrupted,
+			gps_stats.noise_bursts + status_stats.noise_bursts);
+	}else{
+		printf("parser,bytes,messages,accepted,bytes_per_s,ns_per_byte_min,"
+			"ns_per_byte_p50,allocs_per_message,setup_allocs\n");
+	}
+	for(size_t i = 0; i < results.size(); i++){
+		const Result& r = results[i];
+		double best = r.run_ns.front();
+		double p50 = r.run_ns[r.run_ns.size() / 2];
+		double bytes_per_s = best > 0 ? r.bytes / (best / 1e9) : 0;
+		double allocs = r.messages ? (double)r.allocations
+			/ ((double)r.messages * cfg.repeat) : 0;
+		if(cfg.json){
+			printf("%s{\"parser\": \"%s\", \"bytes\": %llu, \"messages\": %u, "
+				"\"accepted\": %llu, \"bytes_per_s\": %.0f, "
+				"\"ns_per_byte\": {\"min\": %.3f, \"p50\": %.3f}, "
+				"\"allocs_per_message\": %.3f, \"setup_allocs\": %llu}",
+				i ? ", " : "", r.parser, (unsigned long long)r.bytes,
+				r.messages, (unsigned long long)r.accepted, bytes_per_s,
+				best / r.bytes, p50 / r.bytes, allocs,
+				(unsigned long long)r.setup_allocations);
+		}else{
+			printf("%s,%llu,%u,%llu,%.0f,%.3f,%.3f,%.3f,%llu\n", r.parser,
+				(unsigned long long)r.bytes, r.messages,
+				(unsigned long long)r.accepted, bytes_per_s, best / r.bytes,
+				p50 / r.bytes, allocs, (unsigned long long)r.setup_allocations);
+		}
+	}
+	if(cfg.json){
+		printf("]}\n");
+	}
+	return 0;
+}
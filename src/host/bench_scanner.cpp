@@ -0,0 +1,450 @@
+/*
+ * @file bench_scanner.cpp
+ *
+ * @description Checks NMEA_Scanner against NMEA::decode and compares their
+ * throughput.
+ *
+ * The check feeds each corpus to NMEA::decode one byte at a time and to the
+ * scanner with every instruction set this CPU supports, both in one call and
+ * in random sized pieces with the unfinished sentence carried over.  Every
+ * accepted sentence, each of its terms and the three counters must come out
+ * identical.  The corpora are:
+ *
+ *  - clean: multi-constellation receiver output (Corpus_Generator)
+ *  - faulty: the same with corrupted sentences, noise bursts and bit errors,
+ *    drops, duplicates and truncations (Fault_Injector)
+ *  - adversarial: random sentences built to hit the parser's edge cases:
+ *    terms and sentences around the runaway limits, too many terms, stray
+ *    '$', CR and LF, lowercase and invalid checksum digits, missing checksums
+ *    and bytes with bit 7 set
+ *
+ * Throughput is then measured on the clean corpus.
+ *
+ * Usage: bench_scanner [options]
+ *   --mb N        size of the throughput corpus in MB (default 64)
+ *   --seed N      seed of the faulty and adversarial corpora (default 1)
+ *   --verify      only run the check
+ *   --format F    csv or json on stdout (default json)
+ *
+ * Exits with 1 if the scanner disagrees with NMEA::decode.
+ */
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "Corpus_Generator.hpp"
+#include "Fault_Injector.hpp"
+#include "NMEA_Scanner.hpp"
+#include "../nmea.hpp"
+
+namespace{
+	struct Config{
+		uint32_t mb = 64;
+		uint32_t seed = 1;
+		bool verify_only = false;
+		bool json = true;
+	};
+
+	/**
+	 * What a parser made of a corpus.  Each accepted sentence is recorded as
+	 * the sentence and its terms, as the C strings NMEA::sentence() and
+	 * NMEA::term() would return.
+	 */
+	struct Result{
+		std::vector<std::string> sentences;
+		unsigned accepted = 0;
+		unsigned checksum_errors = 0;
+		unsigned runaway_resets = 0;
+	};
+
+	struct Check{
+		const char* corpus;
+		size_t bytes;
+		unsigned sentences;
+		unsigned checksum_errors;
+		unsigned runaway_resets;
+		/// Scanner runs that disagreed with NMEA::decode
+		unsigned mismatches;
+	};
+
+	struct Timing{
+		std::string name;
+		double mb_s;
+		unsigned sentences;
+	};
+
+	void usage(const char* name){
+		fprintf(stderr, "Usage: %s [--mb N] [--seed N] [--verify] "
+			"[--format csv|json]\n", name);
+	}
+
+	double now_s(){
+		return std::chrono::duration<double>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	class Random{
+	public:
+		Random(uint32_t seed) : state(seed ? seed : 1){
+		}
+
+		uint32_t next(){
+			state ^= state << 13;
+			state ^= state >> 17;
+			state ^= state << 5;
+			return state;
+		}
+
+		uint32_t below(uint32_t n){
+			return next() % n;
+		}
+
+	private:
+		uint32_t state;
+	};
+
+	void append_hex(std::string& out, uint8_t v, bool lower){
+		const char* digits = lower ? "0123456789abcdef" : "0123456789ABCDEF";
+		out += digits[v >> 4];
+		out += digits[v & 0xF];
+	}
+
+	std::string adversarial(uint32_t seed, size_t bytes){
+		static const char TERM_CHARS[] = "0123456789ABCDEFGLNPSW.-";
+		static const char BAD_DIGITS[] = "0123456789ABCDEFGabcdefz:;@*,";
+		Random rng(seed);
+		std::string out;
+		while(out.size() < bytes){
+			if(rng.below(100) < 5){
+				uint32_t noise = 1 + rng.below(40);
+				for(uint32_t i = 0; i < noise; i++){
+					out += (char)rng.below(256);
+				}
+			}
+
+			std::string body;
+			uint32_t terms = 1 + rng.below(34);
+			for(uint32_t t = 0; t < terms; t++){
+				if(t){
+					body += ',';
+				}
+				uint32_t length = (rng.below(10) == 0) ? 12 + rng.below(6)
+					: rng.below(9);
+				for(uint32_t i = 0; i < length; i++){
+					uint32_t r = rng.below(1000);
+					if(r < 10){
+						body += (char)(0x80 | rng.below(128));
+					}else if(r < 12){
+						body += "$\r\n"[rng.below(3)];
+					}else{
+						body += TERM_CHARS[rng.below(sizeof(TERM_CHARS) - 1)];
+					}
+				}
+			}
+			uint8_t parity = 0;
+			for(size_t i = 0; i < body.size(); i++){
+				parity ^= body[i];
+			}
+
+			out += '$';
+			out += body;
+			uint32_t r = rng.below(100);
+			if(r < 70){
+				out += '*';
+				append_hex(out, parity, false);
+			}else if(r < 80){
+				out += '*';
+				append_hex(out, parity, true);
+			}else if(r < 90){
+				out += '*';
+				out += BAD_DIGITS[rng.below(sizeof(BAD_DIGITS) - 1)];
+				out += BAD_DIGITS[rng.below(sizeof(BAD_DIGITS) - 1)];
+			}else if(r < 95){
+				out += '*';
+				append_hex(out, parity, false);
+				out.resize(out.size() - 1);
+			}
+			r = rng.below(100);
+			out += (r < 80) ? "\r\n" : (r < 90) ? "\n" : (r < 95) ? "\r" : "";
+		}
+		return out;
+	}
+
+	void reference(const std::string& corpus, Result& result){
+		NMEA gps(ALL);
+		for(size_t i = 0; i < corpus.size(); i++){
+			if(gps.decode(corpus[i])){
+				std::string s = gps.sentence();
+				for(int t = 0; t < gps.terms(); t++){
+					s += '\x1F';
+					s += gps.term(t);
+				}
+				result.sentences.push_back(s);
+			}
+		}
+		result.accepted = gps.sentences();
+		result.checksum_errors = gps.checksum_errors();
+		result.runaway_resets = gps.runaway_resets();
+	}
+
+	/**
+	 * Records the scanner's sentences as reference() does, cutting strings
+	 * at a NUL like the parser's C strings.
+	 */
+	void record(const char* buf, const std::vector<NMEA_Scanner::Sentence>& found,
+			Result& result){
+		for(size_t i = 0; i < found.size(); i++){
+			const NMEA_Scanner::Sentence& sentence = found[i];
+			std::string s(buf + sentence.begin, sentence.length);
+			s = s.c_str();
+			for(uint8_t t = 0; t < sentence.terms; t++){
+				size_t len;
+				const char* term = NMEA_Scanner::term(buf, sentence, t, &len);
+				s += '\x1F';
+				s += std::string(term, len).c_str();
+			}
+			result.sentences.push_back(s);
+		}
+	}
+
+	void scan_whole(NMEA_Scanner& scanner, const std::string& corpus,
+			Result& result){
+		std::vector<NMEA_Scanner::Sentence> found;
+		scanner.scan(corpus.data(), corpus.size(), found);
+		record(corpus.data(), found, result);
+	}
+
+	void scan_pieces(NMEA_Scanner& scanner, const std::string& corpus,
+			uint32_t seed, Result& result){
+		Random rng(seed);
+		std::vector<NMEA_Scanner::Sentence> found;
+		std::string piece;
+		size_t i = 0;
+		while(i < corpus.size()){
+			size_t n = 1 + rng.below((rng.below(4) == 0) ? 8 : 4096);
+			n = (n < corpus.size() - i) ? n : corpus.size() - i;
+			piece.append(corpus, i, n);
+			i += n;
+			found.clear();
+			size_t resume = scanner.scan(piece.data(), piece.size(), found);
+			record(piece.data(), found, result);
+			piece.erase(0, resume);
+		}
+	}
+
+	void finish(const NMEA_Scanner& scanner, Result& result){
+		result.accepted = scanner.sentences();
+		result.checksum_errors = scanner.checksum_errors();
+		result.runaway_resets = scanner.runaway_resets();
+	}
+
+	std::string printable(const std::string& s){
+		std::string out;
+		for(size_t i = 0; i < s.size(); i++){
+			unsigned char c = s[i];
+			if(c == 0x1F){
+				out += " | ";
+			}else if(c < 0x20 || c >= 0x7F || c == '\\'){
+				char hex[8];
+				snprintf(hex, sizeof(hex), "\\x%02X", c);
+				out += hex;
+			}else{
+				out += c;
+			}
+		}
+		return out;
+	}
+
+	bool same(const char* corpus, const char* run, const Result& expected,
+			const Result& actual){
+		if(expected.accepted != actual.accepted
+				|| expected.checksum_errors != actual.checksum_errors
+				|| expected.runaway_resets != actual.runaway_resets){
+			fprintf(stderr, "%s, %s: counters %u/%u/%u, expected %u/%u/%u\n",
+				corpus, run, actual.accepted, actual.checksum_errors,
+				actual.runaway_resets, expected.accepted,
+				expected.checksum_errors, expected.runaway_resets);
+			return false;
+		}
+		const std::vector<std::string>& want = expected.sentences;
+		const std::vector<std::string>& got = actual.sentences;
+		size_t i = 0;
+		while(i < want.size() && i < got.size() && want[i] == got[i]){
+			i++;
+		}
+		if(i == want.size() && i == got.size()){
+			return true;
+		}
+		fprintf(stderr, "%s, %s: sentence %zu is\n  %s\nexpected\n  %s\n",
+			corpus, run, i,
+			i < got.size() ? printable(got[i]).c_str() : "(none)",
+			i < want.size() ? printable(want[i]).c_str() : "(none)");
+		return false;
+	}
+
+	Check check(const char* name, const std::string& corpus, uint32_t seed){
+		Result expected;
+		reference(corpus, expected);
+		Check result = {name, corpus.size(), expected.accepted,
+			expected.checksum_errors, expected.runaway_resets, 0};
+		for(int isa = 0; isa < NMEA_Scanner::ISA__SIZE; isa++){
+			if(!NMEA_Scanner::supported((NMEA_Scanner::Isa)isa)){
+				continue;
+			}
+			std::string run = NMEA_Scanner::name((NMEA_Scanner::Isa)isa);
+			NMEA_Scanner whole((NMEA_Scanner::Isa)isa);
+			Result actual;
+			scan_whole(whole, corpus, actual);
+			finish(whole, actual);
+			result.mismatches += !same(name, run.c_str(), expected, actual);
+
+			NMEA_Scanner pieces((NMEA_Scanner::Isa)isa);
+			Result carried;
+			scan_pieces(pieces, corpus, seed + isa, carried);
+			finish(pieces, carried);
+			run += " in pieces";
+			result.mismatches += !same(name, run.c_str(), expected, carried);
+		}
+		return result;
+	}
+
+	Timing time_decode(const std::string& corpus){
+		Timing timing = {"NMEA::decode", 0, 0};
+		double best = 1e9;
+		for(int r = 0; r < 3; r++){
+			NMEA gps(ALL);
+			double start = now_s();
+			for(size_t i = 0; i < corpus.size(); i++){
+				gps.decode(corpus[i]);
+			}
+			double elapsed = now_s() - start;
+			best = (elapsed < best) ? elapsed : best;
+			timing.sentences = gps.sentences();
+		}
+		timing.mb_s = corpus.size() / best / 1e6;
+		return timing;
+	}
+
+	Timing time_scanner(const std::string& corpus, NMEA_Scanner::Isa isa){
+		Timing timing = {std::string("NMEA_Scanner/") + NMEA_Scanner::name(isa),
+			0, 0};
+		std::vector<NMEA_Scanner::Sentence> found;
+		found.reserve(corpus.size() / 40);
+		double best = 1e9;
+		for(int r = 0; r < 3; r++){
+			NMEA_Scanner scanner(isa);
+			found.clear();
+			double start = now_s();
+			scanner.scan(corpus.data(), corpus.size(), found);
+			double elapsed = now_s() - start;
+			best = (elapsed < best) ? elapsed : best;
+			timing.sentences = scanner.sentences();
+		}
+		timing.mb_s = corpus.size() / best / 1e6;
+		return timing;
+	}
+}
+
+int main(int argc, char const *argv[]){
+	Config cfg;
+	for(int i = 1; i < argc; i++){
+		bool has_value = i + 1 < argc;
+		if(!strcmp(argv[i], "--mb") && has_value){
+			cfg.mb = atoi(argv[++i]);
+		}else if(!strcmp(argv[i], "--seed") && has_value){
+			cfg.seed = atoi(argv[++i]);
+		}else if(!strcmp(argv[i], "--verify")){
+			cfg.verify_only = true;
+		}else if(!strcmp(argv[i], "--format") && has_value){
+			cfg.json = strcmp(argv[++i], "csv") != 0;
+		}else{
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	Corpus_Generator::Options options = Corpus_Generator::defaults();
+	Corpus_Generator clean_gen(options);
+	std::string clean = clean_gen.gps(2000);
+
+	options.error_rate = 0.02;
+	options.noise_rate = 0.02;
+	options.noise_max = 64;
+	options.seed = cfg.seed;
+	Corpus_Generator noisy_gen(options);
+	Fault_Injector::Options fault_options = Fault_Injector::defaults();
+	fault_options.bit_error_rate = 1e-3;
+	fault_options.drop_rate = 1e-3;
+	fault_options.duplicate_rate = 1e-3;
+	fault_options.truncate_rate = 1e-2;
+	fault_options.seed = cfg.seed;
+	Fault_Injector injector(fault_options);
+	Fault_Injector::Result faulty;
+	injector.mutate(noisy_gen.gps(2000), faulty);
+
+	std::vector<Check> checks;
+	checks.push_back(check("clean", clean, cfg.seed));
+	checks.push_back(check("faulty", faulty.data, cfg.seed));
+	checks.push_back(check("adversarial", adversarial(cfg.seed, 4 << 20),
+		cfg.seed));
+	unsigned mismatches = 0;
+	for(size_t i = 0; i < checks.size(); i++){
+		mismatches += checks[i].mismatches;
+	}
+
+	std::vector<Timing> timings;
+	std::string corpus;
+	if(!cfg.verify_only){
+		corpus.reserve((size_t)cfg.mb << 20);
+		while(corpus.size() < ((size_t)cfg.mb << 20)){
+			corpus += clean;
+		}
+		timings.push_back(time_decode(corpus));
+		for(int isa = 0; isa < NMEA_Scanner::ISA__SIZE; isa++){
+			if(NMEA_Scanner::supported((NMEA_Scanner::Isa)isa)){
+				timings.push_back(time_scanner(corpus,
+					(NMEA_Scanner::Isa)isa));
+			}
+		}
+	}
+
+	if(cfg.json){
+		printf("{\"best_isa\": \"%s\", \"checks\": [",
+			NMEA_Scanner::name(NMEA_Scanner::best()));
+		for(size_t i = 0; i < checks.size(); i++){
+			const Check& c = checks[i];
+			printf("%s{\"corpus\": \"%s\", \"bytes\": %zu, \"sentences\": %u, "
+				"\"checksum_errors\": %u, \"runaway_resets\": %u, "
+				"\"mismatches\": %u}", i ? ", " : "", c.corpus, c.bytes,
+				c.sentences, c.checksum_errors, c.runaway_resets, c.mismatches);
+		}
+		printf("], \"bytes\": %zu, \"throughput\": [", corpus.size());
+		for(size_t i = 0; i < timings.size(); i++){
+			printf("%s{\"parser\": \"%s\", \"sentences\": %u, \"mb_s\": %.1f, "
+				"\"speedup\": %.1f}", i ? ", " : "", timings[i].name.c_str(),
+				timings[i].sentences, timings[i].mb_s,
+				timings[i].mb_s / timings[0].mb_s);
+		}
+		printf("]}\n");
+	}else{
+		printf("corpus,bytes,sentences,checksum_errors,runaway_resets,"
+			"mismatches\n");
+		for(size_t i = 0; i < checks.size(); i++){
+			const Check& c = checks[i];
+			printf("%s,%zu,%u,%u,%u,%u\n", c.corpus, c.bytes, c.sentences,
+				c.checksum_errors, c.runaway_resets, c.mismatches);
+		}
+		if(!timings.empty()){
+			printf("\nparser,sentences,mb_s,speedup\n");
+		}
+		for(size_t i = 0; i < timings.size(); i++){
+			printf("%s,%u,%.1f,%.1f\n", timings[i].name.c_str(),
+				timings[i].sentences, timings[i].mb_s,
+				timings[i].mb_s / timings[0].mb_s);
+		}
+	}
+	return mismatches ? 1 : 0;
+}
@@ -0,0 +1,153 @@
+/*
+ * @file hal_fleet.cpp
+ *
+ * @description Radio Telemetry Tracker UI Core - fleet HAL backend
+ *
+ * HAL backend for running several simulated UIBs in one process.  Time is the
+ * host's monotonic clock, shared by every UIB; the devices are per thread.
+ * There is no system tick, as the fleet does not run the LED engine.
+ *
+ *
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <time.h>
+#include "hal_fleet.hpp"
+#include "../ui_core.hpp"
+#include "../HMC5983.hpp"
+
+static uint64_t start_ns = 0;
+static thread_local RCT_Fleet_Devices* devices = NULL;
+
+static uint64_t monotonic_ns(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void fleet_begin(uint32_t baud){
+	(void)baud;
+}
+
+static uint8_t fleet_i2c_write(uint8_t addr, const uint8_t* data, uint8_t len){
+	if(devices == NULL || addr != HMC5983_ADDRESS || !devices->compass_present){
+		return 2;	// NACK on address, as Wire reports it
+	}
+	return devices->compass.write(data, len);
+}
+
+static uint8_t fleet_i2c_read(uint8_t addr, uint8_t* data, uint8_t len){
+	if(devices == NULL || addr != HMC5983_ADDRESS || !devices->compass_present){
+		return 0;
+	}
+	return devices->compass.read(data, len);
+}
+
+static void fleet_pin_mode(uint8_t pin, uint8_t mode){
+	if(devices != NULL && pin < HAL_FLEET_PINS && mode == INPUT_PULLUP){
+		devices->pin_levels[pin] = HIGH;
+	}
+}
+
+static int fleet_digital_read(uint8_t pin){
+	return (devices != NULL && pin < HAL_FLEET_PINS)
+		? devices->pin_levels[pin] : LOW;
+}
+
+static void fleet_digital_write(uint8_t pin, uint8_t value){
+	if(devices != NULL && pin < HAL_FLEET_PINS){
+		devices->pin_levels[pin] = value;
+	}
+}
+
+static void fleet_attach_interrupt(uint8_t pin, void (*isr)(void), int mode){
+	(void)pin;
+	(void)isr;
+	(void)mode;
+}
+
+static uint16_t fleet_read_vcc(void){
+	return (devices != NULL) ? devices->vcc_mv : 0;
+}
+
+static void fleet_eeprom_read(uint16_t addr, void* data, uint16_t len){
+	// The fleet UIBs have no EEPROM; it reads erased
+	(void)addr;
+	memset(data, 0xFF, len);
+}
+
+static void fleet_eeprom_write(uint16_t addr, const void* data, uint16_t len){
+	(void)addr;
+	(void)data;
+	(void)len;
+}
+
+static uint32_t fleet_millis(void){
+	return (monotonic_ns() - start_ns) / 1000000ULL;
+}
+
+static uint32_t fleet_micros(void){
+	return (monotonic_ns() - start_ns) / 1000ULL;
+}
+
+static void fleet_delay(uint32_t ms){
+	struct timespec ts;
+	ts.tv_sec = ms / 1000;
+	ts.tv_nsec = (ms % 1000) * 1000000L;
+	nanosleep(&ts, NULL);
+}
+
+static void fleet_start_tick(void){
+}
+
+static void fleet_watchdog_start(void){
+	// Each UIB is a thread of one process; there is nothing to reset
+}
+
+static void fleet_watchdog_kick(void){
+}
+
+static uint8_t fleet_reset_flags(void){
+	return RCT_RESET_POWER_ON;
+}
+
+void RCT_Fleet_Bind(RCT_Fleet_Devices* bound){
+	devices = bound;
+}
+
+void RCT_HAL_Init(RCT_HAL_System_t* system){
+	start_ns = monotonic_ns();
+	// Each UIB's OBC link belongs to its thread, and the GPS stream is fed to
+	// the parser directly
+	system->RCT_SerialOBC = NULL;
+	system->RCT_SerialGPS = NULL;
+	system->RCT_BeginOBC = fleet_begin;
+	system->RCT_BeginGPS = fleet_begin;
+	system->RCT_I2CWrite = fleet_i2c_write;
+	system->RCT_I2CRead = fleet_i2c_read;
+	system->RCT_PinMode = fleet_pin_mode;
+	system->RCT_DigitalRead = fleet_digital_read;
+	system->RCT_DigitalWrite = fleet_digital_write;
+	system->RCT_AttachInterrupt = fleet_attach_interrupt;
+	system->RCT_ReadVCC = fleet_read_vcc;
+	system->RCT_EEPROMRead = fleet_eeprom_read;
+	system->RCT_EEPROMWrite = fleet_eeprom_write;
+	system->RCT_Millis = fleet_millis;
+	system->RCT_Micros = fleet_micros;
+	system->RCT_Delay = fleet_delay;
+	system->RCT_StartTick = fleet_start_tick;
+	system->RCT_WatchdogStart = fleet_watchdog_start;
+	system->RCT_WatchdogKick = fleet_watchdog_kick;
+	system->RCT_ResetFlags = fleet_reset_flags;
+}
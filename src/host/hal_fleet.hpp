@@ -0,0 +1,36 @@
+#ifndef __HAL_FLEET__
+#define __HAL_FLEET__
+/*! \file */
+#include <Arduino.h>
+#include "PTY_Stream.hpp"
+#include "HMC5983_Sim.hpp"
+
+/**
+ * Number of GPIO pins modelled per UIB.
+ */
+#define HAL_FLEET_PINS 32
+
+/**
+ * Simulated devices of one UIB in a fleet.  The HAL is a single global
+ * descriptor, so the fleet backend routes every device access to the devices
+ * bound to the calling thread; each UIB runs on its own thread.
+ */
+typedef struct RCT_Fleet_Devices{
+	/// OBC link
+	PTY_Stream obc;
+	HMC5983_Sim compass;
+	/// Whether the compass answers on the I2C bus
+	bool compass_present;
+	/// Simulated supply rail in mV
+	uint16_t vcc_mv;
+	uint8_t pin_levels[HAL_FLEET_PINS];
+} RCT_Fleet_Devices;
+
+/**
+ * Binds a UIB's devices to the calling thread.  HAL calls from the thread
+ * before this is called, or with NULL, see no devices.
+ * @param devices Devices of the UIB run by this thread
+ */
+void RCT_Fleet_Bind(RCT_Fleet_Devices* devices);
+
+#endif
@@ -0,0 +1,378 @@
+/*
+ * @file hal_linux.cpp
+ *
+ * @description Radio Telemetry Tracker UI Core - Linux HAL backend
+ *
+ *
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <poll.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+#include "hal_linux.hpp"
+#include "../ui_core.hpp"
+#include "../HMC5983.hpp"
+
+RCT_Linux_Options linux_options = {NULL, NULL, true, false, 5000, false, NULL,
+	NULL, 0};
+
+PTY_Stream linux_obc;
+PTY_Stream linux_gps;
+HMC5983_Sim linux_compass;
+Capture_Writer linux_capture;
+
+// Bounds of the RCT_NOINIT variables, provided by the linker.  Weak, so that
+// programs without any still link.
+extern "C" {
+	extern uint8_t __start_rct_noinit[] __attribute__((weak));
+	extern uint8_t __stop_rct_noinit[] __attribute__((weak));
+}
+
+/**
+ * Board state that outlives a reset.  It is shared with every firmware
+ * process, so that a reset can be a new process like it is a new run of the
+ * firmware on the UIB.
+ */
+typedef struct Linux_Board{
+	uint8_t eeprom[RCT_EEPROM_SIZE];
+	/// RCT_RESET_* flags of the last reset
+	uint8_t reset_flags;
+	/// Number of bytes in noinit, 0 if the RAM did not survive
+	uint32_t noinit_len;
+	uint8_t noinit[HAL_LINUX_NOINIT_MAX];
+} Linux_Board;
+
+static Linux_Board* board = NULL;
+static uint64_t power_ns = 0;
+static uint64_t start_ns = 0;
+static uint64_t next_tick_ns = 0;
+static bool tick_running = false;
+/// Set by every watchdog kick
+static volatile sig_atomic_t watchdog_kicked = 0;
+static uint8_t pin_modes[HAL_LINUX_PINS];
+static uint8_t pin_levels[HAL_LINUX_PINS];
+static uint8_t reset_flags = 0;
+
+static uint64_t monotonic_ns(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void linux_begin_obc(uint32_t baud){
+	// The PTY carries bytes at memory speed, so the baud rate is ignored
+	(void)baud;
+}
+
+static void linux_begin_gps(uint32_t baud){
+	(void)baud;
+}
+
+/**
+ * Stands in for a wedged I2C bus once linux_options.i2c_hang_ms has passed:
+ * the transaction never completes.
+ */
+static void linux_i2c_hang(void){
+	if(linux_options.i2c_hang_ms == 0
+			|| monotonic_ns() - start_ns
+				< linux_options.i2c_hang_ms * 1000000ULL){
+		return;
+	}
+	for(;;){
+		pause();
+	}
+}
+
+static uint8_t linux_i2c_write(uint8_t addr, const uint8_t* data, uint8_t len){
+	linux_i2c_hang();
+	if(addr != HMC5983_ADDRESS || !linux_options.compass_present){
+		return 2;	// NACK on address, as Wire reports it
+	}
+	return linux_compass.write(data, len);
+}
+
+static uint8_t linux_i2c_read(uint8_t addr, uint8_t* data, uint8_t len){
+	linux_i2c_hang();
+	if(addr != HMC5983_ADDRESS || !linux_options.compass_present){
+		return 0;
+	}
+	return linux_compass.read(data, len);
+}
+
+static void linux_pin_mode(uint8_t pin, uint8_t mode){
+	if(pin < HAL_LINUX_PINS){
+		pin_modes[pin] = mode;
+		if(mode == INPUT_PULLUP){
+			pin_levels[pin] = HIGH;
+		}
+	}
+}
+
+static int linux_digital_read(uint8_t pin){
+	return (pin < HAL_LINUX_PINS) ? pin_levels[pin] : LOW;
+}
+
+static void linux_digital_write(uint8_t pin, uint8_t value){
+	if(pin >= HAL_LINUX_PINS || pin_levels[pin] == value){
+		return;
+	}
+	pin_levels[pin] = value;
+	if(linux_options.trace_gpio){
+		fprintf(stderr, "%u ms: D%u %s\n",
+			(unsigned)((monotonic_ns() - start_ns) / 1000000ULL), pin,
+			value ? "HIGH" : "LOW");
+	}
+}
+
+static void linux_attach_interrupt(uint8_t pin, void (*isr)(void), int mode){
+	// The simulated compass has no DRDY line
+	(void)pin;
+	(void)isr;
+	(void)mode;
+}
+
+static uint16_t linux_read_vcc(void){
+	return linux_options.vcc_mv;
+}
+
+static void linux_eeprom_read(uint16_t addr, void* data, uint16_t len){
+	for(uint16_t i = 0; i < len; i++){
+		((uint8_t*)data)[i] = board->eeprom[(addr + i) % RCT_EEPROM_SIZE];
+	}
+}
+
+static void linux_eeprom_write(uint16_t addr, const void* data, uint16_t len){
+	for(uint16_t i = 0; i < len; i++){
+		board->eeprom[(addr + i) % RCT_EEPROM_SIZE] = ((const uint8_t*)data)[i];
+	}
+	if(linux_options.eeprom != NULL){
+		FILE* f = fopen(linux_options.eeprom, "wb");
+		if(f == NULL
+				|| fwrite(board->eeprom, sizeof(board->eeprom), 1, f) != 1){
+			perror(linux_options.eeprom);
+		}
+		if(f != NULL){
+			fclose(f);
+		}
+	}
+}
+
+static uint64_t linux_capture_clock(void){
+	return (monotonic_ns() - power_ns) / 1000ULL;
+}
+
+static uint32_t linux_millis(void){
+	return (monotonic_ns() - start_ns) / 1000000ULL;
+}
+
+static uint32_t linux_micros(void){
+	return (monotonic_ns() - start_ns) / 1000ULL;
+}
+
+static void linux_delay(uint32_t ms){
+	uint64_t until = monotonic_ns() + ms * 1000000ULL;
+	uint64_t now;
+	while((now = monotonic_ns()) < until){
+		uint64_t wait = until - now;
+		if(tick_running && next_tick_ns - now < wait){
+			wait = (next_tick_ns > now) ? next_tick_ns - now : 0;
+		}
+		struct timespec ts = {(time_t)(wait / 1000000000ULL),
+			(long)(wait % 1000000000ULL)};
+		nanosleep(&ts, NULL);
+		RCT_Linux_Service();
+	}
+}
+
+static void linux_start_tick(void){
+	next_tick_ns = monotonic_ns() + HAL_LINUX_TICK_MS * 1000000ULL;
+	tick_running = true;
+}
+
+static void linux_watchdog_expired(int sig){
+	(void)sig;
+	// On the UIB the tick interrupt keeps running while loop() is stuck, so
+	// run the ticks loop() has missed: they may still kick the watchdog, and
+	// they leave Watchdog::stuck() what it would see on the hardware
+	watchdog_kicked = 0;
+	RCT_Linux_Service();
+	if(watchdog_kicked){
+		return;
+	}
+	watchdog_expired();
+	RCT_Linux_Reset(RCT_RESET_WATCHDOG);
+}
+
+static void linux_watchdog_kick(void){
+	watchdog_kicked = 1;
+	struct itimerval timeout = {{0, 0},
+		{RCT_WATCHDOG_MS / 1000, (RCT_WATCHDOG_MS % 1000) * 1000}};
+	setitimer(ITIMER_REAL, &timeout, NULL);
+}
+
+static void linux_watchdog_start(void){
+	// A real signal rather than a check in RCT_Linux_Service(), so that it
+	// still fires while loop() is stuck
+	signal(SIGALRM, linux_watchdog_expired);
+	linux_watchdog_kick();
+}
+
+static uint8_t linux_reset_flags(void){
+	return reset_flags;
+}
+
+void RCT_Linux_SetInput(uint8_t pin, uint8_t value){
+	if(pin < HAL_LINUX_PINS){
+		pin_levels[pin] = value;
+	}
+}
+
+void RCT_Linux_Service(void){
+	if(!tick_running){
+		return;
+	}
+	uint64_t now = monotonic_ns();
+	while(now >= next_tick_ns){
+		uint8_t sreg = SREG;
+		cli();
+		timer_tick();
+		SREG = sreg;
+		next_tick_ns += HAL_LINUX_TICK_MS * 1000000ULL;
+	}
+}
+
+void RCT_Linux_Wait(uint32_t max_ms){
+	if(linux_obc.available() > 0 || linux_gps.available() > 0){
+		return;
+	}
+	uint64_t now = monotonic_ns();
+	uint64_t wait = max_ms * 1000000ULL;
+	if(tick_running){
+		uint64_t to_tick = (next_tick_ns > now) ? next_tick_ns - now : 0;
+		if(to_tick < wait){
+			wait = to_tick;
+		}
+	}
+	struct pollfd fds[2] = {
+		{linux_obc.fd(), POLLIN, 0},
+		{linux_gps.fd(), POLLIN, 0}
+	};
+	poll(fds, 2, (wait + 999999ULL) / 1000000ULL);
+}
+
+void RCT_Linux_PowerOn(void){
+	if(board != NULL){
+		return;
+	}
+	board = (Linux_Board*)mmap(NULL, sizeof(Linux_Board),
+		PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if(board == MAP_FAILED){
+		perror("board");
+		exit(1);
+	}
+	power_ns = monotonic_ns();
+	board->reset_flags = RCT_RESET_POWER_ON;
+	board->noinit_len = 0;
+
+	// An erased EEPROM reads all ones
+	memset(board->eeprom, 0xFF, sizeof(board->eeprom));
+	if(linux_options.eeprom != NULL){
+		FILE* f = fopen(linux_options.eeprom, "rb");
+		if(f != NULL){
+			if(fread(board->eeprom, 1, sizeof(board->eeprom), f)
+					!= sizeof(board->eeprom)){
+				memset(board->eeprom, 0xFF, sizeof(board->eeprom));
+			}
+			fclose(f);
+		}
+	}
+
+	if(linux_obc.fd() < 0 && !linux_obc.open(linux_options.obc_link)){
+		perror("OBC PTY");
+		exit(1);
+	}
+	if(linux_gps.fd() < 0 && !linux_gps.open(linux_options.gps_link)){
+		perror("GPS PTY");
+		exit(1);
+	}
+}
+
+void RCT_Linux_Reset(uint8_t flags){
+	size_t len = __stop_rct_noinit - __start_rct_noinit;
+	if(board != NULL && len <= sizeof(board->noinit)){
+		memcpy(board->noinit, __start_rct_noinit, len);
+		board->noinit_len = len;
+		board->reset_flags = flags;
+	}
+	// The capture's timestamps are relative to the last chunk this process
+	// wrote, so the next process cannot carry it on
+	linux_capture.close();
+	_exit(HAL_LINUX_RESET_EXIT);
+}
+
+void RCT_HAL_Init(RCT_HAL_System_t* system){
+	bool power_on = board == NULL;
+	RCT_Linux_PowerOn();
+	start_ns = monotonic_ns();
+	memset(pin_modes, INPUT, sizeof(pin_modes));
+	memset(pin_levels, LOW, sizeof(pin_levels));
+	RCT_Linux_SetInput(10, linux_options.run_switch ? HIGH : LOW);
+
+	reset_flags = board->reset_flags;
+	size_t len = __stop_rct_noinit - __start_rct_noinit;
+	if(board->noinit_len == len && len != 0){
+		memcpy(__start_rct_noinit, board->noinit, len);
+	}
+	board->noinit_len = 0;
+	power_on = power_on || reset_flags == RCT_RESET_POWER_ON;
+
+	if(linux_options.record != NULL && power_on){
+		struct timeval tv;
+		gettimeofday(&tv, NULL);
+		if(!linux_capture.open(linux_options.record,
+				tv.tv_sec * 1000000ULL + tv.tv_usec)){
+			perror(linux_options.record);
+			exit(1);
+		}
+		linux_obc.record(&linux_capture, CAP_PORT_OBC_RX, CAP_PORT_OBC_TX,
+			linux_capture_clock);
+		linux_gps.record(&linux_capture, CAP_PORT_GPS, CAP_PORT_GPS_TX,
+			linux_capture_clock);
+	}
+
+	system->RCT_SerialOBC = &linux_obc;
+	system->RCT_SerialGPS = &linux_gps;
+	system->RCT_BeginOBC = linux_begin_obc;
+	system->RCT_BeginGPS = linux_begin_gps;
+	system->RCT_I2CWrite = linux_i2c_write;
+	system->RCT_I2CRead = linux_i2c_read;
+	system->RCT_PinMode = linux_pin_mode;
+	system->RCT_DigitalRead = linux_digital_read;
+	system->RCT_DigitalWrite = linux_digital_write;
+	system->RCT_AttachInterrupt = linux_attach_interrupt;
+	system->RCT_ReadVCC = linux_read_vcc;
+	system->RCT_EEPROMRead = linux_eeprom_read;
+	system->RCT_EEPROMWrite = linux_eeprom_write;
+	system->RCT_Millis = linux_millis;
+	system->RCT_Micros = linux_micros;
+	system->RCT_Delay = linux_delay;
+	system->RCT_StartTick = linux_start_tick;
+	system->RCT_WatchdogStart = linux_watchdog_start;
+	system->RCT_WatchdogKick = linux_watchdog_kick;
+	system->RCT_ResetFlags = linux_reset_flags;
+}
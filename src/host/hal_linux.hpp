@@ -0,0 +1,98 @@
+#ifndef __HAL_LINUX__
+#define __HAL_LINUX__
+/*! \file */
+#include <Arduino.h>
+#include "PTY_Stream.hpp"
+#include "HMC5983_Sim.hpp"
+
+/**
+ * Number of GPIO pins modelled by the Linux backend.
+ */
+#define HAL_LINUX_PINS 32
+
+/**
+ * Period of the system tick in ms, matching Timer 1 on the UIB.
+ */
+#define HAL_LINUX_TICK_MS 200
+
+/**
+ * Most bytes of RCT_NOINIT variables kept across a reset.
+ */
+#define HAL_LINUX_NOINIT_MAX 512
+
+/**
+ * Exit status of a firmware process that was reset, see RCT_Linux_Reset().
+ */
+#define HAL_LINUX_RESET_EXIT 42
+
+/**
+ * Options for the Linux HAL backend.  Set before RCT_HAL_Init() is called.
+ */
+typedef struct RCT_Linux_Options{
+	/// Path to symlink to the OBC PTY, or NULL
+	const char* obc_link;
+	/// Path to symlink to the GPS PTY, or NULL
+	const char* gps_link;
+	/// Whether the simulated compass answers on the I2C bus
+	bool compass_present;
+	/// Initial level of the run switch
+	bool run_switch;
+	/// Simulated supply rail in mV
+	uint16_t vcc_mv;
+	/// Log GPIO output changes to stderr
+	bool trace_gpio;
+	/// Capture file to record both links to, or NULL
+	const char* record;
+	/// File backing the EEPROM, or NULL to start erased every run
+	const char* eeprom;
+	/// Time after each reset at which I2C transactions stop completing, in
+	/// ms; 0 for never
+	uint32_t i2c_hang_ms;
+} RCT_Linux_Options;
+
+extern RCT_Linux_Options linux_options;
+
+/**
+ * Simulated devices, for host tools that drive the model directly.
+ */
+extern PTY_Stream linux_obc;
+extern PTY_Stream linux_gps;
+extern HMC5983_Sim linux_compass;
+extern Capture_Writer linux_capture;
+
+/**
+ * Sets up the parts of the simulated UIB that outlive a reset: the PTYs and
+ * the EEPROM.  RCT_HAL_Init() calls this if it has not been called yet; a
+ * program that runs the firmware in a new process after every reset calls it
+ * once beforehand.
+ */
+void RCT_Linux_PowerOn(void);
+
+/**
+ * Resets the firmware.  The RCT_NOINIT variables are handed to the next
+ * firmware process, and this process exits with HAL_LINUX_RESET_EXIT.  Meant
+ * to be called from a signal handler, as the watchdog and reset button do.
+ * @param flags RCT_RESET_* cause of the reset
+ */
+void RCT_Linux_Reset(uint8_t flags);
+
+/**
+ * Sets the level of an input pin, as seen by RCT_DigitalRead().
+ * @param pin   Arduino pin number
+ * @param value HIGH or LOW
+ */
+void RCT_Linux_SetInput(uint8_t pin, uint8_t value);
+
+/**
+ * Delivers any system ticks that have come due.  Stands in for the timer
+ * interrupt, so it must be called between loop() iterations.
+ */
+void RCT_Linux_Service(void);
+
+/**
+ * Waits until either serial port has data or the next system tick is due.
+ * @param max_ms Longest time to wait in ms
+ */
+void RCT_Linux_Wait(uint32_t max_ms);
+
+#endif
@@ -0,0 +1,172 @@
+/*
+ * @file hal_virtual.cpp
+ *
+ * @description Radio Telemetry Tracker UI Core - virtual time HAL backend
+ *
+ * HAL backend for host harnesses.  Time only advances when the harness says
+ * so, and the serial ports are in-memory rings, so runs are repeatable and
+ * can go faster than real time.
+ *
+ *
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "hal_virtual.hpp"
+#include "../ui_core.hpp"
+#include "../HMC5983.hpp"
+
+#define HAL_VIRTUAL_PINS 32
+
+Bench_Stream virtual_obc;
+Bench_Stream virtual_gps;
+HMC5983_Sim virtual_compass;
+
+static uint64_t now_ns = 0;
+static uint64_t next_tick_ns = 0;
+static bool tick_running = false;
+static uint8_t pin_levels[HAL_VIRTUAL_PINS];
+static uint8_t eeprom[RCT_EEPROM_SIZE];
+
+static void virtual_begin(uint32_t baud){
+	(void)baud;
+}
+
+static uint8_t virtual_i2c_write(uint8_t addr, const uint8_t* data, uint8_t len){
+	if(addr != HMC5983_ADDRESS){
+		return 2;	// NACK on address, as Wire reports it
+	}
+	return virtual_compass.write(data, len);
+}
+
+static uint8_t virtual_i2c_read(uint8_t addr, uint8_t* data, uint8_t len){
+	if(addr != HMC5983_ADDRESS){
+		return 0;
+	}
+	return virtual_compass.read(data, len);
+}
+
+static void virtual_pin_mode(uint8_t pin, uint8_t mode){
+	if(pin < HAL_VIRTUAL_PINS && mode == INPUT_PULLUP){
+		pin_levels[pin] = HIGH;
+	}
+}
+
+static int virtual_digital_read(uint8_t pin){
+	return (pin < HAL_VIRTUAL_PINS) ? pin_levels[pin] : LOW;
+}
+
+static void virtual_digital_write(uint8_t pin, uint8_t value){
+	if(pin < HAL_VIRTUAL_PINS){
+		pin_levels[pin] = value;
+	}
+}
+
+static void virtual_attach_interrupt(uint8_t pin, void (*isr)(void), int mode){
+	(void)pin;
+	(void)isr;
+	(void)mode;
+}
+
+static uint16_t virtual_read_vcc(void){
+	return 5000;
+}
+
+static void virtual_eeprom_read(uint16_t addr, void* data, uint16_t len){
+	for(uint16_t i = 0; i < len; i++){
+		((uint8_t*)data)[i] = eeprom[(addr + i) % RCT_EEPROM_SIZE];
+	}
+}
+
+static void virtual_eeprom_write(uint16_t addr, const void* data, uint16_t len){
+	for(uint16_t i = 0; i < len; i++){
+		eeprom[(addr + i) % RCT_EEPROM_SIZE] = ((const uint8_t*)data)[i];
+	}
+}
+
+static uint32_t virtual_millis(void){
+	return now_ns / 1000000ULL;
+}
+
+static uint32_t virtual_micros(void){
+	return now_ns / 1000ULL;
+}
+
+static void virtual_delay(uint32_t ms){
+	RCT_Virtual_Advance(ms * 1000000ULL);
+}
+
+static void virtual_start_tick(void){
+	next_tick_ns = now_ns + HAL_VIRTUAL_TICK_NS;
+	tick_running = true;
+}
+
+static void virtual_watchdog_start(void){
+	// Virtual time only moves when the benchmark says so, so a stuck loop
+	// would never run the watchdog out
+}
+
+static void virtual_watchdog_kick(void){
+}
+
+static uint8_t virtual_reset_flags(void){
+	return RCT_RESET_POWER_ON;
+}
+
+uint64_t RCT_Virtual_Now(void){
+	return now_ns;
+}
+
+void RCT_Virtual_Advance(uint64_t ns){
+	uint64_t until = now_ns + ns;
+	while(tick_running && next_tick_ns <= until){
+		now_ns = next_tick_ns;
+		uint8_t sreg = SREG;
+		cli();
+		timer_tick();
+		SREG = sreg;
+		next_tick_ns += HAL_VIRTUAL_TICK_NS;
+	}
+	now_ns = until;
+}
+
+void RCT_Virtual_SetInput(uint8_t pin, uint8_t value){
+	if(pin < HAL_VIRTUAL_PINS){
+		pin_levels[pin] = value;
+	}
+}
+
+void RCT_HAL_Init(RCT_HAL_System_t* system){
+	// An erased EEPROM reads all ones
+	memset(eeprom, 0xFF, sizeof(eeprom));
+	system->RCT_SerialOBC = &virtual_obc;
+	system->RCT_SerialGPS = &virtual_gps;
+	system->RCT_BeginOBC = virtual_begin;
+	system->RCT_BeginGPS = virtual_begin;
+	system->RCT_I2CWrite = virtual_i2c_write;
+	system->RCT_I2CRead = virtual_i2c_read;
+	system->RCT_PinMode = virtual_pin_mode;
+	system->RCT_DigitalRead = virtual_digital_read;
+	system->RCT_DigitalWrite = virtual_digital_write;
+	system->RCT_AttachInterrupt = virtual_attach_interrupt;
+	system->RCT_ReadVCC = virtual_read_vcc;
+	system->RCT_EEPROMRead = virtual_eeprom_read;
+	system->RCT_EEPROMWrite = virtual_eeprom_write;
+	system->RCT_Millis = virtual_millis;
+	system->RCT_Micros = virtual_micros;
+	system->RCT_Delay = virtual_delay;
+	system->RCT_StartTick = virtual_start_tick;
+	system->RCT_WatchdogStart = virtual_watchdog_start;
+	system->RCT_WatchdogKick = virtual_watchdog_kick;
+	system->RCT_ResetFlags = virtual_reset_flags;
+}
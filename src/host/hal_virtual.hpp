@@ -0,0 +1,41 @@
+#ifndef __HAL_VIRTUAL__
+#define __HAL_VIRTUAL__
+/*! \file */
+#include <Arduino.h>
+#include "Bench_Stream.hpp"
+#include "HMC5983_Sim.hpp"
+
+/**
+ * Period of the system tick in ns, matching Timer 1 on the UIB.
+ */
+#define HAL_VIRTUAL_TICK_NS 200000000ULL
+
+/**
+ * Simulated devices behind the virtual time HAL backend.  Harnesses feed the
+ * serial ports and read back the OBC output directly.
+ */
+extern Bench_Stream virtual_obc;
+extern Bench_Stream virtual_gps;
+extern HMC5983_Sim virtual_compass;
+
+/**
+ * Current virtual time in ns.  RCT_Millis() and RCT_Micros() report this
+ * clock, and it only moves when the harness advances it.
+ */
+uint64_t RCT_Virtual_Now(void);
+
+/**
+ * Advances virtual time, delivering every system tick that falls in the
+ * interval.  RCT_Delay() advances the clock the same way.
+ * @param ns Time to advance by in ns
+ */
+void RCT_Virtual_Advance(uint64_t ns);
+
+/**
+ * Sets the level of an input pin, as seen by RCT_DigitalRead().
+ * @param pin   Arduino pin number
+ * @param value HIGH or LOW
+ */
+void RCT_Virtual_SetInput(uint8_t pin, uint8_t value);
+
+#endif
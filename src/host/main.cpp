@@ -0,0 +1,152 @@
+/*
+ * @file main.cpp
+ *
+ * @description Radio Telemetry Tracker UI Core - native process entry point
+ *
+ * Runs the unmodified firmware setup() and loop() against the Linux HAL
+ * backend.  The OBC and GPS links are pseudo terminals; connect an OBC client
+ * and a GPS source (or a recorded NMEA log) to the printed devices.
+ *
+ * The firmware runs in a child process, and a reset starts a new one, so that
+ * only RCT_NOINIT variables and the EEPROM carry over as on the UIB.  SIGHUP
+ * presses the reset button.
+ *
+ *
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <errno.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "hal_linux.hpp"
+#include "../ui_core.hpp"
+
+void setup();
+void loop();
+
+static volatile sig_atomic_t running = 1;
+/// Current firmware process, in the parent; 0 in the firmware itself
+static volatile pid_t firmware = 0;
+
+static void stop(int sig){
+	running = 0;
+	if(firmware > 0){
+		kill(firmware, sig);
+	}
+}
+
+static void reset_button(int sig){
+	if(firmware > 0){
+		kill(firmware, sig);
+	}else{
+		RCT_Linux_Reset(RCT_RESET_EXTERNAL);
+	}
+}
+
+/**
+ * Runs the firmware until it is stopped or reset.
+ */
+static void run_firmware(void){
+	setup();
+	while(running){
+		loop();
+		RCT_Linux_Service();
+		// Short enough for raw compass batches at the 220 Hz data rate
+		RCT_Linux_Wait(1);
+	}
+	linux_capture.close();
+}
+
+static void usage(const char* name){
+	fprintf(stderr,
+		"Usage: %s [options]\n"
+		"  --obc PATH      symlink the OBC serial PTY to PATH\n"
+		"  --gps PATH      symlink the GPS serial PTY to PATH\n"
+		"  --heading DEG   simulated compass heading (default 0)\n"
+		"  --no-compass    leave the compass off the I2C bus\n"
+		"  --run           start with the run switch on\n"
+		"  --vcc MV        simulated 5V rail in mV (default 5000)\n"
+		"  --gpio          log GPIO output changes\n"
+		"  --record FILE   capture both links to FILE\n"
+		"  --eeprom FILE   keep the EEPROM in FILE across runs\n"
+		"  --i2c-hang S    wedge the I2C bus S s after each reset\n", name);
+}
+
+int main(int argc, char** argv){
+	double heading = 0;
+	for(int i = 1; i < argc; i++){
+		const char* arg = argv[i];
+		bool has_value = i + 1 < argc;
+		if(!strcmp(arg, "--obc") && has_value){
+			linux_options.obc_link = argv[++i];
+		}else if(!strcmp(arg, "--gps") && has_value){
+			linux_options.gps_link = argv[++i];
+		}else if(!strcmp(arg, "--heading") && has_value){
+			heading = atof(argv[++i]);
+		}else if(!strcmp(arg, "--no-compass")){
+			linux_options.compass_present = false;
+		}else if(!strcmp(arg, "--run")){
+			linux_options.run_switch = true;
+		}else if(!strcmp(arg, "--vcc") && has_value){
+			linux_options.vcc_mv = atoi(argv[++i]);
+		}else if(!strcmp(arg, "--gpio")){
+			linux_options.trace_gpio = true;
+		}else if(!strcmp(arg, "--record") && has_value){
+			linux_options.record = argv[++i];
+		}else if(!strcmp(arg, "--eeprom") && has_value){
+			linux_options.eeprom = argv[++i];
+		}else if(!strcmp(arg, "--i2c-hang") && has_value){
+			linux_options.i2c_hang_ms = atof(argv[++i]) * 1000;
+		}else{
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	signal(SIGINT, stop);
+	signal(SIGTERM, stop);
+	signal(SIGPIPE, SIG_IGN);
+	signal(SIGHUP, reset_button);
+
+	linux_compass.setHeading(heading);
+
+	RCT_Linux_PowerOn();
+	fprintf(stderr, "OBC: %s\nGPS: %s\n", linux_obc.name(), linux_gps.name());
+
+	while(running){
+		pid_t pid = fork();
+		if(pid < 0){
+			perror("fork");
+			break;
+		}
+		if(pid == 0){
+			run_firmware();
+			_exit(0);
+		}
+		firmware = pid;
+		int status;
+		while(waitpid(pid, &status, 0) < 0 && errno == EINTR){
+		}
+		firmware = 0;
+		if(!WIFEXITED(status) || WEXITSTATUS(status) != HAL_LINUX_RESET_EXIT){
+			break;
+		}
+		fprintf(stderr, "Reset\n");
+	}
+
+	linux_obc.close();
+	linux_gps.close();
+	return 0;
+}
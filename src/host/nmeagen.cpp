@@ -0,0 +1,58 @@
+/*
+ * @file nmeagen.cpp
+ *
+ * @description Writes a synthetic GPS receiver stream.
+ *
+ * Usage: nmeagen [--epochs N] [--rate HZ] [--gsv N] [--no-zda] [--seed N]
+ *                [--multi-gnss] [--constellations N]
+ *
+ * Writes N epochs (default 60) from NMEA_Generator to stdout, for scripting
+ * into the firmware under simbench or through the host build's GPS PTY.
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "NMEA_Generator.hpp"
+
+int main(int argc, char const *argv[]){
+	NMEA_Generator::Options options = NMEA_Generator::defaults();
+	uint32_t epochs = 60;
+	for(int i = 1; i < argc; i++){
+		bool has_value = i + 1 < argc;
+		if(!strcmp(argv[i], "--epochs") && has_value){
+			epochs = atoi(argv[++i]);
+		}else if(!strcmp(argv[i], "--rate") && has_value){
+			options.rate_hz = atof(argv[++i]);
+		}else if(!strcmp(argv[i], "--gsv") && has_value){
+			options.gsv_sentences = atoi(argv[++i]);
+		}else if(!strcmp(argv[i], "--no-zda")){
+			options.zda = false;
+		}else if(!strcmp(argv[i], "--seed") && has_value){
+			options.seed = atoi(argv[++i]);
+		}else if(!strcmp(argv[i], "--multi-gnss")){
+			NMEA_Generator::Options multi = NMEA_Generator::multi_gnss();
+			options.constellations = multi.constellations;
+			options.gsa = multi.gsa;
+			options.vtg = multi.vtg;
+		}else if(!strcmp(argv[i], "--constellations") && has_value){
+			options.constellations = atoi(argv[++i]);
+		}else{
+			fprintf(stderr, "Usage: %s [--epochs N] [--rate HZ] [--gsv N] "
+				"[--no-zda] [--seed N] [--multi-gnss] [--constellations N]\n",
+				argv[0]);
+			return 1;
+		}
+	}
+	if(options.rate_hz <= 0){
+		return 1;
+	}
+
+	NMEA_Generator gen(options);
+	for(uint32_t e = 0; e < epochs; e++){
+		std::string epoch = gen.epoch(e);
+		fwrite(epoch.data(), 1, epoch.size(), stdout);
+	}
+	return 0;
+}
@@ -0,0 +1,697 @@
+/*
+ * @file rctbridge.cpp
+ *
+ * @description OBC side bridge to the UIB.  Owns the UIB's serial port,
+ * parses each sensor packet once and publishes it into a shared memory ring
+ * (Pose_Ring.hpp), and forwards status messages from OBC processes back to
+ * the UIB.
+ *
+ * Usage: rctbridge [options] DEVICE[:BAUD]
+ *   --shm NAME       shared memory ring name (default /rctbridge)
+ *   --capacity N     records kept in the ring (default 1024)
+ *   --status PATH    FIFO for status messages (default /tmp/rctbridge.status)
+ *   --rtcm PATH      FIFO for RTCM3 corrections to relay to the GPS receiver
+ *   --quiet          do not copy other UIB output to stdout
+ *   --stats S        print counters to stderr every S seconds
+ *   --sync S         synchronise clocks with the UIB every S seconds
+ *                    (default 1; 0 to disable)
+ *
+ * Processes write status messages to the FIFO one line each, in the format
+ * Status_Module decodes, e.g.
+ *
+ *     echo '{"STR": 4, "SYS": 3, "SDR": 3}' > /tmp/rctbridge.status
+ *
+ * Each line is checked with the firmware's Status_Module before it is sent,
+ * so a malformed message never reaches the UIB.  Lines of up to PIPE_BUF bytes
+ * are written to a FIFO atomically, so any number of processes can share it.
+ *
+ * With --rtcm, RTCM3 frames written to that FIFO (e.g. by an NTRIP client)
+ * are checked against their CRC-24Q and sent to the UIB whole, between
+ * status lines; the UIB relays them to the GPS receiver (RTCM_Relay.hpp).
+ * Bytes between frames are discarded.
+ *
+ * Sensor packets in the delta format (OutputFormat FMT_DELTA) are decoded
+ * with Delta_Decoder and published the same way; deltas that follow a lost
+ * frame are dropped until the next key frame.
+ *
+ * The bridge also keeps the UIB's clock mapped to CLOCK_MONOTONIC with an
+ * NTP style exchange (Clock_Sync.hpp).  Each record then carries both the
+ * UIB timestamp of its fix and that time on the OBC's clock, free of the USB
+ * and loop latency in the time the bridge read it.  The UIB's reset line
+ * ({"rst": ...}, Warm_Start.hpp) restarts the exchange, since the UIB's clock
+ * starts over after any reset.
+ *
+ * UIB output that is not a sensor packet (diagnostics, profiles, traces, raw
+ * NMEA passthrough) is copied to stdout.  If the device goes away, the bridge
+ * reopens it once a second; the ring stays in place.  Counters are printed to
+ * stderr as JSON on SIGINT or SIGTERM.
+ */
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "Pose_Ring.hpp"
+#include "Delta_Decoder.hpp"
+#include "Clock_Sync.hpp"
+#include "../Status_Module.hpp"
+#include "../RTCM_Relay.hpp"
+
+/// Longest line accepted from the UIB or the status FIFO
+#define BRIDGE_LINE_MAX 512
+#define BRIDGE_STATUS_FIFO "/tmp/rctbridge.status"
+/// Longest RTCM3 frame: header, 1023 byte payload and CRC
+#define BRIDGE_RTCM_MAX (3 + 1023 + 3)
+/// Longest time to wait for the device to take the rest of a frame, in ms
+#define BRIDGE_WRITE_TIMEOUT_MS 100
+
+namespace{
+	volatile sig_atomic_t running = 1;
+
+	void stop(int){
+		running = 0;
+	}
+
+	struct Stats{
+		uint64_t lines = 0;
+		uint64_t packets = 0;
+		uint64_t bad_packets = 0;
+		uint64_t other_lines = 0;
+		uint64_t overlong_lines = 0;
+		uint64_t reopens = 0;
+		uint64_t status_forwarded = 0;
+		uint64_t status_rejected = 0;
+		uint64_t status_dropped = 0;
+		uint64_t rtcm_forwarded = 0;
+		uint64_t rtcm_bytes = 0;
+		uint64_t rtcm_rejected = 0;
+		uint64_t rtcm_skipped = 0;
+		uint64_t rtcm_dropped = 0;
+		uint64_t clock_requests = 0;
+		uint64_t clock_replies = 0;
+		uint64_t uib_resets = 0;
+	};
+
+	/**
+	 * Splits a byte stream into lines, dropping CR and any line longer than
+	 * BRIDGE_LINE_MAX.
+	 */
+	class Line_Splitter{
+	public:
+		Line_Splitter() : len(0), done(0), overlong(false){
+		}
+
+		/**
+		 * Feeds one byte.
+		 * @return true if a line is complete; it is in line() until the next
+		 *         call
+		 */
+		bool feed(char c, Stats& stats){
+			if(c == '\n'){
+				bool complete = !overlong;
+				buf[len] = 0;
+				if(overlong){
+					stats.overlong_lines++;
+				}
+				done = len;
+				len = 0;
+				overlong = false;
+				return complete;
+			}
+			if(c == '\r'){
+				return false;
+			}
+			if(len >= BRIDGE_LINE_MAX - 1){
+				overlong = true;
+			}else{
+				buf[len++] = c;
+			}
+			return false;
+		}
+
+		const char* line() const{
+			return buf;
+		}
+
+		size_t length() const{
+			return done;
+		}
+
+	private:
+		char buf[BRIDGE_LINE_MAX];
+		size_t len;
+		size_t done;
+		bool overlong;
+	};
+
+	/**
+	 * Splits a byte stream into RTCM3 frames, discarding anything between
+	 * frames and frames that fail their CRC.
+	 */
+	class RTCM_Splitter{
+	public:
+		RTCM_Splitter() : len(0), need(0){
+		}
+
+		/**
+		 * Feeds one byte.
+		 * @return true if a frame is complete; it is in frame() until the
+		 *         next call
+		 */
+		bool feed(uint8_t c, Stats& stats){
+			if(len == 0 && c != RTCM_PREAMBLE){
+				stats.rtcm_skipped++;
+				return false;
+			}
+			buf[len++] = c;
+			if(len == 2 && (c & 0xFC)){
+				// Reserved bits set: not a frame header, though this byte may
+				// start one
+				stats.rtcm_skipped++;
+				len = 0;
+				return feed(c, stats);
+			}
+			if(len == 3){
+				need = 6 + (((buf[1] & 0x03) << 8) | buf[2]);
+			}
+			if(len < 3 || len < need){
+				return false;
+			}
+			len = 0;
+			uint32_t crc = ((uint32_t)buf[need - 3] << 16)
+				| ((uint32_t)buf[need - 2] << 8) | buf[need - 1];
+			if(RTCM_Relay::crc24q(buf, need - 3) != crc){
+				stats.rtcm_rejected++;
+				return false;
+			}
+			return true;
+		}
+
+		const uint8_t* frame() const{
+			return buf;
+		}
+
+		size_t length() const{
+			return need;
+		}
+
+	private:
+		uint8_t buf[BRIDGE_RTCM_MAX];
+		size_t len;
+		size_t need;
+	};
+
+	/**
+	 * Writes all of a message to the non-blocking device, waiting up to
+	 * BRIDGE_WRITE_TIMEOUT_MS for room.  A frame cut short would make the
+	 * UIB take the status messages after it as part of the frame.
+	 * @return true if the whole message was written
+	 */
+	bool write_all(int fd, const uint8_t* data, size_t len){
+		while(len > 0){
+			ssize_t n = write(fd, data, len);
+			if(n > 0){
+				data += n;
+				len -= n;
+				continue;
+			}
+			if(n < 0 && errno != EAGAIN && errno != EINTR){
+				return false;
+			}
+			struct pollfd pfd = {fd, POLLOUT, 0};
+			if(poll(&pfd, 1, BRIDGE_WRITE_TIMEOUT_MS) <= 0){
+				return false;
+			}
+		}
+		return true;
+	}
+
+	uint64_t monotonic_ns(){
+		struct timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+	}
+
+	speed_t baud_flag(long baud){
+		switch(baud){
+			case 4800: return B4800;
+			case 9600: return B9600;
+			case 19200: return B19200;
+			case 38400: return B38400;
+			case 57600: return B57600;
+			case 115200: return B115200;
+			case 230400: return B230400;
+			default: return B0;
+		}
+	}
+
+	int open_device(const char* device, long baud){
+		int fd = open(device, O_RDWR | O_NOCTTY | O_NONBLOCK);
+		if(fd < 0){
+			return -1;
+		}
+		struct termios tio;
+		if(tcgetattr(fd, &tio) == 0){
+			cfmakeraw(&tio);
+			if(baud){
+				cfsetispeed(&tio, baud_flag(baud));
+				cfsetospeed(&tio, baud_flag(baud));
+			}
+			tcsetattr(fd, TCSANOW, &tio);
+		}
+		return fd;
+	}
+
+	const char* skip_space(const char* p){
+		while(*p == ' ' || *p == '\t'){
+			p++;
+		}
+		return p;
+	}
+
+	void copy_string(char* out, size_t size, const char* value, size_t len){
+		len = (len < size - 1) ? len : size - 1;
+		memcpy(out, value, len);
+		out[len] = 0;
+	}
+
+	/**
+	 * Parses a sensor packet from Sensor_Module::getPacket, e.g.
+	 * {"lat": 327554300, "lon": -1172340000, "hdg": 90, "tme": "120000.00",
+	 *  "run": "false", "fix": 1, "sat": 9, "dat": "191026", "uts": 81234567}
+	 * @return true if the line is a packet with every numeric field
+	 */
+	bool parse_packet(const char* line, PoseRecord* record){
+		enum{
+			HAVE_LAT = 1, HAVE_LON = 2, HAVE_HDG = 4, HAVE_FIX = 8,
+			HAVE_SAT = 16, HAVE_ALL = 31
+		};
+		memset(record, 0, sizeof(*record));
+		unsigned have = 0;
+		const char* p = skip_space(line);
+		if(*p++ != '{'){
+			return false;
+		}
+		for(;;){
+			p = skip_space(p);
+			if(p[0] != '"' || !p[1] || !p[2] || !p[3] || p[4] != '"'){
+				return false;
+			}
+			const char* key = p + 1;
+			p = skip_space(p + 5);
+			if(*p++ != ':'){
+				return false;
+			}
+			p = skip_space(p);
+			if(*p == '"'){
+				const char* value = ++p;
+				while(*p && *p != '"'){
+					p++;
+				}
+				if(*p != '"'){
+					return false;
+				}
+				size_t len = p++ - value;
+				if(!strncmp(key, "tme", 3)){
+					copy_string(record->time, sizeof(record->time), value, len);
+				}else if(!strncmp(key, "dat", 3)){
+					copy_string(record->date, sizeof(record->date), value, len);
+				}else if(!strncmp(key, "run", 3)){
+					record->run = len == 4 && !strncmp(value, "true", 4);
+				}
+			}else{
+				char* end;
+				long value = strtol(p, &end, 10);
+				if(end == p){
+					return false;
+				}
+				p = end;
+				if(!strncmp(key, "lat", 3)){
+					record->lat = value;
+					have |= HAVE_LAT;
+				}else if(!strncmp(key, "lon", 3)){
+					record->lon = value;
+					have |= HAVE_LON;
+				}else if(!strncmp(key, "hdg", 3)){
+					record->hdg = value;
+					have |= HAVE_HDG;
+				}else if(!strncmp(key, "fix", 3)){
+					record->fix = value;
+					have |= HAVE_FIX;
+				}else if(!strncmp(key, "sat", 3)){
+					record->sat = value;
+					have |= HAVE_SAT;
+				}else if(!strncmp(key, "uts", 3)){
+					record->uts = value;
+				}
+			}
+			p = skip_space(p);
+			if(*p == ','){
+				p++;
+			}else if(*p == '}'){
+				return have == HAVE_ALL;
+			}else{
+				return false;
+			}
+		}
+	}
+
+	/**
+	 * Fills in a pose record from a decoded delta stream frame.
+	 */
+	void delta_record(const DeltaFix& fix, PoseRecord* record){
+		memset(record, 0, sizeof(*record));
+		record->lat = fix.lat;
+		record->lon = fix.lon;
+		record->hdg = fix.hdg;
+		record->fix = fix.fix;
+		record->sat = fix.sat;
+		record->run = fix.run;
+		record->uts = fix.uts;
+		Delta_Decoder::formatTime(fix.time_cs, record->time);
+		Delta_Decoder::formatDate(fix.date, record->date);
+	}
+
+	/**
+	 * Checks a status line with the firmware's parser.
+	 * @return true if it holds at least one complete message, nothing the
+	 *         parser had to resynchronise over and no value it would reject
+	 */
+	bool valid_status(const char* line){
+		StatusPacket packet;
+		ConfigPacket config;
+		Status_Module parser(&packet, &config);
+		for(const char* p = line; *p; p++){
+			parser.decode(*p);
+		}
+		DiagnosticsPacket diag;
+		memset(&diag, 0, sizeof(diag));
+		parser.getDiagnostics(&diag);
+		return diag.status_messages > 0 && diag.status_resyncs == 0
+			&& diag.status_rejects == 0;
+	}
+
+	void print_stats(const Stats& stats, const Pose_Ring& ring,
+			const Delta_Decoder& delta, const Clock_Sync& uib_clock){
+		fprintf(stderr, "{\"lines\": %llu, \"packets\": %llu, "
+			"\"bad_packets\": %llu, \"delta_keyframes\": %llu, "
+			"\"delta_lost\": %llu, \"delta_skipped\": %llu, "
+			"\"other_lines\": %llu, "
+			"\"overlong_lines\": %llu, \"reopens\": %llu, "
+			"\"status_forwarded\": %llu, \"status_rejected\": %llu, "
+			"\"status_dropped\": %llu, \"rtcm_forwarded\": %llu, "
+			"\"rtcm_bytes\": %llu, \"rtcm_rejected\": %llu, "
+			"\"rtcm_skipped\": %llu, \"rtcm_dropped\": %llu, "
+			"\"clock_requests\": %llu, \"clock_replies\": %llu, "
+			"\"uib_resets\": %llu, "
+			"\"clock_delay_us\": %.1f, \"clock_drift_ppm\": %.2f, "
+			"\"head\": %llu}\n",
+			(unsigned long long)stats.lines, (unsigned long long)stats.packets,
+			(unsigned long long)stats.bad_packets,
+			(unsigned long long)delta.keyframes,
+			(unsigned long long)delta.lost,
+			(unsigned long long)delta.skipped,
+			(unsigned long long)stats.other_lines,
+			(unsigned long long)stats.overlong_lines,
+			(unsigned long long)stats.reopens,
+			(unsigned long long)stats.status_forwarded,
+			(unsigned long long)stats.status_rejected,
+			(unsigned long long)stats.status_dropped,
+			(unsigned long long)stats.rtcm_forwarded,
+			(unsigned long long)stats.rtcm_bytes,
+			(unsigned long long)stats.rtcm_rejected,
+			(unsigned long long)stats.rtcm_skipped,
+			(unsigned long long)stats.rtcm_dropped,
+			(unsigned long long)stats.clock_requests,
+			(unsigned long long)stats.clock_replies,
+			(unsigned long long)stats.uib_resets,
+			uib_clock.minDelay() / 1e3, uib_clock.driftPPM(),
+			(unsigned long long)ring.head());
+	}
+
+	void usage(const char* name){
+		fprintf(stderr, "Usage: %s [--shm NAME] [--capacity N] "
+			"[--status PATH] [--rtcm PATH] [--quiet] [--stats S] [--sync S] "
+			"DEVICE[:BAUD]\n", name);
+	}
+}
+
+int main(int argc, char* argv[]){
+	const char* shm = POSE_RING_NAME;
+	const char* status_path = BRIDGE_STATUS_FIFO;
+	const char* rtcm_path = NULL;
+	uint32_t capacity = 1024;
+	bool quiet = false;
+	double stats_s = 0;
+	double sync_s = 1;
+	char* device = NULL;
+	for(int i = 1; i < argc; i++){
+		bool has_value = i + 1 < argc;
+		if(!strcmp(argv[i], "--shm") && has_value){
+			shm = argv[++i];
+		}else if(!strcmp(argv[i], "--capacity") && has_value){
+			capacity = atoi(argv[++i]);
+		}else if(!strcmp(argv[i], "--status") && has_value){
+			status_path = argv[++i];
+		}else if(!strcmp(argv[i], "--rtcm") && has_value){
+			rtcm_path = argv[++i];
+		}else if(!strcmp(argv[i], "--quiet")){
+			quiet = true;
+		}else if(!strcmp(argv[i], "--stats") && has_value){
+			stats_s = atof(argv[++i]);
+		}else if(!strcmp(argv[i], "--sync") && has_value){
+			sync_s = atof(argv[++i]);
+		}else if(argv[i][0] != '-' && device == NULL){
+			device = argv[i];
+		}else{
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if(device == NULL || capacity == 0){
+		usage(argv[0]);
+		return 1;
+	}
+	long baud = 0;
+	char* colon = strchr(device, ':');
+	if(colon != NULL){
+		*colon = 0;
+		baud = atol(colon + 1);
+		if(baud_flag(baud) == B0){
+			fprintf(stderr, "Unsupported baud rate %ld\n", baud);
+			return 1;
+		}
+	}
+
+	int serial = open_device(device, baud);
+	if(serial < 0){
+		perror(device);
+		return 1;
+	}
+	if(mkfifo(status_path, 0622) < 0 && errno != EEXIST){
+		perror(status_path);
+		return 1;
+	}
+	// Held open for writing too, so that the FIFO never reads end of file
+	// while no process has it open
+	int status = open(status_path, O_RDWR | O_NONBLOCK);
+	if(status < 0){
+		perror(status_path);
+		return 1;
+	}
+	int rtcm = -1;
+	if(rtcm_path != NULL){
+		if(mkfifo(rtcm_path, 0622) < 0 && errno != EEXIST){
+			perror(rtcm_path);
+			return 1;
+		}
+		rtcm = open(rtcm_path, O_RDWR | O_NONBLOCK);
+		if(rtcm < 0){
+			perror(rtcm_path);
+			return 1;
+		}
+	}
+	Pose_Ring ring;
+	if(!ring.create(shm, capacity)){
+		perror(shm);
+		return 1;
+	}
+
+	signal(SIGINT, stop);
+	signal(SIGTERM, stop);
+	signal(SIGPIPE, SIG_IGN);
+
+	Stats stats;
+	Line_Splitter uib_lines;
+	Line_Splitter status_lines;
+	RTCM_Splitter rtcm_frames;
+	Delta_Decoder delta;
+	Clock_Sync uib_clock;
+	uint64_t next_sync_ns = 0;
+	uint64_t next_stats_ns = monotonic_ns() + (uint64_t)(stats_s * 1e9);
+	uint64_t next_open_ns = 0;
+	char buf[BRIDGE_LINE_MAX];
+	while(running){
+		struct pollfd fds[3];
+		fds[0].fd = status;
+		fds[0].events = POLLIN;
+		fds[1].fd = rtcm;
+		fds[1].events = POLLIN;
+		fds[2].fd = serial;
+		fds[2].events = POLLIN;
+		// Negative descriptors are ignored by poll
+		if(poll(fds, 3, 100) < 0 && errno != EINTR){
+			perror("poll");
+			break;
+		}
+		uint64_t now = monotonic_ns();
+
+		if(serial < 0){
+			if(now >= next_open_ns){
+				serial = open_device(device, baud);
+				stats.reopens += serial >= 0;
+				delta.reset();
+				// The UIB's clock restarted if it reset
+				uib_clock.reset();
+				next_open_ns = now + 1000000000ULL;
+			}
+		}else if(fds[2].revents & (POLLIN | POLLHUP | POLLERR)){
+			ssize_t n = read(serial, buf, sizeof(buf));
+			if(n > 0){
+				for(ssize_t i = 0; i < n; i++){
+					if(!uib_lines.feed(buf[i], stats)){
+						continue;
+					}
+					stats.lines++;
+					const char* line = uib_lines.line();
+					PoseRecord record;
+					if(!strncmp(line, "{\"clk\"", 6)){
+						stats.clock_replies += uib_clock.reply(line, now);
+					}else if(!strncmp(line, "{\"rst\"", 6)){
+						// The UIB restarted without the port going away, e.g.
+						// after a watchdog reset, so its clock started over
+						uib_clock.reset();
+						delta.reset();
+						stats.uib_resets++;
+						stats.other_lines++;
+						if(!quiet){
+							fwrite(line, 1, uib_lines.length(), stdout);
+							fputc('\n', stdout);
+							fflush(stdout);
+						}
+					}else if(!strncmp(line, "{\"lat\"", 6)){
+						if(parse_packet(line, &record)){
+							record.rx_ns = now;
+							if(record.uts){
+								record.uib_ns = uib_clock.toHost(record.uts);
+							}
+							ring.publish(record);
+							stats.packets++;
+						}else{
+							stats.bad_packets++;
+						}
+					}else if(line[0] == DELTA_MARK){
+						DeltaFix fix;
+						switch(delta.decode(line, &fix)){
+							case DELTA_OK:
+								delta_record(fix, &record);
+								record.rx_ns = now;
+								record.uib_ns = uib_clock.toHost(record.uts);
+								ring.publish(record);
+								stats.packets++;
+								break;
+							case DELTA_INVALID:
+								stats.bad_packets++;
+								break;
+							default:
+								break;
+						}
+					}else if(uib_lines.length() > 0){
+						stats.other_lines++;
+						if(!quiet){
+							fwrite(line, 1, uib_lines.length(), stdout);
+							fputc('\n', stdout);
+							fflush(stdout);
+						}
+					}
+				}
+			}else if(n == 0 || (errno != EAGAIN && errno != EINTR)){
+				// Device unplugged or the UIB reset
+				close(serial);
+				serial = -1;
+				next_open_ns = now + 1000000000ULL;
+			}
+		}
+
+		if(fds[0].revents & POLLIN){
+			ssize_t n = read(status, buf, sizeof(buf));
+			for(ssize_t i = 0; i < n; i++){
+				if(!status_lines.feed(buf[i], stats)){
+					continue;
+				}
+				if(!valid_status(status_lines.line())){
+					stats.status_rejected++;
+					continue;
+				}
+				char message[BRIDGE_LINE_MAX + 1];
+				int len = snprintf(message, sizeof(message), "%s\n",
+					status_lines.line());
+				if(serial < 0 || write(serial, message, len) != len){
+					stats.status_dropped++;
+				}else{
+					stats.status_forwarded++;
+				}
+			}
+		}
+
+		if(fds[1].revents & POLLIN){
+			ssize_t n = read(rtcm, buf, sizeof(buf));
+			for(ssize_t i = 0; i < n; i++){
+				if(!rtcm_frames.feed(buf[i], stats)){
+					continue;
+				}
+				if(serial < 0 || !write_all(serial, rtcm_frames.frame(),
+						rtcm_frames.length())){
+					stats.rtcm_dropped++;
+				}else{
+					stats.rtcm_forwarded++;
+					stats.rtcm_bytes += rtcm_frames.length();
+				}
+			}
+		}
+
+		if(serial >= 0 && sync_s > 0 && now >= next_sync_ns){
+			char message[24];
+			uint64_t t0 = monotonic_ns();
+			int len = snprintf(message, sizeof(message), "{\"CLK\": %u}\n",
+				uib_clock.request(t0));
+			if(write(serial, message, len) == len){
+				stats.clock_requests++;
+			}
+			next_sync_ns = now + (uint64_t)(sync_s * 1e9);
+		}
+
+		if(stats_s > 0 && now >= next_stats_ns){
+			print_stats(stats, ring, delta, uib_clock);
+			next_stats_ns += (uint64_t)(stats_s * 1e9);
+		}
+	}
+
+	print_stats(stats, ring, delta, uib_clock);
+	ring.close();
+	close(status);
+	if(rtcm >= 0){
+		close(rtcm);
+	}
+	if(serial >= 0){
+		close(serial);
+	}
+	return 0;
+}
@@ -0,0 +1,172 @@
+/*
+ * @file rctcap.cpp
+ *
+ * @description Records raw serial traffic into a capture file.
+ *
+ * Usage: rctcap -o FILE PORT=DEVICE[:BAUD] [PORT=DEVICE[:BAUD] ...]
+ *
+ * PORT is one of gps, obc_rx, obc_tx or gps_tx (see Capture.hpp), and names
+ * the link and direction DEVICE is tapping.  For example, on the OBC:
+ *
+ *     rctcap -o flight.cap obc_tx=/dev/ttyACM0 gps=/dev/ttyUSB1:9600
+ *
+ * records the UIB output and, through a spare USB serial adapter spliced onto
+ * the GPS TX line, the exact bytes the UIB saw from the receiver.  Devices are
+ * opened read only in raw mode.  Recording stops on SIGINT or SIGTERM.  The
+ * firmware host build records the same format with --record.
+ */
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/time.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+#include "Capture.hpp"
+
+namespace{
+	volatile sig_atomic_t running = 1;
+
+	void stop(int){
+		running = 0;
+	}
+
+	struct Tap{
+		uint8_t port;
+		int fd;
+		const char* device;
+		uint64_t bytes;
+	};
+
+	speed_t baud_flag(long baud){
+		switch(baud){
+			case 4800: return B4800;
+			case 9600: return B9600;
+			case 19200: return B19200;
+			case 38400: return B38400;
+			case 57600: return B57600;
+			case 115200: return B115200;
+			case 230400: return B230400;
+			default: return B0;
+		}
+	}
+
+	uint64_t monotonic_us(){
+		struct timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+	}
+
+	bool open_tap(Tap& tap, char* spec){
+		char* eq = strchr(spec, '=');
+		if(eq == NULL){
+			return false;
+		}
+		*eq = 0;
+		tap.port = capture_port_parse(spec);
+		if(tap.port >= CAP_PORT__SIZE){
+			fprintf(stderr, "Unknown port %s\n", spec);
+			return false;
+		}
+		tap.device = eq + 1;
+		long baud = 0;
+		char* colon = strchr(eq + 1, ':');
+		if(colon != NULL){
+			*colon = 0;
+			baud = atol(colon + 1);
+		}
+		tap.fd = open(tap.device, O_RDONLY | O_NOCTTY | O_NONBLOCK);
+		if(tap.fd < 0){
+			perror(tap.device);
+			return false;
+		}
+		struct termios tio;
+		if(tcgetattr(tap.fd, &tio) == 0){
+			cfmakeraw(&tio);
+			if(baud){
+				speed_t speed = baud_flag(baud);
+				if(speed == B0){
+					fprintf(stderr, "Unsupported baud rate %ld\n", baud);
+					return false;
+				}
+				cfsetispeed(&tio, speed);
+				cfsetospeed(&tio, speed);
+			}
+			tcsetattr(tap.fd, TCSANOW, &tio);
+		}
+		tap.bytes = 0;
+		return true;
+	}
+}
+
+int main(int argc, char* argv[]){
+	const char* output = NULL;
+	std::vector<Tap> taps;
+	for(int i = 1; i < argc; i++){
+		if(!strcmp(argv[i], "-o") && i + 1 < argc){
+			output = argv[++i];
+		}else{
+			Tap tap;
+			if(!open_tap(tap, argv[i])){
+				return 1;
+			}
+			taps.push_back(tap);
+		}
+	}
+	if(output == NULL || taps.empty()){
+		fprintf(stderr, "Usage: %s -o FILE PORT=DEVICE[:BAUD] ...\n", argv[0]);
+		return 1;
+	}
+
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	Capture_Writer capture;
+	if(!capture.open(output, tv.tv_sec * 1000000ULL + tv.tv_usec)){
+		perror(output);
+		return 1;
+	}
+
+	signal(SIGINT, stop);
+	signal(SIGTERM, stop);
+
+	std::vector<struct pollfd> fds(taps.size());
+	for(size_t i = 0; i < taps.size(); i++){
+		fds[i].fd = taps[i].fd;
+		fds[i].events = POLLIN;
+	}
+	const uint64_t start_us = monotonic_us();
+	uint8_t buf[512];
+	while(running){
+		if(poll(&fds[0], fds.size(), 100) < 0){
+			if(errno == EINTR){
+				continue;
+			}
+			perror("poll");
+			break;
+		}
+		for(size_t i = 0; i < taps.size(); i++){
+			if(!(fds[i].revents & POLLIN)){
+				continue;
+			}
+			ssize_t n = read(taps[i].fd, buf, sizeof(buf));
+			if(n > 0){
+				capture.write(monotonic_us() - start_us, taps[i].port, buf, n);
+				taps[i].bytes += n;
+			}
+		}
+	}
+
+	capture.close();
+	for(size_t i = 0; i < taps.size(); i++){
+		fprintf(stderr, "%s (%s): %llu bytes\n", capture_port_name(taps[i].port),
+			taps[i].device, (unsigned long long)taps[i].bytes);
+		close(taps[i].fd);
+	}
+	return 0;
+}
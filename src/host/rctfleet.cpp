@@ -0,0 +1,202 @@
+/*
+ * @file rctfleet.cpp
+ *
+ * @description Runs a fleet of simulated UIBs, for load testing the OBC side.
+ *
+ * Usage: rctfleet [options]
+ *   --count N            number of UIBs (default 4)
+ *   --rate HZ            fix rate of each UIB (default 1)
+ *   --jitter MS          largest random delay added to each epoch (default 0)
+ *   --aligned            start every UIB in phase, so that packets arrive in
+ *                        bursts; by default the UIBs are spread over a period
+ *   --link PREFIX        symlink UIB i's PTY to PREFIXi, e.g. /tmp/uib0
+ *   --seconds S          stop after S seconds (default: on SIGINT)
+ *   --spacing DEG        distance between the UIBs' circles (default 0.002)
+ *   --heading-noise DEG  compass noise about the course (default 2)
+ *   --no-compass         UIBs without a compass
+ *   --multi-gnss         multi-constellation GPS output
+ *   --stats S            print fleet counters to stderr every S seconds
+ *
+ * Each UIB runs the firmware's Sensor_Module and Status_Module on its own
+ * thread, with its own trajectory, compass and OBC PTY.  The PTYs behave like
+ * /dev/ttyACM0: the OBC reads sensor packets from them and writes status
+ * messages back.  The PTY of each UIB is printed on stdout at start up, and a
+ * JSON summary when the fleet stops.
+ */
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Fleet_UIB.hpp"
+#include "../ui_core.hpp"
+
+RCT_HAL_System_t systemDescriptor;
+RCT_HAL_System_t* pHALSystem = &systemDescriptor;
+
+void timer_tick(void){
+}
+
+namespace{
+	volatile sig_atomic_t stop_requested = 0;
+
+	void on_signal(int sig){
+		(void)sig;
+		stop_requested = 1;
+	}
+
+	void usage(const char* name){
+		fprintf(stderr, "Usage: %s [--count N] [--rate HZ] [--jitter MS] "
+			"[--aligned] [--link PREFIX] [--seconds S] [--spacing DEG] "
+			"[--heading-noise DEG] [--no-compass] [--multi-gnss] "
+			"[--stats S]\n", name);
+	}
+
+	uint64_t monotonic_ns(){
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	Fleet_UIB::Stats total(const std::vector<Fleet_UIB*>& fleet){
+		Fleet_UIB::Stats sum;
+		memset(&sum, 0, sizeof(sum));
+		for(size_t i = 0; i < fleet.size(); i++){
+			Fleet_UIB::Stats s = fleet[i]->stats();
+			sum.packets += s.packets;
+			sum.dropped += s.dropped;
+			sum.status_messages += s.status_messages;
+			sum.status_resyncs += s.status_resyncs;
+			sum.requests += s.requests;
+			if(s.max_late_us > sum.max_late_us){
+				sum.max_late_us = s.max_late_us;
+			}
+		}
+		return sum;
+	}
+}
+
+int main(int argc, char const *argv[]){
+	uint32_t count = 4;
+	bool aligned = false;
+	const char* link = NULL;
+	double seconds = 0;
+	double spacing = 0.002;
+	double stats_s = 0;
+	Fleet_UIB::Options options;
+	options.gps = NMEA_Generator::defaults();
+	options.phase_s = 0;
+	options.jitter_ms = 0;
+	options.heading_noise_deg = 2;
+	options.compass = true;
+	options.link = NULL;
+	for(int i = 1; i < argc; i++){
+		bool has_value = i + 1 < argc;
+		if(!strcmp(argv[i], "--count") && has_value){
+			count = atoi(argv[++i]);
+		}else if(!strcmp(argv[i], "--rate") && has_value){
+			options.gps.rate_hz = atof(argv[++i]);
+		}else if(!strcmp(argv[i], "--jitter") && has_value){
+			options.jitter_ms = atof(argv[++i]);
+		}else if(!strcmp(argv[i], "--aligned")){
+			aligned = true;
+		}else if(!strcmp(argv[i], "--link") && has_value){
+			link = argv[++i];
+		}else if(!strcmp(argv[i], "--seconds") && has_value){
+			seconds = atof(argv[++i]);
+		}else if(!strcmp(argv[i], "--spacing") && has_value){
+			spacing = atof(argv[++i]);
+		}else if(!strcmp(argv[i], "--heading-noise") && has_value){
+			options.heading_noise_deg = atof(argv[++i]);
+		}else if(!strcmp(argv[i], "--no-compass")){
+			options.compass = false;
+		}else if(!strcmp(argv[i], "--multi-gnss")){
+			NMEA_Generator::Options multi = NMEA_Generator::multi_gnss();
+			options.gps.constellations = multi.constellations;
+			options.gps.gsa = multi.gsa;
+			options.gps.vtg = multi.vtg;
+		}else if(!strcmp(argv[i], "--stats") && has_value){
+			stats_s = atof(argv[++i]);
+		}else{
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if(count == 0 || options.gps.rate_hz <= 0){
+		usage(argv[0]);
+		return 1;
+	}
+
+	RCT_HAL_Init(pHALSystem);
+	std::vector<Fleet_UIB*> fleet;
+	std::vector<std::string> links(count);
+	for(uint32_t i = 0; i < count; i++){
+		Fleet_UIB::Options uib = options;
+		uib.gps.seed = i + 1;
+		uib.gps.lat += spacing * i;
+		uib.phase_s = aligned ? 0 : i / (count * options.gps.rate_hz);
+		if(link != NULL){
+			links[i] = link + std::to_string(i);
+			uib.link = links[i].c_str();
+		}
+		fleet.push_back(new Fleet_UIB(uib));
+		if(!fleet.back()->open()){
+			perror("openpty");
+			return 1;
+		}
+		printf("uib%u %s%s%s\n", i, fleet.back()->name(),
+			link != NULL ? " " : "", link != NULL ? uib.link : "");
+	}
+	fflush(stdout);
+
+	signal(SIGINT, on_signal);
+	signal(SIGTERM, on_signal);
+	uint64_t start_ns = monotonic_ns();
+	for(size_t i = 0; i < fleet.size(); i++){
+		fleet[i]->start(start_ns);
+	}
+
+	uint64_t next_stats_ns = start_ns + (uint64_t)(stats_s * 1e9);
+	while(!stop_requested){
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		uint64_t now = monotonic_ns();
+		if(seconds > 0 && now - start_ns >= seconds * 1e9){
+			break;
+		}
+		if(stats_s > 0 && now >= next_stats_ns){
+			Fleet_UIB::Stats sum = total(fleet);
+			fprintf(stderr, "%.1f s: %u packets, %u dropped, %u status, "
+				"max late %u us\n", (now - start_ns) / 1e9, sum.packets,
+				sum.dropped, sum.status_messages, sum.max_late_us);
+			next_stats_ns += (uint64_t)(stats_s * 1e9);
+		}
+	}
+	for(size_t i = 0; i < fleet.size(); i++){
+		fleet[i]->stop();
+	}
+	double elapsed_s = (monotonic_ns() - start_ns) / 1e9;
+
+	Fleet_UIB::Stats sum = total(fleet);
+	printf("{\"count\": %u, \"rate_hz\": %g, \"jitter_ms\": %g, "
+		"\"aligned\": %s, \"seconds\": %.3f, \"packets\": %u, "
+		"\"packets_per_s\": %.1f, \"dropped\": %u, \"status_messages\": %u, "
+		"\"status_resyncs\": %u, \"requests\": %u, \"max_late_us\": %u, "
+		"\"uibs\": [", count, options.gps.rate_hz, options.jitter_ms,
+		aligned ? "true" : "false", elapsed_s, sum.packets,
+		elapsed_s > 0 ? sum.packets / elapsed_s : 0, sum.dropped,
+		sum.status_messages, sum.status_resyncs, sum.requests,
+		sum.max_late_us);
+	for(size_t i = 0; i < fleet.size(); i++){
+		Fleet_UIB::Stats s = fleet[i]->stats();
+		printf("%s{\"packets\": %u, \"dropped\": %u, \"status_messages\": %u, "
+			"\"status_resyncs\": %u, \"requests\": %u, \"max_late_us\": %u}",
+			i ? ", " : "", s.packets, s.dropped, s.status_messages,
+			s.status_resyncs, s.requests, s.max_late_us);
+		delete fleet[i];
+	}
+	printf("]}\n");
+	return 0;
+}
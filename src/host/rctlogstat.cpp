@@ -0,0 +1,478 @@
+/*
+ * @file rctlogstat.cpp
+ *
+ * @description Batch statistics for archived NMEA logs.
+ *
+ * Usage: rctlogstat [options] FILE|DIR...
+ *   --jobs N       worker threads (default: one per core)
+ *   --shard-mb N   split logs larger than this into shards (default 16)
+ *   --format F     table, csv or json (default table)
+ *
+ * Every log is one flight.  Logs are memory mapped and split on sentence
+ * boundaries into shards, which a pool of workers scans in parallel with
+ * NMEA_Scanner, which accepts the sentences the firmware's NMEA parser
+ * would.  Each shard yields the epochs it contains (GGA
+ * sentences, or RMC sentences for logs without GGA); the epochs of a flight
+ * are then joined in order and summarised as one row per flight:
+ *
+ *   sentences, checksum errors   as counted by the NMEA parser
+ *   epochs, fix_pct              epochs in the log, and the share with a fix
+ *   ttff_s                       time from the first epoch to the first fix
+ *   dt_p50_s, dt_max_s           interval between consecutive epochs
+ *   sat_min, sat_mean, sat_max   satellites used, over epochs with a fix
+ *   gaps, gap_max_s, gap_total_s intervals between fixes longer than the 5 s
+ *                                after which Sensor_Module drops to GPS_INIT
+ *
+ * Times come from the UTC term of the sentences, so the logs need no receive
+ * timestamps.  Directories are expanded to the regular files in them.
+ */
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "NMEA_Scanner.hpp"
+
+/// Interval between fixes after which Sensor_Module::decode reports GPS_INIT
+#define LOGSTAT_GAP_S 5.0
+#define LOGSTAT_DAY_S 86400.0
+/// Bytes of a shard scanned at a time
+#define LOGSTAT_SCAN_BYTES (1 << 20)
+/// Longest term of an accepted sentence, with its terminating zero
+#define LOGSTAT_TERM_SIZE 15
+
+namespace{
+	enum Format{
+		FORMAT_TABLE,
+		FORMAT_CSV,
+		FORMAT_JSON
+	};
+
+	struct Epoch{
+		/// UTC seconds of day
+		double t;
+		bool fix;
+		uint8_t sats;
+	};
+
+	struct ShardResult{
+		std::vector<Epoch> gga;
+		std::vector<Epoch> rmc;
+		unsigned sentences = 0;
+		unsigned checksum_errors = 0;
+	};
+
+	struct Log{
+		std::string path;
+		const char* data = NULL;
+		size_t size = 0;
+		std::vector<ShardResult> shards;
+		std::string error;
+	};
+
+	struct Shard{
+		Log* log;
+		size_t index;
+		size_t begin;
+		size_t end;
+	};
+
+	struct Summary{
+		unsigned sentences;
+		unsigned checksum_errors;
+		size_t epochs;
+		size_t fixes;
+		double duration_s;
+		double ttff_s;
+		double dt_p50_s;
+		double dt_max_s;
+		unsigned sat_min;
+		double sat_mean;
+		unsigned sat_max;
+		unsigned gaps;
+		double gap_max_s;
+		double gap_total_s;
+	};
+
+	void usage(const char* name){
+		fprintf(stderr, "Usage: %s [--jobs N] [--shard-mb N] "
+			"[--format table|csv|json] FILE|DIR...\n", name);
+	}
+
+	/**
+	 * Parses an NMEA hhmmss.ss time term.
+	 * @return Seconds of day, or -1 if the term is empty or malformed
+	 */
+	double parse_utc(const char* term){
+		if(strlen(term) < 6){
+			return -1;
+		}
+		for(int i = 0; i < 6; i++){
+			if(term[i] < '0' || term[i] > '9'){
+				return -1;
+			}
+		}
+		int hh = (term[0] - '0') * 10 + (term[1] - '0');
+		int mm = (term[2] - '0') * 10 + (term[3] - '0');
+		double ss = atof(term + 4);
+		return hh * 3600 + mm * 60 + ss;
+	}
+
+	/**
+	 * Copies a term of a sentence as a C string, empty if the sentence has
+	 * no such term.
+	 */
+	const char* copy_term(const char* data,
+			const NMEA_Scanner::Sentence& sentence, uint8_t t, char* out){
+		size_t len = 0;
+		if(t < sentence.terms){
+			const char* term = NMEA_Scanner::term(data, sentence, t, &len);
+			memcpy(out, term, len);
+		}
+		out[len] = 0;
+		return out;
+	}
+
+	bool is_type(const char* data, const NMEA_Scanner::Sentence& sentence,
+			const char* type){
+		size_t len;
+		const char* t = NMEA_Scanner::term(data, sentence, 0, &len);
+		return len == 5 && !strncmp(t + 2, type, 3);
+	}
+
+	void decode_sentence(const char* data,
+			const NMEA_Scanner::Sentence& sentence, ShardResult& result){
+		char term[LOGSTAT_TERM_SIZE];
+		Epoch epoch;
+		if(is_type(data, sentence, "GGA")){
+			epoch.t = parse_utc(copy_term(data, sentence, 1, term));
+			epoch.fix = copy_term(data, sentence, 6, term)[0] > '0';
+			epoch.sats = atoi(copy_term(data, sentence, 7, term));
+			if(epoch.t >= 0){
+				result.gga.push_back(epoch);
+			}
+		}else if(is_type(data, sentence, "RMC")){
+			epoch.t = parse_utc(copy_term(data, sentence, 1, term));
+			epoch.fix = copy_term(data, sentence, 2, term)[0] == 'A';
+			epoch.sats = 0;
+			if(epoch.t >= 0){
+				result.rmc.push_back(epoch);
+			}
+		}
+	}
+
+	void decode_shard(const Shard& shard){
+		ShardResult& result = shard.log->shards[shard.index];
+		NMEA_Scanner scanner;
+		std::vector<NMEA_Scanner::Sentence> found;
+		const char* data = shard.log->data;
+		size_t p = shard.begin;
+		while(p < shard.end){
+			size_t n = std::min((size_t)LOGSTAT_SCAN_BYTES, shard.end - p);
+			found.clear();
+			// The log is contiguous, so an unfinished sentence is picked up
+			// again by starting the next piece where it begins
+			size_t resume = scanner.scan(data + p, n, found);
+			for(size_t i = 0; i < found.size(); i++){
+				decode_sentence(data + p, found[i], result);
+			}
+			if(p + n == shard.end){
+				break;
+			}
+			p += resume;
+		}
+		result.sentences = scanner.sentences();
+		result.checksum_errors = scanner.checksum_errors();
+	}
+
+	/**
+	 * Maps a log and splits it into shards that start after a line end.
+	 */
+	void shard_log(Log& log, size_t shard_bytes, std::vector<Shard>& shards){
+		int fd = open(log.path.c_str(), O_RDONLY);
+		struct stat st;
+		if(fd < 0 || fstat(fd, &st) < 0){
+			log.error = strerror(errno);
+			if(fd >= 0){
+				close(fd);
+			}
+			return;
+		}
+		log.size = st.st_size;
+		if(log.size > 0){
+			void* map = mmap(NULL, log.size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if(map == MAP_FAILED){
+				log.error = strerror(errno);
+				log.size = 0;
+			}else{
+				madvise(map, log.size, MADV_SEQUENTIAL);
+				log.data = (const char*)map;
+			}
+		}
+		close(fd);
+
+		size_t begin = 0;
+		while(begin < log.size){
+			size_t end = std::min(log.size, begin + shard_bytes);
+			while(end < log.size && log.data[end - 1] != '\n'){
+				end++;
+			}
+			Shard shard = {&log, 0, begin, end};
+			shards.push_back(shard);
+			begin = end;
+		}
+	}
+
+	void add_path(const char* path, std::vector<std::string>& paths){
+		struct stat st;
+		if(stat(path, &st) == 0 && S_ISDIR(st.st_mode)){
+			DIR* dir = opendir(path);
+			if(dir == NULL){
+				return;
+			}
+			std::vector<std::string> entries;
+			struct dirent* entry;
+			while((entry = readdir(dir)) != NULL){
+				std::string child = std::string(path) + "/" + entry->d_name;
+				if(stat(child.c_str(), &st) == 0 && S_ISREG(st.st_mode)){
+					entries.push_back(child);
+				}
+			}
+			closedir(dir);
+			std::sort(entries.begin(), entries.end());
+			paths.insert(paths.end(), entries.begin(), entries.end());
+		}else{
+			paths.push_back(path);
+		}
+	}
+
+	Summary summarize(const Log& log){
+		Summary s;
+		memset(&s, 0, sizeof(s));
+		s.ttff_s = -1;
+		bool have_gga = false;
+		for(size_t i = 0; i < log.shards.size(); i++){
+			s.sentences += log.shards[i].sentences;
+			s.checksum_errors += log.shards[i].checksum_errors;
+			have_gga |= !log.shards[i].gga.empty();
+		}
+		std::vector<Epoch> epochs;
+		for(size_t i = 0; i < log.shards.size(); i++){
+			const std::vector<Epoch>& e = have_gga ? log.shards[i].gga
+				: log.shards[i].rmc;
+			epochs.insert(epochs.end(), e.begin(), e.end());
+		}
+		s.epochs = epochs.size();
+		if(epochs.empty()){
+			return s;
+		}
+
+		// Unwrap midnight: UTC only goes backwards across a day boundary
+		double day = 0;
+		for(size_t i = 1; i < epochs.size(); i++){
+			if(epochs[i].t + day < epochs[i - 1].t - LOGSTAT_DAY_S / 2){
+				day += LOGSTAT_DAY_S;
+			}
+			epochs[i].t += day;
+		}
+		s.duration_s = epochs.back().t - epochs.front().t;
+
+		std::vector<double> dt;
+		double last_fix = -1;
+		uint64_t sat_sum = 0;
+		s.sat_min = 0xFF;
+		for(size_t i = 0; i < epochs.size(); i++){
+			const Epoch& e = epochs[i];
+			if(i > 0){
+				dt.push_back(e.t - epochs[i - 1].t);
+			}
+			if(!e.fix){
+				continue;
+			}
+			s.fixes++;
+			sat_sum += e.sats;
+			s.sat_min = std::min<unsigned>(s.sat_min, e.sats);
+			s.sat_max = std::max<unsigned>(s.sat_max, e.sats);
+			if(last_fix < 0){
+				s.ttff_s = e.t - epochs.front().t;
+			}else if(e.t - last_fix > LOGSTAT_GAP_S){
+				double gap = e.t - last_fix;
+				s.gaps++;
+				s.gap_total_s += gap;
+				s.gap_max_s = std::max(s.gap_max_s, gap);
+			}
+			last_fix = e.t;
+		}
+		if(s.fixes == 0){
+			s.sat_min = 0;
+		}else{
+			s.sat_mean = (double)sat_sum / s.fixes;
+		}
+		if(!dt.empty()){
+			std::nth_element(dt.begin(), dt.begin() + dt.size() / 2, dt.end());
+			s.dt_p50_s = dt[dt.size() / 2];
+			s.dt_max_s = *std::max_element(dt.begin(), dt.end());
+		}
+		return s;
+	}
+}
+
+int main(int argc, char const *argv[]){
+	unsigned jobs = std::thread::hardware_concurrency();
+	size_t shard_bytes = 16 << 20;
+	Format format = FORMAT_TABLE;
+	std::vector<std::string> paths;
+	for(int i = 1; i < argc; i++){
+		bool has_value = i + 1 < argc;
+		if(!strcmp(argv[i], "--jobs") && has_value){
+			jobs = atoi(argv[++i]);
+		}else if(!strcmp(argv[i], "--shard-mb") && has_value){
+			shard_bytes = (size_t)(atof(argv[++i]) * (1 << 20));
+		}else if(!strcmp(argv[i], "--format") && has_value){
+			i++;
+			if(!strcmp(argv[i], "csv")){
+				format = FORMAT_CSV;
+			}else if(!strcmp(argv[i], "json")){
+				format = FORMAT_JSON;
+			}else{
+				format = FORMAT_TABLE;
+			}
+		}else if(argv[i][0] == '-' && argv[i][1] == '-'){
+			usage(argv[0]);
+			return 1;
+		}else{
+			add_path(argv[i], paths);
+		}
+	}
+	if(paths.empty() || shard_bytes == 0){
+		usage(argv[0]);
+		return 1;
+	}
+	if(jobs == 0){
+		jobs = 1;
+	}
+
+	std::vector<Log> logs(paths.size());
+	std::vector<Shard> shards;
+	for(size_t i = 0; i < paths.size(); i++){
+		logs[i].path = paths[i];
+		size_t first = shards.size();
+		shard_log(logs[i], shard_bytes, shards);
+		logs[i].shards.resize(shards.size() - first);
+		for(size_t s = first; s < shards.size(); s++){
+			shards[s].index = s - first;
+		}
+	}
+
+	// Largest shards first, so that one big log does not finish last
+	std::vector<size_t> order(shards.size());
+	for(size_t i = 0; i < order.size(); i++){
+		order[i] = i;
+	}
+	std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b){
+		return shards[a].end - shards[a].begin > shards[b].end - shards[b].begin;
+	});
+	std::atomic<size_t> next(0);
+	std::vector<std::thread> workers;
+	for(unsigned j = 0; j < std::min<size_t>(jobs, shards.size()); j++){
+		workers.push_back(std::thread([&](){
+			size_t i;
+			while((i = next++) < order.size()){
+				decode_shard(shards[order[i]]);
+			}
+		}));
+	}
+	for(size_t j = 0; j < workers.size(); j++){
+		workers[j].join();
+	}
+
+	static const char* const COLUMNS[] = {
+		"file", "bytes", "sentences", "checksum_errors", "epochs", "fix_pct",
+		"duration_s", "ttff_s", "dt_p50_s", "dt_max_s", "sat_min", "sat_mean",
+		"sat_max", "gaps", "gap_max_s", "gap_total_s"
+	};
+	const size_t ncolumns = sizeof(COLUMNS) / sizeof(COLUMNS[0]);
+	std::vector<std::vector<std::string> > rows;
+	for(size_t i = 0; i < logs.size(); i++){
+		const Log& log = logs[i];
+		if(!log.error.empty()){
+			fprintf(stderr, "%s: %s\n", log.path.c_str(), log.error.c_str());
+			continue;
+		}
+		Summary s = summarize(log);
+		char buf[ncolumns][32];
+		snprintf(buf[1], 32, "%zu", log.size);
+		snprintf(buf[2], 32, "%u", s.sentences);
+		snprintf(buf[3], 32, "%u", s.checksum_errors);
+		snprintf(buf[4], 32, "%zu", s.epochs);
+		snprintf(buf[5], 32, "%.1f", s.epochs ? 100.0 * s.fixes / s.epochs : 0);
+		snprintf(buf[6], 32, "%.1f", s.duration_s);
+		snprintf(buf[7], 32, "%.1f", s.ttff_s);
+		snprintf(buf[8], 32, "%.2f", s.dt_p50_s);
+		snprintf(buf[9], 32, "%.2f", s.dt_max_s);
+		snprintf(buf[10], 32, "%u", s.sat_min);
+		snprintf(buf[11], 32, "%.1f", s.sat_mean);
+		snprintf(buf[12], 32, "%u", s.sat_max);
+		snprintf(buf[13], 32, "%u", s.gaps);
+		snprintf(buf[14], 32, "%.1f", s.gap_max_s);
+		snprintf(buf[15], 32, "%.1f", s.gap_total_s);
+		std::vector<std::string> row(1, log.path);
+		for(size_t c = 1; c < ncolumns; c++){
+			row.push_back(buf[c]);
+		}
+		rows.push_back(row);
+		munmap((void*)log.data, log.size);
+	}
+
+	if(format == FORMAT_JSON){
+		printf("[");
+		for(size_t r = 0; r < rows.size(); r++){
+			printf("%s{\"file\": \"%s\"", r ? ", " : "", rows[r][0].c_str());
+			for(size_t c = 1; c < ncolumns; c++){
+				printf(", \"%s\": %s", COLUMNS[c], rows[r][c].c_str());
+			}
+			printf("}");
+		}
+		printf("]\n");
+	}else if(format == FORMAT_CSV){
+		for(size_t c = 0; c < ncolumns; c++){
+			printf("%s%s", c ? "," : "", COLUMNS[c]);
+		}
+		printf("\n");
+		for(size_t r = 0; r < rows.size(); r++){
+			for(size_t c = 0; c < ncolumns; c++){
+				printf("%s%s", c ? "," : "", rows[r][c].c_str());
+			}
+			printf("\n");
+		}
+	}else{
+		std::vector<size_t> width(ncolumns);
+		for(size_t c = 0; c < ncolumns; c++){
+			width[c] = strlen(COLUMNS[c]);
+			for(size_t r = 0; r < rows.size(); r++){
+				width[c] = std::max(width[c], rows[r][c].size());
+			}
+		}
+		for(size_t c = 0; c < ncolumns; c++){
+			printf(c ? "  %*s" : "%-*s", (int)width[c], COLUMNS[c]);
+		}
+		printf("\n");
+		for(size_t r = 0; r < rows.size(); r++){
+			for(size_t c = 0; c < ncolumns; c++){
+				printf(c ? "  %*s" : "%-*s", (int)width[c], rows[r][c].c_str());
+			}
+			printf("\n");
+		}
+	}
+	return 0;
+}
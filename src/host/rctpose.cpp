@@ -0,0 +1,159 @@
+/*
+ * @file rctpose.cpp
+ *
+ * @description Reads UIB pose records from rctbridge's shared memory ring.
+ *
+ * Usage: rctpose [options]
+ *   --shm NAME       shared memory ring name (default /rctbridge)
+ *   --all            start at the oldest record kept rather than the next one
+ *   --count N        exit after N records
+ *   --poll-us N      sleep between polls of the ring (default 1000; 0 spins)
+ *   --latency S      print delivery latency every S seconds instead of the
+ *                    records
+ *
+ * Records are printed one JSON object per line, with the packet's keys plus
+ * the record number and the time the bridge received it.  The latency is the
+ * time from the bridge reading the end of a packet to this process reading
+ * the record, which is mostly the poll interval.  If the bridge restarts,
+ * rctpose attaches to the new ring.  This is also a minimal example of a
+ * ring consumer.
+ */
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+#include "Pose_Ring.hpp"
+
+namespace{
+	volatile sig_atomic_t running = 1;
+
+	void stop(int){
+		running = 0;
+	}
+
+	uint64_t monotonic_ns(){
+		struct timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+	}
+
+	void sleep_us(uint32_t us){
+		struct timespec ts;
+		ts.tv_sec = us / 1000000;
+		ts.tv_nsec = (us % 1000000) * 1000L;
+		nanosleep(&ts, NULL);
+	}
+
+	bool writer_alive(const Pose_Ring& ring){
+		return kill(ring.writer(), 0) == 0 || errno != ESRCH;
+	}
+
+	double percentile(std::vector<double>& v, double p){
+		if(v.empty()){
+			return 0;
+		}
+		size_t i = (size_t)(p * (v.size() - 1) + 0.5);
+		std::nth_element(v.begin(), v.begin() + i, v.end());
+		return v[i];
+	}
+
+	void usage(const char* name){
+		fprintf(stderr, "Usage: %s [--shm NAME] [--all] [--count N] "
+			"[--poll-us N] [--latency S]\n", name);
+	}
+}
+
+int main(int argc, char const *argv[]){
+	const char* shm = POSE_RING_NAME;
+	bool all = false;
+	uint64_t count = 0;
+	uint32_t poll_us = 1000;
+	double latency_s = 0;
+	for(int i = 1; i < argc; i++){
+		bool has_value = i + 1 < argc;
+		if(!strcmp(argv[i], "--shm") && has_value){
+			shm = argv[++i];
+		}else if(!strcmp(argv[i], "--all")){
+			all = true;
+		}else if(!strcmp(argv[i], "--count") && has_value){
+			count = strtoull(argv[++i], NULL, 10);
+		}else if(!strcmp(argv[i], "--poll-us") && has_value){
+			poll_us = atoi(argv[++i]);
+		}else if(!strcmp(argv[i], "--latency") && has_value){
+			latency_s = atof(argv[++i]);
+		}else{
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	signal(SIGINT, stop);
+	signal(SIGTERM, stop);
+
+	Pose_Ring ring;
+	uint64_t next = 0;
+	uint64_t read = 0;
+	uint64_t lost = 0;
+	uint64_t next_check_ns = 0;
+	uint64_t next_report_ns = monotonic_ns() + (uint64_t)(latency_s * 1e9);
+	std::vector<double> latency_us;
+	bool attached = false;
+	while(running && (count == 0 || read < count)){
+		uint64_t now = monotonic_ns();
+		if(!attached || now >= next_check_ns){
+			// Attach, or re-attach if the bridge went away
+			if(!attached || !writer_alive(ring)){
+				attached = ring.attach(shm);
+				if(!attached){
+					sleep_us(100000);
+					continue;
+				}
+				next = all ? 0 : ring.head();
+			}
+			next_check_ns = now + 1000000000ULL;
+		}
+
+		PoseRecord record;
+		if(!ring.next(&next, &record, &lost)){
+			if(poll_us){
+				sleep_us(poll_us);
+			}
+			continue;
+		}
+		read++;
+		uint64_t n = next - 1;
+		if(latency_s > 0){
+			latency_us.push_back((monotonic_ns() - record.rx_ns) / 1e3);
+			if(now >= next_report_ns){
+				printf("{\"records\": %llu, \"lost\": %llu, \"latency_us\": "
+					"{\"p50\": %.1f, \"p99\": %.1f, \"max\": %.1f}}\n",
+					(unsigned long long)read, (unsigned long long)lost,
+					percentile(latency_us, 0.5), percentile(latency_us, 0.99),
+					percentile(latency_us, 1));
+				fflush(stdout);
+				latency_us.clear();
+				next_report_ns += (uint64_t)(latency_s * 1e9);
+			}
+			continue;
+		}
+		printf("{\"seq\": %llu, \"rx_ns\": %llu, \"lat\": %ld, \"lon\": %ld, "
+			"\"hdg\": %u, \"tme\": \"%s\", \"run\": \"%s\", \"fix\": %u, "
+			"\"sat\": %u, \"dat\": \"%s\", \"uts\": %lu, \"uib_ns\": %llu}\n",
+			(unsigned long long)n, (unsigned long long)record.rx_ns,
+			(long)record.lat, (long)record.lon, record.hdg, record.time,
+			record.run ? "true" : "false", record.fix, record.sat, record.date,
+			(unsigned long)record.uts, (unsigned long long)record.uib_ns);
+		fflush(stdout);
+	}
+	if(lost){
+		fprintf(stderr, "%llu records lost\n", (unsigned long long)lost);
+	}
+	return 0;
+}
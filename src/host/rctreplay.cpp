@@ -0,0 +1,236 @@
+/*
+ * @file rctreplay.cpp
+ *
+ * @description Replays a capture file through the firmware parsers.
+ *
+ * Usage: rctreplay [options] FILE
+ *   --realtime      pace the replay by the capture timestamps
+ *   --speed X       with --realtime, play X times faster (default 1)
+ *   --out FILE      write the sensor packets produced to FILE, one per line,
+ *                   prefixed with the capture time in us
+ *   --dump          print the chunks of the capture instead of replaying it
+ *
+ * GPS bytes are fed to a Sensor_Module and OBC bytes to an RTCM_Relay and,
+ * if it does not claim them, a Status_Module, compiled from the firmware sources against the virtual time HAL.  The
+ * replay starts from the default configuration, and configuration changes
+ * in the capture are applied to the Sensor_Module as the firmware does.  Virtual
+ * time follows the capture timestamps, so a replay is deterministic whether
+ * it is paced or run as fast as possible.  A summary of the replay is written
+ * to stdout as JSON; the packet counts can be compared against the packets
+ * the UIB actually sent when the capture includes the obc_tx port.
+ */
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+#include "Capture.hpp"
+#include "hal_virtual.hpp"
+#include "../ui_core.hpp"
+#include "../Config_Store.hpp"
+#include "../RTCM_Relay.hpp"
+#include "../Sensor_Module.hpp"
+#include "../Status_Module.hpp"
+
+RCT_HAL_System_t systemDescriptor;
+RCT_HAL_System_t* pHALSystem = &systemDescriptor;
+
+void timer_tick(void){
+}
+
+namespace{
+	void dump(Capture_Reader& capture){
+		CaptureChunk chunk;
+		while(capture.next(chunk)){
+			printf("%12.6f %-6s %4zu ", chunk.t_us / 1e6,
+				capture_port_name(chunk.port), chunk.data.size());
+			for(size_t i = 0; i < chunk.data.size(); i++){
+				unsigned char c = chunk.data[i];
+				if(c >= 0x20 && c < 0x7F && c != '\\'){
+					putchar(c);
+				}else{
+					printf("\\x%02X", c);
+				}
+			}
+			putchar('\n');
+		}
+	}
+
+	/**
+	 * Counts sensor packets in a chunk of UIB output.
+	 */
+	unsigned count_packets(const std::string& data, std::string& line){
+		unsigned packets = 0;
+		for(size_t i = 0; i < data.size(); i++){
+			if(data[i] == '\n'){
+				if(line.compare(0, 8, "{\"lat\": ") == 0){
+					packets++;
+				}
+				line.clear();
+			}else if(data[i] != '\r'){
+				line += data[i];
+			}
+		}
+		return packets;
+	}
+}
+
+int main(int argc, char const *argv[]){
+	bool realtime = false;
+	bool dump_only = false;
+	double speed = 1;
+	const char* input = NULL;
+	FILE* out = NULL;
+	for(int i = 1; i < argc; i++){
+		if(!strcmp(argv[i], "--realtime")){
+			realtime = true;
+		}else if(!strcmp(argv[i], "--speed") && i + 1 < argc){
+			speed = atof(argv[++i]);
+		}else if(!strcmp(argv[i], "--out") && i + 1 < argc){
+			out = fopen(argv[++i], "w");
+			if(out == NULL){
+				perror(argv[i]);
+				return 1;
+			}
+		}else if(!strcmp(argv[i], "--dump")){
+			dump_only = true;
+		}else if(input == NULL){
+			input = argv[i];
+		}else{
+			input = NULL;
+			break;
+		}
+	}
+	if(input == NULL || speed <= 0){
+		fprintf(stderr, "Usage: %s [--realtime] [--speed X] [--out FILE] "
+			"[--dump] FILE\n", argv[0]);
+		return 1;
+	}
+
+	Capture_Reader capture;
+	if(!capture.open(input)){
+		fprintf(stderr, "%s: not a capture file\n", input);
+		return 1;
+	}
+	if(dump_only){
+		dump(capture);
+		if(capture.error() != NULL){
+			fprintf(stderr, "%s: %s\n", input, capture.error());
+			return 1;
+		}
+		return 0;
+	}
+
+	RCT_HAL_Init(pHALSystem);
+	RCT_Virtual_SetInput(10, HIGH);
+	StatusPacket status;
+	ConfigPacket config;
+	Config_Store::defaults(&config);
+	Sensor_Module sensor(&status.gps);
+	Status_Module obc(&status, &config);
+	RTCM_Relay rtcm;
+	sensor.configure(config);
+	sensor.start();
+
+	char packet[SENSOR_PACKET_MAX_LEN];
+	uint64_t bytes[CAP_PORT__SIZE] = {0};
+	uint64_t chunks = 0;
+	uint64_t last_us = 0;
+	unsigned packets = 0;
+	unsigned recorded_packets = 0;
+	std::string tx_line;
+	auto start = std::chrono::steady_clock::now();
+	CaptureChunk chunk;
+	while(capture.next(chunk)){
+		chunks++;
+		if(chunk.port < CAP_PORT__SIZE){
+			bytes[chunk.port] += chunk.data.size();
+		}
+		if(realtime){
+			std::this_thread::sleep_until(start + std::chrono::microseconds(
+				(uint64_t)(chunk.t_us / speed)));
+		}
+		// The OBC link is empty between chunks
+		rtcm.idle(pHALSystem->RCT_Micros());
+		RCT_Virtual_Advance((chunk.t_us - last_us) * 1000ULL);
+		last_us = chunk.t_us;
+		rtcm.idle(pHALSystem->RCT_Micros());
+
+		switch(chunk.port){
+			case CAP_PORT_GPS:
+				for(size_t i = 0; i < chunk.data.size(); i++){
+					sensor.service();
+					if(sensor.decode(chunk.data[i])){
+						sensor.getPacket(packet, sizeof(packet));
+						packets++;
+						if(out != NULL){
+							fprintf(out, "%llu %s\n",
+								(unsigned long long)chunk.t_us, packet);
+						}
+					}
+				}
+				break;
+			case CAP_PORT_OBC_RX:
+				for(size_t i = 0; i < chunk.data.size(); i++){
+					if(rtcm.decode(chunk.data[i])
+							|| !obc.decode(chunk.data[i])){
+						continue;
+					}
+					uint8_t applied, rejected;
+					if(obc.getConfigAck(&applied, &rejected)){
+						sensor.configure(config);
+					}
+					if(obc.getRequest() == REQ_CONFIG_RESET){
+						Config_Store::defaults(&config);
+						sensor.configure(config);
+					}
+				}
+				// Drain the relay as the main loop would, and throw away
+				// what it sent to the receiver
+				rtcm.service(pHALSystem->RCT_SerialGPS);
+				virtual_gps.reset();
+				break;
+			case CAP_PORT_OBC_TX:
+				recorded_packets += count_packets(chunk.data, tx_line);
+				break;
+			default:
+				break;
+		}
+	}
+	if(capture.error() != NULL){
+		fprintf(stderr, "%s: %s after %llu chunks\n", input, capture.error(),
+			(unsigned long long)chunks);
+		return 1;
+	}
+	double wall_s = std::chrono::duration<double>(
+		std::chrono::steady_clock::now() - start).count();
+	if(out != NULL){
+		fclose(out);
+	}
+
+	DiagnosticsPacket diag;
+	memset(&diag, 0, sizeof(diag));
+	sensor.getDiagnostics(&diag);
+	obc.getDiagnostics(&diag);
+	rtcm.getDiagnostics(&diag);
+	printf("{\"chunks\": %llu, \"duration_s\": %.3f, \"replay_s\": %.3f, "
+		"\"speedup\": %.1f", (unsigned long long)chunks, last_us / 1e6, wall_s,
+		wall_s > 0 ? last_us / 1e6 / wall_s : 0);
+	for(uint8_t p = 0; p < CAP_PORT__SIZE; p++){
+		printf(", \"%s_bytes\": %llu", capture_port_name(p),
+			(unsigned long long)bytes[p]);
+	}
+	printf(", \"packets\": %u, \"recorded_packets\": %u, "
+		"\"nmea_sentences\": %u, \"nmea_checksum_errors\": %u, "
+		"\"nmea_runaway_resets\": %u, \"status_messages\": %u, "
+		"\"status_resyncs\": %u, \"status_rejects\": %u, "
+		"\"rtcm_frames\": %u, \"rtcm_crc_errors\": %u, "
+		"\"rtcm_dropped\": %u, \"rtcm_timeouts\": %u}\n", packets,
+		recorded_packets,
+		diag.nmea_sentences, diag.nmea_checksum_errors,
+		diag.nmea_runaway_resets, diag.status_messages, diag.status_resyncs,
+		diag.status_rejects, diag.rtcm_frames, diag.rtcm_crc_errors,
+		diag.rtcm_dropped, diag.rtcm_timeouts);
+	return 0;
+}
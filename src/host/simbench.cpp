@@ -0,0 +1,368 @@
+/*
+ * @file simbench.cpp
+ *
+ * @description Cycle accurate benchmarks of the UIB firmware under simavr.
+ *
+ * Usage: simbench [options] ELF
+ *   --uart FILE[:BAUD]  script FILE into UART1 (the GPS port) at BAUD
+ *                       (default 9600)
+ *   --uart-delay MS     start the UART script MS simulated ms after reset,
+ *                       once the image is in its main loop (default 1000)
+ *   --func NAME         time every call of function NAME, inclusive of
+ *                       callees; needs --nm.  May be repeated
+ *   --nm FILE           avr-nm output for the ELF, to resolve --func names
+ *   --seconds S         stop after S simulated seconds (default 60)
+ *   --format F          csv or json (default json)
+ *
+ * Marker benchmarks: images built with Bench_Marker.hpp (bench_avr.elf)
+ * bracket each unit of work with GPIOR0 writes.  Every START to STOP pair is
+ * timed in CPU cycles, and the minimum empty pair is subtracted as the marker
+ * overhead.  The run ends when the image writes BENCH_MARK_DONE.
+ *
+ * Function benchmarks: any image, including the production ui_core.elf, can
+ * be timed per function.  A call starts when the PC reaches the function's
+ * entry and ends when the stack pointer rises above its value at entry, i.e.
+ * on the matching ret or reti.  Interrupt vectors (e.g. __vector_17, the
+ * Timer 1 compare ISR) work the same way, so ISR entry and exit are counted.
+ *
+ * Needs simavr (https://github.com/buserror/simavr) and libelf; set
+ * SIMAVR_DIR in the Makefile if it is not installed under /usr/local.
+ */
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <simavr/sim_avr.h>
+#include <simavr/sim_elf.h>
+#include <simavr/sim_io.h>
+#include <simavr/sim_cycle_timers.h>
+#include <simavr/avr_uart.h>
+
+#include "../Bench_Marker.hpp"
+
+#define SIMBENCH_FREQUENCY 16000000UL
+
+namespace{
+	const char* const BENCH_NAMES[BENCH__SIZE] = {
+		"empty",
+		"nmea_byte",
+		"rmc_sentence",
+		"gga_sentence",
+		"get_packet",
+		"compass_read",
+		"timer_isr",
+		"uart_byte"
+	};
+
+	struct Stats{
+		std::string name;
+		uint64_t count = 0;
+		uint64_t total = 0;
+		uint64_t min = UINT64_MAX;
+		uint64_t max = 0;
+		/// Measurement overhead to subtract, in cycles
+		uint64_t overhead = 0;
+
+		void add(uint64_t cycles){
+			count++;
+			total += cycles;
+			min = std::min(min, cycles);
+			max = std::max(max, cycles);
+		}
+	};
+
+	struct Function{
+		Stats stats;
+		avr_flashaddr_t addr;
+		// Stack pointers of the calls in progress, innermost last
+		std::vector<uint16_t> sp;
+		std::vector<avr_cycle_count_t> start;
+	};
+
+	struct Harness{
+		avr_t* avr = NULL;
+		bool done = false;
+		uint8_t bench_id = 0;
+		avr_cycle_count_t bench_start = 0;
+		bool bench_running = false;
+		Stats marks[BENCH__SIZE];
+
+		std::string uart_data;
+		size_t uart_next = 0;
+		uint32_t uart_us = 1042;
+		avr_irq_t* uart_in = NULL;
+		bool uart_xon = true;
+
+		std::vector<Function> functions;
+	};
+
+	void gpior0_write(avr_t* avr, avr_io_addr_t addr, uint8_t v, void* param){
+		Harness* h = (Harness*)param;
+		avr->data[addr] = v;
+		switch(v){
+			case BENCH_MARK_START:
+				h->bench_id = avr->data[BENCH_GPIOR1_ADDR];
+				h->bench_start = avr->cycle;
+				h->bench_running = true;
+				break;
+			case BENCH_MARK_STOP:
+				if(h->bench_running && h->bench_id < BENCH__SIZE){
+					h->marks[h->bench_id].add(avr->cycle - h->bench_start);
+				}
+				h->bench_running = false;
+				break;
+			case BENCH_MARK_DONE:
+				h->done = true;
+				break;
+			default:
+				break;
+		}
+	}
+
+	void uart_xon(avr_irq_t* irq, uint32_t value, void* param){
+		((Harness*)param)->uart_xon = true;
+	}
+
+	void uart_xoff(avr_irq_t* irq, uint32_t value, void* param){
+		((Harness*)param)->uart_xon = false;
+	}
+
+	avr_cycle_count_t uart_feed(avr_t* avr, avr_cycle_count_t when,
+			void* param){
+		Harness* h = (Harness*)param;
+		if(h->uart_next >= h->uart_data.size()){
+			return 0;
+		}
+		// The UART model raises XOFF while its receive register is full;
+		// a real receiver would overrun, so the byte is dropped the same way
+		if(h->uart_xon){
+			avr_raise_irq(h->uart_in, (uint8_t)h->uart_data[h->uart_next]);
+		}
+		h->uart_next++;
+		return when + avr_usec_to_cycles(avr, h->uart_us);
+	}
+
+	bool load_uart(Harness& h, const char* spec){
+		std::string path = spec;
+		uint32_t baud = 9600;
+		size_t colon = path.rfind(':');
+		if(colon != std::string::npos){
+			baud = atoi(path.c_str() + colon + 1);
+			path.resize(colon);
+		}
+		std::ifstream in(path, std::ios::binary);
+		if(!in || baud == 0){
+			return false;
+		}
+		std::stringstream ss;
+		ss << in.rdbuf();
+		h.uart_data = ss.str();
+		// 10 bits per byte, rounded up to whole us
+		h.uart_us = (10000000UL + baud - 1) / baud;
+		return true;
+	}
+
+	bool resolve(Harness& h, const char* nm_file, const std::vector<std::string>& names){
+		std::map<std::string, avr_flashaddr_t> symbols;
+		std::ifstream in(nm_file);
+		std::string line;
+		while(std::getline(in, line)){
+			// "<address> <type> <name>", where the name may contain spaces
+			std::istringstream ls(line);
+			std::string addr;
+			std::string type;
+			if(!(ls >> addr >> type) || (type != "T" && type != "t")){
+				continue;
+			}
+			std::string name;
+			std::getline(ls >> std::ws, name);
+			symbols[name] = strtoul(addr.c_str(), NULL, 16);
+		}
+		for(size_t i = 0; i < names.size(); i++){
+			std::map<std::string, avr_flashaddr_t>::iterator it =
+				symbols.find(names[i]);
+			if(it == symbols.end()){
+				fprintf(stderr, "%s: no such function in %s\n",
+					names[i].c_str(), nm_file);
+				return false;
+			}
+			Function f;
+			f.stats.name = names[i];
+			f.addr = it->second;
+			h.functions.push_back(f);
+		}
+		return true;
+	}
+
+	uint16_t stack_pointer(avr_t* avr){
+		return avr->data[R_SPL] | (avr->data[R_SPH] << 8);
+	}
+
+	void trace_functions(Harness& h){
+		uint16_t sp = stack_pointer(h.avr);
+		for(size_t i = 0; i < h.functions.size(); i++){
+			Function& f = h.functions[i];
+			while(!f.sp.empty() && sp > f.sp.back()){
+				f.stats.add(h.avr->cycle - f.start.back());
+				f.sp.pop_back();
+				f.start.pop_back();
+			}
+			if(h.avr->pc == f.addr){
+				f.sp.push_back(sp);
+				f.start.push_back(h.avr->cycle);
+			}
+		}
+	}
+
+	void print(const std::vector<Stats>& results, bool json,
+			avr_cycle_count_t cycles){
+		if(!json){
+			printf("benchmark,count,min_cycles,mean_cycles,max_cycles,"
+				"min_us,mean_us\n");
+		}
+		for(size_t i = 0; i < results.size(); i++){
+			const Stats& s = results[i];
+			uint64_t overhead = s.overhead;
+			uint64_t min = s.min - std::min(s.min, overhead);
+			uint64_t max = s.max - std::min(s.max, overhead);
+			double mean = (double)s.total / s.count - overhead;
+			if(json){
+				printf("{\"bench\": \"%s\", \"cnt\": %llu, \"min\": %llu, "
+					"\"mean\": %.1f, \"max\": %llu, \"min_us\": %.3f, "
+					"\"mean_us\": %.3f}\n", s.name.c_str(),
+					(unsigned long long)s.count, (unsigned long long)min, mean,
+					(unsigned long long)max, min * 1e6 / SIMBENCH_FREQUENCY,
+					mean * 1e6 / SIMBENCH_FREQUENCY);
+			}else{
+				printf("%s,%llu,%llu,%.1f,%llu,%.3f,%.3f\n", s.name.c_str(),
+					(unsigned long long)s.count, (unsigned long long)min, mean,
+					(unsigned long long)max, min * 1e6 / SIMBENCH_FREQUENCY,
+					mean * 1e6 / SIMBENCH_FREQUENCY);
+			}
+		}
+		if(json){
+			printf("{\"cycles\": %llu}\n", (unsigned long long)cycles);
+		}
+	}
+
+	void usage(const char* name){
+		fprintf(stderr, "Usage: %s [--uart FILE[:BAUD]] [--uart-delay MS] "
+			"[--func NAME]... [--nm FILE] [--seconds S] [--format csv|json] "
+			"ELF\n", name);
+	}
+}
+
+int main(int argc, char* argv[]){
+	Harness h;
+	const char* elf = NULL;
+	const char* nm_file = NULL;
+	const char* uart = NULL;
+	std::vector<std::string> funcs;
+	double seconds = 60;
+	uint32_t uart_delay_ms = 1000;
+	bool json = true;
+	for(int i = 1; i < argc; i++){
+		bool has_value = i + 1 < argc;
+		if(!strcmp(argv[i], "--uart") && has_value){
+			uart = argv[++i];
+		}else if(!strcmp(argv[i], "--uart-delay") && has_value){
+			uart_delay_ms = atoi(argv[++i]);
+		}else if(!strcmp(argv[i], "--func") && has_value){
+			funcs.push_back(argv[++i]);
+		}else if(!strcmp(argv[i], "--nm") && has_value){
+			nm_file = argv[++i];
+		}else if(!strcmp(argv[i], "--seconds") && has_value){
+			seconds = atof(argv[++i]);
+		}else if(!strcmp(argv[i], "--format") && has_value){
+			json = strcmp(argv[++i], "csv") != 0;
+		}else if(elf == NULL && argv[i][0] != '-'){
+			elf = argv[i];
+		}else{
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if(elf == NULL || (!funcs.empty() && nm_file == NULL)){
+		usage(argv[0]);
+		return 1;
+	}
+	if(!funcs.empty() && !resolve(h, nm_file, funcs)){
+		return 1;
+	}
+	if(uart != NULL && !load_uart(h, uart)){
+		fprintf(stderr, "Unable to read %s\n", uart);
+		return 1;
+	}
+
+	elf_firmware_t firmware;
+	memset(&firmware, 0, sizeof(firmware));
+	if(elf_read_firmware(elf, &firmware) != 0){
+		fprintf(stderr, "Unable to load %s\n", elf);
+		return 1;
+	}
+	h.avr = avr_make_mcu_by_name("atmega32u4");
+	if(h.avr == NULL){
+		fprintf(stderr, "simavr has no ATmega32U4 core\n");
+		return 1;
+	}
+	avr_init(h.avr);
+	avr_load_firmware(h.avr, &firmware);
+	h.avr->frequency = SIMBENCH_FREQUENCY;
+
+	avr_register_io_write(h.avr, BENCH_GPIOR0_ADDR, gpior0_write, &h);
+	for(uint8_t i = 0; i < BENCH__SIZE; i++){
+		h.marks[i].name = BENCH_NAMES[i];
+	}
+
+	if(!h.uart_data.empty()){
+		uint32_t flags = 0;
+		avr_ioctl(h.avr, AVR_IOCTL_UART_GET_FLAGS('1'), &flags);
+		flags &= ~AVR_UART_FLAG_STDIO;
+		avr_ioctl(h.avr, AVR_IOCTL_UART_SET_FLAGS('1'), &flags);
+		h.uart_in = avr_io_getirq(h.avr, AVR_IOCTL_UART_GETIRQ('1'),
+			UART_IRQ_INPUT);
+		avr_irq_register_notify(avr_io_getirq(h.avr,
+			AVR_IOCTL_UART_GETIRQ('1'), UART_IRQ_OUT_XON), uart_xon, &h);
+		avr_irq_register_notify(avr_io_getirq(h.avr,
+			AVR_IOCTL_UART_GETIRQ('1'), UART_IRQ_OUT_XOFF), uart_xoff, &h);
+		avr_cycle_timer_register_usec(h.avr, uart_delay_ms * 1000UL, uart_feed,
+			&h);
+	}
+
+	const avr_cycle_count_t limit =
+		(avr_cycle_count_t)(seconds * SIMBENCH_FREQUENCY);
+	int state = cpu_Running;
+	while(!h.done && h.avr->cycle < limit
+			&& state != cpu_Done && state != cpu_Crashed){
+		if(!h.functions.empty()){
+			trace_functions(h);
+		}
+		state = avr_run(h.avr);
+	}
+	if(state == cpu_Crashed){
+		fprintf(stderr, "Simulation crashed at PC 0x%04X\n", h.avr->pc);
+	}
+
+	std::vector<Stats> results;
+	uint64_t overhead = h.marks[BENCH_EMPTY].count ? h.marks[BENCH_EMPTY].min
+		: 0;
+	for(uint8_t i = BENCH_EMPTY + 1; i < BENCH__SIZE; i++){
+		if(h.marks[i].count){
+			h.marks[i].overhead = overhead;
+			results.push_back(h.marks[i]);
+		}
+	}
+	for(size_t i = 0; i < h.functions.size(); i++){
+		if(h.functions[i].stats.count){
+			results.push_back(h.functions[i].stats);
+		}
+	}
+	print(results, json, h.avr->cycle);
+	return state == cpu_Crashed;
+}
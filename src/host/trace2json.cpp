@@ -0,0 +1,161 @@
+/*
+ * @file trace2json.cpp
+ *
+ * @description Converts an event trace dump from the UIB trace build into the
+ * Chrome trace event format, for viewing in chrome://tracing or Perfetto.
+ *
+ * Usage: trace2json [dump] [output.json]
+ *
+ * The dump is the raw OBC serial stream captured after sending {"REQ": 4};
+ * lines other than the trace header and records are ignored, so a full
+ * session log can be converted directly.  Several dumps may be concatenated.
+ */
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../Trace_Event.hpp"
+
+namespace{
+	const int TID_LOOP = 1;
+	const int TID_ISR = 2;
+
+	struct Event{
+		double ts_us;
+		int event;
+		int arg;
+	};
+
+	void write_event(std::ostream& out, bool& first, const std::string& body){
+		out << (first ? "\n" : ",\n") << "\t{" << body << "}";
+		first = false;
+	}
+
+	std::string common(const char* name, const char* ph, double ts, int tid){
+		char buf[128];
+		snprintf(buf, sizeof(buf),
+			"\"name\": \"%s\", \"ph\": \"%s\", \"ts\": %.3f, \"pid\": 1, "
+			"\"tid\": %d", name, ph, ts, tid);
+		return buf;
+	}
+}
+
+int main(int argc, char const *argv[]){
+	std::ifstream in_file;
+	std::ofstream out_file;
+	if(argc > 1){
+		in_file.open(argv[1]);
+		if(!in_file){
+			std::cerr << "Unable to open " << argv[1] << std::endl;
+			return 1;
+		}
+	}
+	if(argc > 2){
+		out_file.open(argv[2]);
+		if(!out_file){
+			std::cerr << "Unable to open " << argv[2] << std::endl;
+			return 1;
+		}
+	}
+	std::istream& in = (argc > 1) ? in_file : std::cin;
+	std::ostream& out = (argc > 2) ? out_file : std::cout;
+
+	std::vector<Event> events;
+	double clock_hz = 16e6;
+	uint64_t epoch = 0;
+	uint32_t last_ts = 0;
+	bool have_ts = false;
+	std::string line;
+	while(std::getline(in, line)){
+		unsigned long count, clk, ts;
+		int event, arg;
+		if(sscanf(line.c_str(), " {\"trc\": %lu, \"clk\": %lu}", &count,
+				&clk) == 2){
+			clock_hz = clk;
+			continue;
+		}
+		if(sscanf(line.c_str(), " {\"tev\": %lu, \"eid\": %d, \"arg\": %d}",
+				&ts, &event, &arg) != 3){
+			continue;
+		}
+		// The cycle counter is 32 bits wide, so unwrap it
+		if(have_ts && (uint32_t)ts < last_ts){
+			epoch += 1ULL << 32;
+		}
+		last_ts = ts;
+		have_ts = true;
+		Event e = {(epoch + ts) * 1e6 / clock_hz, event, arg};
+		events.push_back(e);
+	}
+
+	out << "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [";
+	bool first = true;
+	write_event(out, first, "\"name\": \"thread_name\", \"ph\": \"M\", "
+		"\"pid\": 1, \"tid\": 1, \"args\": {\"name\": \"loop\"}");
+	write_event(out, first, "\"name\": \"thread_name\", \"ph\": \"M\", "
+		"\"pid\": 1, \"tid\": 2, \"args\": {\"name\": \"timer_isr\"}");
+
+	bool sentence_open = false, packet_open = false;
+	double sentence_start = 0, packet_start = 0;
+	for(const Event& e : events){
+		char args[64];
+		switch(e.event){
+			case TRACE_SENTENCE_START:
+				// An unterminated sentence was dropped by the parser
+				sentence_open = true;
+				sentence_start = e.ts_us;
+				break;
+			case TRACE_SENTENCE_END:
+				if(sentence_open){
+					snprintf(args, sizeof(args),
+						", \"dur\": %.3f, \"args\": {\"type\": \"%c\"}",
+						e.ts_us - sentence_start, (char)e.arg);
+					write_event(out, first, common("sentence", "X",
+						sentence_start, TID_LOOP) + args);
+				}
+				sentence_open = false;
+				break;
+			case TRACE_PACKET_START:
+				packet_open = true;
+				packet_start = e.ts_us;
+				break;
+			case TRACE_PACKET_END:
+				if(packet_open){
+					snprintf(args, sizeof(args),
+						", \"dur\": %.3f, \"args\": {\"len\": %d}",
+						e.ts_us - packet_start, e.arg);
+					write_event(out, first, common("packet", "X",
+						packet_start, TID_LOOP) + args);
+				}
+				packet_open = false;
+				break;
+			case TRACE_COMPASS_SAMPLE:
+				snprintf(args, sizeof(args),
+					", \"s\": \"t\", \"args\": {\"hdg\": %d}", e.arg * 2);
+				write_event(out, first, common("compass", "i", e.ts_us,
+					TID_LOOP) + args);
+				break;
+			case TRACE_OBC_STATUS:
+				write_event(out, first, common("obc_status", "i", e.ts_us,
+					TID_LOOP) + ", \"s\": \"t\"");
+				break;
+			case TRACE_TIMER_ISR:
+				write_event(out, first, common("timer_isr", "i", e.ts_us,
+					TID_ISR) + ", \"s\": \"t\"");
+				break;
+			default:
+				snprintf(args, sizeof(args),
+					", \"s\": \"t\", \"args\": {\"eid\": %d, \"arg\": %d}",
+					e.event, e.arg);
+				write_event(out, first, common("unknown", "i", e.ts_us,
+					TID_LOOP) + args);
+				break;
+		}
+	}
+	out << "\n]}" << std::endl;
+	return 0;
+}
@@ -43,6 +43,9 @@ NMEA::NMEA(int connect)
 	_state = 0;
 	_parity = 0;
 	_nt = 0;
+	_sentences = 0;
+	_checksum_errors = 0;
+	_runaway_resets = 0;
 
 	f_sentence[0] = 0;
 	f_terms = 0;
@@ -61,7 +64,10 @@ NMEA::NMEA(int connect)
 
 int NMEA::decode(char c) {
 	// avoid runaway sentences (>99 chars or >29 terms) and terms (>14 chars)
-	if ((n >= 100) || (_terms >= 30) || (_nt >= 15)) { _state = 0; }
+	if ((n >= 100) || (_terms >= 30) || (_nt >= 15)) {
+		if (_state != 0) { _runaway_resets++; }
+		_state = 0;
+	}
 	// LF and CR always reset parser
 	if ((c == 0x0A) || (c == 0x0D)) { _state = 0; }
 	// '$' always starts a new sentence
@@ -165,9 +171,13 @@ int NMEA::decode(char c) {
 					_gprmc_angle = _decimal(_term[8]);
 				}
 				// sentence accepted!
+				_sentences++;
 				return 1;
 			}
 		}
+		else {
+			_checksum_errors++;
+		}
 		break;
 	default:
 		_state = 0;
@@ -250,6 +260,21 @@ int NMEA::libversion() {
 	return _LIB_VERSION;
 }
 
+unsigned int NMEA::sentences() {
+	// returns number of sentences accepted
+	return _sentences;
+}
+
+unsigned int NMEA::checksum_errors() {
+	// returns number of sentences rejected for a bad checksum
+	return _checksum_errors;
+}
+
+unsigned int NMEA::runaway_resets() {
+	// returns number of runaway sentences discarded
+	return _runaway_resets;
+}
+
 
 //
 // private methods
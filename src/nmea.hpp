@@ -70,6 +70,12 @@ class NMEA
 		float	term_decimal(int t);
 		/// returns software version number of NMEA library
 		int		libversion();
+		/// returns number of sentences accepted since construction
+		unsigned int	sentences();
+		/// returns number of sentences rejected for a bad checksum since construction
+		unsigned int	checksum_errors();
+		/// returns number of runaway sentences (too long, too many terms) discarded since construction
+		unsigned int	runaway_resets();
   private:
   	// properties
 		int		_gprmc_only;
@@ -79,11 +85,12 @@ class NMEA
 		float	_gprmc_long;
 		float	_gprmc_speed;
 		float	_gprmc_angle;
-		char	f_sentence[100];
+		// 100 sentence characters and the terminating zero
+		char	f_sentence[101];
 		char*	f_term[30];
 		int		f_terms;
 		int		_terms;
-		char	_sentence[100];
+		char	_sentence[101];
 		char*	_term[30];
 		int		n;
 		int		_gprmc_tag;
@@ -91,6 +98,9 @@ class NMEA
 		int		_parity;
 		int		_nt;
 		float	_degs;
+		unsigned int	_sentences;
+		unsigned int	_checksum_errors;
+		unsigned int	_runaway_resets;
 		// methods
 		float distance_between (float lat1, float long1, float lat2, float long2, float units_per_meter);
 		float	initial_course(float lat1, float long1, float lat2, float long2);
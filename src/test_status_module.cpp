@@ -1,4 +1,5 @@
 #include <cassert>
+#include <cstring>
 #include <iostream>
 #include "Status_Packet.hpp"
 
@@ -6,7 +7,7 @@
 #define protected public
 #include "Status_Module.hpp"
 #undef private
-#undef public
+#undef protected
 
 using namespace std;
 
@@ -47,7 +48,7 @@ void testSelfPacket(const char* testString){
 	// std::cout << "System: " << status.system << std::endl;
 	// std::cout << "SDR: " << status.sdr << std::endl;
 	assert(status.storage == STR_READY);
-	assert(status.system == SYS_RETRY);
+	assert(status.system == SYS_FAIL);
 	assert(status.sdr == SDR_FAIL);
 }
 
@@ -66,13 +67,61 @@ void testGlobalPacket(const char* testString){
 	// std::cout << "System: " << packet.system << std::endl;
 	// std::cout << "SDR: " << packet.sdr << std::endl;
 	assert(packet.storage == STR_READY);
-	assert(packet.system == SYS_RETRY);
+	assert(packet.system == SYS_FAIL);
 	assert(packet.sdr == SDR_FAIL);
 }
 
+void testRejects(){
+	Status_Module testModule;
+	const char* testString = "{\"STR\": 9, \"SYS\": 4294967299, \"SDR\": 3, "
+		"\"XYZ\": 1, \"REQ\": 1}";
+	int messages = 0;
+	for(size_t i = 0; testString[i] != '\0'; i++){
+		messages += testModule.decode(testString[i]);
+	}
+	const StatusPacket status = testModule.getStatus();
+	assert(messages == 1);
+	assert(status.storage == STR_GET_OUTPUT_DIR);
+	assert(status.system == SYS_INIT);
+	assert(status.sdr == SDR_READY);
+	assert(testModule.getRequest() == REQ_DIAGNOSTICS);
+	assert(testModule.rejects == 3);
+	assert(testModule.resyncs == 0);
+}
+
+void testConfig(){
+	StatusPacket packet;
+	ConfigPacket config;
+	memset(&config, 0, sizeof(config));
+	Status_Module testModule(&packet, &config);
+	const char* testString = "{\"OPR\": 500, \"GRT\": 11, \"GTO\": 2000, "
+		"\"STR\": 4}";
+	for(size_t i = 0; testString[i] != '\0'; i++){
+		testModule.decode(testString[i]);
+	}
+	uint8_t applied, rejected;
+	assert(testModule.getConfigAck(&applied, &rejected));
+	assert(applied == 2 && rejected == 1);
+	assert(config.output_period_ms == 500);
+	assert(config.gps_rate_hz == 0);
+	assert(config.gps_timeout_ms == 2000);
+	assert(packet.storage == STR_READY);
+	assert(!testModule.getConfigAck(&applied, &rejected));
+
+	// Without a ConfigPacket the configuration keys are rejected
+	Status_Module statusOnly(&packet);
+	for(size_t i = 0; testString[i] != '\0'; i++){
+		statusOnly.decode(testString[i]);
+	}
+	assert(!statusOnly.getConfigAck(&applied, &rejected));
+	assert(statusOnly.rejects == 3);
+}
+
 int main(int argc, char const *argv[]){
-	const char* testString = "{ \"STR\" : 1 , \"SYS\" : 3 , \"SDR\" : 2  }  ";
+	const char* testString = "{ \"STR\" : 4 , \"SYS\" : 6 , \"SDR\" : 4  }  ";
 	testSelfPacket(testString);
 	testGlobalPacket(testString);
+	testRejects();
+	testConfig();
 	return 0;
 }
\ No newline at end of file
@@ -0,0 +1,313 @@
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include "Delta_Encoder.hpp"
+#include "RTCM_Relay.hpp"
+#include "host/Delta_Decoder.hpp"
+#include "host/Clock_Sync.hpp"
+
+#define LINE_MAX_LEN (DELTA_LINE_MAX + 1)
+
+bool sameFix(const DeltaFix& a, const DeltaFix& b){
+	return a.lat == b.lat && a.lon == b.lon && a.hdg == b.hdg
+		&& a.time_cs == b.time_cs && a.uts == b.uts && a.date == b.date
+		&& a.sat == b.sat && a.fix == b.fix && a.run == b.run;
+}
+
+/**
+ * The i-th fix of a track crossing the equator and the antimeridian, with the
+ * heading wrapping and the UIB clock wrapping.
+ */
+DeltaFix trackFix(int i){
+	DeltaFix fix;
+	fix.lat = -250 + i * 37;
+	fix.lon = 1799999900 - i * 53;
+	fix.hdg = (355 + i * 3) % 360;
+	fix.time_cs = 8639900 + i * 20;
+	fix.uts = 0xFFFFFF00UL + i * 200000UL;
+	fix.date = 191026;
+	fix.sat = 4 + i % 9;
+	fix.fix = i % 5 != 0;
+	fix.run = i % 2;
+	return fix;
+}
+
+/**
+ * Whether a line holds a key frame: only a key frame decodes without a base.
+ */
+bool isKeyframe(const char* line){
+	Delta_Decoder decoder;
+	DeltaFix fix;
+	return decoder.decode(line, &fix) == DELTA_OK;
+}
+
+void testDeltaRoundTrip(){
+	Delta_Encoder encoder;
+	Delta_Decoder decoder;
+	char line[LINE_MAX_LEN];
+	for(int i = 0; i < 25; i++){
+		DeltaFix fix = trackFix(i);
+		int len = encoder.encode(fix, 8, line, sizeof(line));
+		assert(len > 0 && len <= DELTA_LINE_MAX);
+		assert((int)strlen(line) == len);
+		assert(line[0] == DELTA_MARK);
+		DeltaFix decoded;
+		assert(decoder.decode(line, &decoded) == DELTA_OK);
+		assert(sameFix(fix, decoded));
+	}
+	// Key frames at 0, 8, 16 and 24
+	assert(decoder.frames == 25);
+	assert(decoder.keyframes == 4);
+	assert(decoder.lost == 0 && decoder.invalid == 0 && decoder.skipped == 0);
+
+	// Truncated output still counts the whole line
+	char small[8];
+	int len = encoder.encode(trackFix(25), 8, small, sizeof(small));
+	assert(len > (int)sizeof(small) - 1);
+	assert(strlen(small) == sizeof(small) - 1);
+}
+
+void testDeltaDateChange(){
+	Delta_Encoder encoder;
+	Delta_Decoder decoder;
+	char line[LINE_MAX_LEN];
+	DeltaFix fix = trackFix(0);
+	DeltaFix decoded;
+	for(int i = 0; i < 3; i++){
+		encoder.encode(fix, 255, line, sizeof(line));
+		assert(decoder.decode(line, &decoded) == DELTA_OK);
+		fix.time_cs += 20;
+	}
+	assert(decoder.keyframes == 1);
+
+	// Midnight: the date only travels in key frames
+	fix.date = 201026;
+	fix.time_cs = 0;
+	encoder.encode(fix, 255, line, sizeof(line));
+	assert(decoder.decode(line, &decoded) == DELTA_OK);
+	assert(decoder.keyframes == 2);
+	assert(decoded.date == 201026 && decoded.time_cs == 0);
+
+	fix.time_cs = 20;
+	encoder.encode(fix, 255, line, sizeof(line));
+	assert(decoder.decode(line, &decoded) == DELTA_OK);
+	assert(decoder.keyframes == 2);
+	assert(sameFix(fix, decoded));
+}
+
+void testDeltaGap(){
+	Delta_Encoder encoder;
+	Delta_Decoder decoder;
+	char line[LINE_MAX_LEN];
+	DeltaFix decoded;
+	int i = 0;
+	for(; i < 3; i++){
+		encoder.encode(trackFix(i), 6, line, sizeof(line));
+		assert(decoder.decode(line, &decoded) == DELTA_OK);
+	}
+	// Frames 3 and 4 are lost; 5 has nothing to apply to
+	encoder.encode(trackFix(i++), 6, line, sizeof(line));
+	encoder.encode(trackFix(i++), 6, line, sizeof(line));
+	encoder.encode(trackFix(i++), 6, line, sizeof(line));
+	assert(decoder.decode(line, &decoded) == DELTA_NO_BASE);
+	assert(decoder.lost == 2 && decoder.skipped == 1);
+
+	// Frame 6 is the next key frame and resynchronises the stream
+	encoder.encode(trackFix(i), 6, line, sizeof(line));
+	assert(isKeyframe(line));
+	assert(decoder.decode(line, &decoded) == DELTA_OK);
+	assert(sameFix(trackFix(i++), decoded));
+	encoder.encode(trackFix(i), 6, line, sizeof(line));
+	assert(decoder.decode(line, &decoded) == DELTA_OK);
+	assert(sameFix(trackFix(i++), decoded));
+	assert(decoder.lost == 2 && decoder.skipped == 1);
+
+	// A reset encoder starts over with a key frame
+	encoder.reset();
+	encoder.encode(trackFix(i), 6, line, sizeof(line));
+	assert(isKeyframe(line));
+}
+
+void testDeltaCorrupt(){
+	Delta_Encoder encoder;
+	Delta_Decoder decoder;
+	char line[LINE_MAX_LEN];
+	DeltaFix decoded;
+	encoder.encode(trackFix(0), 10, line, sizeof(line));
+	assert(decoder.decode(line, &decoded) == DELTA_OK);
+
+	encoder.encode(trackFix(1), 10, line, sizeof(line));
+	char corrupt[LINE_MAX_LEN];
+	strcpy(corrupt, line);
+	corrupt[4] = (corrupt[4] == 'A') ? 'B' : 'A';
+	assert(decoder.decode(corrupt, &decoded) == DELTA_INVALID);
+	assert(decoder.invalid == 1);
+
+	// Not a frame at all
+	assert(decoder.decode("{\"lat\": 1}", &decoded) == DELTA_INVALID);
+	assert(decoder.decode("~A*AAAA", &decoded) == DELTA_INVALID);
+	assert(decoder.decode("~AA", &decoded) == DELTA_INVALID);
+	assert(decoder.invalid == 4);
+
+	// The corrupted frame never reached the decoder as far as it can tell,
+	// so the frame after it is a delta with no base
+	encoder.encode(trackFix(2), 10, line, sizeof(line));
+	assert(decoder.decode(line, &decoded) == DELTA_NO_BASE);
+	assert(decoder.lost == 1);
+}
+
+void testCRC24Q(){
+	// CRC-24Q check value
+	assert(RTCM_Relay::crc24q((const uint8_t*)"123456789", 9) == 0xCDE703);
+	// An RTCM3 1005 frame: preamble, length, message, CRC
+	static const uint8_t frame[] = {
+		0xD3, 0x00, 0x13, 0x3E, 0xD7, 0xD3, 0x02, 0x02, 0x98, 0x0E, 0xDE, 0xEF,
+		0x34, 0xB4, 0xBD, 0x62, 0xAC, 0x09, 0x41, 0x98, 0x6F, 0x33, 0x36, 0x0B,
+		0x98
+	};
+	size_t len = sizeof(frame) - 3;
+	assert(RTCM_Relay::crc24q(frame, len) == 0x360B98);
+	// In parts
+	assert(RTCM_Relay::crc24q(frame + 5, len - 5,
+		RTCM_Relay::crc24q(frame, 5)) == 0x360B98);
+
+	RTCM_Relay relay;
+	for(size_t i = 0; i < sizeof(frame); i++){
+		assert(relay.decode(frame[i]));
+	}
+	// Status bytes are left alone
+	assert(!relay.decode('{'));
+	for(size_t i = 0; i < sizeof(frame); i++){
+		relay.decode((i == 10) ? frame[i] ^ 0x01 : frame[i]);
+	}
+	DiagnosticsPacket diag;
+	memset(&diag, 0, sizeof(diag));
+	relay.getDiagnostics(&diag);
+	assert(diag.rtcm_frames == 1);
+	assert(diag.rtcm_crc_errors == 1);
+}
+
+void testRTCMTimeout(){
+	static const uint8_t frame[] = {
+		0xD3, 0x00, 0x13, 0x3E, 0xD7, 0xD3, 0x02, 0x02, 0x98, 0x0E, 0xDE, 0xEF,
+		0x34, 0xB4, 0xBD, 0x62, 0xAC, 0x09, 0x41, 0x98, 0x6F, 0x33, 0x36, 0x0B,
+		0x98
+	};
+	RTCM_Relay relay;
+	DiagnosticsPacket diag;
+	memset(&diag, 0, sizeof(diag));
+
+	// Pauses shorter than the timeout do not break a frame
+	uint32_t now = 0xFFFFF000UL;
+	for(size_t i = 0; i < sizeof(frame); i++){
+		assert(relay.decode(frame[i]));
+		relay.idle(now);
+		now += RTCM_GAP_TIMEOUT_US / 2;
+		relay.idle(now);
+	}
+	// An idle link between frames is no timeout either
+	relay.idle(now + 10 * RTCM_GAP_TIMEOUT_US);
+	relay.getDiagnostics(&diag);
+	assert(diag.rtcm_frames == 1 && diag.rtcm_timeouts == 0);
+
+	// A frame cut short gives the link back to the status parser
+	for(size_t i = 0; i < 10; i++){
+		assert(relay.decode(frame[i]));
+	}
+	relay.idle(now);
+	assert(relay.decode('{'));
+	relay.idle(now);
+	relay.idle(now + RTCM_GAP_TIMEOUT_US + 1);
+	assert(!relay.decode('{'));
+	relay.getDiagnostics(&diag);
+	assert(diag.rtcm_frames == 1 && diag.rtcm_timeouts == 1);
+	assert(diag.rtcm_crc_errors == 0 && diag.rtcm_dropped == 0);
+
+	// The next frame goes through whole
+	for(size_t i = 0; i < sizeof(frame); i++){
+		relay.decode(frame[i]);
+	}
+	relay.getDiagnostics(&diag);
+	assert(diag.rtcm_frames == 2 && diag.rtcm_crc_errors == 0);
+}
+
+/**
+ * Pseudo random number in [0, 1), so that the test is repeatable.
+ */
+double lcg(uint32_t* state){
+	*state = *state * 1664525UL + 1013904223UL;
+	return (*state >> 8) / 16777216.0;
+}
+
+void testClockSync(){
+	// The UIB clock runs 40 ppm fast and wraps during the run
+	const double drift = 40e-6;
+	const uint64_t start_ns = 5000000000ULL;
+	const uint32_t start_uib = 0xFFFFFFFFUL - 20000000UL;
+	auto uib_at = [&](uint64_t host_ns){
+		return (uint32_t)(start_uib
+			+ (uint64_t)((host_ns - start_ns) / 1e3 * (1 + drift)));
+	};
+
+	Clock_Sync sync(32);
+	assert(!sync.valid());
+	assert(sync.toHost(start_uib) == 0);
+	uint32_t rng = 1;
+	uint64_t t = start_ns;
+	for(int i = 0; i < 120; i++){
+		// USB and loop latency: every other exchange near the floor, the
+		// rest anywhere up to a few ms
+		uint64_t up_ns = 150000 + (uint64_t)(lcg(&rng) * 4e6);
+		uint64_t down_ns = 150000 + (uint64_t)(lcg(&rng) * 4e6);
+		if(i % 2 == 0){
+			up_ns = 150000 + (uint64_t)(lcg(&rng) * 2e4);
+			down_ns = 150000 + (uint64_t)(lcg(&rng) * 2e4);
+		}
+		uint64_t t0 = t;
+		uint16_t id = sync.request(t0);
+		uint32_t rx = uib_at(t0 + up_ns);
+		uint32_t tx = uib_at(t0 + up_ns + 80000);
+		uint64_t t3 = t0 + up_ns + 80000 + down_ns;
+		char line[64];
+		snprintf(line, sizeof(line), "{\"clk\": %u, \"rx\": %lu, \"tx\": %lu}",
+			id, (unsigned long)rx, (unsigned long)tx);
+		// A stale reply is ignored
+		if(i == 50){
+			char stale[64];
+			snprintf(stale, sizeof(stale),
+				"{\"clk\": %u, \"rx\": 1, \"tx\": 2}", (unsigned)(id - 1));
+			assert(!sync.reply(stale, t3));
+		}
+		assert(sync.reply(line, t3));
+		assert(!sync.reply(line, t3));
+		t += 500000000ULL;
+	}
+	assert(sync.valid());
+	assert(sync.samples() == 32);
+	assert(sync.minDelay() < 400000);
+	assert(fabs(sync.driftPPM() - 40) < 2);
+
+	// Times both sides of the wrap map to within 100 us
+	for(uint64_t host_ns = t - 20000000000ULL; host_ns < t;
+			host_ns += 1000000000ULL){
+		double error = (double)(int64_t)(sync.toHost(uib_at(host_ns))
+			- host_ns);
+		assert(fabs(error) < 100000);
+	}
+
+	sync.reset();
+	assert(!sync.valid() && sync.samples() == 0);
+}
+
+int main(int argc, char const *argv[]){
+	testDeltaRoundTrip();
+	testDeltaDateChange();
+	testDeltaGap();
+	testDeltaCorrupt();
+	testCRC24Q();
+	testRTCMTimeout();
+	testClockSync();
+	return 0;
+}
@@ -29,137 +29,276 @@
 #include "ui_core.hpp"
 #include "Sensor_Module.hpp"
 #include "Status_Module.hpp"
-#include "LED.hpp"
+#include "LED_Engine.hpp"
+#include "Diagnostics.hpp"
+#include "Config_Store.hpp"
+#include "RTCM_Relay.hpp"
+#include "Memory_Report.hpp"
+#include "Profiler.hpp"
+#include "Trace.hpp"
+#include "Watchdog.hpp"
+#include "Warm_Start.hpp"
 
-#define SENSOR_PACKET_MAX_LEN 128
+#define BLUE_LED_PIN 4
+#define RED_LED_PIN 12
+#define ORANGE_LED_PIN 6
+#define YELLOW_LED_PIN 8
+#define GREEN_LED_PIN 9
 
-#define SLEEP_TIME 100
+/**
+ * LED indices into the LED engine, in the same order as the engine's pins.
+ */
+enum LEDIndex{
+	LED_BLUE,
+	LED_RED,
+	LED_ORANGE,
+	LED_YELLOW,
+	LED_GREEN
+};
 
-uint8_t count = 0;
-uint8_t blueState = 0,
-	redState = 0, 
-	orangeState = 0, 
-	yellowState = 0, 
-	greenState = 0;
 char sensor_packet_buf[SENSOR_PACKET_MAX_LEN];
+/// RCT_Micros() at the start of the last status message
+uint32_t status_rx_us = 0;
 StatusPacket status;
+ConfigPacket config;
 Sensor_Module sensor(&status.gps);
-Status_Module obc(&status);
+Status_Module obc(&status, &config);
+RTCM_Relay rtcm;
+Diagnostics diagnostics;
+Watchdog watchdog;
+
+LED_Engine<BLUE_LED_PIN, RED_LED_PIN, ORANGE_LED_PIN, YELLOW_LED_PIN,
+	GREEN_LED_PIN> leds;
 
-LED blue, red, orange, yellow, green;
+LEDState gps_map[GPS__SIZE] {FAST, OFF, SLOW, ON};
+LEDState storage_map[STR__SIZE] {FAST, FAST, FAST, SLOW, ON, SLOW};
+LEDState sdr_map[SDR__SIZE] {FAST, SLOW, FAST, ON, SLOW};
+LEDState system_map[SYS__SIZE] {FAST, FAST, ON, ON, OFF, ON, SLOW};
 RCT_HAL_System_t systemDescriptor;
 RCT_HAL_System_t* pHALSystem = NULL;
 
-// write interrupt handler (happens everything timer interrupt happens)
-// Figure out how to configure timer to 5 hz, set leds at 5hz only if handler called
+/**
+ * Shows the subsystem states on the LEDs.
+ */
+void showStatus(){
+	leds.set(LED_BLUE, system_map[status.system]);
+	leds.set(LED_RED, storage_map[status.storage]);
+	leds.set(LED_ORANGE, sdr_map[status.sdr]);
+	leds.set(LED_YELLOW, gps_map[status.gps]);
 
-inline void blink(uint8_t pin){
-	digitalWrite(pin, HIGH);
-	delay(SLEEP_TIME);
-	digitalWrite(pin, LOW);
+	if( status.system == SYS_WAIT_START
+		&& status.storage == STR_READY
+		&& status.sdr == SDR_READY
+		&& status.gps == GPS_READY ) {
+		leds.set(LED_GREEN, ON);
+	}
 }
 
 void setup() {
 	pHALSystem = &systemDescriptor;
-	pHALSystem->RCT_SerialOBC = &Serial;
-	pHALSystem->RCT_SerialGPS = &Serial1;
-	Serial.begin(9600); // via USB
-	Serial1.begin(9600); // GPS
-	// Set up LEDs
-	blue.pin = 4;
-	red.pin = 12;
-	orange.pin = 6;
-	yellow.pin = 8;
-	green.pin = 9;
-	pinMode(green.pin, OUTPUT);
-	pinMode(yellow.pin, OUTPUT);
-	pinMode(orange.pin, OUTPUT);
-	pinMode(red.pin, OUTPUT);
-	pinMode(blue.pin, OUTPUT);
+	RCT_HAL_Init(pHALSystem);
+	pHALSystem->RCT_BeginOBC(9600); // via USB
+	pHALSystem->RCT_BeginGPS(9600); // GPS
+	bool warm = Warm_Start::begin(pHALSystem->RCT_ResetFlags());
+	// Set up LEDs; the self test sweeps them from the timer tick
+	leds.begin();
+	if(!warm){
+		leds.selfTest();
+	}
 	
 	// Set up timer
-	cli();
-	TCCR1A = 0;
-	TCCR1B = 0;
-	TCNT1  = 0;
-	OCR1A = 3124;
-	TCCR1B |= (1 << WGM12);
-	TCCR1B |= (1 << CS12) | (1 << CS10);  
-	TIMSK1 |= (1 << OCIE1A);
-	sei();
-
-	sensor.start();
-
-	blink(blue.pin);
-	blink(red.pin);
-	blink(orange.pin);
-	blink(yellow.pin);
-	blink(green.pin);
-}
+	pHALSystem->RCT_StartTick();
 
-inline void setLED(LEDState state, uint8_t count, uint8_t& blinkState){
-	switch(state){
-		case OFF:
-			blinkState = LOW;
-			break;
-		case SLOW:
-			if(count == 4){
-				blinkState = !blinkState;
-			}
-			break;
-		case FAST:
-			blinkState = !blinkState;
-			break;
-		case ON:
-			blinkState = HIGH;
+#ifdef RCT_PROFILE
+	profiler.begin();
+#endif
+#ifdef RCT_TRACE
+	trace.begin();
+#endif
+
+	Config_Store::load(&config);
+	sensor.configure(config);
+	sensor.start(warm);
+	if(warm){
+		// Pick up where the reset interrupted
+		const WarmState& kept = Warm_Start::state();
+		status = kept.status;
+		if(kept.sensor_valid){
+			sensor.restoreState(kept.sensor);
+		}
+	}
+	// A stuck I2C bus would hang the compass again; carry on without a
+	// heading instead
+	if(Warm_Start::stuck() != 0 && Sensor_Module::compassHung()){
+		sensor.skipCompass();
+	}
+	if(warm){
+		showStatus();
 	}
+	Warm_Start::print(pHALSystem->RCT_SerialOBC);
+	watchdog.begin();
+	diagnostics.setupDone(pHALSystem->RCT_Micros());
+}
+
+RCT_TICK_HANDLER() {
+	PROFILE_BEGIN(PROF_TIMER_ISR);
+	TRACE(TRACE_TIMER_ISR, 0);
+	leds.update();
+	watchdog.tick();
+	PROFILE_END(PROF_TIMER_ISR);
+}
 
+/**
+ * Fills in every diagnostics field that is cheap enough to gather from
+ * interrupt context.
+ */
+void collectDiagnostics(DiagnosticsPacket* diag){
+	diagnostics.getDiagnostics(diag);
+	sensor.getDiagnostics(diag);
+	obc.getDiagnostics(diag);
+	rtcm.getDiagnostics(diag);
+	Warm_Start::getDiagnostics(diag);
 }
 
-ISR( TIMER1_COMPA_vect ) { //timer1 interrupt 1Hz
-	count = (count + 1) % 5;
-	setLED(blue.ledstate, count, blueState);
-	setLED(red.ledstate, count, redState);
-	setLED(orange.ledstate, count, orangeState);
-	setLED(yellow.ledstate, count, yellowState);
-	setLED(green.ledstate, count, greenState);
-	digitalWrite(green.pin, greenState);
-	digitalWrite(yellow.pin, yellowState);
-	digitalWrite(orange.pin, orangeState);
-	digitalWrite(red.pin, redState);
-	digitalWrite(blue.pin, blueState);
+void watchdog_expired(void) {
+	DiagnosticsPacket diag;
+	collectDiagnostics(&diag);
+	Warm_Start::expire(watchdog.stuck(), diag);
 }
 
-LEDState gps_map[5] {FAST, OFF, SLOW, ON, OFF};
-LEDState storage_map[STR__SIZE] {FAST, FAST, FAST, SLOW, ON, SLOW};
-LEDState sdr_map[SDR__SIZE] {FAST, SLOW, FAST, ON, SLOW};
-LEDState system_map[SYS__SIZE] {FAST, FAST, ON, ON, OFF, ON, SLOW};
+void sendDiagnostics(){
+	DiagnosticsPacket diag;
+	collectDiagnostics(&diag);
+	Memory_Report::getDiagnostics(&diag);
+	Diagnostics::print(pHALSystem->RCT_SerialOBC, diag);
+	Warm_Start::saveCounters(diag);
+}
+
+/**
+ * Applies the configuration, stores it if anything was changed and
+ * acknowledges it to the OBC.
+ */
+void applyConfig(uint8_t applied, uint8_t rejected){
+	sensor.configure(config);
+	if(applied){
+		Config_Store::save(config);
+	}
+	Config_Store::print(pHALSystem->RCT_SerialOBC, config, applied, rejected);
+}
+
+/**
+ * Answers a clock synchronisation request with the time the request was
+ * received and the time the answer is sent, both RCT_Micros().  This goes
+ * out before any other reply so that nothing is queued ahead of it.
+ */
+void sendClock(uint16_t id){
+	uint32_t tx_us = pHALSystem->RCT_Micros();
+	Print* out = pHALSystem->RCT_SerialOBC;
+	out->print(F("{\"clk\": "));
+	out->print(id);
+	out->print(F(", \"rx\": "));
+	out->print(status_rx_us);
+	out->print(F(", \"tx\": "));
+	out->print(tx_us);
+	out->println(F("}"));
+}
 
 void loop() {
+	diagnostics.loopTick(pHALSystem->RCT_Micros());
+	diagnostics.checkRX(DIAG_PORT_GPS, pHALSystem->RCT_SerialGPS->available());
+	diagnostics.checkRX(DIAG_PORT_OBC, pHALSystem->RCT_SerialOBC->available());
+
 	if (pHALSystem->RCT_SerialGPS->available() > 0){
 		char c = pHALSystem->RCT_SerialGPS->read();
-		if(sensor.decode(c)){
+		PROFILE_BEGIN(PROF_SENSOR_DECODE);
+		int packet_ready = sensor.decode(c);
+		PROFILE_END(PROF_SENSOR_DECODE);
+		const char* raw = sensor.getPassthrough();
+		if(raw != NULL){
+			// Straight from the parser's buffer, ahead of any packet it made
+			pHALSystem->RCT_SerialOBC->println(raw);
+		}
+		if(packet_ready){
+			TRACE(TRACE_PACKET_START, 0);
+			PROFILE_BEGIN(PROF_GET_PACKET);
 			sensor.getPacket(sensor_packet_buf, SENSOR_PACKET_MAX_LEN);
+			PROFILE_END(PROF_GET_PACKET);
+			PROFILE_BEGIN(PROF_OBC_PRINTLN);
 			pHALSystem->RCT_SerialOBC->println(sensor_packet_buf);
+			PROFILE_END(PROF_OBC_PRINTLN);
+			diagnostics.packetSent(pHALSystem->RCT_Millis());
+			TRACE(TRACE_PACKET_END, strlen(sensor_packet_buf));
+			Warm_Start::saveSensor(sensor.getState());
 		}
 	}
+	watchdog.checkIn(WDT_TASK_GPS);
 
 	if(pHALSystem->RCT_SerialOBC->available() > 0){
 		char c = pHALSystem->RCT_SerialOBC->read();
-		if(obc.decode(c)){
-			
-			blue.ledstate = system_map[status.system];
-			red.ledstate = storage_map[status.storage];
-			orange.ledstate = sdr_map[status.sdr];
-			yellow.ledstate = gps_map[status.gps];
+		bool rtcm_byte = rtcm.decode(c);
+		if(!rtcm_byte && c == '{'){
+			status_rx_us = pHALSystem->RCT_Micros();
+		}
+		if(!rtcm_byte && obc.decode(c)){
+			TRACE(TRACE_OBC_STATUS, 0);
+
+			uint16_t clock_id;
+			if(obc.getClockRequest(&clock_id)){
+				sendClock(clock_id);
+			}
 			
-			if( status.system == SYS_WAIT_START
-				&& status.storage == STR_READY
-				&& status.sdr == SDR_READY
-				&& status.gps == GPS_READY ) {
-				green.ledstate = ON;
+			showStatus();
+			Warm_Start::saveStatus(status);
+
+			uint8_t applied, rejected;
+			if(obc.getConfigAck(&applied, &rejected)){
+				applyConfig(applied, rejected);
+			}
+
+			switch(obc.getRequest()){
+				case REQ_DIAGNOSTICS:
+					sendDiagnostics();
+					break;
+				case REQ_CONFIG:
+					Config_Store::print(pHALSystem->RCT_SerialOBC, config, 0, 0);
+					break;
+				case REQ_CONFIG_RESET:
+					Config_Store::defaults(&config);
+					sensor.configure(config);
+					Config_Store::save(config);
+					Config_Store::print(pHALSystem->RCT_SerialOBC, config, 0, 0);
+					break;
+#ifdef RCT_PROFILE
+				case REQ_PROFILE:
+					profiler.print(pHALSystem->RCT_SerialOBC);
+					break;
+				case REQ_PROFILE_RESET:
+					profiler.reset();
+					break;
+#endif
+#ifdef RCT_TRACE
+				case REQ_TRACE:
+					trace.print(pHALSystem->RCT_SerialOBC);
+					break;
+#endif
+				default:
+					break;
 			}
 		}
+	}else{
+		rtcm.idle(pHALSystem->RCT_Micros());
+	}
+	watchdog.checkIn(WDT_TASK_OBC);
+	sensor.service();
+	if(sensor.sampleCompass()){
+		sensor.printMagBatch(pHALSystem->RCT_SerialOBC);
+	}
+	watchdog.checkIn(WDT_TASK_SENSOR);
+
+	leds.set(LED_YELLOW, gps_map[status.gps]);
+	rtcm.service(pHALSystem->RCT_SerialGPS);
+
+	if(diagnostics.reportDue(pHALSystem->RCT_Millis())){
+		sendDiagnostics();
 	}
-	yellow.ledstate = gps_map[status.gps];
 }
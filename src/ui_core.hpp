@@ -27,11 +27,193 @@
 #ifndef __UI_CORE__
 #define __UI_CORE__
 
+#include <Arduino.h>
 
+/**
+ * Hardware Abstraction Layer descriptor.  Every access the firmware makes to
+ * the hardware goes through this descriptor, so that the same sources can run
+ * on the UIB (hal_arduino.cpp) or as a native process (host/hal_linux.cpp).
+ * The descriptor is filled in by RCT_HAL_Init().
+ */
 typedef struct RCT_HAL_System_{
+	/// Serial link to the OBC
 	Stream* RCT_SerialOBC;
+	/// Serial link to the GPS receiver
 	Stream* RCT_SerialGPS;
+
+	/**
+	 * (Re)starts the OBC serial link.
+	 * @param baud Baud rate
+	 */
+	void (*RCT_BeginOBC)(uint32_t baud);
+	/**
+	 * (Re)starts the GPS serial link.
+	 * @param baud Baud rate
+	 */
+	void (*RCT_BeginGPS)(uint32_t baud);
+
+	/**
+	 * Writes to an I2C device.  A write of no bytes probes for the device.
+	 * @param  addr 7-bit device address
+	 * @param  data Bytes to write
+	 * @param  len  Number of bytes to write
+	 * @return      0 on success, otherwise a Wire endTransmission() error
+	 */
+	uint8_t (*RCT_I2CWrite)(uint8_t addr, const uint8_t* data, uint8_t len);
+	/**
+	 * Reads from an I2C device.
+	 * @param  addr 7-bit device address
+	 * @param  data Buffer to read into
+	 * @param  len  Number of bytes to read
+	 * @return      Number of bytes actually read
+	 */
+	uint8_t (*RCT_I2CRead)(uint8_t addr, uint8_t* data, uint8_t len);
+
+	/**
+	 * Configures a GPIO pin.
+	 * @param pin  Arduino pin number
+	 * @param mode INPUT, OUTPUT or INPUT_PULLUP
+	 */
+	void (*RCT_PinMode)(uint8_t pin, uint8_t mode);
+	/**
+	 * Reads a GPIO pin.
+	 * @param  pin Arduino pin number
+	 * @return     HIGH or LOW
+	 */
+	int (*RCT_DigitalRead)(uint8_t pin);
+	/**
+	 * Drives a GPIO pin.
+	 * @param pin   Arduino pin number
+	 * @param value HIGH or LOW
+	 */
+	void (*RCT_DigitalWrite)(uint8_t pin, uint8_t value);
+	/**
+	 * Attaches a handler to a pin change interrupt.
+	 * @param pin  Arduino pin number
+	 * @param isr  Interrupt handler
+	 * @param mode RISING, FALLING or CHANGE
+	 */
+	void (*RCT_AttachInterrupt)(uint8_t pin, void (*isr)(void), int mode);
+
+	/**
+	 * Measures the supply rail against the internal reference.
+	 * @return VCC in mV
+	 */
+	uint16_t (*RCT_ReadVCC)(void);
+
+	/**
+	 * Reads from the EEPROM.
+	 * @param addr First EEPROM address
+	 * @param data Buffer to read into
+	 * @param len  Number of bytes to read
+	 */
+	void (*RCT_EEPROMRead)(uint16_t addr, void* data, uint16_t len);
+	/**
+	 * Writes to the EEPROM, skipping bytes that already hold the value.
+	 * @param addr First EEPROM address
+	 * @param data Bytes to write
+	 * @param len  Number of bytes to write
+	 */
+	void (*RCT_EEPROMWrite)(uint16_t addr, const void* data, uint16_t len);
+
+	/**
+	 * Milliseconds since boot.
+	 */
+	uint32_t (*RCT_Millis)(void);
+	/**
+	 * Microseconds since boot.
+	 */
+	uint32_t (*RCT_Micros)(void);
+	/**
+	 * Blocks for the specified time.
+	 * @param ms Time to wait in ms
+	 */
+	void (*RCT_Delay)(uint32_t ms);
+
+	/**
+	 * Starts the 5 Hz system tick.  Each tick runs the RCT_TICK_HANDLER()
+	 * body from interrupt context.
+	 */
+	void (*RCT_StartTick)(void);
+
+	/**
+	 * Starts the hardware watchdog with a timeout of RCT_WATCHDOG_MS.  If it
+	 * is not kicked in time, watchdog_expired() is called from interrupt
+	 * context and the system resets straight after.
+	 */
+	void (*RCT_WatchdogStart)(void);
+	/**
+	 * Restarts the watchdog timeout.
+	 */
+	void (*RCT_WatchdogKick)(void);
+	/**
+	 * Causes of the last reset.
+	 * @return RCT_RESET_* flags, or 0 if the hardware did not say
+	 */
+	uint8_t (*RCT_ResetFlags)(void);
 }RCT_HAL_System_t;
 
+/**
+ * Size of the EEPROM in bytes.
+ */
+#define RCT_EEPROM_SIZE 1024
+
+/**
+ * Watchdog timeout in ms.
+ */
+#define RCT_WATCHDOG_MS 1000
+
+/**
+ * Reset causes, as reported by RCT_ResetFlags().  These are the MCUSR bits of
+ * the ATmega32U4.
+ */
+#define RCT_RESET_POWER_ON 0x01
+#define RCT_RESET_EXTERNAL 0x02
+#define RCT_RESET_BROWN_OUT 0x04
+#define RCT_RESET_WATCHDOG 0x08
+
+/**
+ * Places a variable in RAM that is left alone at startup, so that it keeps
+ * its value across any reset that does not remove power.  Such variables
+ * start out with whatever the RAM held and must be validated before use.
+ */
+#ifdef __AVR__
+#define RCT_NOINIT __attribute__((section(".noinit")))
+#else
+#define RCT_NOINIT __attribute__((section("rct_noinit")))
+#endif
+
 extern RCT_HAL_System_t* pHALSystem;
+
+/**
+ * Fills in a HAL descriptor for the platform being built for and initializes
+ * the underlying hardware.  Implemented by each HAL backend.
+ * @param system HAL descriptor to fill in
+ */
+void RCT_HAL_Init(RCT_HAL_System_t* system);
+
+/**
+ * 5 Hz system tick handler, called by the HAL.
+ */
+void timer_tick(void);
+
+/**
+ * Defines the system tick handler.  On the UIB this is the Timer 1 compare
+ * vector itself, so that the handler body is compiled into the vector and
+ * the ISR does not have to save every call-clobbered register for a call into
+ * another translation unit.  Off target it defines timer_tick(), which the
+ * HAL calls.
+ */
+#ifdef __AVR__
+#define RCT_TICK_HANDLER() ISR(TIMER1_COMPA_vect)
+#else
+#define RCT_TICK_HANDLER() void timer_tick(void)
+#endif
+
+/**
+ * Watchdog timeout handler, called by the HAL from interrupt context just
+ * before the watchdog resets the system.
+ */
+void watchdog_expired(void);
+
 #endif